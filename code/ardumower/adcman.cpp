@@ -31,6 +31,7 @@
 #include "config.h"
 #include "drivers.h"
 #include "flashmem.h"
+#include "RunningMedian.h"
 
 #define ADDR 500
 #define MAGIC 1
@@ -42,6 +43,9 @@
 #endif 
 
 #define NO_CHANNEL 255
+#define SEQUENCE_CHANNEL 254
+
+#define DMA_BUF_SIZE 512    // pair capture: 2 x 255 samples
 
 volatile short position = 0;
 volatile int16_t lastvalue = 0;
@@ -55,8 +59,19 @@ int16_t ADCMax[CHANNELS]; // ADC max sample value (ADC-ADC7)
 volatile boolean captureComplete[CHANNELS]; // ADC buffer filled?
 boolean autoCalibrate[CHANNELS]; // do auto-calibrate? (ADC0-ADC7)
 int16_t *sample[CHANNELS];   // ADC one sample (ADC0-ADC7) - 10 bit unsigned
+volatile boolean captureBusy[CHANNELS]; // ADC channel captured by DMA (DMA mode only)
+uint8_t pairChannel[CHANNELS]; // channel captured together with this channel (NO_CHANNEL: none)
 ADCManager ADCMan;
 
+#ifndef __AVR__
+volatile uint16_t dmaBuf[2][DMA_BUF_SIZE]; // DMA ping-pong buffers (raw ADC data)
+volatile uint8_t dmaBankChannel[2];  // channel captured into buffer (SEQUENCE_CHANNEL: one-sample channel sequence)
+volatile uint16_t dmaBankCount[2];   // number of samples in buffer
+volatile boolean dmaBankReady[2];    // buffer filled, waiting for run()
+volatile int8_t dmaBank = -1;        // buffer currently filled by DMA (-1 = DMA idle)
+uint8_t hwChannelToCh[16];           // ADC hardware channel number => channel (ADC0-ADC11)
+#endif
+
 
 ADCManager::ADCManager(){
   calibrationAvail = false;
@@ -68,6 +83,8 @@ ADCManager::ADCManager(){
     autoCalibrate[i] = false;
     ADCMax[i] = -9999;
     ADCMin[i] = 9999;
+    captureBusy[i] = false;
+    pairChannel[i] = NO_CHANNEL;
   }
   capturedChannels = 0;
   // NOTE: when choosing a higher perimeter sample rate (38 kHz) and using odometry interrupts, 
@@ -77,6 +94,12 @@ ADCManager::ADCManager(){
   //sampleRate = SRATE_19231;
   sampleRate = SRATE_38462;
   //sampleRate = SRATE_9615;
+#ifdef __AVR__
+  captureMode = CAPTURE_ISR;
+#else
+  captureMode = CAPTURE_DMA;
+  //captureMode = CAPTURE_ISR;
+#endif
 }
 
 void ADCManager::init(){    
@@ -92,7 +115,16 @@ void ADCManager::init(){
   adc_init(ADC, SystemCoreClock, adcclk, ADC_STARTUP_FAST); // startup=768 clocks
   adc_configure_timing(ADC, 0, ADC_SETTLING_TIME_3, 1);  // tracking=0, settling=17, transfer=1    
   ADC->ADC_MR |= ADC_MR_FREERUN_ON;   // free running  
+  if (captureMode == CAPTURE_DMA){
+    ADC->ADC_EMR |= ADC_EMR_TAG;      // channel number in converted data (for channel sequences)
+    ADC->ADC_PTCR = ADC_PTCR_RXTDIS;  // DMA off until first capture
+    for (int ch=0; ch < CHANNELS; ch++){
+      hwChannelToCh[g_APinDescription[A0+ch].ulADCChannelNumber & 0x0F] = ch;
+    }
+  }
   NVIC_EnableIRQ(ADC_IRQn);    
+#else
+  captureMode = CAPTURE_ISR;
 #endif
   delay(500); // wait for ADCRef to settle (stable ADCRef required for later calibration)
   if (loadCalib()) printCalib();
@@ -106,6 +138,17 @@ void ADCManager::setCapture(byte pin, byte samplecount, boolean autoCalibrateOfs
   autoCalibrate[ch] = autoCalibrateOfs;
 }
 
+void ADCManager::setCapturePair(byte pin0, byte pin1, byte samplecount, boolean autoCalibrateOfs){
+  setCapture(pin0, samplecount, autoCalibrateOfs);
+  setCapture(pin1, samplecount, autoCalibrateOfs);
+  pairChannel[pin0-A0] = pin1-A0;
+  pairChannel[pin1-A0] = pin0-A0;
+}
+
+int ADCManager::getInterleave(byte pin){
+  return ((captureMode == CAPTURE_DMA) && (pairChannel[pin-A0] != NO_CHANNEL)) ? 2 : 1;
+}
+
 void ADCManager::calibrate(){
   Console.println("ADC calibration...");
   for (int ch=0; ch < CHANNELS; ch++){    
@@ -131,7 +174,7 @@ void ADCManager::calibrateOfs(byte pin){
   ADCMin[ch] = 9999;
   ofs[ch]=0;    
   for (int i=0; i < 10; i++){
-    captureComplete[ch]=false;      
+    restart(pin);
     while (!isCaptureComplete(pin)) {
       delay(20);
       run();    
@@ -211,12 +254,91 @@ void ADCManager::startCapture(int sampleCount){
   startADC(sampleCount);  
 }
 
+// convert one sample (remove offset, convert to signed 8 bit, min/max)
+static inline void storeSample(uint8_t ch, int pos, int16_t value){
+  value -= ofs[ch];                   
+  capture[ch][pos] =  min(SCHAR_MAX,  max(SCHAR_MIN, value / 4));   // convert to signed (zero = ADC/2)                                    
+  sample[ch][pos] = value;           
+  // determine min/max 
+  if (value < ADCMin[ch]) ADCMin[ch]  = value;
+  if (value > ADCMax[ch]) ADCMax[ch]  = value;        
+}
+
+#ifndef __AVR__
+// start DMA capture of next channel (or of next one-sample channel sequence) into buffer 'bank'
+// returns false if there is nothing to capture
+static boolean startDMA(byte bank){
+  static boolean sequenceTurn = false;
+  int ch = -1;
+  uint16_t mask = 0;
+  // alternate between multi-sample captures (perimeter) and one-sample channel sequences
+  sequenceTurn = !sequenceTurn;
+  if (sequenceTurn) mask = ADCMan.sequenceMask();
+  if (mask == 0) {
+    ch = ADCMan.nextChannel(channel, 2);
+    if (ch == -1) mask = ADCMan.sequenceMask();
+  }
+  if ((ch == -1) && (mask == 0)) return false;
+  uint32_t cher = 0;
+  uint16_t count = 0;
+  if (ch != -1){
+    channel = ch;
+    captureBusy[ch] = true;
+    cher = 1 << g_APinDescription[A0+ch].ulADCChannelNumber;
+    count = captureSize[ch];
+    byte pair = pairChannel[ch];
+    if (pair != NO_CHANNEL){
+      // pair: hardware converts both channels alternately
+      captureBusy[pair] = true;
+      cher |= 1 << g_APinDescription[A0+pair].ulADCChannelNumber;
+      count += captureSize[pair];
+    }
+    dmaBankChannel[bank] = ch;
+  } else {
+    for (ch=0; ch < CHANNELS; ch++){
+      if (mask & (1 << ch)){
+        captureBusy[ch] = true;
+        cher |= 1 << g_APinDescription[A0+ch].ulADCChannelNumber;
+        count++;
+      }
+    }
+    dmaBankChannel[bank] = SEQUENCE_CHANNEL;
+  }
+  dmaBankCount[bank] = count;
+  dmaBank = bank;
+  ADC->ADC_CHDR = 0xFFFF;            // disable all channels
+  ADC->ADC_CHER = cher;              // hardware converts enabled channels one after the other
+  ADC->ADC_RPR = (uint32_t)(uintptr_t)dmaBuf[bank];
+  ADC->ADC_RCR = count;  
+  ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+  adc_enable_interrupt(ADC, ADC_IER_ENDRX);  
+  adc_start( ADC );  
+  return true;
+}
+
+static void stopDMA(){
+  ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+  adc_disable_interrupt(ADC, 0xFFFFFFFF);
+  ADC->ADC_CHDR = 0xFFFF;
+}
+#endif
+
 #ifdef __AVR__  // Arduino Mega
 // free running ADC fills capture buffer
 ISR(ADC_vect){
   volatile int16_t value = ADC;    
 #else  // Arduino Due (ARM)
 void ADC_Handler(void){   
+  if (ADCMan.captureMode == CAPTURE_DMA){
+    // DMA buffer filled: hand it over to run() and continue with other buffer (if free)
+    if ((adc_get_status(ADC) & ADC_ISR_ENDRX) != ADC_ISR_ENDRX) return;
+    stopDMA();
+    byte bank = dmaBank;
+    dmaBankReady[bank] = true;
+    dmaBank = -1;
+    if (!dmaBankReady[1-bank]) startDMA(1-bank);
+    return;
+  }
   if ((adc_get_status(ADC) & ADC_ISR_DRDY) != ADC_ISR_DRDY) return;
   volatile int16_t value = adc_get_latest_value(ADC) >> 2;     
 #endif  
@@ -227,12 +349,7 @@ void ADC_Handler(void){
     busy=false;
     return;
   } 
-  value -= ofs[channel];                   
-  capture[channel][position] =  min(SCHAR_MAX,  max(SCHAR_MIN, value / 4));   // convert to signed (zero = ADC/2)                                    
-  sample[channel][position] = value;           
-  // determine min/max 
-  if (value < ADCMin[channel]) ADCMin[channel]  = value;
-  if (value > ADCMax[channel]) ADCMax[channel]  = value;        
+  storeSample(channel, position, value);
   position++;      
 }
 
@@ -250,6 +367,10 @@ void ADCManager::stopCapture(){
 
 
 void ADCManager::run(){
+  if (captureMode == CAPTURE_DMA){
+    runDMA();
+    return;
+  }
   if (busy) {
     //Console.print("busy pos=");
     //Console.println(position);
@@ -261,15 +382,96 @@ void ADCManager::run(){
     capturedChannels++;
   }
   // find next channel for capturing
-  for (int i=0; i < CHANNELS; i++){    
-    channel++;
-    if (channel == CHANNELS) channel = 0;
-    if ((captureSize[channel] != 0) && (!captureComplete[channel])){        
-      // found channel for sampling      
-      startCapture( captureSize[channel] );                   
+  int ch = nextChannel(channel, 1);
+  if (ch != -1){
+    // found channel for sampling      
+    channel = ch;
+    startCapture( captureSize[channel] );                   
+  }
+}
+
+void ADCManager::runDMA(){
+#ifndef __AVR__
+  // batch pass: convert filled DMA buffers
+  for (byte bank=0; bank < 2; bank++){
+    if (!dmaBankReady[bank]) continue;
+    const uint16_t *raw = (const uint16_t*)dmaBuf[bank];
+    if (dmaBankChannel[bank] == SEQUENCE_CHANNEL) storeSequence(raw, dmaBankCount[bank]);
+      else if (pairChannel[dmaBankChannel[bank]] != NO_CHANNEL) storePair(dmaBankChannel[bank], raw, dmaBankCount[bank]);
+      else storeCapture(dmaBankChannel[bank], raw, dmaBankCount[bank]);
+    dmaBankReady[bank] = false;
+  }
+  // DMA idle? start next capture
+  noInterrupts();
+  if (dmaBank == -1){
+    for (byte bank=0; bank < 2; bank++){
+      if (dmaBankReady[bank]) continue;
+      if (!startDMA(bank)) stopDMA();
       break;
-    }      
+    }
+  }
+  interrupts();
+#endif
+}
+
+int ADCManager::nextChannel(int ch, byte minSampleCount){
+  for (int i=0; i < CHANNELS; i++){    
+    ch++;
+    if (ch >= CHANNELS) ch = 0;
+    if ((captureSize[ch] < minSampleCount) || (captureComplete[ch]) || (captureBusy[ch])) continue;
+    // DMA: pair is captured together only
+    byte pair = pairChannel[ch];
+    if ((captureMode == CAPTURE_DMA) && (pair != NO_CHANNEL) && ((captureComplete[pair]) || (captureBusy[pair]))) continue;
+    return ch;
+  }
+  return -1;
+}
+
+uint16_t ADCManager::sequenceMask(){
+  uint16_t mask = 0;
+  for (int ch=0; ch < CHANNELS; ch++){
+    if ((captureSize[ch] == 1) && (!captureComplete[ch]) && (!captureBusy[ch])) mask |= (1 << ch);
+  }
+  return mask;
+}
+
+void ADCManager::storeCapture(byte ch, const uint16_t *raw, int count){
+  if (count > captureSize[ch]) count = captureSize[ch];
+  for (int i=0; i < count; i++){
+    storeSample(ch, i, (raw[i] & 0x0FFF) >> 2);
   }
+  captureBusy[ch] = false;
+  captureComplete[ch] = true;
+  capturedChannels++;
+}
+
+void ADCManager::storeSequence(const uint16_t *raw, int count){
+#ifndef __AVR__
+  for (int i=0; i < count; i++){
+    byte ch = hwChannelToCh[raw[i] >> 12];
+    if (captureSize[ch] == 0) continue;
+    storeSample(ch, 0, (raw[i] & 0x0FFF) >> 2);
+    captureBusy[ch] = false;
+    captureComplete[ch] = true;
+    capturedChannels++;
+  }
+#endif
+}
+
+void ADCManager::storePair(byte ch, const uint16_t *raw, int count){
+#ifndef __AVR__
+  byte pair = pairChannel[ch];
+  int pos[CHANNELS];
+  pos[ch] = pos[pair] = 0;
+  for (int i=0; i < count; i++){
+    byte c = hwChannelToCh[raw[i] >> 12];
+    if (((c != ch) && (c != pair)) || (pos[c] >= captureSize[c])) continue;
+    storeSample(c, pos[c]++, (raw[i] & 0x0FFF) >> 2);
+  }
+  captureBusy[ch] = captureBusy[pair] = false;
+  captureComplete[ch] = captureComplete[pair] = true;
+  capturedChannels += 2;
+#endif
 }
 
 
@@ -296,25 +498,17 @@ int ADCManager::readMedian(byte pin){
   captureComplete[ch]=false;    
   if (captureSize[ch] == 0) return 0;
   else if (captureSize[ch] == 1) return sample[ch][0];
-   else { 
-    for (int i = 1; i < captureSize[ch]; ++i)
-    {
-      int j = sample[ch][i];
-      int k;
-      for (k = i - 1; (k >= 0) && (j > sample[ch][k]); k--)
-      {
-        sample[ch][k + 1] = sample[ch][k];
-      }
-      sample[ch][k + 1] = j;
-    }
-    return sample[ch][(int)(captureSize[ch]/2 )];
-  }
+  // middle value (lower one if count is even), samples are reordered
+  int n = captureSize[ch];
+  return selectElement(sample[ch], n, n - 1 - n/2);
 }  
 
 
 
 void ADCManager::restart(byte pin){
-  captureComplete[pin-A0]=false;
+  int ch = pin-A0;
+  captureComplete[ch]=false;
+  if (pairChannel[ch] != NO_CHANNEL) captureComplete[pairChannel[ch]]=false;
 }
         
 int ADCManager::getCapturedChannels(){
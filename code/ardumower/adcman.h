@@ -29,6 +29,8 @@ Arduino ADC manager (ADC0-ADC9)
 - can capture multiple pins one after the other (example ADC0: 1000 samples, ADC1: 100 samples, ADC2: 1 sample etc.)
 - can capture more than one sample into buffers (fixed sample rate)
 - runs in background: interrupt-based (free-running) 
+- can capture two pins together (pair): Due DMA mode converts both channels alternately into one
+  buffer (each pin sampled at half the sample rate), otherwise the pins are captured one after the other
 - two types of ADC capture:
   1) free-running ADC capturing (for certain sample count) (8 bit signed - zero = VCC/2)
   2) ordinary ADC sampling (one-time sampling) (10 bit unsigned)
@@ -60,6 +62,12 @@ enum {
   SRATE_38462  
 };
 
+// capture modes
+enum {
+  CAPTURE_ISR,   // one interrupt per sample (Mega, Due)
+  CAPTURE_DMA,   // PDC/DMA ping-pong buffers, one interrupt per capture (Due only)
+};
+
 
 class ADCManager
 {
@@ -73,6 +81,10 @@ class ADCManager
     // samplecount = 1: 10 bit sampling (unsigned)
     // samplecount > 1: 8 bit sampling (signed - zero = VCC/2)    
     void setCapture(byte pin, byte samplecount, boolean autoCalibrateOfs);    
+    // configure sampling for two pins captured together (samplecount per pin, restart() restarts both)
+    void setCapturePair(byte pin0, byte pin1, byte samplecount, boolean autoCalibrateOfs);
+    // number of pins sampled alternately with pin (1: pin has the full sample rate)
+    int getInterleave(byte pin);
     // get buffer with samples for pin
     int8_t* getCapture(byte pin);        
     // restart sampling for pin
@@ -93,8 +105,24 @@ class ADCManager
     // calibration data available?
     boolean calibrationDataAvail();
     // get the manager running, starts sampling next pin
+    // (DMA mode: also converts finished DMA buffers)
     void run();    
     uint8_t sampleRate;
+    uint8_t captureMode;
+    // --- hardware independent capture logic (used by interrupt handlers, can be tested without ADC) ---
+    // find next channel (after channel 'ch') with at least 'minSampleCount' samples that needs a capture (-1 if none)
+    int nextChannel(int ch, byte minSampleCount);
+    // bitmask of all one-sample channels that need a capture
+    uint16_t sequenceMask();
+    // store raw ADC data of a finished capture for channel 'ch' (offset, clamp, min/max)
+    // raw: 12 bit ADC result in bits 0-11
+    void storeCapture(byte ch, const uint16_t *raw, int count);
+    // store raw ADC data of a finished one-sample channel sequence
+    // raw: 12 bit ADC result in bits 0-11, ADC hardware channel number (tag) in bits 12-15
+    void storeSequence(const uint16_t *raw, int count);
+    // store raw ADC data of a finished pair capture (samples of both channels alternating)
+    // raw: 12 bit ADC result in bits 0-11, ADC hardware channel number (tag) in bits 12-15
+    void storePair(byte ch, const uint16_t *raw, int count);
   private:
     int capturedChannels;    
     void startADC(int sampleCount);
@@ -102,6 +130,7 @@ class ADCManager
     void calibrateOfs(byte pin);
     void startCapture(int sampleCount);
     void stopCapture();    
+    void runDMA();
     boolean loadCalib();
     void loadSaveCalib(boolean readflag);
     void saveCalib();    
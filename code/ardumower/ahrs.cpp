@@ -0,0 +1,197 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "ahrs.h"
+
+#define AHRS_TWO_KP 4.0       // 2 * proportional gain (accelerometer/compass correction)
+#define AHRS_TWO_KI 0.2      // 2 * integral gain (gyro bias)
+
+// atan(i/64) in Q16 radiant, i=0..64
+static const uint16_t atanTable[65] PROGMEM = {
+      0,  1024,  2047,  3070,  4091,  5110,  6126,  7140,
+   8150,  9156, 10158, 11155, 12147, 13133, 14114, 15088,
+  16055, 17015, 17968, 18913, 19850, 20779, 21699, 22610,
+  23512, 24406, 25289, 26163, 27028, 27882, 28727, 29561,
+  30386, 31200, 32003, 32797, 33580, 34353, 35115, 35867,
+  36608, 37340, 38060, 38771, 39472, 40162, 40842, 41512,
+  42172, 42823, 43464, 44095, 44716, 45328, 45931, 46525,
+  47109, 47685, 48251, 48809, 49359, 49899, 50432, 50956,
+  51472,
+};
+
+float fastAtan2(float y, float x){
+  float ax = fabs(x);
+  float ay = fabs(y);
+  if ((ax == 0) && (ay == 0)) return 0;
+  // reduce to first octant (ratio 0..1)
+  boolean swap = (ay > ax);
+  float ratio = (swap) ? ax / ay : ay / ax;
+  uint32_t r = (uint32_t)(ratio * 65536.0);   // Q16
+  byte idx = r >> 10;
+  int32_t a = pgm_read_word(&atanTable[idx]);
+  if (idx < 64) {
+    int32_t b = pgm_read_word(&atanTable[idx + 1]);
+    a += ((b - a) * (int32_t)(r & 1023)) >> 10;
+  }
+  float angle = ((float)a) / 65536.0;
+  if (swap) angle = HALF_PI - angle;
+  if (x < 0) angle = PI - angle;
+  if (y < 0) angle = -angle;
+  return angle;
+}
+
+float fastAsin(float x){
+  if (x >= 1.0) return HALF_PI;
+  if (x <= -1.0) return -HALF_PI;
+  float c = 1.0 - x * x;
+  return fastAtan2(x, c * invSqrt(c));
+}
+
+// bit-level estimate and one Newton step (relative error < 0.2%)
+float invSqrt(float x){
+  union { float f; int32_t i; } u;
+  u.f = x;
+  u.i = 0x5f3759df - (u.i >> 1);
+  return u.f * (1.5f - (0.5f * x * u.f * u.f));
+}
+
+
+AHRS::AHRS(){
+  twoKp = AHRS_TWO_KP;
+  twoKi = AHRS_TWO_KI;
+  reset();
+}
+
+void AHRS::reset(){
+  q0 = 1;
+  q1 = q2 = q3 = 0;
+  integralX = integralY = integralZ = 0;
+  initialized = false;
+}
+
+// initial orientation from accelerometer and compass (no convergence time after start)
+void AHRS::init(float ax, float ay, float az, float mx, float my, float mz){
+  float roll  = atan2(ay, az);
+  float pitch = atan2(-ax, sqrt(ay * ay + az * az));
+  float yaw = 0;
+  if ((mx != 0) || (my != 0) || (mz != 0)) {
+    // tilt compensated compass
+    float hx = mx * cos(pitch) + (my * sin(roll) + mz * cos(roll)) * sin(pitch);
+    float hy = my * cos(roll) - mz * sin(roll);
+    yaw = atan2(-hy, hx);
+  }
+  float cr = cos(roll / 2);
+  float sr = sin(roll / 2);
+  float cp = cos(pitch / 2);
+  float sp = sin(pitch / 2);
+  float cy = cos(yaw / 2);
+  float sy = sin(yaw / 2);
+  q0 = cr * cp * cy + sr * sp * sy;
+  q1 = sr * cp * cy - cr * sp * sy;
+  q2 = cr * sp * cy + sr * cp * sy;
+  q3 = cr * cp * sy - sr * sp * cy;
+  initialized = true;
+}
+
+void AHRS::update(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt){
+  float recipNorm;
+  boolean useMag = ((mx != 0) || (my != 0) || (mz != 0));
+  // no correction without accelerometer data
+  if ((ax != 0) || (ay != 0) || (az != 0)) {
+    if (!initialized) init(ax, ay, az, mx, my, mz);
+    recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+    float q0q0 = q0 * q0;
+    float q0q1 = q0 * q1;
+    float q0q2 = q0 * q2;
+    float q0q3 = q0 * q3;
+    float q1q1 = q1 * q1;
+    float q1q2 = q1 * q2;
+    float q1q3 = q1 * q3;
+    float q2q2 = q2 * q2;
+    float q2q3 = q2 * q3;
+    float q3q3 = q3 * q3;
+    // estimated direction of gravity (half)
+    float halfvx = q1q3 - q0q2;
+    float halfvy = q0q1 + q2q3;
+    float halfvz = q0q0 - 0.5f + q3q3;
+    // error = cross product between estimated and measured direction
+    float halfex = (ay * halfvz - az * halfvy);
+    float halfey = (az * halfvx - ax * halfvz);
+    float halfez = (ax * halfvy - ay * halfvx);
+    if (useMag) {
+      recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+      mx *= recipNorm;
+      my *= recipNorm;
+      mz *= recipNorm;
+      // reference direction of earth's magnetic field
+      float hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+      float hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+      float hh = hx * hx + hy * hy;
+      float bx = hh * invSqrt(hh);
+      float bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+      // estimated direction of magnetic field (half)
+      float halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+      float halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+      float halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+      halfex += (my * halfwz - mz * halfwy);
+      halfey += (mz * halfwx - mx * halfwz);
+      halfez += (mx * halfwy - my * halfwx);
+    }
+    if (twoKi > 0) {
+      integralX += twoKi * halfex * dt;
+      integralY += twoKi * halfey * dt;
+      integralZ += twoKi * halfez * dt;
+      gx += integralX;
+      gy += integralY;
+      gz += integralZ;
+    }
+    gx += twoKp * halfex;
+    gy += twoKp * halfey;
+    gz += twoKp * halfez;
+  }
+  // integrate rate of change of quaternion
+  gx *= (0.5f * dt);
+  gy *= (0.5f * dt);
+  gz *= (0.5f * dt);
+  float qa = q0;
+  float qb = q1;
+  float qc = q2;
+  q0 += (-qb * gx - qc * gy - q3 * gz);
+  q1 += (qa * gx + qc * gz - q3 * gy);
+  q2 += (qa * gy - qb * gz + q3 * gx);
+  q3 += (qa * gz + qb * gy - qc * gx);
+  recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+void AHRS::getEuler(float &yaw, float &pitch, float &roll){
+  roll  = fastAtan2(q0 * q1 + q2 * q3, 0.5f - q1 * q1 - q2 * q2);
+  pitch = fastAsin(2.0f * (q0 * q2 - q1 * q3));
+  yaw   = fastAtan2(q1 * q2 + q0 * q3, 0.5f - q2 * q2 - q3 * q3);
+}
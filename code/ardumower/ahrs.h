@@ -0,0 +1,69 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+quaternion attitude and heading estimation (Mahony AHRS: gyro integration, accelerometer and
+compass feedback via PI correction, gyro bias estimated by the integral term)
+
+- update has no trigonometry (only multiply/add and a fast inverse square root)
+- Euler angles are computed with a table-based fixed-point atan2 (fastAtan2, max. error approx. 0.003 degree)
+- frame: sensor frame as used by the IMU (x forward, y left, z up), yaw counter-clockwise from north
+
+How to use it (example):
+  1. fixed rate update (e.g. 100 Hz):   ahrs.update(gx,gy,gz, ax,ay,az, mx,my,mz, 0.01);   // rad/s, any unit, any unit, s
+  2. read angles (radiant):             ahrs.getEuler(yaw, pitch, roll);
+*/
+
+#ifndef AHRS_H
+#define AHRS_H
+
+#include <Arduino.h>
+
+
+// atan2 (radiant) via lookup table (65 entries, Q16 radiant) and fixed-point interpolation
+float fastAtan2(float y, float x);
+// asin (radiant) via fastAtan2
+float fastAsin(float x);
+// 1/sqrt(x)
+float invSqrt(float x);
+
+
+class AHRS
+{
+  public:
+    AHRS();
+    void reset();
+    // gyro: rad/s, acc, mag: any (consistent) unit, mag all zero: no heading correction, dt: s
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+    void getEuler(float &yaw, float &pitch, float &roll);
+    float twoKp;    // 2 * proportional gain
+    float twoKi;    // 2 * integral gain
+    float q0, q1, q2, q3;  // quaternion (sensor frame relative to earth frame)
+    float integralX, integralY, integralZ;  // gyro bias (rad/s, scaled by Ki)
+  private:
+    boolean initialized;
+    void init(float ax, float ay, float az, float mx, float my, float mz);
+};
+
+
+#endif
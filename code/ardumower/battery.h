@@ -4,6 +4,12 @@
 void Robot::checkBattery(){
 if (millis() < nextTimeCheckBattery) return;
 	nextTimeCheckBattery = millis() + 1000;  
+  if (millis() >= nextTimeBatteryLog){
+    // event history: battery snapshot
+    nextTimeBatteryLog = millis() + 300000;
+    int16_t v[3] = { (int16_t)(batVoltage*1000), (int16_t)(chgVoltage*1000), (int16_t)(chgCurrent*1000) };
+    FlashLog.add(FLOG_BATTERY, 0, v, sizeof v);
+  }
   if (batMonitor){
     if ((batVoltage < batSwitchOffIfBelow) && (idleTimeSec != BATTERY_SW_OFF)) {      
 			Console.println(F("Battery warning: triggered batSwitchOffIfBelow"));
@@ -38,12 +38,19 @@ void Robot::printInfo(Stream &s){
 
   if (consoleMode == CONSOLE_OFF) {
   } else {
+  // console busy (e.g. Bluetooth back-pressure): skip this line instead of waiting
+  if ((&s == &Console) && (!ConsoleTx.reserve(CONSOLE_INFO_SIZE))) return;
   Streamprint(s, "t%6u ", (millis()-stateStartTime)/1000);  
   Streamprint(s, "L%3u ", loopsPerSec);  
   //Streamprint(s, "r%4u ", freeRam());  
   Streamprint(s, "m%1d ", consoleMode);			    
   Streamprint(s, "%4s ", stateNames[stateCurr]);			    
-  if (consoleMode == CONSOLE_PERIMETER){
+  if (consoleMode == CONSOLE_PROFILER){
+    // loop stage timing of the last second
+    Streamprint(s, "\r\n");
+    profiler.printReport(s);
+    profiler.reset();
+  } else if (consoleMode == CONSOLE_PERIMETER){
     Streamprint(s, "sig min %4d max %4d avg %4d mag %5d qty %3d",
       (int)perimeter.getSignalMin(0), (int)perimeter.getSignalMax(0), (int)perimeter.getSignalAvg(0),
       perimeterMag, (int)(perimeter.getFilterQuality(0)*100.0));
@@ -77,11 +84,8 @@ void Robot::printInfo(Stream &s){
       if (lawnSensorUse) Streamprint(s, "lawn %3d ", lawnSensorCounter);
       if (gpsUse) Streamprint(s, "gps %2d ", (int)gps.satellites());            
     }
-    Streamprint(s, "bat %2d.%01d ", (int)batVoltage, (int)((batVoltage *10) - ((int)batVoltage*10)) );       
-    Streamprint(s, "chg %2d.%01d %2d.%01d ", 
-        (int)chgVoltage, (int)((chgVoltage *10) - ((int)chgVoltage*10)),
-        (int)chgCurrent, (int)((abs(chgCurrent) *10) - ((int)abs(chgCurrent)*10))    
-      );    
+    Streamprint(s, "bat %4.1f ", batVoltage);       
+    Streamprint(s, "chg %4.1f %4.1f ", chgVoltage, chgCurrent);    
     Streamprint(s, "imu%3d ", imu.getCallCounter());  
     Streamprint(s, "adc%3d ", ADCMan.getCapturedChannels());  
     Streamprint(s, "%s\r\n", name.c_str());                  
@@ -106,6 +110,8 @@ void Robot::printMenu(){
   Console.println(F("r=delete robot stats"));  
   Console.println(F("x=print settings"));  
   Console.println(F("e=delete all errors"));  
+  Console.println(F("s=print task report (and GPS statistics)"));  
+  Console.println(F("h=print event history"));  
   Console.println(F("0=exit"));  
   Console.println();
 }
@@ -324,6 +330,17 @@ void Robot::menu(){
           Console.println(F("ALL ERRORS ARE DELETED"));          
           printMenu();
           break;          
+        case 's':
+          scheduler.printReport(Console);
+          scheduler.resetStats();
+          if (gpsUse) gps.printStats(Console);
+          if (fusionUse) fusion.print(Console);
+          printMenu();
+          break;          
+        case 'h':
+          FlashLog.print(Console, 100, stateNames, sizeof stateNames / sizeof stateNames[0]);
+          printMenu();
+          break;          
       }            
     }
     delay(10);
@@ -421,7 +438,7 @@ void Robot::readSerial() {
          menu(); // menu
          break;
        case 'v': 
-         consoleMode = (consoleMode +1) % 4;
+         consoleMode = (consoleMode +1) % 5;
          Console.println(consoleModeNames[consoleMode]);
          break; 
        case 'h':
@@ -0,0 +1,47 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), bytewise: flash images (settings, obstacle map) and
+telemetry frames
+
+How to use it (example):
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i < size; i++) crc = crc16(crc, data[i]);
+*/
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <Arduino.h>
+
+inline uint16_t crc16(uint16_t crc, byte data){
+  crc ^= ((uint16_t)data) << 8;
+  for (byte i=0; i < 8; i++){
+    if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+      else crc <<= 1;
+  }
+  return crc;
+}
+
+#endif
@@ -34,27 +34,6 @@ char *dayOfWeek[] = {"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
 
 // ---- print helpers ------------------------------------------------------------
 
-void StreamPrint_progmem(Print &out,PGM_P format,...)
-{
-  // program memory version of printf - copy of format string and result share a buffer
-  // so as to avoid too much memory use
-  char formatString[128], *ptr;
-  #ifdef __AVR__
-    strncpy_P( formatString, format, sizeof(formatString) ); // copy in from program mem
-  #else
-    strncpy( formatString, format, sizeof(formatString) ); // copy in from program mem  
-  #endif
-  // null terminate - leave char since we might need it in worst case for result's \0
-  formatString[ sizeof(formatString)-2 ]='\0';
-  ptr=&formatString[ strlen(formatString)+1 ]; // our result buffer...
-  va_list args;
-  va_start (args,format);
-  vsnprintf(ptr, sizeof(formatString)-1-strlen(formatString), formatString, args );
-  va_end (args);
-  formatString[ sizeof(formatString)-1 ]='\0';
-  out.print(ptr);
-}
-
 String verToString(int v){
   char buf[20] = {0};
   int a = v >> 12;
@@ -224,6 +203,11 @@ boolean readDS1307(datetime_t &dt){
     //addErrorCounter(ERR_RTC_COMM);
     return false;
   }      
+  return parseDS1307(buf, dt);
+}
+
+// check and convert DS1307 registers 0..7
+boolean parseDS1307(const byte *buf, datetime_t &dt){
   if (   ((buf[0] >> 7) != 0) || ((buf[1] >> 7) != 0) || ((buf[2] >> 7) != 0) || ((buf[3] >> 3) != 0) 
       || ((buf[4] >> 6) != 0) || ((buf[5] >> 5) != 0) || ((buf[7] & B01101100) != 0) ) {    
     Console.println("DS1307 data1 error");    
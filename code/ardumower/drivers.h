@@ -29,6 +29,7 @@
 #define DRIVERS_H
 
 #include <Arduino.h>
+#include "printfmt.h"
 #ifdef __AVR__
   // Arduino Mega
   #include <EEPROM.h>  
@@ -88,10 +89,8 @@ template <typename T> int sign(T val) {
 
 int freeRam();
   
-// print helpers
-void StreamPrint_progmem(Print &out,PGM_P format,...);
-#define Serialprint(format, ...) StreamPrint_progmem(Serial,PSTR(format),##__VA_ARGS__)
-#define Streamprint(stream,format, ...) StreamPrint_progmem(stream,PSTR(format),##__VA_ARGS__)
+// print helpers (Streamprint: see printfmt.h)
+#define Serialprint(format, ...) streamPrintFmt(Serial,PSTR(format),##__VA_ARGS__)
 String verToString(int v);
 
 // time helpers
@@ -124,6 +123,7 @@ int measureLawnCapacity(int pinSend, int pinReceive);
 
 // real time drivers
 boolean readDS1307(datetime_t &dt);
+boolean parseDS1307(const byte *buf, datetime_t &dt);
 boolean setDS1307(datetime_t &dt);
 
 
@@ -0,0 +1,207 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "encoder.h"
+
+
+EdgeRing::EdgeRing(){
+  head = tail = 0;
+  droppedFwd = droppedRev = 0;
+  seenFwd = seenRev = 0;
+  dropped = 0;
+}
+
+boolean EdgeRing::peek(uint32_t &time){
+  uint8_t t = tail;
+  if (t == head) return false;
+  time = times[t];
+  return true;
+}
+
+boolean EdgeRing::pop(uint32_t &time, int8_t &dir){
+  uint8_t t = tail;
+  if (t == head) return false;
+  time = times[t];
+  dir = dirs[t];
+  tail = (t + 1) & (ENCODER_RING_SIZE - 1);    // release after the entry is read
+  return true;
+}
+
+int EdgeRing::takeDropped(){
+  uint8_t fwd = droppedFwd;
+  uint8_t rev = droppedRev;
+  uint8_t newFwd = fwd - seenFwd;
+  uint8_t newRev = rev - seenRev;
+  seenFwd = fwd;
+  seenRev = rev;
+  dropped += newFwd + newRev;
+  return (int)newFwd - (int)newRev;
+}
+
+
+WheelSpeed::WheelSpeed(){
+  reset();
+}
+
+void WheelSpeed::reset(){
+  hasEdge = refValid = false;
+  dir = 1;
+  lastTime = refTime = period = 0;
+  edges = 0;
+  speed = 0;
+}
+
+void WheelSpeed::edge(uint32_t time, int8_t dir){
+  if ((!hasEdge) || (dir != this->dir) || (time - lastTime > ENCODER_STOP_TIME)){
+    // first edge after start, stop or reversal: reference only
+    period = 0;
+    refValid = false;
+    speed = 0;
+  } else if (refValid) {
+    period = time - lastTime;
+  }
+  if (!refValid){
+    refTime = time;
+    edges = 0;
+    refValid = true;
+  } else edges++;
+  this->dir = dir;
+  lastTime = time;
+  hasEdge = true;
+}
+
+void WheelSpeed::lost(){
+  // no period across the dropped edges, keeps the last estimate until the next one
+  period = 0;
+  refValid = false;
+}
+
+float WheelSpeed::update(uint32_t now){
+  if (!hasEdge) return speed = 0;
+  uint32_t idle = now - lastTime;
+  if ((int32_t)idle < 0) idle = 0;     // edge after 'now' (interrupt between micros() and run())
+  if (idle > ENCODER_STOP_TIME) {
+    period = 0;
+    refValid = false;
+    return speed = 0;
+  }
+  float value = fabs(speed);
+  if (edges > 0) value = edges * 1e6 / (float)(lastTime - refTime);   // edges over their time span
+    else if (period > 0) value = 1e6 / (float)period;                // no new edge: last period
+  // no edge for 'idle': the wheel is not faster than one edge per idle time
+  if ((idle > 0) && (value * idle > 1e6)) value = 1e6 / (float)idle;
+  refTime = lastTime;
+  edges = 0;
+  speed = dir * value;
+  return speed;
+}
+
+
+EncoderOdometry::EncoderOdometry(){
+  begin(1, 1);
+}
+
+void EncoderOdometry::begin(float ticksPerCm, float wheelBaseCm){
+  halfTick = 0.5 / ticksPerCm;
+  turn = 1.0 / (ticksPerCm * wheelBaseCm);
+  turnSin = sin(turn / 2);
+  turnCos = cos(turn / 2);
+  x = y = theta = distance = 0;
+  edges = 0;
+  speedLeft.reset();
+  speedRight.reset();
+  setHeading(0);
+}
+
+void EncoderOdometry::setHeading(float value){
+  heading = value;
+  headingSin = sin(value);
+  headingCos = cos(value);
+}
+
+// heading += sign * turn/2
+void EncoderOdometry::rotate(int8_t sign){
+  float s = headingSin;
+  float c = headingCos;
+  float ts = sign * turnSin;
+  headingSin = s * turnCos + c * ts;
+  headingCos = c * turnCos - s * ts;
+  heading += sign * turn / 2;
+}
+
+void EncoderOdometry::step(boolean isLeft, int count){
+  int8_t dir = (count > 0) ? 1 : -1;
+  // left forward edge turns clockwise (see Robot::calcOdometry)
+  int8_t sign = (isLeft) ? dir : -dir;
+  for (int i = abs(count); i > 0; i--){
+    rotate(sign);                  // heading at the middle of the step
+    x += dir * halfTick * headingSin;
+    y += dir * halfTick * headingCos;
+    distance += dir * halfTick;
+    rotate(sign);
+    theta += sign * turn;
+    edges++;
+  }
+}
+
+void EncoderOdometry::run(){
+  uint32_t timeLeft, timeRight;
+  int8_t dir = 0;
+  boolean hasLeft = left.peek(timeLeft);
+  boolean hasRight = right.peek(timeRight);
+  while ((hasLeft) || (hasRight)){
+    if ((hasLeft) && ((!hasRight) || ((int32_t)(timeLeft - timeRight) <= 0))){
+      left.pop(timeLeft, dir);
+      speedLeft.edge(timeLeft, dir);
+      step(true, dir);
+      hasLeft = left.peek(timeLeft);
+    } else {
+      right.pop(timeRight, dir);
+      speedRight.edge(timeRight, dir);
+      step(false, dir);
+      hasRight = right.peek(timeRight);
+    }
+  }
+  // dropped edges (ring full): pose without time, speed estimate restarts
+  int count = left.takeDropped();
+  if (count != 0) {
+    speedLeft.lost();
+    step(true, count);
+  }
+  count = right.takeDropped();
+  if (count != 0) {
+    speedRight.lost();
+    step(false, count);
+  }
+}
+
+void EncoderOdometry::update(uint32_t now){
+  speedLeft.update(now);
+  speedRight.update(now);
+}
+
+float EncoderOdometry::takeDistance(){
+  float value = distance;
+  distance = 0;
+  return value;
+}
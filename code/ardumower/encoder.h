@@ -0,0 +1,170 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+encoder odometry on edge timestamps: the odometry interrupts store the time (micros) and direction of
+each encoder edge, the loop integrates the pose edge by edge and estimates the wheel speeds
+
+- EdgeRing: lock-free single producer (interrupt) / single consumer (loop) ring, one byte indices
+  (atomic on the Mega), the producer only writes head, the consumer only tail; a full ring drops the
+  edge and counts it (one byte counter per direction), the loop applies dropped edges without time
+- WheelSpeed: edges counted over their exact time span (first to last edge since the previous
+  estimate, no window quantization), at low speed (no edge since the previous estimate) the last
+  inter-edge period, bounded by the time since the last edge (speed decays while the wheel slows
+  down), zero after ENCODER_STOP_TIME without edges
+- EncoderOdometry: the edges of both wheels in time order, each edge moves the pose by half a tick
+  along the heading at the middle of the step (heading turns by one tick difference / wheel base),
+  sin/cos of the heading are rotated by a precomputed half-step rotation (no trig per edge) and set
+  again by setHeading() on each odometry update (IMU yaw or wheel heading)
+
+How to use it (example):
+  EncoderOdometry encoders;
+  encoders.begin(odometryTicksPerCm, odometryWheelBaseCm);
+  encoders.left.push(micros(), 1);                         // odometry interrupt (forward edge)
+  encoders.run();                                          // each loop
+  encoders.update(micros());                               // odometry task (speed estimate)
+  rpm = encoders.getSpeedLeft() * 60 / odometryTicksPerRevolution;
+  encoders.setHeading(imu.ypr.yaw);
+*/
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+  #define ENCODER_RING_SIZE 32         // power of two
+#else
+  #define ENCODER_RING_SIZE 128
+#endif
+
+#define ENCODER_STOP_TIME 500000       // us without edge: wheel stopped
+
+
+class EdgeRing
+{
+  public:
+    EdgeRing();
+    // interrupt: edge at time (micros), direction +1/-1
+    inline void push(uint32_t time, int8_t dir){
+      uint8_t h = head;
+      uint8_t next = (h + 1) & (ENCODER_RING_SIZE - 1);
+      if (next == tail) {
+        if (dir > 0) droppedFwd++;
+          else droppedRev++;
+        return;
+      }
+      times[h] = time;
+      dirs[h] = dir;
+      head = next;          // publish after the entry is written
+    }
+    // loop: oldest edge
+    boolean peek(uint32_t &time);
+    boolean pop(uint32_t &time, int8_t &dir);
+    int getPending(){ return (head - tail) & (ENCODER_RING_SIZE - 1); }
+    // edges dropped since the last call (signed)
+    int takeDropped();
+    unsigned long getDropped(){ return dropped; }
+  private:
+    volatile uint32_t times[ENCODER_RING_SIZE];
+    volatile int8_t dirs[ENCODER_RING_SIZE];
+    volatile uint8_t head;       // producer
+    volatile uint8_t tail;       // consumer
+    volatile uint8_t droppedFwd; // producer
+    volatile uint8_t droppedRev;
+    uint8_t seenFwd;             // consumer
+    uint8_t seenRev;
+    unsigned long dropped;
+};
+
+
+class WheelSpeed
+{
+  public:
+    WheelSpeed();
+    void reset();
+    // edge at time (micros), direction +1/-1
+    void edge(uint32_t time, int8_t dir);
+    // edges without time (dropped): next estimate starts at the next edge
+    void lost();
+    // speed estimate at time now (micros), ticks per second (negative: backward)
+    float update(uint32_t now);
+    float getSpeed(){ return speed; }
+  private:
+    boolean hasEdge;
+    boolean refValid;
+    int8_t dir;
+    uint32_t lastTime;     // last edge
+    uint32_t refTime;      // last edge of the previous estimate
+    uint32_t period;       // us, last inter-edge period (0: none)
+    int edges;             // since refTime
+    float speed;
+};
+
+
+class EncoderOdometry
+{
+  public:
+    EdgeRing left;
+    EdgeRing right;
+    EncoderOdometry();
+    void begin(float ticksPerCm, float wheelBaseCm);
+    // integrates the received edges (time order)
+    void run();
+    // speed estimate (odometry task)
+    void update(uint32_t now);
+    float getSpeedLeft(){ return speedLeft.getSpeed(); }
+    float getSpeedRight(){ return speedRight.getSpeed(); }
+    // pose heading (rad, clockwise from the y axis), turned by the wheels until set again
+    void setHeading(float value);
+    float getHeading(){ return heading; }
+    float getX(){ return x; }          // cm
+    float getY(){ return y; }
+    // wheel heading (rad, wheels only)
+    float getTheta(){ return theta; }
+    // distance (cm) since the last call
+    float takeDistance();
+    unsigned long getEdges(){ return edges; }
+    unsigned long getDropped(){ return left.getDropped() + right.getDropped(); }
+  private:
+    WheelSpeed speedLeft;
+    WheelSpeed speedRight;
+    float halfTick;        // cm, center move per edge
+    float turn;            // rad, heading change per edge
+    float turnSin;         // half-step rotation
+    float turnCos;
+    float x;
+    float y;
+    float theta;
+    float heading;
+    float headingSin;
+    float headingCos;
+    float distance;
+    unsigned long edges;
+    // one edge of the left (turn +) or right (turn -) wheel, count edges in direction dir
+    void step(boolean isLeft, int count);
+    void rotate(int8_t sign);
+};
+
+
+#endif
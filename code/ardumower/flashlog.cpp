@@ -0,0 +1,328 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+  
+  Private-use only! (you need to ask for a commercial-use)
+ 
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "flashlog.h"
+#include "flashmem.h"
+#include "drivers.h"
+
+#ifndef __AVR__
+  #include <chip.h>
+  // log area: last pages of the settings flash (addresses relative to settings flash, see flashmem.cpp)
+  #define FLASHLOG_ADDR (IFLASH1_SIZE - FLASHLOG_PAGES * FLASHLOG_PAGE_SIZE)
+#endif
+
+
+FlashLogClass FlashLog;
+
+
+FlashLogClass::FlashLogClass(){
+  available = false;
+  pageWrites = 0;
+}
+
+
+#ifdef __AVR__
+
+void FlashLogClass::begin(){}
+void FlashLogClass::add(byte type, byte code, const void *data, byte size){}
+boolean FlashLogClass::saveBlob(byte type, const void *data, byte size){ return false; }
+boolean FlashLogClass::loadBlob(byte type, void *data, byte size){ return false; }
+void FlashLogClass::run(){}
+boolean FlashLogClass::flush(){ return false; }
+int FlashLogClass::getRecordCount(){ return 0; }
+boolean FlashLogClass::getRecord(int idx, flashlogrecord_t &rec){ return false; }
+void FlashLogClass::print(Stream &s, int count, const char **stateNames, byte stateCount){
+  s.println(F("flash log not available"));
+}
+
+#else
+
+// reads page of ring slot (current page: RAM), false if not a valid page of the current ring cycle
+boolean FlashLogClass::readPage(int slot, flashlogpage_t &p){
+  if (slot == pageSlot) {
+    p = page;
+    return true;
+  }
+  memcpy(&p, Flash.readAddress(FLASHLOG_ADDR + (uint32_t)slot * FLASHLOG_PAGE_SIZE), sizeof p);
+  if ((p.magic != FLASHLOG_MAGIC) || (p.version != FLASHLOG_VERSION)) return false;
+  return ((p.seq < page.seq) && (p.seq + FLASHLOG_PAGES > page.seq));
+}
+
+int FlashLogClass::pageRecords(flashlogpage_t &p){
+  int count = 0;
+  while ((count < FLASHLOG_RECORDS) && (p.records[count].type != FLOG_EMPTY)) count++;
+  return count;
+}
+
+// oldest slot of the ring (walk: oldestSlot() ... pageSlot)
+int FlashLogClass::oldestSlot(){
+  return (pageSlot + 1) % FLASHLOG_PAGES;
+}
+
+void FlashLogClass::begin(){
+  available = true;
+  dirty = false;
+  flushTime = 0;
+  for (int i=0; i < FLASHLOG_BLOB_COUNT; i++){
+    blobSize[i] = 0;
+    blobSlot[i] = -1;
+  }
+  // find newest page
+  pageSlot = -1;
+  uint32_t seq = 0;
+  for (int slot=0; slot < FLASHLOG_PAGES; slot++){
+    flashlogpage_t *p = (flashlogpage_t*)Flash.readAddress(FLASHLOG_ADDR + (uint32_t)slot * FLASHLOG_PAGE_SIZE);
+    if ((p->magic != FLASHLOG_MAGIC) || (p->version != FLASHLOG_VERSION)) continue;
+    if ((pageSlot == -1) || (p->seq > seq)){
+      pageSlot = slot;
+      seq = p->seq;
+    }
+  }
+  if (pageSlot == -1){
+    // empty log
+    pageSlot = FLASHLOG_PAGES-1;
+    memset(&page, 0xFF, sizeof page);
+    page.seq = 0;
+    nextPage();
+    return;
+  }
+  memcpy(&page, Flash.readAddress(FLASHLOG_ADDR + (uint32_t)pageSlot * FLASHLOG_PAGE_SIZE), sizeof page);
+  recordCount = pageRecords(page);
+  // restore latest complete blobs
+  byte chunks[FLASHLOG_BLOB_COUNT];
+  int firstSlot[FLASHLOG_BLOB_COUNT];
+  byte tmp[FLASHLOG_BLOB_COUNT][FLASHLOG_BLOB_SIZE];
+  memset(chunks, 0, sizeof chunks);
+  flashlogpage_t p;
+  for (int k=0; k < FLASHLOG_PAGES; k++){
+    int slot = (oldestSlot() + k) % FLASHLOG_PAGES;
+    if (!readPage(slot, p)) continue;
+    for (int i=0; i < pageRecords(p); i++){
+      flashlogrecord_t &rec = p.records[i];
+      if ((rec.type < FLOG_BLOB_STATS) || (rec.type >= FLOG_BLOB_STATS + FLASHLOG_BLOB_COUNT)) continue;
+      byte idx = rec.type - FLOG_BLOB_STATS;
+      byte chunk = rec.code & 0x0F;
+      byte count = rec.code >> 4;
+      if (chunk == 0) firstSlot[idx] = slot;
+        else if (chunk != chunks[idx]) continue;    // incomplete blob
+      if ((chunk+1) * FLASHLOG_DATA_SIZE > FLASHLOG_BLOB_SIZE) continue;
+      memcpy(tmp[idx] + chunk * FLASHLOG_DATA_SIZE, rec.data, FLASHLOG_DATA_SIZE);
+      chunks[idx] = chunk+1;
+      if (chunks[idx] == count){
+        memcpy(blob[idx], tmp[idx], count * FLASHLOG_DATA_SIZE);
+        blobSize[idx] = count * FLASHLOG_DATA_SIZE;
+        blobSlot[idx] = firstSlot[idx];
+        chunks[idx] = 0;
+      }
+    }
+  }
+  if (recordCount == FLASHLOG_RECORDS) nextPage();
+}
+
+// starts next page of the ring (blobs that would be lost with the overwritten page are appended again)
+void FlashLogClass::nextPage(){
+  pageSlot = (pageSlot + 1) % FLASHLOG_PAGES;
+  uint32_t seq = page.seq + 1;
+  memset(&page, 0xFF, sizeof page);
+  page.magic = FLASHLOG_MAGIC;
+  page.version = FLASHLOG_VERSION;
+  page.reserved = 0;
+  page.seq = seq;
+  recordCount = 0;
+  for (int i=0; i < FLASHLOG_BLOB_COUNT; i++){
+    if (blobSlot[i] == pageSlot) appendBlob(i);
+  }
+}
+
+void FlashLogClass::append(flashlogrecord_t &rec){
+  page.records[recordCount++] = rec;
+  if (!dirty) flushTime = millis() + FLASHLOG_FLUSH_INTERVAL;
+  dirty = true;
+  if (recordCount == FLASHLOG_RECORDS){
+    flush();
+    nextPage();
+  }
+}
+
+void FlashLogClass::add(byte type, byte code, const void *data, byte size){
+  if (!available) return;
+  flashlogrecord_t rec;
+  rec.time = millis();
+  rec.type = type;
+  rec.code = code;
+  memset(rec.data, 0, FLASHLOG_DATA_SIZE);
+  if (data != NULL) memcpy(rec.data, data, min(size, FLASHLOG_DATA_SIZE));
+  append(rec);
+  if ((type == FLOG_ERROR) && (dirty) && ((long)(flushTime - (millis() + FLASHLOG_ERROR_FLUSH_DELAY)) > 0))
+    flushTime = millis() + FLASHLOG_ERROR_FLUSH_DELAY;
+}
+
+void FlashLogClass::appendBlob(byte idx){
+  byte count = (blobSize[idx] + FLASHLOG_DATA_SIZE-1) / FLASHLOG_DATA_SIZE;
+  blobSlot[idx] = pageSlot;
+  for (byte chunk=0; chunk < count; chunk++){
+    flashlogrecord_t rec;
+    rec.time = millis();
+    rec.type = FLOG_BLOB_STATS + idx;
+    rec.code = (count << 4) | chunk;
+    memcpy(rec.data, blob[idx] + chunk * FLASHLOG_DATA_SIZE, FLASHLOG_DATA_SIZE);
+    append(rec);
+  }
+}
+
+boolean FlashLogClass::saveBlob(byte type, const void *data, byte size){
+  if ((!available) || (type < FLOG_BLOB_STATS) || (type >= FLOG_BLOB_STATS + FLASHLOG_BLOB_COUNT)) return false;
+  if (size > FLASHLOG_BLOB_SIZE) return false;
+  byte idx = type - FLOG_BLOB_STATS;
+  memset(blob[idx], 0, FLASHLOG_BLOB_SIZE);
+  memcpy(blob[idx], data, size);
+  blobSize[idx] = size;
+  appendBlob(idx);
+  return flush();
+}
+
+boolean FlashLogClass::loadBlob(byte type, void *data, byte size){
+  if ((!available) || (type < FLOG_BLOB_STATS) || (type >= FLOG_BLOB_STATS + FLASHLOG_BLOB_COUNT)) return false;
+  byte idx = type - FLOG_BLOB_STATS;
+  if (blobSlot[idx] == -1) return false;
+  memcpy(data, blob[idx], min(size, FLASHLOG_BLOB_SIZE));
+  return true;
+}
+
+void FlashLogClass::run(){
+  if ((available) && (dirty) && ((long)(millis() - flushTime) >= 0)) flush();
+}
+
+boolean FlashLogClass::flush(){
+  if ((!available) || (!dirty)) return true;
+  dirty = false;
+  pageWrites++;
+  return Flash.write(FLASHLOG_ADDR + (uint32_t)pageSlot * FLASHLOG_PAGE_SIZE, (byte*)&page, sizeof page);
+}
+
+int FlashLogClass::getRecordCount(){
+  if (!available) return 0;
+  int count = 0;
+  flashlogpage_t p;
+  for (int k=0; k < FLASHLOG_PAGES; k++){
+    if (readPage((oldestSlot() + k) % FLASHLOG_PAGES, p)) count += pageRecords(p);
+  }
+  return count;
+}
+
+boolean FlashLogClass::getRecord(int idx, flashlogrecord_t &rec){
+  if (!available) return false;
+  flashlogpage_t p;
+  for (int k=0; k < FLASHLOG_PAGES; k++){
+    if (!readPage((oldestSlot() + k) % FLASHLOG_PAGES, p)) continue;
+    int count = pageRecords(p);
+    if (idx < count){
+      rec = p.records[idx];
+      return true;
+    }
+    idx -= count;
+  }
+  return false;
+}
+
+// state name (number if unknown, e.g. old or damaged record)
+static void printState(Stream &s, byte state, const char **stateNames, byte stateCount){
+  if (state < stateCount) s.print(stateNames[state]);
+    else s.print(state);
+}
+
+void FlashLogClass::print(Stream &s, int count, const char **stateNames, byte stateCount){
+  if (!available) return;
+  int total = getRecordCount();
+  int first = max(0, total - count);
+  s.print(F("flash log: records="));
+  s.print(total);
+  s.print(F(" page writes="));
+  s.println(pageWrites);
+  flashlogpage_t p;
+  int idx = 0;
+  for (int k=0; k < FLASHLOG_PAGES; k++){
+    if (!readPage((oldestSlot() + k) % FLASHLOG_PAGES, p)) continue;
+    for (int i=0; i < pageRecords(p); i++, idx++){
+      if (idx < first) continue;
+      flashlogrecord_t &rec = p.records[i];
+      if ((rec.type >= FLOG_BLOB_STATS) && ((rec.code & 0x0F) != 0)) continue;   // blob: first chunk only
+      s.print(rec.time / 1000.0, 1);
+      s.print(F("s "));
+      switch (rec.type){
+        case FLOG_BOOT: {
+            datetime_t dt;
+            memcpy(&dt, rec.data, min(sizeof dt, FLASHLOG_DATA_SIZE));
+            s.print(F("BOOT "));
+            s.print(date2str(dt.date));
+            s.print(F(" "));
+            s.print(time2str(dt.time));
+          }
+          break;
+        case FLOG_STATE:
+          s.print(F("STATE "));
+          if (stateNames != NULL){
+            printState(s, rec.data[0], stateNames, stateCount);
+            s.print(F("-> "));
+            printState(s, rec.code, stateNames, stateCount);
+          } else {
+            s.print(rec.data[0]);
+            s.print(F("->"));
+            s.print(rec.code);
+          }
+          break;
+        case FLOG_ERROR:
+          s.print(F("ERROR "));
+          s.print(rec.code);
+          s.print(F(" count="));
+          s.print(rec.data[0]);
+          break;
+        case FLOG_BATTERY: {
+            int16_t v[3];
+            memcpy(v, rec.data, sizeof v);
+            s.print(F("BATTERY bat="));
+            s.print(v[0] / 1000.0);
+            s.print(F("V chg="));
+            s.print(v[1] / 1000.0);
+            s.print(F("V "));
+            s.print(v[2]);
+            s.print(F("mA"));
+          }
+          break;
+        case FLOG_BLOB_STATS:
+          s.print(F("STATS saved"));
+          break;
+        case FLOG_BLOB_ERRORS:
+          s.print(F("ERROR COUNTERS saved"));
+          break;
+        default:
+          s.print(F("type="));
+          s.print(rec.type);
+          break;
+      }
+      s.println();
+    }
+  }
+}
+
+#endif
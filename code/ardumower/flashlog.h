@@ -0,0 +1,155 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+  
+  Private-use only! (you need to ask for a commercial-use)
+ 
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+append-only, wear-levelled event log in the Due flash (robot stats, error counters, event history)
+
+- the log is a ring of FLASHLOG_PAGES flash pages at the end of the settings flash,
+  each page: header (magic, version, sequence number) + FLASHLOG_RECORDS records of 16 bytes
+- records are collected in a RAM page and written a page at a time (one erase/write per flush):
+  when the page is full, FLASHLOG_FLUSH_INTERVAL after the first unsaved record, shortly after an
+  error record, or on flush(); then the next page of the ring is used (wear levelling)
+- on begin() the page with the highest sequence number is continued
+- blobs (robot stats, error counters) are stored as a series of records; the latest complete blob
+  is restored on begin() and appended again before its page is overwritten by the ring
+- Arduino Mega: not available (EEPROM too small), all functions do nothing/fail
+
+record:  time (millis, u32) | type | code | data (10 bytes)
+
+How to use it (example):
+  FlashLog.begin();
+  FlashLog.add(FLOG_STATE, stateNew, &stateOld, 1);
+  FlashLog.run();              // periodically (flushes)
+  FlashLog.print(Console, 50); // last 50 records
+*/
+
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include <Arduino.h>
+
+#define FLASHLOG_PAGES 64
+#define FLASHLOG_PAGE_SIZE 256
+#define FLASHLOG_RECORDS 15
+#define FLASHLOG_DATA_SIZE 10
+#define FLASHLOG_MAGIC 0x4C47
+#define FLASHLOG_VERSION 1
+#define FLASHLOG_FLUSH_INTERVAL 600000L   // max. time (ms) records are kept in RAM only
+#define FLASHLOG_ERROR_FLUSH_DELAY 5000   // flush delay (ms) after error records (collects follow-up errors)
+
+// blobs
+#define FLASHLOG_BLOB_COUNT 2
+#define FLASHLOG_BLOB_SIZE 40
+
+// record types
+enum {
+  FLOG_BOOT = 1,           // data: date/time
+  FLOG_STATE,              // code: new state, data: old state
+  FLOG_ERROR,              // code: error type, data: max. error counter
+  FLOG_BATTERY,            // data: battery voltage (mV, i16), charge voltage (mV, i16), charge current (mA, i16)
+  FLOG_BLOB_STATS,         // blob (code: chunk count << 4 | chunk)
+  FLOG_BLOB_ERRORS,
+  FLOG_EMPTY = 0xFF,
+};
+
+
+struct flashlogrecord_t {
+  uint32_t time;   // millis
+  byte type;
+  byte code;
+  byte data[FLASHLOG_DATA_SIZE];
+};
+
+typedef struct flashlogrecord_t flashlogrecord_t;
+
+struct flashlogpage_t {
+  uint16_t magic;
+  byte version;
+  byte reserved;
+  uint32_t seq;
+  flashlogrecord_t records[FLASHLOG_RECORDS];
+  byte unused[FLASHLOG_PAGE_SIZE - 8 - FLASHLOG_RECORDS * sizeof(flashlogrecord_t)];
+};
+
+typedef struct flashlogpage_t flashlogpage_t;
+
+
+class FlashLogClass
+{
+  public:
+    FlashLogClass();
+    // finds newest page, restores blobs
+    void begin();
+    // appends record (data is truncated to FLASHLOG_DATA_SIZE bytes)
+    void add(byte type, byte code, const void *data = NULL, byte size = 0);
+    // appends blob (FLOG_BLOB_...) and flushes
+    boolean saveBlob(byte type, const void *data, byte size);
+    // latest blob (false if none)
+    boolean loadBlob(byte type, void *data, byte size);
+    // flushes if due
+    void run();
+    // writes RAM page (if anything changed)
+    boolean flush();
+    // records in log (oldest first)
+    int getRecordCount();
+    boolean getRecord(int idx, flashlogrecord_t &rec);
+    // prints last 'count' records (state names optional, states >= stateCount are printed as numbers)
+    void print(Stream &s, int count, const char **stateNames = NULL, byte stateCount = 0);
+    unsigned long getPageWrites(){ return pageWrites; }
+  private:
+    boolean available;
+#ifndef __AVR__
+    flashlogpage_t page;     // current page (RAM)
+    int pageSlot;            // ring slot of current page
+    byte recordCount;        // records in current page
+    boolean dirty;
+    unsigned long flushTime;
+    byte blob[FLASHLOG_BLOB_COUNT][FLASHLOG_BLOB_SIZE];
+    byte blobSize[FLASHLOG_BLOB_COUNT];
+    int blobSlot[FLASHLOG_BLOB_COUNT];   // ring slot of the latest blob (-1: none)
+#endif
+    unsigned long pageWrites;
+    void append(flashlogrecord_t &rec);
+    void nextPage();
+    void appendBlob(byte idx);
+    boolean readPage(int slot, flashlogpage_t &p);
+    int pageRecords(flashlogpage_t &p);
+    int oldestSlot();
+};
+
+
+extern FlashLogClass FlashLog;
+
+
+// blob fields (like eereadwrite)
+template <class T> int blobreadwrite(boolean readflag, byte *blob, int &idx, T& value)
+{
+  if (idx + sizeof(value) > FLASHLOG_BLOB_SIZE) return 0;
+  if (readflag) memcpy(&value, blob + idx, sizeof(value));
+    else memcpy(blob + idx, &value, sizeof(value));
+  idx += sizeof(value);
+  return sizeof(value);
+}
+
+
+#endif
@@ -30,6 +30,7 @@ FlashClass Flash;
 
 int eereadwriteString(boolean readflag, int &ee, String& value)
 {
+  int start = ee;
   unsigned int i;
   if (readflag) {
     value = "";
@@ -44,6 +45,7 @@ int eereadwriteString(boolean readflag, int &ee, String& value)
     }
     Flash.write(ee++, 0);
   }
+  return ee - start;
 }
 
 FlashClass::FlashClass() {
@@ -102,7 +104,7 @@ boolean FlashClass::write(uint32_t address, byte value) {
     Console.println();
   }
 #ifdef __AVR__  
-  EEPROM.write(address, value);
+  EEPROM.update(address, value);   // only changed bytes are written (EEPROM wear)
   return true;
 #else
   uint32_t retCode;
@@ -138,7 +140,7 @@ boolean FlashClass::write(uint32_t address, byte value) {
 boolean FlashClass::write(uint32_t address, byte *data, uint32_t dataLength) {
 #ifdef __AVR__  
   for (int i=0; i < dataLength; i++){
-    EEPROM.write(address+i, data[i]);    
+    EEPROM.update(address+i, data[i]);    
   }
   return true;
 #else
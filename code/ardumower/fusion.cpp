@@ -0,0 +1,276 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "fusion.h"
+#include "printfmt.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+  #define PI 3.1415926535897932384626433832795
+#endif
+
+// WGS84
+#define WGS84_A  6378137.0
+#define WGS84_E2 6.69437999014e-3
+
+
+static float sqr(float x){
+  return x * x;
+}
+
+static float wrapPI(float a){
+  while (a > PI) a -= 2 * PI;
+  while (a < -PI) a += 2 * PI;
+  return a;
+}
+
+
+EnuProjection::EnuProjection(){
+  valid = false;
+  lat0 = lon0 = 0;
+  eastScale = northScale = 0;
+}
+
+void EnuProjection::setOrigin(long lat, long lon){
+  double unit = 1e-7 * PI / 180.0;     // rad per 1e-7 deg
+  double phi = lat * unit;
+  double sinPhi = sin(phi);
+  double w = 1.0 - WGS84_E2 * sinPhi * sinPhi;
+  double n = WGS84_A / sqrt(w);                      // prime vertical radius
+  double m = WGS84_A * (1.0 - WGS84_E2) / (w * sqrt(w));   // meridian radius
+  lat0 = lat;
+  lon0 = lon;
+  northScale = m * unit;
+  eastScale = n * cos(phi) * unit;
+  valid = true;
+}
+
+void EnuProjection::toLocal(long lat, long lon, float &east, float &north){
+  int64_t dlon = (int64_t)lon - lon0;
+  // across the antimeridian
+  if (dlon > 1800000000LL) dlon -= 3600000000LL;
+    else if (dlon < -1800000000LL) dlon += 3600000000LL;
+  east = (float)dlon * eastScale;
+  north = (float)(lat - lat0) * northScale;
+}
+
+void EnuProjection::toGeodetic(float east, float north, long &lat, long &lon){
+  lat = lat0 + (long)floor(north / northScale + 0.5);
+  lon = lon0 + (long)floor(east / eastScale + 0.5);
+}
+
+
+PoseFusion::PoseFusion(){
+  initialized = aligned = false;
+  memset(state, 0, sizeof state);
+  memset(P, 0, sizeof P);
+  memset(&pose, 0, sizeof pose);
+  anchorX = anchorY = odoDx = odoDy = 0;
+  rejectCount = 0;
+  predicts = updates = rejects = restarts = 0;
+}
+
+void PoseFusion::reset(float x, float y, float heading, float headingSigma, float posSigma){
+  memset(P, 0, sizeof P);
+  state[0] = x;
+  state[1] = y;
+  state[2] = wrapPI(heading);
+  state[3] = 0;
+  state[4] = 0;
+  P[0][0] = P[1][1] = sqr(posSigma);
+  P[2][2] = sqr(headingSigma);
+  P[4][4] = sqr(FUSION_BIAS_SIGMA);
+  aligned = (headingSigma < FUSION_ALIGN_SIGMA);
+  anchorX = x;
+  anchorY = y;
+  odoDx = odoDy = 0;
+  rejectCount = 0;
+  initialized = true;
+}
+
+void PoseFusion::predict(float distance, float yawRate, float dt){
+  if (!initialized) return;
+  predicts++;
+  float rate = yawRate - state[4];
+  float midHeading = state[2] + 0.5 * rate * dt;
+  float sn = sin(midHeading);
+  float cs = cos(midHeading);
+  state[0] += distance * sn;
+  state[1] += distance * cs;
+  state[2] = wrapPI(state[2] + rate * dt);
+  if (dt > 0) state[3] = distance / dt;
+  if (!aligned){
+    odoDx += distance * sn;
+    odoDy += distance * cs;
+  }
+  // Jacobian (speed is replaced by the odometry speed)
+  float F[FUSION_STATES][FUSION_STATES];
+  memset(F, 0, sizeof F);
+  for (int i=0; i < FUSION_STATES; i++) F[i][i] = 1;
+  F[0][2] = distance * cs;
+  F[0][4] = -0.5 * dt * distance * cs;
+  F[1][2] = -distance * sn;
+  F[1][4] = 0.5 * dt * distance * sn;
+  F[2][4] = -dt;
+  F[3][3] = 0;
+  // P = F P F'
+  float A[FUSION_STATES][FUSION_STATES];
+  for (int i=0; i < FUSION_STATES; i++){
+    for (int j=0; j < FUSION_STATES; j++){
+      float sum = 0;
+      for (int k=0; k < FUSION_STATES; k++) sum += F[i][k] * P[k][j];
+      A[i][j] = sum;
+    }
+  }
+  for (int i=0; i < FUSION_STATES; i++){
+    for (int j=0; j < FUSION_STATES; j++){
+      float sum = 0;
+      for (int k=0; k < FUSION_STATES; k++) sum += A[i][k] * F[j][k];
+      P[i][j] = sum;
+    }
+  }
+  // process noise: odometry distance (moves x, y and speed), gyro, bias random walk
+  float distVar = sqr(FUSION_ODO_NOISE * distance);
+  if (distance != 0) distVar += sqr(FUSION_SLIP_NOISE) * dt;
+  float g[FUSION_STATES] = { sn, cs, 0, (dt > 0) ? 1 / dt : 0, 0 };
+  for (int i=0; i < FUSION_STATES; i++)
+    for (int j=0; j < FUSION_STATES; j++) P[i][j] += g[i] * g[j] * distVar;
+  P[2][2] += sqr(FUSION_GYRO_NOISE) * dt;
+  P[4][4] += sqr(FUSION_BIAS_NOISE) * dt;
+}
+
+// scalar measurement with Jacobian h and innovation (measurement - prediction), noise variance r,
+// false if outside the gate
+bool PoseFusion::correct(const float *h, float innov, float r){
+  float ph[FUSION_STATES];
+  float var = r;
+  for (int i=0; i < FUSION_STATES; i++){
+    float sum = 0;
+    for (int j=0; j < FUSION_STATES; j++) sum += P[i][j] * h[j];
+    ph[i] = sum;
+    var += h[i] * sum;
+  }
+  if (sqr(innov) > sqr(FUSION_GATE) * var) return false;
+  for (int i=0; i < FUSION_STATES; i++) state[i] += ph[i] / var * innov;
+  for (int i=0; i < FUSION_STATES; i++)
+    for (int j=0; j < FUSION_STATES; j++) P[i][j] -= ph[i] * ph[j] / var;
+  state[2] = wrapPI(state[2]);
+  return true;
+}
+
+// heading unknown: follow the GPS position, rotate the heading once the displacement is large enough
+void PoseFusion::align(float x, float y, float sigma){
+  state[0] = x;
+  state[1] = y;
+  for (int i=0; i < FUSION_STATES; i++) P[0][i] = P[i][0] = P[1][i] = P[i][1] = 0;
+  P[0][0] = P[1][1] = sqr(sigma);
+  float gpsDx = x - anchorX;
+  float gpsDy = y - anchorY;
+  float gpsDist = sqrt(sqr(gpsDx) + sqr(gpsDy));
+  float odoDist = sqrt(sqr(odoDx) + sqr(odoDy));
+  if ((gpsDist < FUSION_ALIGN_DIST) || (odoDist < FUSION_ALIGN_DIST / 2)) return;
+  float headingSigma = 2 * sigma / gpsDist;
+  if (headingSigma >= FUSION_ALIGN_SIGMA) return;
+  // heading clockwise from north: atan2(east, north)
+  state[2] = wrapPI(state[2] + atan2(gpsDx, gpsDy) - atan2(odoDx, odoDy));
+  for (int i=0; i < FUSION_STATES; i++) P[2][i] = P[i][2] = 0;
+  P[2][2] = sqr(headingSigma);
+  aligned = true;
+}
+
+bool PoseFusion::updatePosition(float x, float y, float sigma){
+  if (!initialized) return false;
+  float r = sqr(sigma);
+  if (!aligned){
+    align(x, y, sigma);
+    updates++;
+    return true;
+  }
+  float dx = x - state[0];
+  float dy = y - state[1];
+  // gate (cross covariance ignored)
+  if (sqr(dx) / (P[0][0] + r) + sqr(dy) / (P[1][1] + r) > sqr(FUSION_GATE)){
+    rejects++;
+    rejectCount++;
+    if (rejectCount >= FUSION_MAX_REJECTS){
+      // diverged (e.g. wrong heading): restart at the GPS position, align the heading again
+      restarts++;
+      rejectCount = 0;
+      aligned = false;
+      anchorX = x;
+      anchorY = y;
+      odoDx = odoDy = 0;
+      align(x, y, sigma);
+      return true;
+    }
+    return false;
+  }
+  rejectCount = 0;
+  float hx[FUSION_STATES] = { 1, 0, 0, 0, 0 };
+  float hy[FUSION_STATES] = { 0, 1, 0, 0, 0 };
+  correct(hx, dx, r);
+  correct(hy, y - state[1], r);
+  updates++;
+  return true;
+}
+
+bool PoseFusion::updateVelocity(float speed, float course, float sigma){
+  if ((!initialized) || (!aligned)) return false;
+  if (fabs(speed) < FUSION_MIN_SPEED) return false;
+  float r = sqr(sigma);
+  float ve = speed * sin(course);
+  float vn = speed * cos(course);
+  // measured velocity (east, north) = speed * (sin(heading), cos(heading))
+  float v = state[3];
+  float sn = sin(state[2]);
+  float cs = cos(state[2]);
+  float he[FUSION_STATES] = { 0, 0, v * cs, sn, 0 };
+  bool ok = correct(he, ve - v * sn, r);
+  v = state[3];
+  sn = sin(state[2]);
+  cs = cos(state[2]);
+  float hn[FUSION_STATES] = { 0, 0, -v * sn, cs, 0 };
+  if (!correct(hn, vn - v * cs, r)) ok = false;
+  if (ok) updates++;
+    else rejects++;
+  return ok;
+}
+
+const pose_t &PoseFusion::getPose(){
+  pose.x = state[0];
+  pose.y = state[1];
+  pose.heading = state[2];
+  pose.speed = state[3];
+  pose.posStd = sqrt(fabs(P[0][0]) + fabs(P[1][1]));
+  pose.headingStd = sqrt(fabs(P[2][2]));
+  pose.valid = ((initialized) && (aligned));
+  return pose;
+}
+
+void PoseFusion::print(Print &s){
+  getPose();
+  Streamprint(s, "fusion: init=%d aligned=%d x=%d y=%d heading=%d std=%dcm/%ddeg bias=%dmdeg/s updates=%lu rejects=%lu restarts=%lu\r\n",
+    initialized, aligned, (int)pose.x, (int)pose.y, (int)(pose.heading / PI * 180), (int)pose.posStd,
+    (int)(pose.headingStd / PI * 180), (int)(state[4] / PI * 180000), updates, rejects, restarts);
+}
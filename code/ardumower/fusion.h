@@ -0,0 +1,162 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+GPS/odometry pose fusion (extended Kalman filter) in a local East-North-Up frame
+
+- EnuProjection: local tangent plane at the first fix (WGS84 meridian and prime vertical radius of
+  the origin latitude), meters per 1e-7 degree are computed once in setOrigin(), a fix is projected
+  with two integer differences and two multiplications (no trig per sample, exact to a few mm
+  within some km of the origin)
+- PoseFusion: state x, y (cm, east/north), heading (rad, clockwise from north, i.e. the odometry
+  heading convention), speed (cm/s) and gyro bias (rad/s)
+  - predict(): odometry distance and yaw rate (gyro / IMU yaw, bias is subtracted) move the pose,
+    speed is the odometry speed, the covariance grows by the odometry (relative), slip, gyro and bias
+    random walk noise
+  - updatePosition(): GPS position (cm) with its accuracy, updateVelocity(): GPS speed and course
+    (heading while driving) - sequential scalar updates (no matrix inversion), an update outside
+    FUSION_GATE sigma is rejected (counted), FUSION_MAX_REJECTS in a row restart at the GPS position
+  - heading alignment: while the heading is unknown (e.g. no compass, odometry heading is relative to
+    the start), the pose follows the GPS position until the robot has moved FUSION_ALIGN_DIST, the
+    heading is then rotated by the angle between the GPS and the dead-reckoned displacement
+- output: one pose (getPose), position/heading std. deviation from the covariance
+
+How to use it (example):
+  EnuProjection enu;
+  enu.setOrigin(lat, lon);                               // 1e-7 deg (first fix)
+  enu.toLocal(lat, lon, east, north);                    // m
+  fusion.reset(east*100, north*100, imu.ypr.yaw, 0.3);   // initial pose (cm), heading and its sigma (rad)
+  fusion.predict(odometryCm, yawRate, 0.1);              // each odometry update
+  fusion.updatePosition(east*100, north*100, 150);       // each GPS fix, accuracy (cm)
+  fusion.updateVelocity(speed, course, 10);              // cm/s, rad, cm/s
+  const pose_t &pose = fusion.getPose();
+*/
+
+#ifndef FUSION_H
+#define FUSION_H
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  // host build (simulator)
+  #include <stdint.h>
+  #include "Print.h"
+#endif
+
+#define FUSION_STATES 5
+
+// filter parameters
+#define FUSION_ODO_NOISE 0.05          // relative odometry distance noise
+#define FUSION_SLIP_NOISE 2.0          // cm per sqrt(s) while moving (wheel slip, odometry heading)
+#define FUSION_GYRO_NOISE 0.02         // rad per sqrt(s), yaw rate noise
+#define FUSION_BIAS_NOISE 0.0005       // rad/s per sqrt(s), gyro bias random walk
+#define FUSION_BIAS_SIGMA 0.02         // rad/s, initial gyro bias uncertainty
+#define FUSION_GATE 4.0                // sigma, updates outside are rejected
+#define FUSION_MAX_REJECTS 10          // position updates rejected in a row: restart at GPS position
+#define FUSION_ALIGN_SIGMA 0.5         // rad, heading aligned below this uncertainty
+#define FUSION_ALIGN_DIST 300          // cm, GPS displacement for the heading alignment
+#define FUSION_MIN_SPEED 15            // cm/s, GPS course is used above this speed
+#define FUSION_GPS_UERE 300            // cm, NMEA fix accuracy = HDOP * range error
+#define FUSION_GPS_SPEED_SIGMA 10      // cm/s
+#define FUSION_IMU_HEADING_SIGMA 0.3   // rad, initial heading from the IMU (compass) yaw
+
+
+// fused pose
+struct pose_t {
+  float x;               // cm, east
+  float y;               // cm, north
+  float heading;         // rad, clockwise from north
+  float speed;           // cm/s
+  float posStd;          // cm, position std. deviation
+  float headingStd;      // rad
+  bool valid;
+};
+
+typedef struct pose_t pose_t;
+
+
+// local East-North-Up frame at an origin
+class EnuProjection
+{
+  public:
+    EnuProjection();
+    // origin (1e-7 deg), precomputes the scale
+    void setOrigin(long lat, long lon);
+    bool isValid(){ return valid; }
+    long getOriginLat(){ return lat0; }
+    long getOriginLon(){ return lon0; }
+    // position (1e-7 deg) to east/north (m)
+    void toLocal(long lat, long lon, float &east, float &north);
+    // east/north (m) to position (1e-7 deg)
+    void toGeodetic(float east, float north, long &lat, long &lon);
+  private:
+    bool valid;
+    long lat0;
+    long lon0;
+    float eastScale;       // m per 1e-7 deg longitude
+    float northScale;      // m per 1e-7 deg latitude
+};
+
+
+class PoseFusion
+{
+  public:
+    PoseFusion();
+    // initial pose (cm, rad), heading sigma (rad, >= FUSION_ALIGN_SIGMA: heading unknown)
+    void reset(float x, float y, float heading, float headingSigma, float posSigma = 100);
+    bool isInitialized(){ return initialized; }
+    bool isAligned(){ return aligned; }
+    // odometry distance (cm, negative: reverse), yaw rate (rad/s, clockwise), dt (s)
+    void predict(float distance, float yawRate, float dt);
+    // GPS position (cm) and accuracy (cm, 1 sigma), false if rejected
+    bool updatePosition(float x, float y, float sigma);
+    // GPS speed (cm/s), course (rad, clockwise from north) and speed accuracy (cm/s), false if rejected
+    bool updateVelocity(float speed, float course, float sigma);
+    const pose_t &getPose();
+    float getGyroBias(){ return state[4]; }
+    unsigned long getUpdates(){ return updates; }
+    unsigned long getRejects(){ return rejects; }
+    unsigned long getRestarts(){ return restarts; }
+    void print(Print &s);
+  private:
+    bool initialized;
+    bool aligned;
+    float state[FUSION_STATES];              // x, y, heading, speed, gyro bias
+    float P[FUSION_STATES][FUSION_STATES];   // covariance
+    pose_t pose;
+    // heading alignment: GPS and dead-reckoned displacement since the anchor fix
+    float anchorX;
+    float anchorY;
+    float odoDx;
+    float odoDy;
+    int rejectCount;
+    unsigned long predicts;
+    unsigned long updates;
+    unsigned long rejects;
+    unsigned long restarts;
+    bool correct(const float *h, float innov, float r);
+    void align(float x, float y, float sigma);
+};
+
+
+#endif
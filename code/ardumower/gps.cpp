@@ -23,11 +23,17 @@
 
 #include "gps.h"
 
-#define _GPRMC_TERM   "GPRMC"
-#define _GPGGA_TERM   "GPGGA"
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+#define UBX_LEN_MAX 1024      // longer: no frame (lost sync)
 
 GPS::GPS()
-  :  _time(GPS_INVALID_TIME)
+#ifdef __AVR__
+  :  rx(Serial3)
+#else
+  :  rx(Serial3, USART3)     // Due: Serial3 is USART3 (PDC receive)
+#endif
+  ,  _time(GPS_INVALID_TIME)
   ,  _date(GPS_INVALID_DATE)
   ,  _latitude(GPS_INVALID_ANGLE)
   ,  _longitude(GPS_INVALID_ANGLE)
@@ -36,47 +42,159 @@ GPS::GPS()
   ,  _course(GPS_INVALID_ANGLE)
   ,  _hdop(GPS_INVALID_HDOP)
   ,  _numsats(GPS_INVALID_SATELLITES)
+  ,  _hacc(GPS_INVALID_HDOP)
+  ,  _fix_type(0)
+  ,  _carr_soln(0)
+  ,  _rel_valid(false)
   ,  _last_time_fix(GPS_INVALID_FIX_TIME)
   ,  _last_position_fix(GPS_INVALID_FIX_TIME)
+  ,  _last_ubx_fix(GPS_INVALID_FIX_TIME)
+  ,  _last_relpos_fix(GPS_INVALID_FIX_TIME)
   ,  _parity(0)
   ,  _is_checksum_term(false)
+  ,  _in_sentence(false)
+  ,  _msg_type(GPS_MSG_NMEA_OTHER)
   ,  _sentence_type(_GPS_SENTENCE_OTHER)
   ,  _term_number(0)
   ,  _term_offset(0)
   ,  _gps_data_good(false)
-#ifndef _GPS_NO_STATS
-  ,  _encoded_characters(0)
-  ,  _good_sentences(0)
-  ,  _failed_checksum(0)
-#endif
+  ,  _ubx_state(_UBX_IDLE)
 {
   _term[0] = '\0';
+#ifndef _GPS_NO_STATS
+  resetStats();
+#endif
 }
 
 //
 // public methods
 //
 
-void GPS::init(){
-  Serial3.begin(9600);
+void GPS::init(unsigned long baud){
+  rx.begin(baud);
+  // request UBX NAV-PVT and NAV-RELPOSNED with each solution (CFG-MSG, current port)
+  const byte pvt[3] = { 0x01, 0x07, 1 };
+  const byte relpos[3] = { 0x01, 0x3C, 1 };
+  ubx_send(0x06, 0x01, pvt, sizeof pvt);
+  ubx_send(0x06, 0x01, relpos, sizeof relpos);
 }
 
 boolean GPS::feed(){
-  while (Serial3.available())
-  {
-    if (encode(Serial3.read()))
-      return true;
-  }  
-  return false;
+  boolean fix = false;
+  const uint8_t *data;
+  int len;
+  // received bytes in contiguous blocks (two at most if the ring wrapped)
+  while ((len = rx.peek(&data)) > 0){
+    if (parse(data, len)) fix = true;
+    rx.consume(len);
+  }
+  return fix;
 }
 
 bool GPS::encode(char c)
 {
-  bool valid_sentence = false;
+  return parse((const uint8_t*)&c, 1);
+}
 
+bool GPS::parse(const uint8_t *data, int len)
+{
+  bool fix = false;
+  const uint8_t *end = data + len;
 #ifndef _GPS_NO_STATS
-  ++_encoded_characters;
+  _encoded_characters += len;
 #endif
+  while (data < end)
+  {
+    if (_ubx_state == _UBX_PAYLOAD)
+    {
+      // payload block: stored and summed without per-byte state changes
+      uint16_t count = min((long)(end - data), (long)(_ubx_len - _ubx_pos));
+      byte ck_a = _ubx_ck_a;
+      byte ck_b = _ubx_ck_b;
+      for (uint16_t i=0; i < count; i++)
+      {
+        byte b = data[i];
+        if (_ubx_pos + i < GPS_UBX_PAYLOAD_MAX) _ubx_payload[_ubx_pos + i] = b;
+        ck_a += b;
+        ck_b += ck_a;
+      }
+      _ubx_ck_a = ck_a;
+      _ubx_ck_b = ck_b;
+      data += count;
+      _ubx_pos += count;
+      if (_ubx_pos == _ubx_len) _ubx_state = _UBX_CK_A;
+      continue;
+    }
+    byte c = *data++;
+    switch (_ubx_state)
+    {
+    case _UBX_IDLE:
+      if (c == UBX_SYNC1)
+      {
+        _ubx_state = _UBX_SYNC2;
+        _in_sentence = false;       // NMEA sentence interrupted
+      }
+      else if (nmea_char(c))
+        fix = true;
+      break;
+    case _UBX_SYNC2:
+      if (c == UBX_SYNC2)
+      {
+        _ubx_state = _UBX_CLASS;
+        _ubx_ck_a = _ubx_ck_b = 0;
+      }
+      else
+      {
+        _ubx_state = _UBX_IDLE;
+        if (nmea_char(c)) fix = true;
+      }
+      break;
+    case _UBX_CLASS:
+    case _UBX_ID:
+    case _UBX_LEN1:
+    case _UBX_LEN2:
+      _ubx_ck_a += c;
+      _ubx_ck_b += _ubx_ck_a;
+      if (_ubx_state == _UBX_CLASS) _ubx_class = c;
+        else if (_ubx_state == _UBX_ID) _ubx_id = c;
+        else if (_ubx_state == _UBX_LEN1) _ubx_len = c;
+        else _ubx_len |= (uint16_t)c << 8;
+      _ubx_state++;
+      if (_ubx_state == _UBX_PAYLOAD)
+      {
+        _ubx_pos = 0;
+        if (_ubx_len > UBX_LEN_MAX)
+        {
+          message(ubx_type(), false);
+          _ubx_state = _UBX_IDLE;
+        }
+        else if (_ubx_len == 0)
+          _ubx_state = _UBX_CK_A;
+      }
+      break;
+    case _UBX_CK_A:
+      _ubx_ck_ok = (c == _ubx_ck_a);
+      _ubx_state = _UBX_CK_B;
+      break;
+    case _UBX_CK_B:
+      _ubx_state = _UBX_IDLE;
+      if ((_ubx_ck_ok) && (c == _ubx_ck_b))
+      {
+        if (ubx_frame()) fix = true;
+      }
+      else
+        message(ubx_type(), false);
+      break;
+    }
+  }
+  return fix;
+}
+
+// NMEA character, returns true if a new position was decoded
+bool GPS::nmea_char(char c)
+{
+  bool valid_sentence = false;
+
   switch(c)
   {
   case ',': // term terminators
@@ -84,42 +202,120 @@ bool GPS::encode(char c)
   case '\r':
   case '\n':
   case '*':
-    if (_term_offset < sizeof(_term))
+    if (_in_sentence)
     {
-      _term[_term_offset] = 0;
+      if (_term_number == 0) _term[min((int)_term_offset, (int)sizeof(_term) - 1)] = 0;
       valid_sentence = term_complete();
+      ++_term_number;
+      if ((c == '\r') || (c == '\n')) _in_sentence = false;
     }
-    ++_term_number;
     _term_offset = 0;
+    _term_int = _term_frac = 0;
+    _term_decimals = 0;
+    _term_dot = false;
+    _term_char = 0;
     _is_checksum_term = c == '*';
     return valid_sentence;
 
   case '$': // sentence begin
     _term_number = _term_offset = 0;
+    _term_int = _term_frac = 0;
+    _term_decimals = 0;
+    _term_dot = false;
+    _term_char = 0;
     _parity = 0;
     _sentence_type = _GPS_SENTENCE_OTHER;
+    _msg_type = GPS_MSG_NMEA_OTHER;
     _is_checksum_term = false;
     _gps_data_good = false;
+    _in_sentence = true;
     return valid_sentence;
   }
 
-  // ordinary characters
-  if (_term_offset < sizeof(_term) - 1)
-    _term[_term_offset++] = c;
-  if (!_is_checksum_term)
+  if (!_in_sentence) return false;
+  // ordinary characters: the term value is accumulated while it arrives
+  if (_term_offset == 0) _term_char = c;
+  if ((_term_number == 0) && (_term_offset < sizeof(_term) - 1)) _term[_term_offset] = c;
+  if (_is_checksum_term)
+    _term_int = 16 * _term_int + from_hex(c);
+  else
+  {
     _parity ^= c;
-
+    if (gpsisdigit(c))
+    {
+      if (!_term_dot)
+        _term_int = 10 * _term_int + (c - '0');
+      else if (_term_decimals < 7)
+      {
+        _term_frac = 10 * _term_frac + (c - '0');
+        _term_decimals++;
+      }
+    }
+    else if (c == '.')
+      _term_dot = true;
+  }
+  if (_term_offset < 255) _term_offset++;
   return valid_sentence;
 }
 
 #ifndef _GPS_NO_STATS
 void GPS::stats(unsigned long *chars, unsigned short *sentences, unsigned short *failed_cs)
 {
+  unsigned long good = 0, failed = 0;
+  for (byte i=0; i < GPS_MSG_COUNT; i++)
+  {
+    good += _msg_good[i];
+    failed += _msg_failed[i];
+  }
   if (chars) *chars = _encoded_characters;
-  if (sentences) *sentences = _good_sentences;
-  if (failed_cs) *failed_cs = _failed_checksum;
+  if (sentences) *sentences = min(good, 65535UL);
+  if (failed_cs) *failed_cs = min(failed, 65535UL);
 }
+
+void GPS::resetStats()
+{
+  _encoded_characters = 0;
+  for (byte i=0; i < GPS_MSG_COUNT; i++) _msg_good[i] = _msg_failed[i] = 0;
+}
+
+void GPS::printStats(Print &s)
+{
+  static const char *names[GPS_MSG_COUNT] = { "GGA", "RMC", "GSA", "GSV", "VTG", "GLL", "NMEA",
+    "NAV-PVT", "NAV-RELPOSNED", "ACK", "UBX" };
+  s.print(F("GPS chars="));
+  s.print(_encoded_characters);
+  s.print(F(" overflows="));
+  s.print(rx.getOverflows());
+  s.print(F(" rx max="));
+  s.print(rx.getPendingMax());
+  s.print(F(" ubx="));
+  s.println(ubxActive());
+  for (byte i=0; i < GPS_MSG_COUNT; i++)
+  {
+    if ((_msg_good[i] == 0) && (_msg_failed[i] == 0)) continue;
+    s.print(names[i]);
+    s.print(F("="));
+    s.print(_msg_good[i]);
+    s.print(F(" failed="));
+    s.print(_msg_failed[i]);
+    s.print(F("  "));
+  }
+  s.println();
+}
+#endif
+
+void GPS::message(byte type, bool good)
+{
+#ifndef _GPS_NO_STATS
+  if (good) _msg_good[type]++;
+    else _msg_failed[type]++;
 #endif
+}
+
+boolean GPS::ubxActive()
+{
+  return ((_last_ubx_fix != GPS_INVALID_FIX_TIME) && (millis() - _last_ubx_fix < GPS_UBX_TIMEOUT));
+}
 
 //
 // internal utilities
@@ -136,40 +332,32 @@ int GPS::from_hex(char a)
 
 unsigned long GPS::parse_decimal()
 {
-  char *p = _term;
-  bool isneg = *p == '-';
-  if (isneg) ++p;  // skip heading '-'
-    
-  unsigned long ret = 100UL * gpsatol(p); // gpsatol = generalPtrStrToLong => convert int-part to long: 90.239 => 100*90
-  while (gpsisdigit(*p)) ++p; // skip converted digits '.'
-  if (*p == '.')
-  {
-    if (gpsisdigit(p[1])) // any number behind '.' ?
-    {
-      ret += 10 * (p[1] - '0'); // add first decimal
-      if (gpsisdigit(p[2]))
-        ret += p[2] - '0'; // add second decimal - note all meter values are converted to cm with the precision of 2 digits
-    }
-  }
-  return isneg ? -ret : ret; // negate result if isneg is set
+  // note all meter values are converted to cm with the precision of 2 digits
+  unsigned long ret = 100UL * _term_int;
+  unsigned long frac = _term_frac;
+  if (_term_decimals == 1) frac *= 10;
+  for (byte i=2; i < _term_decimals; i++) frac /= 10;
+  ret += frac;
+  return (_term_char == '-') ? -ret : ret; // negate result if negative
 }
 
-unsigned long GPS::parse_degrees()  // term=5000.0095 (50° 00' 0.0095*60'')
-{                                        // (D)DDMM.MMMM is the format
-  char *p;
-  unsigned long left = gpsatol(_term); // get (D)DDMM in left 
-  unsigned long tenk_minutes = (left % 100UL) * 10000UL; // get MM*10000
-  for (p=_term; gpsisdigit(*p); ++p);  // advance to '.'
-  if (*p == '.')
-  {
-    unsigned long mult = 1000;
-    while (gpsisdigit(*++p))
-    {
-      tenk_minutes += mult * (*p - '0');
-      mult /= 10;
-    }
-  }    
-  return (left / 100) * 100000 + tenk_minutes / 6; // DDD * 100000 + tenk_minutes/6=°*10*10000 
+long GPS::parse_degrees()  // term=5000.0095 (50° 00' 0.0095*60'')
+{                          // (D)DDMM.MMMM is the format, result in 1e-7 degrees
+  unsigned long minutes = (_term_int % 100UL) * 10000000UL;  // 1e-7 minutes
+  unsigned long frac = _term_frac;
+  for (byte i=_term_decimals; i < 7; i++) frac *= 10;
+  minutes += frac;
+  return (long)(_term_int / 100) * 10000000L + (long)((minutes + 30) / 60);
+}
+
+// sentence type of the first term (any talker: GPGGA, GNGGA, ...)
+byte GPS::sentence_id()
+{
+  static const char *ids[] = { "GGA", "RMC", "GSA", "GSV", "VTG", "GLL" };
+  if ((_term[0] == 'P') || (strlen(_term) != 5)) return GPS_MSG_NMEA_OTHER;  // proprietary
+  for (byte i=0; i < sizeof ids / sizeof ids[0]; i++)
+    if (strcmp(_term + 2, ids[i]) == 0) return GPS_MSG_GGA + i;
+  return GPS_MSG_NMEA_OTHER;
 }
 
 // Sample sentences:
@@ -184,21 +372,14 @@ unsigned long GPS::parse_degrees()  // term=5000.0095 (50° 00' 0.0095*60'')
 // Returns true if new sentence has just passed checksum test and is validated
 bool GPS::term_complete()
 {
-  //Console.println("compl");
   if (_is_checksum_term)
   {
-    byte checksum = 16 * from_hex(_term[0]) + from_hex(_term[1]);
-    //Console.print(checksum);
-    //Console.print(",");
-    //Console.println(_parity);
-    if (checksum == _parity)
+    if ((byte)_term_int == _parity)
     {
-      //if (1==1) 
-      if (_gps_data_good)
+      message(_msg_type, true);
+      // positions of NAV-PVT are used if available (higher resolution)
+      if ((_gps_data_good) && (!ubxActive()))
       {
-#ifndef _GPS_NO_STATS
-        ++_good_sentences;
-#endif
         _last_time_fix = _new_time_fix;
         _last_position_fix = _new_position_fix;
 
@@ -225,27 +406,25 @@ bool GPS::term_complete()
         return true;
       }
     }
-
-#ifndef _GPS_NO_STATS
     else
-      ++_failed_checksum;
-#endif
+      message(_msg_type, false);
     return false;
   }
 
   // the first term determines the sentence type
   if (_term_number == 0)
   {
-    if (!gpsstrcmp(_term, _GPRMC_TERM))
+    _msg_type = sentence_id();
+    if (_msg_type == GPS_MSG_RMC)
       _sentence_type = _GPS_SENTENCE_GPRMC;
-    else if (!gpsstrcmp(_term, _GPGGA_TERM))
+    else if (_msg_type == GPS_MSG_GGA)
       _sentence_type = _GPS_SENTENCE_GPGGA;
     else
       _sentence_type = _GPS_SENTENCE_OTHER;
     return false;
   }
 
-  if (_sentence_type != _GPS_SENTENCE_OTHER && _term[0])
+  if (_sentence_type != _GPS_SENTENCE_OTHER && _term_offset > 0)
     switch(COMBINE(_sentence_type, _term_number))
   {
     case COMBINE(_GPS_SENTENCE_GPRMC, 1): // Time in both sentences
@@ -254,7 +433,7 @@ bool GPS::term_complete()
       _new_time_fix = millis();
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 2): // GPRMC validity
-      _gps_data_good = _term[0] == 'A';
+      _gps_data_good = _term_char == 'A';
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 3): // Latitude
     case COMBINE(_GPS_SENTENCE_GPGGA, 2):
@@ -263,7 +442,7 @@ bool GPS::term_complete()
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 4): // N/S
     case COMBINE(_GPS_SENTENCE_GPGGA, 3):
-      if (_term[0] == 'S')
+      if (_term_char == 'S')
         _new_latitude = -_new_latitude;
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 5): // Longitude
@@ -272,7 +451,7 @@ bool GPS::term_complete()
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 6): // E/W
     case COMBINE(_GPS_SENTENCE_GPGGA, 5):
-      if (_term[0] == 'W')
+      if (_term_char == 'W')
         _new_longitude = -_new_longitude;
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 7): // Speed (GPRMC)
@@ -282,13 +461,13 @@ bool GPS::term_complete()
       _new_course = parse_decimal();
       break;
     case COMBINE(_GPS_SENTENCE_GPRMC, 9): // Date (GPRMC)
-      _new_date = gpsatol(_term);
+      _new_date = _term_int;
       break;
     case COMBINE(_GPS_SENTENCE_GPGGA, 6): // Fix data (GPGGA) ; 0=invalid, 1=GPS fix, 2=DGPS fix, 6=estimation
-      _gps_data_good = _term[0] > '0';
+      _gps_data_good = _term_char > '0';
       break;
     case COMBINE(_GPS_SENTENCE_GPGGA, 7): // NN-Satellites used (GPGGA): 00-12
-      _new_numsats = (unsigned char)atoi(_term);
+      _new_numsats = (unsigned char)_term_int;
       break;
     case COMBINE(_GPS_SENTENCE_GPGGA, 8): // D.D - HDOP (GPGGA) - horizontal deviation
       _new_hdop = parse_decimal();
@@ -301,21 +480,100 @@ bool GPS::term_complete()
   return false;
 }
 
-long GPS::gpsatol(const char *str) // convert string to long - does only work for unsigned ints!
+// UBX frame (checksum ok)
+// NAV-PVT:       iTOW U4, year U2, month, day, hour, min, sec U1, valid X1, tAcc U4, nano I4, fixType U1,
+//                flags X1, flags2 X1, numSV U1, lon I4, lat I4 (1e-7 deg), height I4, hMSL I4 (mm),
+//                hAcc U4, vAcc U4, velN/E/D I4, gSpeed I4 (mm/s), headMot I4 (1e-5 deg), sAcc, headAcc U4,
+//                pDOP U2 (0.01), ...
+// NAV-RELPOSNED: version U1, ..., relPosN/E/D I4 (cm) at 8, high precision parts I1 (0.1 mm) and flags X4
+//                (gnssFixOK, diffSoln, relPosValid, carrSoln) at 20/36 (version 0) or 32/60 (version 1)
+byte GPS::ubx_type()
+{
+  if (_ubx_class == 0x01)
+  {
+    if (_ubx_id == 0x07) return GPS_MSG_NAV_PVT;
+    if (_ubx_id == 0x3C) return GPS_MSG_NAV_RELPOSNED;
+  }
+  if (_ubx_class == 0x05) return GPS_MSG_UBX_ACK;
+  return GPS_MSG_UBX_OTHER;
+}
+
+bool GPS::ubx_frame()
+{
+  byte type = ubx_type();
+  message(type, true);
+  if ((type == GPS_MSG_NAV_PVT) && (_ubx_len >= 92)) return ubx_nav_pvt();
+  if (type == GPS_MSG_NAV_RELPOSNED) ubx_nav_relposned();
+  return false;
+}
+
+uint32_t GPS::ubx_u4(byte ofs)
+{
+  return (uint32_t)_ubx_payload[ofs] | ((uint32_t)_ubx_payload[ofs+1] << 8)
+    | ((uint32_t)_ubx_payload[ofs+2] << 16) | ((uint32_t)_ubx_payload[ofs+3] << 24);
+}
+
+uint16_t GPS::ubx_u2(byte ofs)
 {
-  long ret = 0;
-  while (gpsisdigit(*str)) // process only digits
-    ret = 10 * ret + *str++ - '0'; // inc str after assignment
-  return ret;
+  return (uint16_t)_ubx_payload[ofs] | ((uint16_t)_ubx_payload[ofs+1] << 8);
 }
 
+bool GPS::ubx_nav_pvt()
+{
+  byte valid = _ubx_payload[11];
+  byte flags = _ubx_payload[21];
+  _fix_type  = _ubx_payload[20];
+  _carr_soln = (flags >> 6) & 3;
+  _numsats   = _ubx_payload[23];
+  _hdop      = ubx_u2(76);        // pDOP (NAV-PVT has no HDOP)
+  _hacc      = ubx_u4(40);
+  _last_ubx_fix = millis();
+  if ((valid & 0x03) == 0x03)
+  {
+    // valid date and time
+    long nano = (long)ubx_u4(16);
+    _date = _ubx_payload[7] * 10000UL + _ubx_payload[6] * 100UL + (ubx_u2(4) % 100);
+    _time = _ubx_payload[8] * 1000000UL + _ubx_payload[9] * 10000UL + _ubx_payload[10] * 100UL
+      + ((nano > 0) ? nano / 10000000L : 0);
+    _last_time_fix = _last_ubx_fix;
+  }
+  if (((flags & 0x01) == 0) || (_fix_type < 2)) return false;   // no valid fix (gnssFixOK)
+  _longitude = (long)ubx_u4(24);
+  _latitude  = (long)ubx_u4(28);
+  _altitude  = (long)ubx_u4(36) / 10;
+  long gspeed = (long)ubx_u4(60);
+  _speed     = (gspeed * 1000L + 2572) / 5144;   // mm/s -> 100ths of a knot
+  _course    = (long)ubx_u4(64) / 1000;
+  _last_position_fix = _last_ubx_fix;
+  return true;
+}
 
+void GPS::ubx_nav_relposned()
+{
+  byte hp, flagsOfs;
+  if ((_ubx_payload[0] == 0) && (_ubx_len >= 40)) { hp = 20; flagsOfs = 36; }
+    else if ((_ubx_payload[0] == 1) && (_ubx_len >= 64)) { hp = 32; flagsOfs = 60; }
+    else return;
+  uint32_t flags = ubx_u4(flagsOfs);
+  _rel_valid = ((flags & 0x05) == 0x05);    // gnssFixOK, relPosValid
+  _carr_soln = (flags >> 3) & 3;
+  // 0.1 mm
+  _rel_north = (long)ubx_u4(8) * 100L + (int8_t)_ubx_payload[hp];
+  _rel_east  = (long)ubx_u4(12) * 100L + (int8_t)_ubx_payload[hp+1];
+  _rel_down  = (long)ubx_u4(16) * 100L + (int8_t)_ubx_payload[hp+2];
+  _last_relpos_fix = millis();
+}
 
-int GPS::gpsstrcmp(const char *str1, const char *str2)
+void GPS::ubx_send(byte msgClass, byte msgId, const byte *payload, uint16_t len)
 {
-  while (*str1 && *str1 == *str2)
-    ++str1, ++str2;
-  return *str1;
+  byte header[6] = { UBX_SYNC1, UBX_SYNC2, msgClass, msgId, (byte)(len & 0xFF), (byte)(len >> 8) };
+  byte ck_a = 0, ck_b = 0;
+  for (byte i=2; i < 6; i++) { ck_a += header[i]; ck_b += ck_a; }
+  for (uint16_t i=0; i < len; i++) { ck_a += payload[i]; ck_b += ck_a; }
+  Serial3.write(header, sizeof header);
+  Serial3.write(payload, len);
+  Serial3.write(ck_a);
+  Serial3.write(ck_b);
 }
 
 /* static */
@@ -377,6 +635,14 @@ const char *GPS::cardinal (float course)
 
 // lat/long in hundred thousandths of a degree and age of fix in milliseconds
 void GPS::get_position(long *latitude, long *longitude, unsigned long *fix_age)
+{
+  get_position_e7(latitude, longitude, fix_age);
+  if ((latitude) && (*latitude != GPS_INVALID_ANGLE)) *latitude /= 100;
+  if ((longitude) && (*longitude != GPS_INVALID_ANGLE)) *longitude /= 100;
+}
+
+// lat/long in 1e-7 degrees and age of fix in milliseconds
+void GPS::get_position_e7(long *latitude, long *longitude, unsigned long *fix_age)
 {
   if (latitude) *latitude = _latitude;
   if (longitude) *longitude = _longitude;
@@ -384,6 +650,17 @@ void GPS::get_position(long *latitude, long *longitude, unsigned long *fix_age)
 GPS_INVALID_AGE : millis() - _last_position_fix;
 }
 
+// position relative to the base (m), false if not valid
+boolean GPS::get_relpos(float *north, float *east, float *down, unsigned long *fix_age)
+{
+  if (north) *north = _rel_north / 10000.0;
+  if (east) *east = _rel_east / 10000.0;
+  if (down) *down = _rel_down / 10000.0;
+  if (fix_age) *fix_age = _last_relpos_fix == GPS_INVALID_FIX_TIME ? 
+GPS_INVALID_AGE : millis() - _last_relpos_fix;
+  return ((_rel_valid) && (_last_relpos_fix != GPS_INVALID_FIX_TIME));
+}
+
 // date as ddmmyy, time as hhmmsscc, and age in milliseconds
 void GPS::get_datetime(unsigned long *date, unsigned long *time, unsigned long *age)
 {
@@ -396,9 +673,9 @@ GPS_INVALID_AGE : millis() - _last_time_fix;
 void GPS::f_get_position(float *latitude, float *longitude, unsigned long *fix_age)
 {
   long lat, lon;
-  get_position(&lat, &lon, fix_age);
-  *latitude = lat == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lat / 100000.0);
-  *longitude = lon == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lon / 100000.0);
+  get_position_e7(&lat, &lon, fix_age);
+  *latitude = lat == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lat / 10000000.0);
+  *longitude = lon == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lon / 10000000.0);
 }
 
 void GPS::crack_datetime(int *year, byte *month, byte *day, 
@@ -22,13 +22,30 @@
 
 */
 
-//  GPS neo6m  (NMEA-0183 protocol)
+/*
+GPS receiver (NMEA-0183 and u-blox UBX protocol)
+
+- reception: RX ring buffer (rxbuffer.h, Due: PDC), feed() parses all received bytes in blocks
+- UBX: frames are checked (Fletcher checksum) and decoded as a whole: NAV-PVT (position 1e-7 degrees,
+  speed, course, time, satellites, accuracy) and NAV-RELPOSNED (RTK rover: position relative to the
+  base); init() requests both messages (receivers without them answer with ACK-NAK)
+- NMEA (fallback, e.g. neo6m): GGA and RMC of any talker (GP, GN, ...), terms are converted while
+  they arrive (no term strings); ignored while UBX NAV-PVT is received
+- statistics per message type (received, checksum errors), RX buffer overflows
+
+How to use it (example):
+  gps.init(GPS_BAUDRATE);
+  gps.feed();                                    // each loop
+  gps.get_position_e7(&lat, &lon, &age);
+  gps.printStats(Console);
+*/
 
 
 #ifndef GPS_H
 #define GPS_H
 
 #include "Arduino.h"
+#include "rxbuffer.h"
 
 #define _GPS_MPH_PER_KNOT 1.15077945
 #define _GPS_MPS_PER_KNOT 0.51444444
@@ -37,6 +54,13 @@
 #define _GPS_KM_PER_METER 0.001
 // #define _GPS_NO_STATS
 
+#define GPS_UBX_PAYLOAD_MAX 100    // NAV-PVT: 92 bytes (longer frames are checked, not stored)
+#define GPS_UBX_TIMEOUT     2000   // ms, NMEA positions are used if no NAV-PVT was received
+
+// message types (statistics)
+enum { GPS_MSG_GGA, GPS_MSG_RMC, GPS_MSG_GSA, GPS_MSG_GSV, GPS_MSG_VTG, GPS_MSG_GLL, GPS_MSG_NMEA_OTHER,
+       GPS_MSG_NAV_PVT, GPS_MSG_NAV_RELPOSNED, GPS_MSG_UBX_ACK, GPS_MSG_UBX_OTHER, GPS_MSG_COUNT };
+
 class GPS
 {
 public:
@@ -52,13 +76,19 @@ public:
 
   GPS();
   bool encode(char c); // process one character received from GPS
-  void init();
+  // process received bytes, returns true if a new position was decoded
+  bool parse(const uint8_t *data, int len);
+  void init(unsigned long baud = 9600);
+  // parses all received bytes, returns true if a new position was decoded
   boolean feed();
   GPS &operator << (char c) {encode(c); return *this;}
 
   // lat/long in hundred thousandths of a degree and age of fix in milliseconds
   void get_position(long *latitude, long *longitude, unsigned long *fix_age = 0);
 
+  // lat/long in 1e-7 degrees and age of fix in milliseconds
+  void get_position_e7(long *latitude, long *longitude, unsigned long *fix_age = 0);
+
   // date as ddmmyy, time as hhmmsscc, and age in milliseconds
   void get_datetime(unsigned long *date, unsigned long *time, unsigned long *age = 0);
 
@@ -77,6 +107,18 @@ public:
   // horizontal dilution of precision in 100ths
   inline unsigned long hdop() { return _hdop; }
 
+  // horizontal accuracy estimate in mm (UBX only)
+  inline unsigned long hAcc() { return _hacc; }
+
+  // UBX: 0=no fix, 2=2D, 3=3D; carrier solution 0=none, 1=float, 2=fixed (RTK)
+  inline byte fixType() { return _fix_type; }
+  inline byte carrierSolution() { return _carr_soln; }
+  // NAV-PVT received within GPS_UBX_TIMEOUT?
+  boolean ubxActive();
+
+  // NAV-RELPOSNED: position relative to the base in m (false: none valid)
+  boolean get_relpos(float *north, float *east, float *down, unsigned long *fix_age = 0);
+
   void f_get_position(float *latitude, float *longitude, unsigned long *fix_age = 0);
   void crack_datetime(int *year, byte *month, byte *day, 
     byte *hour, byte *minute, byte *second, byte *hundredths = 0, unsigned long *fix_age = 0);
@@ -95,12 +137,20 @@ public:
 
 #ifndef _GPS_NO_STATS
   void stats(unsigned long *chars, unsigned short *good_sentences, unsigned short *failed_cs);
+  unsigned long getMessages(byte type){ return _msg_good[type]; }
+  unsigned long getFailed(byte type){ return _msg_failed[type]; }
+  void resetStats();
+  void printStats(Print &s);
 #endif
+  unsigned long getOverflows(){ return rx.getOverflows(); }
 
 private:
   enum {_GPS_SENTENCE_GPGGA, _GPS_SENTENCE_GPRMC, _GPS_SENTENCE_OTHER};
+  enum {_UBX_IDLE, _UBX_SYNC2, _UBX_CLASS, _UBX_ID, _UBX_LEN1, _UBX_LEN2, _UBX_PAYLOAD, _UBX_CK_A, _UBX_CK_B};
 
-  // properties
+  RxBuffer rx;
+
+  // properties (latitude/longitude in 1e-7 degrees)
   unsigned long _time, _new_time;
   unsigned long _date, _new_date;
   long _latitude, _new_latitude;
@@ -110,35 +160,67 @@ private:
   unsigned long  _course, _new_course;
   unsigned long  _hdop, _new_hdop;
   unsigned short _numsats, _new_numsats;
+  unsigned long _hacc;
+  byte _fix_type;
+  byte _carr_soln;
+  long _rel_north, _rel_east, _rel_down;    // mm
+  boolean _rel_valid;
 
   unsigned long _last_time_fix, _new_time_fix;
   unsigned long _last_position_fix, _new_position_fix;
+  unsigned long _last_ubx_fix;
+  unsigned long _last_relpos_fix;
 
-  // parsing state variables
+  // NMEA parsing state variables (term value: integer part, fraction digits)
   byte _parity;
   bool _is_checksum_term;
-  char _term[15];
+  bool _in_sentence;
+  char _term[6];              // first term (sentence id)
+  unsigned long _term_int;
+  unsigned long _term_frac;
+  byte _term_decimals;
+  bool _term_dot;
+  char _term_char;            // first character
+  byte _msg_type;
   byte _sentence_type;
   byte _term_number;
   byte _term_offset;
   bool _gps_data_good;
 
+  // UBX parsing state variables
+  byte _ubx_state;
+  byte _ubx_class;
+  byte _ubx_id;
+  uint16_t _ubx_len;
+  uint16_t _ubx_pos;
+  byte _ubx_ck_a;
+  byte _ubx_ck_b;
+  bool _ubx_ck_ok;
+  byte _ubx_payload[GPS_UBX_PAYLOAD_MAX];
+
 #ifndef _GPS_NO_STATS
   // statistics
   unsigned long _encoded_characters;
-  unsigned short _good_sentences;
-  unsigned short _failed_checksum;
-  unsigned short _passed_checksum;
+  unsigned long _msg_good[GPS_MSG_COUNT];
+  unsigned long _msg_failed[GPS_MSG_COUNT];
 #endif
 
   // internal utilities
   int from_hex(char a);
   unsigned long parse_decimal();
-  unsigned long parse_degrees();
+  long parse_degrees();
+  bool nmea_char(char c);
   bool term_complete();
   bool gpsisdigit(char c) { return c >= '0' && c <= '9'; }
-  long gpsatol(const char *str);
-  int gpsstrcmp(const char *str1, const char *str2);
+  byte sentence_id();
+  void ubx_send(byte msgClass, byte msgId, const byte *payload, uint16_t len);
+  bool ubx_frame();
+  byte ubx_type();
+  bool ubx_nav_pvt();
+  void ubx_nav_relposned();
+  uint32_t ubx_u4(byte ofs);
+  uint16_t ubx_u2(byte ofs);
+  void message(byte type, bool good);
 };
 
 
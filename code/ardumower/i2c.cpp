@@ -1,6 +1,7 @@
 #include "i2c.h"
 #include <Wire.h>
 #include "config.h"
+#include "i2cman.h"
 
 #if defined(__AVR_ATmega328P__)  
   // Nano pins  
@@ -102,7 +103,10 @@ void I2Creset(){
   }
 }
 
+// blocking transfers: queued transactions (I2CMan) are completed first
+
 void I2CwriteTo(uint8_t device, uint8_t address, uint8_t val) {
+   I2CMan.flush();
    Wire.beginTransmission(device); //start transmission to device 
    Wire.write(address);        // send register address
    Wire.write(val);        // send value to write
@@ -110,6 +114,7 @@ void I2CwriteTo(uint8_t device, uint8_t address, uint8_t val) {
 }
 
 void I2CwriteToBuf(uint8_t device, uint8_t address, int num, uint8_t buff[]) {
+   I2CMan.flush();
    Wire.beginTransmission(device); //start transmission to device 
    Wire.write(address);        // send register address
    for (int i=0; i < num; i++){
@@ -120,6 +125,7 @@ void I2CwriteToBuf(uint8_t device, uint8_t address, int num, uint8_t buff[]) {
 
 int I2CreadFrom(uint8_t device, uint8_t address, uint8_t num, uint8_t buff[], int retryCount) {
   int i = 0;
+  I2CMan.flush();
   for (int j=0; j < retryCount+1; j++){
     i=0;
     Wire.beginTransmission(device); //start transmission to device 
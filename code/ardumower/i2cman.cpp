@@ -0,0 +1,285 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "i2cman.h"
+#include <Wire.h>
+
+#ifndef __AVR__
+  #define I2C_TWI TWI1    // Wire (SDA/SCL)
+#endif
+
+I2CManager I2CMan;
+
+
+I2CManager::I2CManager(){
+  head = tail = count = 0;
+  state = I2C_STATE_IDLE;
+  running = false;
+  deadline = recoverTime = 0;
+  recoverClocks = 0;
+  completed = nacks = timeouts = retryCount = busErrors = recoveries = 0;
+  maxQueued = 0;
+}
+
+void I2CManager::begin(){
+  stopPDC();
+  state = I2C_STATE_IDLE;
+}
+
+boolean I2CManager::add(i2ctrans_t &t){
+  if ((count >= I2C_QUEUE_SIZE) || (state == I2C_STATE_RECOVER)) return false;
+  t.result = I2C_BUSY;
+  queue[head] = t;
+  head = (head + 1) % I2C_QUEUE_SIZE;
+  count++;
+  if (count > maxQueued) maxQueued = count;
+  return true;
+}
+
+boolean I2CManager::read(byte device, byte reg, byte *buf, byte len, i2c_callback_t callback, void *user, byte retries){
+  if (len == 0) return false;
+  i2ctrans_t t;
+  t.device = device;
+  t.reg = reg;
+  t.read = true;
+  t.len = len;
+  t.buf = buf;
+  t.retries = retries;
+  t.callback = callback;
+  t.user = user;
+  return add(t);
+}
+
+boolean I2CManager::write(byte device, byte reg, const byte *data, byte len, i2c_callback_t callback, void *user, byte retries){
+  if ((len == 0) || (len > I2C_WRITE_MAX)) return false;
+  i2ctrans_t t;
+  t.device = device;
+  t.reg = reg;
+  t.read = false;
+  t.len = len;
+  t.buf = NULL;
+  memcpy(t.data, data, len);
+  t.retries = retries;
+  t.callback = callback;
+  t.user = user;
+  return add(t);
+}
+
+#ifdef __AVR__
+// one complete (blocking) transfer with Wire
+static byte transferWire(i2ctrans_t &t){
+  Wire.beginTransmission(t.device);
+  Wire.write(t.reg);
+  if (!t.read) Wire.write(t.data, t.len);
+  if (Wire.endTransmission() != 0) return I2C_NACK;
+  if (!t.read) return I2C_OK;
+  if (Wire.requestFrom(t.device, t.len) != t.len) return I2C_NACK;
+  for (byte i=0; i < t.len; i++) t.buf[i] = Wire.read();
+  return I2C_OK;
+}
+#endif
+
+void I2CManager::run(){
+  if (running) return;  // called by a callback (flush)
+  running = true;
+#ifdef __AVR__
+  if (count > 0) finish(transferWire(queue[tail]));
+#else
+  if (state == I2C_STATE_RECOVER) recover();
+  for (byte i=0; i < 2; i++){
+    if ((state == I2C_STATE_IDLE) && (count > 0)) start();
+    if ((state == I2C_STATE_IDLE) || (state == I2C_STATE_RECOVER)) break;
+    service();
+    if (state != I2C_STATE_IDLE) break;   // transfer still running
+  }
+#endif
+  running = false;
+}
+
+boolean I2CManager::flush(unsigned int timeout){
+  if (running) return false;
+  unsigned long endTime = millis() + timeout;
+  while (!isIdle()){
+    if ((state == I2C_STATE_RECOVER) || ((long)(millis() - endTime) >= 0)) return false;
+    run();
+  }
+  return true;
+}
+
+void I2CManager::stopPDC(){
+#ifndef __AVR__
+  I2C_TWI->TWI_PTCR = TWI_PTCR_RXTDIS | TWI_PTCR_TXTDIS;
+#endif
+}
+
+// start transfer of current transaction (Due)
+// read:  PDC receives len-2 bytes, then STOP is set before byte len-2 is read from RHR
+//        (SCL is stretched while RHR is full, so STOP follows byte len-1, see SAM3X datasheet
+//        'Read Sequence with PDC'), last byte is read from RHR
+// write: first byte starts the transfer, PDC sends the rest, then STOP
+void I2CManager::start(){
+  deadline = millis() + I2C_TRANSFER_TIMEOUT;
+#ifndef __AVR__
+  i2ctrans_t &t = queue[tail];
+  if (TWI_GetStatus(I2C_TWI) & TWI_SR_RXRDY) TWI_ReadByte(I2C_TWI);   // clear NACK, discard stale RHR
+  if (t.read){
+    if (t.len > 1){
+      I2C_TWI->TWI_RPR = (uint32_t)(uintptr_t)t.buf;
+      I2C_TWI->TWI_RCR = t.len - 2;
+      if (t.len > 2) I2C_TWI->TWI_PTCR = TWI_PTCR_RXTEN;
+      TWI_StartRead(I2C_TWI, t.device, t.reg, 1);
+      state = (t.len > 2) ? I2C_STATE_READ : I2C_STATE_READ_PENULT;
+    } else {
+      // single byte: STOP right after START
+      TWI_StartRead(I2C_TWI, t.device, t.reg, 1);
+      TWI_SendSTOPCondition(I2C_TWI);
+      state = I2C_STATE_READ_LAST;
+    }
+  } else {
+    I2C_TWI->TWI_TPR = (uint32_t)(uintptr_t)&t.data[1];
+    I2C_TWI->TWI_TCR = t.len - 1;
+    TWI_StartWrite(I2C_TWI, t.device, t.reg, 1, t.data[0]);
+    I2C_TWI->TWI_PTCR = TWI_PTCR_TXTEN;
+    state = I2C_STATE_WRITE;
+  }
+#endif
+}
+
+// next transfer step (if the TWI is ready for it), checks timeout
+void I2CManager::service(){
+#ifndef __AVR__
+  i2ctrans_t &t = queue[tail];
+  for (byte steps=0; steps < 4; steps++){
+    uint32_t sr = TWI_GetStatus(I2C_TWI);
+    if (sr & TWI_SR_NACK){
+      stopPDC();
+      finish(I2C_NACK);
+      return;
+    }
+    byte last = state;
+    switch (state){
+      case I2C_STATE_READ:
+        if (sr & TWI_SR_ENDRX){
+          I2C_TWI->TWI_PTCR = TWI_PTCR_RXTDIS;
+          state = I2C_STATE_READ_PENULT;
+        }
+        break;
+      case I2C_STATE_READ_PENULT:
+        if (sr & TWI_SR_RXRDY){
+          TWI_SendSTOPCondition(I2C_TWI);   // before RHR is read: STOP after the next byte
+          t.buf[t.len - 2] = TWI_ReadByte(I2C_TWI);
+          state = I2C_STATE_READ_LAST;
+        }
+        break;
+      case I2C_STATE_READ_LAST:
+        if (sr & TWI_SR_RXRDY){
+          t.buf[t.len - 1] = TWI_ReadByte(I2C_TWI);
+          state = I2C_STATE_STOP;
+        }
+        break;
+      case I2C_STATE_WRITE:
+        if ((sr & TWI_SR_ENDTX) && (sr & TWI_SR_TXRDY)){
+          I2C_TWI->TWI_PTCR = TWI_PTCR_TXTDIS;
+          TWI_Stop(I2C_TWI);
+          state = I2C_STATE_STOP;
+        }
+        break;
+      case I2C_STATE_STOP:
+        if (sr & TWI_SR_TXCOMP){
+          finish(I2C_OK);
+          return;
+        }
+        break;
+    }
+    if (state == last) break;
+  }
+  if ((long)(millis() - deadline) >= 0) timeout();
+#endif
+}
+
+void I2CManager::timeout(){
+  timeouts++;
+  stopPDC();
+  Wire.begin();   // reset TWI
+  if ((digitalRead(SDA) == LOW) || (digitalRead(SCL) == LOW)){
+    // slave still holds the bus
+    state = I2C_STATE_RECOVER;
+    recoverClocks = 0;
+    recoverTime = millis();
+    return;
+  }
+  finish(I2C_TIMEOUT);
+}
+
+// one bus recovery step per call: clock SCL until the slave releases SDA, then STOP
+void I2CManager::recover(){
+  if ((long)(millis() - recoverTime) < 0) return;
+  if ((digitalRead(SDA) == HIGH) && (digitalRead(SCL) == HIGH)){
+    pinMode(SDA, OUTPUT);
+    digitalWrite(SDA, LOW);
+    delayMicroseconds(5);
+    pinMode(SDA, INPUT_PULLUP);   // SDA low->high while SCL high: STOP
+    delayMicroseconds(5);
+    Wire.begin();
+    recoveries++;
+    if (count > 0) finish(I2C_TIMEOUT);  // retry (or fail) the interrupted transaction
+      else state = I2C_STATE_IDLE;
+    return;
+  }
+  if (recoverClocks < I2C_RECOVER_CLOCKS){
+    pinMode(SCL, OUTPUT);
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    recoverClocks++;
+    return;
+  }
+  // bus still blocked: fail all transactions, try again later
+  failAll(I2C_BUS_ERROR);
+  state = I2C_STATE_RECOVER;
+  recoverClocks = 0;
+  recoverTime = millis() + I2C_RECOVER_INTERVAL;
+}
+
+// complete current transaction (or schedule a retry)
+void I2CManager::finish(byte result){
+  state = I2C_STATE_IDLE;
+  i2ctrans_t &t = queue[tail];
+  if (result == I2C_NACK) nacks++;
+  if ((result != I2C_OK) && (result != I2C_BUS_ERROR) && (t.retries > 0)){
+    t.retries--;
+    retryCount++;
+    return;
+  }
+  t.result = result;
+  i2ctrans_t done = t;
+  tail = (tail + 1) % I2C_QUEUE_SIZE;
+  count--;
+  if (result == I2C_OK) completed++;
+  if (result == I2C_BUS_ERROR) busErrors++;
+  if (done.callback != NULL) done.callback(done);
+}
+
+void I2CManager::failAll(byte result){
+  while (count > 0) finish(result);
+}
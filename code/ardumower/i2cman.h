@@ -0,0 +1,133 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+I2C transaction manager: non-blocking register reads/writes (queued, completion callbacks)
+
+Problem: blocking I2C reads (Wire) stall the robot loop (several ms with long cables, 
+and much longer if a sensor does not answer).
+
+Solution:
+- transactions are queued and processed in the background, the caller gets the result later 
+  via callback (called from run(), so it may use the robot state and queue new transactions)
+- Due: TWI1 (SDA/SCL) with PDC (DMA) transfers, run() only polls the status and 
+  starts the next step - no busy waiting (the TWI stretches SCL while RHR is full, so the 
+  STOP for the last byte can be set at loop rate, see I2CManager::start)
+- every transaction has a timeout and a retry count
+- bus recovery: if SDA/SCL stay low (slave stuck in a transfer), SCL is clocked (one pulse per run) 
+  until the slave releases SDA, then a STOP is sent and the TWI is re-initialized
+- Mega: the TWI interrupt belongs to the Wire library, so run() executes one queued 
+  transaction per call (blocking) using Wire
+- read buffers must stay valid until the transaction is completed (DMA target)
+
+How to use it (example):
+  1. queue register read:   I2CMan.read(ADXL345B, 0x32, buf, 6, accReadDone, this);
+  2. program loop:          I2CMan.run();
+  3. callback:              void accReadDone(i2ctrans_t &t){ if (t.result == I2C_OK) ... t.buf ... }
+*/
+
+#ifndef I2CMAN_H
+#define I2CMAN_H
+
+#include <Arduino.h>
+
+#define I2C_QUEUE_SIZE 8
+#define I2C_WRITE_MAX 8           // max. data bytes of a queued write
+#define I2C_TRANSFER_TIMEOUT 5    // ms per transfer
+#define I2C_RETRIES 1             // default retries (NACK, timeout)
+#define I2C_RECOVER_CLOCKS 9      // SCL pulses before a recovery attempt is given up
+#define I2C_RECOVER_INTERVAL 100  // ms between recovery attempts
+
+// transaction result
+enum { I2C_BUSY, I2C_OK, I2C_NACK, I2C_TIMEOUT, I2C_BUS_ERROR };
+
+// manager state
+enum { I2C_STATE_IDLE, I2C_STATE_READ, I2C_STATE_READ_PENULT, I2C_STATE_READ_LAST, I2C_STATE_WRITE, I2C_STATE_STOP, I2C_STATE_RECOVER };
+
+struct i2ctrans_t;
+typedef void (*i2c_callback_t)(struct i2ctrans_t &t);
+
+struct i2ctrans_t {
+  byte device;
+  byte reg;                   // register address
+  boolean read;
+  byte len;
+  byte *buf;                  // read: destination
+  byte data[I2C_WRITE_MAX];   // write: data (copied)
+  byte retries;               // retries left
+  byte result;
+  i2c_callback_t callback;    // may be NULL
+  void *user;
+};
+
+typedef struct i2ctrans_t i2ctrans_t;
+
+
+class I2CManager
+{
+  public:
+    I2CManager();
+    // call this after Wire.begin()
+    void begin();
+    // queue register read/write (false if queue is full or bus is being recovered)
+    boolean read(byte device, byte reg, byte *buf, byte len, i2c_callback_t callback, void *user = NULL, byte retries = I2C_RETRIES);
+    boolean write(byte device, byte reg, const byte *data, byte len, i2c_callback_t callback = NULL, void *user = NULL, byte retries = I2C_RETRIES);
+    // get the manager running (next transfer step, callbacks)
+    void run();
+    // run until all transactions are completed (or timeout), required before blocking Wire access
+    boolean flush(unsigned int timeout = 100);
+    boolean isIdle(){ return ((count == 0) && (state == I2C_STATE_IDLE)); }
+    byte getState(){ return state; }
+    byte getQueued(){ return count; }
+    // statistics
+    unsigned long completed;
+    unsigned long nacks;
+    unsigned long timeouts;
+    unsigned long retryCount;
+    unsigned long busErrors;
+    unsigned long recoveries;
+    byte maxQueued;
+  private:
+    i2ctrans_t queue[I2C_QUEUE_SIZE];
+    byte head;                    // next free entry
+    byte tail;                    // current transaction
+    byte count;
+    byte state;
+    boolean running;              // in run() (callbacks)
+    unsigned long deadline;       // timeout of current transfer
+    unsigned long recoverTime;    // next recovery step
+    byte recoverClocks;
+    boolean add(i2ctrans_t &t);
+    void start();
+    void service();
+    void timeout();
+    void finish(byte result);
+    void failAll(byte result);
+    void recover();
+    void stopPDC();
+};
+
+extern I2CManager I2CMan;
+
+
+#endif
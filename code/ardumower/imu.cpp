@@ -26,6 +26,7 @@
 #include <Wire.h>
 #include "drivers.h"
 #include "i2c.h"
+#include "i2cman.h"
 #include "config.h"
 #include "flashmem.h"
 #include "buzzer.h"
@@ -63,6 +64,8 @@ IMU::IMU(){
   gyroCounter = 0; 
   useGyroCalibration = false;
   lastGyroTime = millis();
+  readsPending = readsOk = 0;
+  sampleTime = lastSampleTime = 0;
   
   accelCounter = 0;
   calibAccAxisCounter = 0;
@@ -254,6 +257,10 @@ void IMU::readADXL345B(){
     errorCounter++;
     return;
   }
+  parseADXL345B(buf);
+}
+
+void IMU::parseADXL345B(const uint8_t *buf){
   // Convert the accelerometer value to G's. 
   // With 10 bits measuring over a +/-4g range we can find how to convert by using the equation:
   // Gs = Measurement Value * (G-range/(2^10)) or Gs = Measurement Value * (8/1024)
@@ -346,7 +353,11 @@ void IMU::readL3G4200D(boolean useTa){
   memset(gyroFifo, 0, sizeof(gyroFifo[0])*32);
   I2CreadFrom(L3G4200D, 0xA8, sizeof(gyroFifo[0])*countOfData, (uint8_t *)gyroFifo);         // the first bit of the register address specifies we want automatic address increment
   //I2CreadFrom(L3G4200D, 0x28, sizeof(gyroFifo[0])*countOfData, (uint8_t *)gyroFifo);         // the first bit of the register address specifies we want automatic address increment
+  parseL3G4200D(countOfData);
+}
 
+// sum of the first countOfData FIFO samples (gyroFifo)
+void IMU::parseL3G4200D(uint8_t countOfData){
   gyro.x = gyro.y = gyro.z = 0;
   //Console.print("fifo:");
   //Console.println(countOfData);
@@ -372,7 +383,7 @@ void IMU::readL3G4200D(boolean useTa){
 
 // HMC5883L compass sensor driver
 void  IMU::initHMC5883L(){
-  I2CwriteTo(HMC5883L, 0x00, 0x70);  // 8 samples averaged, 75Hz frequency, no artificial bias.       
+  I2CwriteTo(HMC5883L, 0x00, 0x78);  // 8 samples averaged, 75Hz frequency, no artificial bias.       
   //I2CwriteTo(HMC5883L, 0x01, 0xA0);      // gain
   I2CwriteTo(HMC5883L, 0x01, 0x20);   // gain
   I2CwriteTo(HMC5883L, 0x02, 00);    // mode         
@@ -384,6 +395,10 @@ void IMU::readHMC5883L(){
     errorCounter++;
     return;
   }
+  parseHMC5883L(buf);
+}
+
+void IMU::parseHMC5883L(const uint8_t *buf){
   // scale +1.3Gauss..-1.3Gauss  (*0.00092)  
   float x = (int16_t) (((uint16_t)buf[0]) << 8 | buf[1]);
   float y = (int16_t) (((uint16_t)buf[4]) << 8 | buf[5]);
@@ -655,49 +670,102 @@ float scalePIangles(float setAngle, float currAngle){
     else return setAngle;
 }
 
+void IMU::fuseComplementary(int looptime){
+  // ------ roll, pitch --------------  
+  float forceMagnitudeApprox = abs(acc.x) + abs(acc.y) + abs(acc.z);    
+  //if (forceMagnitudeApprox < 1.2) {
+    //Console.println(forceMagnitudeApprox);      
+    accPitch   = atan2(-acc.x , sqrt(sq(acc.y) + sq(acc.z)));         
+    accRoll    = atan2(acc.y , acc.z);       
+    accPitch = scalePIangles(accPitch, ypr.pitch);
+    accRoll  = scalePIangles(accRoll, ypr.roll);
+    // complementary filter            
+    ypr.pitch = Kalman(accPitch, gyro.x, looptime, ypr.pitch);  
+    ypr.roll  = Kalman(accRoll,  gyro.y, looptime, ypr.roll);            
+  /*} else {
+    //Console.print("too much acceleration ");
+    //Console.println(forceMagnitudeApprox);
+    ypr.pitch = ypr.pitch + gyro.y * ((float)(looptime))/1000.0;
+    ypr.roll  = ypr.roll  + gyro.x * ((float)(looptime))/1000.0;
+  }*/
+  ypr.pitch=scalePI(ypr.pitch);
+  ypr.roll=scalePI(ypr.roll);
+  // ------ yaw --------------
+  // tilt-compensated yaw
+  comTilt.x =  com.x  * cos(ypr.pitch) + com.z * sin(ypr.pitch);
+  comTilt.y =  com.x  * sin(ypr.roll)         * sin(ypr.pitch) + com.y * cos(ypr.roll) - com.z * sin(ypr.roll) * cos(ypr.pitch);
+  comTilt.z = -com.x  * cos(ypr.roll)         * sin(ypr.pitch) + com.y * sin(ypr.roll) + com.z * cos(ypr.roll) * cos(ypr.pitch);     
+  comYaw = scalePI( atan2(comTilt.y, comTilt.x)  );  
+  comYaw = scalePIangles(comYaw, ypr.yaw);
+  //comYaw = atan2(com.y, com.x);  // assume pitch, roll are 0
+  // complementary filter
+  ypr.yaw = Complementary2(comYaw, -gyro.z, looptime, ypr.yaw);
+  ypr.yaw = scalePI(ypr.yaw);
+}
+
+// quaternion AHRS (sensor frame: x forward, y left, z up) - yaw is clockwise (compass heading),
+// pitch positive nose down, roll positive right side down (as the previous filter)
+void IMU::fuse(float dt){
+  ahrs.update(gyro.x, gyro.y, gyro.z, acc.x, acc.y, acc.z, com.x, com.y, com.z, dt);
+  float yaw;
+  ahrs.getEuler(yaw, ypr.pitch, ypr.roll);
+  ypr.yaw = -yaw;
+}
+
 void IMU::update(){
-  read();  
-  now = millis();
-  int looptime = (now - lastAHRSTime);
-  lastAHRSTime = now;
-  
-  if (state == IMU_RUN){
-    // ------ roll, pitch --------------  
-    float forceMagnitudeApprox = abs(acc.x) + abs(acc.y) + abs(acc.z);    
-    //if (forceMagnitudeApprox < 1.2) {
-      //Console.println(forceMagnitudeApprox);      
-      accPitch   = atan2(-acc.x , sqrt(sq(acc.y) + sq(acc.z)));         
-      accRoll    = atan2(acc.y , acc.z);       
-      accPitch = scalePIangles(accPitch, ypr.pitch);
-      accRoll  = scalePIangles(accRoll, ypr.roll);
-      // complementary filter            
-      ypr.pitch = Kalman(accPitch, gyro.x, looptime, ypr.pitch);  
-      ypr.roll  = Kalman(accRoll,  gyro.y, looptime, ypr.roll);            
-    /*} else {
-      //Console.print("too much acceleration ");
-      //Console.println(forceMagnitudeApprox);
-      ypr.pitch = ypr.pitch + gyro.y * ((float)(looptime))/1000.0;
-      ypr.roll  = ypr.roll  + gyro.x * ((float)(looptime))/1000.0;
-    }*/
-    ypr.pitch=scalePI(ypr.pitch);
-    ypr.roll=scalePI(ypr.roll);
-    // ------ yaw --------------
-    // tilt-compensated yaw
-    comTilt.x =  com.x  * cos(ypr.pitch) + com.z * sin(ypr.pitch);
-    comTilt.y =  com.x  * sin(ypr.roll)         * sin(ypr.pitch) + com.y * cos(ypr.roll) - com.z * sin(ypr.roll) * cos(ypr.pitch);
-    comTilt.z = -com.x  * cos(ypr.roll)         * sin(ypr.pitch) + com.y * sin(ypr.roll) + com.z * cos(ypr.roll) * cos(ypr.pitch);     
-    comYaw = scalePI( atan2(comTilt.y, comTilt.x)  );  
-    comYaw = scalePIangles(comYaw, ypr.yaw);
-    //comYaw = atan2(com.y, com.x);  // assume pitch, roll are 0
-    // complementary filter
-    ypr.yaw = Complementary2(comYaw, -gyro.z, looptime, ypr.yaw);
-    ypr.yaw = scalePI(ypr.yaw);
-  } 
-  else if (state == IMU_CAL_COM) {
+  if (state == IMU_CAL_COM) {
+    read();
     calibComUpdate();
+    return;
+  }
+  if (readsPending > 0) return;   // previous reads still running (bus busy)
+  if (readsOk & IMU_GYRO_OK) {
+    memcpy(gyroFifo, gyroBuf, sizeof gyroBuf);
+    parseL3G4200D(1);
   }
+  if (readsOk & IMU_ACC_OK) parseADXL345B(accBuf);
+  if (readsOk & IMU_COM_OK) parseHMC5883L(comBuf);
+  if ((readsOk & (IMU_GYRO_OK | IMU_ACC_OK)) == (IMU_GYRO_OK | IMU_ACC_OK)) {
+    float dt = ((float)(sampleTime - lastSampleTime)) / 1000000.0;
+    // first samples or IMU not updated for a while
+    if (dt > 0.1) dt = IMU_AHRS_PERIOD / 1000.0;
+    lastAHRSTime = micros();
+    fuse(dt);
+  }
+  readAsync();
 }  
 
+// async read completed (called by I2CMan)
+void IMU::readDone(i2ctrans_t &t){
+  IMU *imu = (IMU*)t.user;
+  imu->readsPending--;
+  if (t.result != I2C_OK) {
+    imu->errorCounter++;
+    return;
+  }
+  if (t.buf == imu->gyroBuf) imu->readsOk |= IMU_GYRO_OK;
+    else if (t.buf == imu->accBuf) imu->readsOk |= IMU_ACC_OK;
+    else imu->readsOk |= IMU_COM_OK;
+}
+
+// queue burst reads of all sensors (gyro FIFO in bypass mode: one sample)
+void IMU::readAsync(){
+  readsOk = 0;
+  if (!hardwareInitialized) {
+    errorCounter++;
+    return;
+  }
+  callCounter++;
+  lastSampleTime = sampleTime;
+  sampleTime = micros();
+  readsPending = 3;
+  if (!I2CMan.read(L3G4200D, 0xA8, gyroBuf, 6, readDone, this)) readsPending--;
+  if (!I2CMan.read(ADXL345B, 0x32, accBuf, 6, readDone, this)) readsPending--;
+  // compass output rate is 75 Hz
+  if ((!(callCounter & 1)) || (!I2CMan.read(HMC5883L, 0x03, comBuf, 6, readDone, this))) readsPending--;
+  if (readsPending == 0) errorCounter++;
+}
+
 boolean IMU::init(){    
   loadCalib();
   printCalib();    
@@ -729,7 +797,8 @@ void IMU::read(){
   callCounter++;    
   readL3G4200D(true);
   readADXL345B();
-  readHMC5883L();  
+  // compass output rate is 75 Hz
+  if ((callCounter & 1) || (state == IMU_CAL_COM)) readHMC5883L();  
   //calcComCal();
 }
 
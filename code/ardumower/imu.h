@@ -22,12 +22,15 @@
 
 */
 
-/* pitch/roll and heading estimation (IMU sensor fusion)  
+/* pitch/roll and heading estimation (IMU sensor fusion, quaternion AHRS see ahrs.h)  
    requires: GY-80 module (L3G4200D, ADXL345B, HMC5883L) 
+   sensors are read with queued burst reads (I2CMan, see i2cman.h): each update fuses the
+   samples of the previous one and queues the next reads (compass calibration reads blocking)
    
 How to use it (example):     
   1. initialize IMU:                 IMU imu;  imu.init(); 
-  2. read IMU (yaw/pitch/roll:       Serial.println( imu.ypr.yaw );
+  2. fixed rate update (100 Hz):     imu.update();     (every IMU_AHRS_PERIOD ms)
+  3. read IMU (yaw/pitch/roll:       Serial.println( imu.ypr.yaw );
 */
 
 
@@ -35,6 +38,13 @@ How to use it (example):
 #define IMU_H
 
 #include <Arduino.h>
+#include "ahrs.h"
+#include "i2cman.h"
+
+#define IMU_AHRS_PERIOD 10    // update period (ms)
+
+// sensor data received (async reads)
+enum { IMU_GYRO_OK = 1, IMU_ACC_OK = 2, IMU_COM_OK = 4 };
 
 // IMU state
 enum { IMU_RUN, IMU_CAL_COM };
@@ -82,9 +92,22 @@ public:
   int errorCounter;
   boolean hardwareInitialized;  
   byte state;
-  unsigned long lastAHRSTime;
+  unsigned long lastAHRSTime;  // micros
   unsigned long now;  
   ypr_t ypr;  // gyro yaw,pitch,roll    
+  AHRS ahrs;  // quaternion filter
+  // sensor fusion of current gyro/acc/com data (dt: seconds)
+  void fuse(float dt);
+  // previous filter (Kalman pitch/roll, complementary yaw), for comparison (see tests/host)
+  void fuseComplementary(int looptime);
+  // async reads (I2CMan)
+  byte gyroBuf[6];
+  byte accBuf[6];
+  byte comBuf[6];
+  volatile byte readsPending;
+  volatile byte readsOk;        // IMU_GYRO_OK | IMU_ACC_OK | IMU_COM_OK
+  unsigned long sampleTime;     // micros (reads queued)
+  unsigned long lastSampleTime;
   // --------- gyro state -----------------------------
   point_float_t gyro;   // gyro sensor data (degree)    
   point_float_t gyroOfs; // gyro calibration data
@@ -146,6 +169,11 @@ private:
   void readL3G4200D(boolean useTa);
   void readADXL345B();
   void readHMC5883L();
+  void parseL3G4200D(uint8_t countOfData);
+  void parseADXL345B(const uint8_t *buf);
+  void parseHMC5883L(const uint8_t *buf);
+  void readAsync();
+  static void readDone(i2ctrans_t &t);
   boolean foundNewMinMax;
 };
 
@@ -0,0 +1,341 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "lanes.h"
+#include "printfmt.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+  #define PI 3.1415926535897932384626433832795
+#endif
+
+// lo end flag -> hi end flag
+#define LANE_END_FLAG(flag, end) ((end) > 0 ? (flag) << 1 : (flag))
+
+
+static float distance(float x1, float y1, float x2, float y2){
+  return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+}
+
+static float scaleAngle(float v){
+  while (v > PI) v -= 2 * PI;
+  while (v < -PI) v += 2 * PI;
+  return v;
+}
+
+
+LanePlanner::LanePlanner(){
+  mode = PLAN_OFF;
+  rollRequest = false;
+  width = 20;
+  lane = 0;
+  dir = adv = 1;
+  gaps = 0;
+  poseX = poseY = poseHeading = poseS = poseC = 0;
+}
+
+lane_t *LanePlanner::laneAt(int k){
+  k += LANES_MAX / 2;
+  if ((k < 0) || (k >= LANES_MAX)) return NULL;
+  return &lanes[k];
+}
+
+void LanePlanner::toLane(float x, float y, float &s, float &c){
+  float dx = x - originX;
+  float dy = y - originY;
+  s = dx * sinH + dy * cosH;
+  c = dx * cosH - dy * sinH;
+}
+
+void LanePlanner::begin(float x, float y, float heading, int laneWidth){
+  memset(lanes, 0, sizeof lanes);
+  width = (laneWidth < 5) ? 5 : laneWidth;
+  originX = poseX = x;
+  originY = poseY = y;
+  laneHeading = poseHeading = heading;
+  sinH = sin(heading);
+  cosH = cos(heading);
+  poseS = poseC = 0;
+  gaps = 0;
+  adv = 1;
+  rollRequest = false;
+  mode = PLAN_LANE;
+  enterLane(0, 1);
+}
+
+void LanePlanner::stop(){
+  mode = PLAN_OFF;
+  rollRequest = false;
+}
+
+void LanePlanner::resume(){
+  if (mode == PLAN_LANE){
+    lane_t *l = laneAt(lane);
+    targetLane = lane;
+    targetDir = dir;
+    targetEnd = dir;
+    targetS = (dir > 0) ? l->hi : l->lo;
+    mode = PLAN_GOTO;
+  }
+  if (mode == PLAN_GOTO) rollRequest = true;
+}
+
+bool LanePlanner::getRollRequest(){
+  bool res = rollRequest;
+  rollRequest = false;
+  return res;
+}
+
+void LanePlanner::enterLane(int k, int d){
+  lane_t *l = laneAt(k);
+  lane = k;
+  dir = d;
+  passEntry = (int16_t)poseS;
+  passVisited = (l->flags & LANE_VISITED);
+  passLo = l->lo;
+  passHi = l->hi;
+  entryType = 0;
+}
+
+// sets end type (flag of lo end: LANE_LO_BOUNDARY, LANE_LO_OBSTACLE or 0 = unknown)
+void LanePlanner::setEnd(lane_t *l, int end, uint8_t type){
+  l->flags &= ~LANE_END_FLAG(LANE_LO_BOUNDARY | LANE_LO_OBSTACLE, end);
+  l->flags |= LANE_END_FLAG(type, end);
+}
+
+void LanePlanner::setPose(float x, float y, float heading, bool covering){
+  poseX = x;
+  poseY = y;
+  poseHeading = heading;
+  toLane(x, y, poseS, poseC);
+  if ((mode != PLAN_LANE) && (mode != PLAN_GOTO)) return;
+  // covered lane (driving along it in either direction)
+  if ((covering) && (fabs(cos(heading - laneHeading)) > cos(LANE_ALIGNED))){
+    lane_t *l = laneAt((int)floor(poseC / width + 0.5));
+    if (l != NULL){
+      int16_t s = (int16_t)poseS;
+      if (!(l->flags & LANE_VISITED)){
+        l->flags = LANE_VISITED;
+        l->lo = l->hi = s;
+        if ((mode == PLAN_LANE) && (l == laneAt(lane))) setEnd(l, -dir, entryType);
+      } else if (s < l->lo) {
+        l->lo = s;
+        setEnd(l, -1, 0);
+      } else if (s > l->hi) {
+        l->hi = s;
+        setEnd(l, 1, 0);
+      }
+    }
+  }
+  if (mode == PLAN_GOTO){
+    float tx = originX + targetS * sinH + targetLane * width * cosH;
+    float ty = originY + targetS * cosH - targetLane * width * sinH;
+    if (distance(x, y, tx, ty) < LANE_ARRIVE){
+      mode = PLAN_LANE;
+      enterLane(targetLane, targetDir);
+      rollRequest = true;
+    }
+  } else if ((covering) && (passVisited)) {
+    // pass reached the part covered before: gap closed, continue with the next lane
+    if ( ((dir > 0) && (passEntry < passLo) && (poseS > passLo + width/2))
+      || ((dir < 0) && (passEntry > passHi) && (poseS < passHi - width/2)) ){
+      nextLane(0);
+      rollRequest = true;
+    }
+  }
+}
+
+void LanePlanner::laneEnd(bool boundary){
+  if (mode == PLAN_GOTO){
+    failGap();
+    nextGap();
+  } else if ((mode == PLAN_LANE) && (!(laneAt(lane)->flags & LANE_VISITED))) {
+    // nothing covered (lane outside the perimeter)
+    targetLane = lane;
+    targetEnd = 0;
+    targetS = poseS;
+    failGap();
+    nextGap();
+  } else if (mode == PLAN_LANE){
+    uint8_t type = (boundary) ? LANE_LO_BOUNDARY : LANE_LO_OBSTACLE;
+    setEnd(laneAt(lane), dir, type);
+    nextLane(type);
+  }
+}
+
+// sweep: neighbour lane in opposite direction (entry end: obstacle if the end reached is one, else unknown)
+void LanePlanner::nextLane(uint8_t type){
+  lane_t *l = laneAt(lane);
+  lane_t *n = laneAt(lane + adv);
+  if ((l->hi - l->lo < LANE_MIN_LENGTH) || (n == NULL)
+    || ( (n->flags & LANE_VISITED) && (poseS >= n->lo - width/2) && (poseS <= n->hi + width/2) )) {
+    nextGap();
+    return;
+  }
+  enterLane(lane + adv, -dir);
+  entryType = type & LANE_LO_OBSTACLE;
+  if ((n->flags & LANE_VISITED) && ((dir > 0) ? (poseS <= n->lo) : (poseS >= n->hi))) setEnd(n, -dir, entryType);
+}
+
+// furthest end of the other visited lanes in direction 'end' (both: on both sides, i.e. the nearer
+// of the two sides), false if there is none
+bool LanePlanner::extent(int k, int end, bool both, int &ext){
+  bool found[2] = { false, false };
+  int best[2] = { 0, 0 };
+  for (int j = -LANES_MAX/2; j < LANES_MAX/2; j++){
+    if (j == k) continue;
+    lane_t *l = laneAt(j);
+    if (!(l->flags & LANE_VISITED)) continue;
+    int side = (j > k);
+    int v = ((end > 0) ? l->hi : l->lo) * end;
+    if ((!found[side]) || (v > best[side])) best[side] = v;
+    found[side] = true;
+  }
+  if (both){
+    if ((!found[0]) || (!found[1])) return false;
+    ext = ((best[0] < best[1]) ? best[0] : best[1]) * end;
+  } else {
+    if ((!found[0]) && (!found[1])) return false;
+    if (!found[0]) best[0] = best[1];
+    if (!found[1]) best[1] = best[0];
+    ext = ((best[0] > best[1]) ? best[0] : best[1]) * end;
+  }
+  return true;
+}
+
+// nearest gap: goto (or done if there is none)
+void LanePlanner::nextGap(){
+  float bestDist = -1;
+  for (int k = -LANES_MAX/2; k < LANES_MAX/2; k++){
+    lane_t *l = laneAt(k);
+    if (!(l->flags & LANE_VISITED)) continue;
+    for (int end = -1; end <= 1; end += 2){
+      // gap at lane end
+      if (l->flags & LANE_END_FLAG(LANE_LO_CLOSED, end)) continue;
+      int e = (end > 0) ? l->hi : l->lo;
+      int ext;
+      int attempts = (end > 0) ? l->attemptsHi : l->attemptsLo;
+      bool boundary = (l->flags & LANE_END_FLAG(LANE_LO_BOUNDARY, end));
+      bool obstacle = (l->flags & LANE_END_FLAG(LANE_LO_OBSTACLE, end));
+      if ((!extent(k, end, boundary, ext)) || ((ext - e) * end < LANE_GAP_MIN)) continue;
+      // unknown end: drive on from there, else approach from behind and drive back to the end
+      float s = e;
+      int d = end;
+      if ((boundary) || (obstacle)){
+        s = e + (ext - e) * (LANE_ATTEMPTS - attempts) / (LANE_ATTEMPTS + 1);
+        d = -end;
+      }
+      float dist = distance(poseS, poseC, s, k * width);
+      if ((ext - e) * end < LANE_GAP_SMALL) dist += 100000L;
+      if ((bestDist < 0) || (dist < bestDist)){
+        bestDist = dist;
+        targetLane = k;
+        targetS = s;
+        targetDir = d;
+        targetEnd = end;
+      }
+    }
+    // unvisited neighbour lane (from the nearer end of this lane)
+    if (l->hi - l->lo < 2 * LANE_MIN_LENGTH) continue;
+    for (int side = -1; side <= 1; side += 2){
+      lane_t *n = laneAt(k + side);
+      if ((n == NULL) || (n->flags & LANE_VISITED)) continue;
+      float s = l->lo + width;
+      int d = 1;
+      if (fabs(l->hi - poseS) < fabs(l->lo - poseS)){
+        s = l->hi - width;
+        d = -1;
+      }
+      float dist = distance(poseS, poseC, s, (k + side) * width);
+      if ((bestDist < 0) || (dist < bestDist)){
+        bestDist = dist;
+        targetLane = k + side;
+        targetS = s;
+        targetDir = d;
+        targetEnd = 0;
+      }
+    }
+  }
+  if (bestDist < 0){
+    mode = PLAN_DONE;
+    return;
+  }
+  // continue the sweep towards the neighbour with the same gap (or away from the visited lane)
+  if (targetEnd == 0){
+    lane_t *a = laneAt(targetLane - 1);
+    adv = ((a != NULL) && (a->flags & LANE_VISITED)) ? 1 : -1;
+  } else {
+    lane_t *a = laneAt(targetLane - 1);
+    lane_t *b = laneAt(targetLane + 1);
+    int ea = (a == NULL) ? 0 : ((targetEnd > 0) ? a->hi : a->lo) * targetEnd;
+    int eb = (b == NULL) ? 0 : ((targetEnd > 0) ? b->hi : b->lo) * targetEnd;
+    adv = (b != NULL) && ((a == NULL) || (eb < ea)) ? 1 : -1;
+  }
+  gaps++;
+  mode = PLAN_GOTO;
+}
+
+// goto failed (perimeter/obstacle on the way): give the gap up after LANE_ATTEMPTS
+void LanePlanner::failGap(){
+  lane_t *l = laneAt(targetLane);
+  if (targetEnd > 0){
+    if (++l->attemptsHi >= LANE_ATTEMPTS) l->flags |= LANE_HI_CLOSED;
+  } else if (targetEnd < 0){
+    if (++l->attemptsLo >= LANE_ATTEMPTS) l->flags |= LANE_LO_CLOSED;
+  } else if (++l->attemptsLo >= LANE_ATTEMPTS) {
+    // unreachable lane: short lane without gaps
+    l->flags = LANE_VISITED | LANE_LO_CLOSED | LANE_HI_CLOSED;
+    l->lo = l->hi = (int16_t)targetS;
+  }
+}
+
+float LanePlanner::getHeading(){
+  if (mode == PLAN_LANE){
+    // steer onto the lane center line
+    float e = poseC - lane * width;
+    float corr = atan(e / LANE_LOOKAHEAD);
+    if (corr > LANE_MAX_CORRECTION) corr = LANE_MAX_CORRECTION;
+    if (corr < -LANE_MAX_CORRECTION) corr = -LANE_MAX_CORRECTION;
+    return scaleAngle(laneHeading + ((dir < 0) ? PI : 0) - dir * corr);
+  }
+  if (mode == PLAN_GOTO){
+    float tx = originX + targetS * sinH + targetLane * width * cosH;
+    float ty = originY + targetS * cosH - targetLane * width * sinH;
+    return atan2(tx - poseX, ty - poseY);
+  }
+  return poseHeading;
+}
+
+int LanePlanner::getVisitedCount(){
+  if (mode == PLAN_OFF) return 0;
+  int count = 0;
+  for (int i=0; i < LANES_MAX; i++) if (lanes[i].flags & LANE_VISITED) count++;
+  return count;
+}
+
+void LanePlanner::print(Print &s){
+  static const char *modeNames[] = { "off", "lane", "goto", "done" };
+  Streamprint(s, "lanes: mode=%s lane=%d dir=%d visited=%d gaps=%d\r\n",
+              modeNames[mode], lane, dir, getVisitedCount(), gaps);
+}
@@ -0,0 +1,167 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+lane (boustrophedon) coverage planner driven by the odometry/IMU pose
+
+- lanes are parallel to the robot heading when the job starts, lane k is the line at cross
+  offset k * laneWidth from the start point (lane frame = odometry frame, i.e. odometry drift
+  shifts the lanes on long jobs)
+- for each lane the covered part [lo, hi] (cm along the lane) is kept in a fixed table, each
+  end is boundary (perimeter), obstacle or unknown (where a pass started)
+- sweep: drive the lane until perimeter/obstacle (laneEnd), then the neighbour lane in the opposite
+  direction, until the next lane is already covered at that point or the lane is too short
+  (edge of the lawn) - the robot reverses before it rolls, so the entry end of the next lane is
+  unknown (perimeter) or obstacle
+- gaps: lane ends where the neighbour lanes reach further (behind obstacles/islands: both sides,
+  obstacle/unknown end: either side) and unvisited lanes next to visited ones - the nearest gap
+  is approached (goto), then swept from there; a gap is given up after LANE_ATTEMPTS failed
+  approaches
+- the planner only computes headings (imuDriveHeading/imuRollHeading), the robot state
+  machine drives (forward/reverse/roll) as usual
+- compiles for Arduino and the host (drivecontrol simulator)
+
+How to use it (example):
+  lanePlanner.begin(odometryX, odometryY, imu.ypr.yaw, laneWidth);
+  lanePlanner.setPose(odometryX, odometryY, imu.ypr.yaw, perimeterInside);  // while driving forward
+  imuDriveHeading = lanePlanner.getHeading();
+  lanePlanner.laneEnd(true);                               // perimeter reached (false: obstacle)
+  if (lanePlanner.getRollRequest()) ...                    // roll to getHeading() first
+  if (lanePlanner.isDone()) ...                            // drive home
+  lanePlanner.resume();                                    // after charging: back to the last lane
+*/
+
+#ifndef LANES_H
+#define LANES_H
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  // host build (simulator)
+  #include <stdint.h>
+  #include "Print.h"
+#endif
+
+#ifdef __AVR__
+  #define LANES_MAX 40               // lane table (8 bytes per lane)
+#else
+  #define LANES_MAX 200
+#endif
+
+#define LANE_LOOKAHEAD 50            // cm, lane following: heading points this far ahead onto the lane
+#define LANE_MAX_CORRECTION 1.0      // rad, max. heading correction when following a lane
+#define LANE_ALIGNED 0.35            // rad, pose marks a lane covered if aligned within this angle
+#define LANE_MIN_LENGTH 30           // cm, shorter lane ends the sweep (outside the lawn)
+#define LANE_GAP_MIN 30              // cm, neighbours reaching further than this make a gap
+#define LANE_GAP_SMALL 100           // cm, smaller gaps (lane ends at the perimeter) are approached last
+#define LANE_ATTEMPTS 3              // approaches per gap
+#define LANE_ARRIVE 25               // cm, gap target reached
+
+// lane flags
+#define LANE_VISITED      0x01
+#define LANE_LO_BOUNDARY  0x02       // lo end is the perimeter
+#define LANE_HI_BOUNDARY  0x04
+#define LANE_LO_OBSTACLE  0x08       // lo end is an obstacle (neither: unknown, e.g. start point)
+#define LANE_HI_OBSTACLE  0x10
+#define LANE_LO_CLOSED    0x20       // no gap at lo end (given up)
+#define LANE_HI_CLOSED    0x40
+
+enum { PLAN_OFF, PLAN_LANE, PLAN_GOTO, PLAN_DONE };
+
+
+struct lane_t {
+  int16_t lo;            // covered part (cm along the lane)
+  int16_t hi;
+  uint8_t flags;
+  uint8_t attemptsLo;    // failed approaches of the gap at lo/hi end
+  uint8_t attemptsHi;
+  uint8_t reserved;
+};
+
+typedef struct lane_t lane_t;
+
+
+class LanePlanner
+{
+  public:
+    LanePlanner();
+    // starts a new job, lanes parallel to heading (rad, clockwise from the y axis)
+    void begin(float x, float y, float heading, int laneWidth);
+    void stop();
+    // after an interruption (charging): approach the last lane end again
+    void resume();
+    // odometry pose (cm) while driving forward, covering: mowing inside the perimeter (pose covers the lane)
+    void setPose(float x, float y, float heading, bool covering);
+    // forward drive stopped by perimeter (boundary) or obstacle
+    void laneEnd(bool boundary);
+    // heading to drive/roll to
+    float getHeading();
+    // robot must roll to getHeading() before driving on (cleared by reading)
+    bool getRollRequest();
+    bool isActive(){ return ((mode != PLAN_OFF) && (mode != PLAN_DONE)); }
+    bool isDone(){ return (mode == PLAN_DONE); }
+    uint8_t getMode(){ return mode; }
+    int getLane(){ return lane; }
+    int getVisitedCount();
+    int getGapCount(){ return gaps; }
+    void print(Print &s);
+  private:
+    lane_t lanes[LANES_MAX];
+    uint8_t mode;
+    bool rollRequest;
+    int width;
+    float originX;
+    float originY;
+    float laneHeading;
+    float sinH;
+    float cosH;
+    float poseX;
+    float poseY;
+    float poseHeading;
+    float poseS;           // pose in lane frame (along, cross)
+    float poseC;
+    int lane;              // current lane
+    int dir;               // direction along the lane (+1/-1)
+    int adv;               // next lane (+1/-1)
+    int16_t passLo;        // covered part of the current lane before this pass
+    int16_t passHi;
+    int16_t passEntry;     // where this pass started
+    bool passVisited;
+    uint8_t entryType;     // end type of the current lane where it is entered (set when it is first covered)
+    int targetLane;        // goto: gap target
+    int targetDir;
+    int targetEnd;         // gap end (+1 hi, -1 lo, 0 unvisited lane)
+    float targetS;
+    int gaps;              // gaps approached
+    lane_t *laneAt(int k);
+    void toLane(float x, float y, float &s, float &c);
+    void enterLane(int k, int d);
+    void setEnd(lane_t *l, int end, uint8_t type);
+    void nextLane(uint8_t type);
+    void nextGap();
+    bool extent(int k, int end, bool both, int &ext);
+    void failGap();
+};
+
+
+#endif
@@ -0,0 +1,374 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "localize.h"
+#include "printfmt.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+  #define PI 3.1415926535897932384626433832795
+#endif
+
+
+static float distance(float x1, float y1, float x2, float y2){
+  return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+}
+
+
+Localizer::Localizer(){
+  available = false;
+  ready = false;
+  odoValid = false;
+  rng = 1;
+  scale = 0;
+  autoScale = true;
+  scaleNum = scaleDen = 0;
+  odoX = odoY = poseHeading = 0;
+  meanX = meanY = meanOffset = 0;
+  spread = 0;
+  updates = 0;
+  wireCount = loopCount = loopStart = 0;
+  stepScale = 1;
+  openLength = 0;
+}
+
+
+#ifdef __AVR__
+
+void Localizer::begin(uint32_t seed){}
+void Localizer::clearWire(){}
+void Localizer::addWirePoint(float x, float y, int minDist){}
+bool Localizer::isLoopComplete(float x, float y){ return false; }
+bool Localizer::closeLoop(bool island){ return false; }
+bool Localizer::prepare(){ return false; }
+void Localizer::reset(float x, float y, float sigma){}
+void Localizer::setScale(float value){}
+void Localizer::predict(float x, float y, float heading){}
+void Localizer::sense(float magnitude){}
+float Localizer::getHeading(){ return 0; }
+float Localizer::fieldAt(float x, float y){ return 0; }
+float Localizer::computeField(float x, float y, float minDist){ return 0; }
+void Localizer::print(Print &s){
+  s.println(F("localization not available"));
+}
+
+#else
+
+void Localizer::begin(uint32_t seed){
+  available = true;
+  rng = (seed == 0) ? 1 : seed;
+  clearWire();
+  reset(0, 0, 0);
+}
+
+// xorshift32, [0, 1)
+float Localizer::uniform(){
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return (rng >> 8) * (1.0 / 16777216.0);
+}
+
+// approx. standard normal (sum of three uniform [-1, 1), variance 1)
+float Localizer::gauss(){
+  return 2 * (uniform() + uniform() + uniform()) - 3;
+}
+
+void Localizer::clearWire(){
+  ready = false;
+  wireCount = loopCount = loopStart = 0;
+  stepScale = 1;
+  openLength = 0;
+  prepareIdx = 0;
+}
+
+void Localizer::addWirePoint(float x, float y, int minDist){
+  if ((!available) || (loopCount >= LOC_LOOPS)) return;
+  if (wireCount > loopStart){
+    float d = distance(wireX[wireCount-1], wireY[wireCount-1], x, y);
+    if (d < minDist * stepScale) return;
+    openLength += d;
+  }
+  if (wireCount >= LOC_WIRE_POINTS){
+    // table full: every other point of the open loop
+    if (wireCount - loopStart < 4) return;
+    int n = loopStart;
+    for (int i=loopStart; i < wireCount; i += 2){
+      wireX[n] = wireX[i];
+      wireY[n] = wireY[i];
+      n++;
+    }
+    wireCount = n;
+    stepScale *= 2;
+  }
+  wireX[wireCount] = x;
+  wireY[wireCount] = y;
+  wireCount++;
+}
+
+bool Localizer::isLoopComplete(float x, float y){
+  if ((!available) || (wireCount - loopStart < 3) || (openLength < LOC_WIRE_MIN_LENGTH)) return false;
+  return (distance(wireX[loopStart], wireY[loopStart], x, y) < LOC_WIRE_CLOSE);
+}
+
+// current direction so that the field is positive inside the lawn (perimeter: inside, island: outside)
+bool Localizer::closeLoop(bool island){
+  if ((!available) || (wireCount - loopStart < 3)) return false;
+  float area = 0;
+  for (int i=loopStart, j=wireCount-1; i < wireCount; j = i++)
+    area += (float)wireX[j] * wireY[i] - (float)wireX[i] * wireY[j];
+  loopReverse[loopCount] = ((area < 0) != island);
+  loopEnd[loopCount] = wireCount;
+  loopCount++;
+  loopStart = wireCount;
+  stepScale = 1;
+  openLength = 0;
+  // field grid over all loops
+  int x0 = wireX[0], x1 = wireX[0], y0 = wireY[0], y1 = wireY[0];
+  for (int i=1; i < wireCount; i++){
+    if (wireX[i] < x0) x0 = wireX[i];
+    if (wireX[i] > x1) x1 = wireX[i];
+    if (wireY[i] < y0) y0 = wireY[i];
+    if (wireY[i] > y1) y1 = wireY[i];
+  }
+  gridX = x0 - LOC_GRID_MARGIN;
+  gridY = y0 - LOC_GRID_MARGIN;
+  int size = ((x1 - x0 > y1 - y0) ? x1 - x0 : y1 - y0) + 2 * LOC_GRID_MARGIN;
+  gridCell = (size + LOC_GRID_SIZE - 2) / (LOC_GRID_SIZE - 1);
+  if (gridCell < LOC_GRID_MIN_CELL) gridCell = LOC_GRID_MIN_CELL;
+  prepareIdx = 0;
+  ready = false;
+  return true;
+}
+
+bool Localizer::prepare(){
+  if ((!available) || (loopCount == 0)) return false;
+  for (int k=0; (k < LOC_PREPARE_CELLS) && (prepareIdx < LOC_GRID_SIZE * LOC_GRID_SIZE); k++){
+    int i = prepareIdx % LOC_GRID_SIZE;
+    int j = prepareIdx / LOC_GRID_SIZE;
+    // nodes next to the wire: field at a quarter cell (bilinear lookup would overshoot)
+    float b = computeField(gridX + i * gridCell, gridY + j * gridCell, gridCell / 4.0) * LOC_GRID_SCALE;
+    if (b > 32767) b = 32767;
+      else if (b < -32767) b = -32767;
+    grid[prepareIdx++] = b;
+  }
+  ready = (prepareIdx == LOC_GRID_SIZE * LOC_GRID_SIZE);
+  return ready;
+}
+
+// magnetic field of the wire segments (Biot-Savart, field perpendicular to ground plane)
+// finite straight wire: B = k/d * (sin(a2) - sin(a1)), d = distance to wire line (dm, min. 1 cm)
+float Localizer::computeField(float x, float y, float minDist){
+  const float k = 100.0 / (4.0 * PI);
+  float b = 0;
+  int first = 0;
+  for (int l=0; l < loopCount; l++){
+    for (int i=first, j=loopEnd[l]-1; i < loopEnd[l]; j = i++){
+      int a = (loopReverse[l]) ? i : j;
+      int e = (loopReverse[l]) ? j : i;
+      float dx = wireX[e] - wireX[a];
+      float dy = wireY[e] - wireY[a];
+      float len = sqrt(dx*dx + dy*dy);
+      if (len < 0.001) continue;
+      float tx = dx / len;
+      float ty = dy / len;
+      float ax = wireX[a] - x;
+      float ay = wireY[a] - y;
+      float bx = wireX[e] - x;
+      float by = wireY[e] - y;
+      float d = (tx*(-ay) - ty*(-ax)) / 10.0;
+      if (fabs(d) < minDist / 10.0) d = (d < 0) ? -minDist / 10.0 : minDist / 10.0;
+      float ra = sqrt(ax*ax + ay*ay);
+      float rb = sqrt(bx*bx + by*by);
+      if (ra < 0.001) ra = 0.001;
+      if (rb < 0.001) rb = 0.001;
+      b += k / d * ((tx*bx + ty*by) / rb - (tx*ax + ty*ay) / ra);
+    }
+    first = loopEnd[l];
+  }
+  return b;
+}
+
+// bilinear grid lookup (clamped to the grid)
+float Localizer::fieldAt(float x, float y){
+  if (!ready) return 0;
+  float fx = (x - gridX) / gridCell;
+  float fy = (y - gridY) / gridCell;
+  if (fx < 0) fx = 0;
+    else if (fx > LOC_GRID_SIZE - 1.001) fx = LOC_GRID_SIZE - 1.001;
+  if (fy < 0) fy = 0;
+    else if (fy > LOC_GRID_SIZE - 1.001) fy = LOC_GRID_SIZE - 1.001;
+  int i = fx;
+  int j = fy;
+  fx -= i;
+  fy -= j;
+  const int16_t *g = &grid[j * LOC_GRID_SIZE + i];
+  float b0 = g[0] + fx * (g[1] - g[0]);
+  float b1 = g[LOC_GRID_SIZE] + fx * (g[LOC_GRID_SIZE + 1] - g[LOC_GRID_SIZE]);
+  return (b0 + fy * (b1 - b0)) / LOC_GRID_SCALE;
+}
+
+void Localizer::reset(float x, float y, float sigma){
+  if (!available) return;
+  for (int i=0; i < LOC_PARTICLES; i++){
+    px[i] = x + sigma * gauss();
+    py[i] = y + sigma * gauss();
+    po[i] = 0;
+    pw[i] = 1.0 / LOC_PARTICLES;
+  }
+  odoValid = false;
+  estimate();
+}
+
+void Localizer::setScale(float value){
+  scale = value;
+  autoScale = (value == 0);
+  scaleNum = scaleDen = 0;
+}
+
+void Localizer::predict(float x, float y, float heading){
+  if (!ready) return;
+  poseHeading = heading;
+  if (!odoValid){
+    odoX = x;
+    odoY = y;
+    odoValid = true;
+    return;
+  }
+  float dx = x - odoX;
+  float dy = y - odoY;
+  odoX = x;
+  odoY = y;
+  if (fabs(dx) + fabs(dy) < 0.5) return;   // not moving
+  // odometry step rotated by the mean heading offset (heading clockwise from the y axis),
+  // particle deviations from the mean are small angles
+  float c = cos(meanOffset);
+  float s = sin(meanOffset);
+  float rx = dx * c + dy * s;
+  float ry = dy * c - dx * s;
+  for (int i=0; i < LOC_PARTICLES; i++){
+    float f = 1 + LOC_DIST_NOISE * gauss();
+    float o = po[i] - meanOffset;
+    px[i] += f * (rx + o * ry) + LOC_POS_NOISE * gauss();
+    py[i] += f * (ry - o * rx) + LOC_POS_NOISE * gauss();
+    po[i] += LOC_HEADING_NOISE * gauss();
+  }
+  estimate();
+}
+
+void Localizer::sense(float magnitude){
+  if (!ready) return;
+  if (scale == 0){
+    // auto scale: first reading at the start pose
+    float b = fieldAt(meanX, meanY);
+    if (fabs(b) > LOC_SCALE_MIN_FIELD) scale = magnitude / b;
+    return;
+  }
+  float m = magnitude / scale;
+  float sum = 0;
+  for (int i=0; i < LOC_PARTICLES; i++){
+    float b = fieldAt(px[i], py[i]);
+    float e = m - b;
+    float s = LOC_SIGMA_ABS + LOC_SIGMA_REL * fabs(b);
+    pw[i] *= 1.0 / (1.0 + e * e / (s * s));
+    sum += pw[i];
+  }
+  if (sum <= 1e-30){
+    // no particle explains the reading: keep them all
+    for (int i=0; i < LOC_PARTICLES; i++) pw[i] = 1.0 / LOC_PARTICLES;
+  } else {
+    float neff = 0;
+    for (int i=0; i < LOC_PARTICLES; i++){
+      pw[i] /= sum;
+      neff += pw[i] * pw[i];
+    }
+    if (neff * LOC_PARTICLES > 2) resample();     // effective count 1/neff below half
+  }
+  estimate();
+  if ((autoScale) && (spread < LOC_SCALE_SPREAD)){
+    float b = fieldAt(meanX, meanY);
+    if (fabs(b) > LOC_SCALE_MIN_FIELD){
+      scaleNum = 0.99 * scaleNum + magnitude * b;
+      scaleDen = 0.99 * scaleDen + b * b;
+      scale = scaleNum / scaleDen;
+    }
+  }
+  updates++;
+}
+
+// systematic resampling (one random offset, O(N))
+void Localizer::resample(){
+  float nx[LOC_PARTICLES];
+  float ny[LOC_PARTICLES];
+  float no[LOC_PARTICLES];
+  float u = uniform() / LOC_PARTICLES;
+  float c = pw[0];
+  int k = 0;
+  for (int i=0; i < LOC_PARTICLES; i++){
+    while ((u > c) && (k < LOC_PARTICLES - 1)) c += pw[++k];
+    nx[i] = px[k];
+    ny[i] = py[k];
+    no[i] = po[k];
+    u += 1.0 / LOC_PARTICLES;
+  }
+  memcpy(px, nx, sizeof px);
+  memcpy(py, ny, sizeof py);
+  memcpy(po, no, sizeof po);
+  for (int i=0; i < LOC_PARTICLES; i++) pw[i] = 1.0 / LOC_PARTICLES;
+}
+
+// weighted mean and spread
+void Localizer::estimate(){
+  float x = 0, y = 0, o = 0;
+  for (int i=0; i < LOC_PARTICLES; i++){
+    x += pw[i] * px[i];
+    y += pw[i] * py[i];
+    o += pw[i] * po[i];
+  }
+  float v = 0;
+  for (int i=0; i < LOC_PARTICLES; i++) v += pw[i] * ((px[i] - x) * (px[i] - x) + (py[i] - y) * (py[i] - y));
+  meanX = x;
+  meanY = y;
+  meanOffset = o;
+  spread = sqrt(v);
+}
+
+float Localizer::getHeading(){
+  float h = poseHeading + meanOffset;
+  if (h > PI) h -= 2 * PI;
+    else if (h < -PI) h += 2 * PI;
+  return h;
+}
+
+void Localizer::print(Print &s){
+  if (!available) {
+    s.print("localization not available\r\n");
+    return;
+  }
+  Streamprint(s, "localize: ready=%d wire=%d loops=%d grid=%d%% x=%d y=%d spread=%d scale=%d/100 updates=%lu\r\n",
+    ready, wireCount, loopCount, prepareIdx * 100 / (LOC_GRID_SIZE * LOC_GRID_SIZE),
+    (int)meanX, (int)meanY, (int)spread, (int)(scale * 100), updates);
+}
+
+#endif
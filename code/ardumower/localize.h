@@ -0,0 +1,170 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+particle filter localization relative to the perimeter wire (perimeter magnitude, odometry, IMU yaw)
+
+- wire map: loops of wire points (cm, odometry frame), recorded while tracking the perimeter
+  (robot: one full loop) or given (simulator: scenario perimeter and islands)
+- field model: Biot-Savart sum over the wire segments (same model as the simulator world), current
+  direction so that the field is positive inside the lawn, precomputed into a grid of
+  LOC_GRID_SIZE x LOC_GRID_SIZE int16 values by prepare() (a few cells per call, bilinear lookup)
+- particles (fixed count, one float array per component): position (cm) and heading offset (rad)
+  of the odometry pose - predict() moves each particle by the odometry step (which follows the IMU
+  yaw if available, see calcOdometry) rotated by its heading offset, plus noise
+- sense(): weights by a Cauchy likelihood of the measured magnitude vs. scale * field model
+  (robust against outliers, no exp()), systematic resampling if the effective particle count drops
+  below half - scale 0 estimates the magnitude scale from the readings (least squares at the
+  estimated pose while well localized)
+- deterministic random numbers (xorshift32, seed in begin()), i.e. reproducible runs
+- Arduino Mega: not available (RAM too small), all functions do nothing
+
+Status: experimental, off by default (setting localizeUse). The estimate is only shown (pfod perimeter menu),
+nothing in the firmware uses it. In the simulator scenarios it is worse than the raw odometry except with
+odometry drift (drift.txt: 25 cm vs. 45 cm), e.g. rectangle.txt 8 cm vs. 1 cm, garden.txt 173 cm vs. 2 cm.
+
+How to use it (example):
+  localizer.begin(1);                                     // seed
+  localizer.addWirePoint(odometryX, odometryY, LOC_WIRE_STEP);  // while tracking the perimeter
+  if (localizer.isLoopComplete(odometryX, odometryY)) localizer.closeLoop(false);
+  localizer.prepare();                                    // until isReady()
+  localizer.reset(odometryX, odometryY, 20);
+  localizer.predict(odometryX, odometryY, imu.ypr.yaw);   // each odometry update
+  localizer.sense(-perimeterMag);                         // magnitude positive inside
+  localizer.getX(); localizer.getY(); localizer.getSpread();
+*/
+
+#ifndef LOCALIZE_H
+#define LOCALIZE_H
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  // host build (simulator)
+  #include <stdint.h>
+  #include "Print.h"
+#endif
+
+#define LOC_PARTICLES 64
+#define LOC_WIRE_POINTS 128          // all loops (table full: open loop is thinned out)
+#define LOC_LOOPS 4
+#define LOC_WIRE_STEP 50             // cm, robot: min. distance of recorded wire points
+#define LOC_WIRE_MIN_LENGTH 1000     // cm, recorded loop is complete when back at its start after this
+#define LOC_WIRE_CLOSE 100           // cm
+#define LOC_GRID_SIZE 64             // field grid nodes per side (8 KB)
+#define LOC_GRID_MIN_CELL 10         // cm
+#define LOC_GRID_MARGIN 200          // cm around the wire
+#define LOC_GRID_SCALE 100.0         // grid value = field * scale
+#define LOC_PREPARE_CELLS 16         // grid nodes computed per prepare() call
+
+// filter parameters (field model units)
+#define LOC_SIGMA_ABS 0.5            // measurement noise
+#define LOC_SIGMA_REL 0.3            // measurement noise relative to the field (model error near the wire)
+#define LOC_DIST_NOISE 0.05          // relative odometry distance noise
+#define LOC_POS_NOISE 0.5            // cm per update while moving
+#define LOC_HEADING_NOISE 0.003      // rad per update while moving (heading offset random walk)
+#define LOC_SCALE_MIN_FIELD 0.5      // auto scale: min. field at the estimated pose
+#define LOC_SCALE_SPREAD 50          // cm, auto scale: max. spread
+
+
+class Localizer
+{
+  public:
+    Localizer();
+    void begin(uint32_t seed);
+    // wire map (cm): points of the open loop, ignored if closer than minDist to the previous point
+    void clearWire();
+    void addWirePoint(float x, float y, int minDist = 0);
+    // open loop is back at its start (robot recording the perimeter)
+    bool isLoopComplete(float x, float y);
+    // closes the open loop (island: loop inside the perimeter), starts the field grid
+    bool closeLoop(bool island);
+    // computes some field grid nodes, true if the grid is complete
+    bool prepare();
+    bool isReady(){ return ready; }
+    // particles around position (cm)
+    void reset(float x, float y, float sigma);
+    // magnitude = scale * field model (0: estimate scale)
+    void setScale(float value);
+    float getScale(){ return scale; }
+    // odometry pose (cm, heading rad clockwise from the y axis)
+    void predict(float x, float y, float heading);
+    // perimeter magnitude (positive inside)
+    void sense(float magnitude);
+    // estimated pose (weighted mean) and spread (cm, weighted std. deviation)
+    float getX(){ return meanX; }
+    float getY(){ return meanY; }
+    float getHeading();
+    float getSpread(){ return spread; }
+    unsigned long getUpdates(){ return updates; }
+    int getWirePointCount(){ return wireCount; }
+    // field model at position (grid, 0 if not ready)
+    float fieldAt(float x, float y);
+    // field model at position (Biot-Savart sum over the wire segments)
+    float computeField(float x, float y, float minDist = 1);
+    void print(Print &s);
+  private:
+    bool available;
+    bool ready;
+    bool odoValid;
+    uint32_t rng;
+    float scale;
+    bool autoScale;
+    float scaleNum;
+    float scaleDen;
+    float odoX;
+    float odoY;
+    float poseHeading;
+    float meanX;
+    float meanY;
+    float meanOffset;
+    float spread;
+    unsigned long updates;
+    int wireCount;
+    int loopCount;
+    int loopStart;         // first point of the open loop
+    int stepScale;         // open loop thinned out: minDist factor
+    float openLength;      // cm, path length of the open loop
+#ifndef __AVR__
+    int16_t wireX[LOC_WIRE_POINTS];
+    int16_t wireY[LOC_WIRE_POINTS];
+    int16_t loopEnd[LOC_LOOPS];      // closed loops: end of points
+    bool loopReverse[LOC_LOOPS];     // current flows from point i to i-1
+    float px[LOC_PARTICLES];
+    float py[LOC_PARTICLES];
+    float po[LOC_PARTICLES];         // heading offset
+    float pw[LOC_PARTICLES];         // weight
+    int16_t grid[LOC_GRID_SIZE * LOC_GRID_SIZE];
+    int gridX;             // grid origin (cm)
+    int gridY;
+    int gridCell;          // cm
+    int prepareIdx;        // next grid node
+#endif
+    float uniform();
+    float gauss();
+    void estimate();
+    void resample();
+};
+
+
+#endif
@@ -12,37 +12,33 @@ void Robot::setMotorMowRPMState(boolean motorMowRpmState){
 
 
 // calculate map position by odometry sensors
+// (pose is integrated per encoder edge, see EncoderOdometry, wheel speeds from the edge timestamps)
 void Robot::calcOdometry(){
-  if ((!odometryUse) || (millis() < nextTimeOdometry)) return;    
-  nextTimeOdometry = millis() + 100;
-
-  static int lastOdoLeft = 0;
-  static int lastOdoRight = 0;
-  int odoLeft = odometryLeft;
-  int odoRight = odometryRight;
-  int ticksLeft = odoLeft - lastOdoLeft;
-  int ticksRight = odoRight - lastOdoRight;
-  lastOdoLeft = odoLeft;
-  lastOdoRight = odoRight;    
-  double left_cm = ((double)ticksLeft) / ((double)odometryTicksPerCm);
-  double right_cm = ((double)ticksRight) / ((double)odometryTicksPerCm);  
-  double avg_cm  = (left_cm + right_cm) / 2.0;
-  double wheel_theta = (left_cm - right_cm) / ((double)odometryWheelBaseCm);
-  odometryTheta += wheel_theta; 
+  if (!odometryUse) return;    
+
+  encoders.run();
+  encoders.update(micros());
+  float dt = ((float)(millis() - lastMotorRpmTime)) / 1000.0;
+  lastMotorRpmTime = millis();
   
 	// calculate RPM 
-  motorLeftRpmCurr  = double ((( ((double)ticksLeft) / ((double)odometryTicksPerRevolution)) / ((double)(millis() - lastMotorRpmTime))) * 60000.0); 
-  motorRightRpmCurr = double ((( ((double)ticksRight) / ((double)odometryTicksPerRevolution)) / ((double)(millis() - lastMotorRpmTime))) * 60000.0);                      
-  lastMotorRpmTime = millis();
+  motorLeftRpmCurr  = encoders.getSpeedLeft() * 60.0 / ((float)odometryTicksPerRevolution);
+  motorRightRpmCurr = encoders.getSpeedRight() * 60.0 / ((float)odometryTicksPerRevolution);
                
-  if (imuUse){
-    odometryX += avg_cm * sin(imu.ypr.yaw); 
-    odometryY += avg_cm * cos(imu.ypr.yaw); 
-  } else {
-    // FIXME: theta should be old theta, not new theta?
-    odometryX += avg_cm * sin(odometryTheta); 
-    odometryY += avg_cm * cos(odometryTheta); 
- }
+  odometryTheta = encoders.getTheta();
+  odometryX = encoders.getX();
+  odometryY = encoders.getY();
+  float heading = (imuUse) ? imu.ypr.yaw : odometryTheta;
+  // edges until the next update turn the heading by the wheels
+  encoders.setHeading(heading);
+  obstacleMap.setPose(odometryX, odometryY, heading);
+  float distance = encoders.takeDistance();
+  if ((fusionUse) && (gpsUse)){
+    // yaw rate of the odometry heading (IMU yaw or wheels), the filter estimates its drift
+    static float lastHeading = heading;
+    fusion.predict(distance, (dt > 0) ? distancePI(lastHeading, heading) / dt : 0, dt);
+    lastHeading = heading;
+  }
 }
 
 
@@ -152,6 +148,17 @@ void Robot::motorControlPerimeter() {
   if (millis() < nextTimeMotorPerimeterControl) return;
   nextTimeMotorPerimeterControl = millis() + 30; //possible 15ms with the DUE
   //PerimeterMagMaxValue=2000;  //need to change in the future 	
+  double balance = 0;
+  boolean straddle = ((perimeter.isDualCoil()) && ((perimeterMag < 0) != (perimeterMagRight < 0)));
+  if (straddle) {
+    // dual coil, wire between the coils: left/right magnitude difference (-1..1), zero with the wire
+    // centered, positive when the wire is nearer to the left coil - proportional, no in/out toggling
+    // (both coils on one side: single coil control below steers back to the wire)
+    double sum = abs(perimeterMag) + abs(perimeterMagRight);
+    if (sum > 0) balance = (abs(perimeterMag) - abs(perimeterMagRight)) / sum;
+    perimeterPID.x = -5 * balance;
+    perimeterPID.w = 0;
+  } else {
   //tell to the pid where is the mower   (Pid.x)
   perimeterPID.x = 5 * (double(perimeterMag) / perimeterMagMaxValue);
   //tell to the Pid where to go (Pid.w)
@@ -161,6 +168,7 @@ void Robot::motorControlPerimeter() {
   else {
     perimeterPID.w = 0.5;
   }
+  }
   //parameter the PID 
   perimeterPID.y_min = -MaxSpeedperiPwm ;
   perimeterPID.y_max = MaxSpeedperiPwm ;
@@ -235,6 +243,8 @@ void Robot::motorControlPerimeter() {
 		if (abs(perimeterMag ) < perimeterMagMaxValue/4) { 
 			perimeterLastTransitionTime = millis(); //initialise perimeterLastTransitionTime in perfect sthraith line
 		}  
+		// dual coil: wire between the coils
+		if ((straddle) && (fabs(balance) < 0.5)) perimeterLastTransitionTime = millis();
 }
 
 
@@ -398,10 +408,7 @@ void Robot::motorControl(){
 // input: motorMowEnable, motorMowModulate, motorMowRpmCurr
 // output: motorMowPWMCurr
 void Robot::motorMowControl(){
-  if (millis() < nextTimeMotorMowControl) return;
-
-    nextTimeMotorMowControl = millis() + 100;
-    if (motorMowForceOff) motorMowEnable = false;
+  if (motorMowForceOff) motorMowEnable = false;
   double mowSpeed ;
   if (!motorMowEnable) {
     mowSpeed = 0;         
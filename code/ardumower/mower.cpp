@@ -15,6 +15,7 @@ default settings for motor, perimeter, bumper, odometry etc.
 #include "buzzer.h"
 
 
+TxBuffer ConsoleTx(ConsolePort);
 Mower robot;
 
 
@@ -61,6 +62,7 @@ Mower::Mower(){
   motorForwTimeMax           = 80000;     // max. forward time (ms) / timeout
   motorBiDirSpeedRatio1      = 0.3;       // bidir mow pattern speed ratio 1
   motorBiDirSpeedRatio2      = 0.92;      // bidir mow pattern speed ratio 2
+  laneWidth                  = 25;        // lane mow pattern: lane distance (cm), a bit less than the cutting width
     
   motorRightSwapDir          = 0;          // inverse right motor direction? 
   motorLeftSwapDir           = 0;          // inverse left motor direction?
@@ -94,6 +96,13 @@ Mower::Mower(){
   sonarCenterUse             = 0;
   sonarTriggerBelow          = 0;       // ultrasonic sensor trigger distance (0=off)
 	sonarSlowBelow             = 100;     // ultrasonic sensor slow down distance
+
+  // ------ obstacle map ------------------------------
+  obstacleMapUse             = 0;          // build obstacle map (odometry, sonar, bumper), slow down before known obstacles?
+  obstacleMapSlowBelow       = 60;         // slow down distance (cm) to known obstacles
+  
+  // ------ localization ------------------------------
+  localizeUse                = 0;          // particle filter localization (perimeter magnitude, odometry, IMU)? experimental, keep off (see localize.h)
   
   // ------ perimeter ---------------------------------
   perimeterUse               = 0;          // use perimeter?    
@@ -197,6 +206,7 @@ Mower::Mower(){
   gpsUse                     = 0;          // use GPS?
   stuckIfGpsSpeedBelow       = 0.2;        // if Gps speed is below given value the mower is stuck
   gpsSpeedIgnoreTime         = 5000;       // how long gpsSpeed is ignored when robot switches into a new STATE (in ms)
+  fusionUse                  = 0;          // GPS/odometry/IMU pose fusion (Kalman filter)?
 
   // ----- other -----------------------------------------
   buttonUse                  = 1;          // has digital ON/OFF button?
@@ -253,20 +263,26 @@ ISR(PCINT0_vect){
   {				
 		const byte actPins = PINK;                				// read register PINK
 		const byte setPins = (oldOdoPins ^ actPins);
-		unsigned long time = millis();    
+		uint32_t time = micros();    
     if ((setPins & 0b00010000) && (actPins & 0b00010000))               				// pin left is RISING
     {			
-			if (robot.motorLeftPWMCurr >= 0)						// forward
+			if (robot.motorLeftPWMCurr >= 0) {						// forward
         robot.odometryLeft++;
-      else
+        robot.encoders.left.push(time, 1);
+      } else {
         robot.odometryLeft--;									// backward
+        robot.encoders.left.push(time, -1);
+      }
     }
     if ((setPins & 0b01000000) && (actPins & 0b01000000))                  				// pin right is RISING
     {			
-			if (robot.motorRightPWMCurr >= 0)
+			if (robot.motorRightPWMCurr >= 0) {
         robot.odometryRight++;								// forward
-      else
+        robot.encoders.right.push(time, 1);
+      } else {
         robot.odometryRight--;								// backward
+        robot.encoders.right.push(time, -1);
+      }
     }      
 		oldOdoPins = actPins;
   }
@@ -275,17 +291,23 @@ ISR(PCINT0_vect){
   
   // Arduino Due odometry interrupts
   void OdometryRightInt(){			
-			if (robot.motorRightPWMCurr >= 0)
+			if (robot.motorRightPWMCurr >= 0) {
         robot.odometryRight++;								// forward
-      else
+        robot.encoders.right.push(micros(), 1);
+      } else {
         robot.odometryRight--;								// backward
+        robot.encoders.right.push(micros(), -1);
+      }
   }   
 
 	void OdometryLeftInt(){			
-			if (robot.motorLeftPWMCurr >= 0)						// forward
+			if (robot.motorLeftPWMCurr >= 0) {						// forward
         robot.odometryLeft++;
-      else
+        robot.encoders.left.push(micros(), 1);
+      } else {
         robot.odometryLeft--;									// backward
+        robot.encoders.left.push(micros(), -1);
+      }
   }	
 
 #endif
@@ -312,6 +334,7 @@ void Mower::setup(){
 	Console.begin(CONSOLE_BAUDRATE);  
 	I2Creset();	
   Wire.begin();            	
+  I2CMan.begin();
 	ADCMan.init();
   Console.println("SETUP");
   
@@ -416,11 +439,11 @@ void Mower::setup(){
   ADCMan.setCapture(pinBatteryVoltage, 1, false);
   ADCMan.setCapture(pinChargeVoltage, 1, false);  
   ADCMan.setCapture(pinVoltageMeasurement, 1, false);    
-  perimeter.setPins(pinPerimeterLeft, pinPerimeterRight);      
+  perimeter.setPins(pinPerimeterLeft, pinPerimeterRight, (PERIMETER_COILS == 2));      
     
   imu.init();
 	  
-  gps.init();
+  gps.init(GPS_BAUDRATE);
 
   Robot::setup();  
 
@@ -548,6 +571,18 @@ void Mower::resetMotorFault(){
 }
 
  
+// RTC read completed (queued by readSensor(SEN_RTC))
+void Mower::rtcReadDone(i2ctrans_t &t){
+  Mower *mower = (Mower*)t.user;
+  if ((t.result != I2C_OK) || (!parseDS1307(t.buf, mower->datetime))) {
+    mower->addErrorCounter((t.result != I2C_OK) ? ERR_RTC_COMM : ERR_RTC_DATA);
+    mower->setNextState(STATE_ERROR, 0);
+    return;
+  }
+  Console.print(F("RTC date received: "));
+  Console.println(date2str(mower->datetime.date));
+}
+
 int Mower::readSensor(char type){
   switch (type) {
 // motors------------------------------------------------------------------------------------------------
@@ -559,7 +594,7 @@ int Mower::readSensor(char type){
 #endif
 // perimeter----------------------------------------------------------------------------------------------
     case SEN_PERIM_LEFT: return perimeter.getMagnitude(0); break;
-    //case SEN_PERIM_RIGHT: return Perimeter.getMagnitude(1); break;
+    case SEN_PERIM_RIGHT: return perimeter.getMagnitude(1); break;
     
 // battery------------------------------------------------------------------------------------------------
     case SEN_BAT_VOLTAGE: ADCMan.read(pinVoltageMeasurement);  return ADCMan.read(pinBatteryVoltage); break;
@@ -598,11 +633,8 @@ int Mower::readSensor(char type){
     //case SEN_IMU: imuYaw=imu.ypr.yaw; imuPitch=imu.ypr.pitch; imuRoll=imu.ypr.roll; break;    
 // rtc--------------------------------------------------------------------------------------------------------
     case SEN_RTC: 
-      if (!readDS1307(datetime)) {
-        //Console.println("RTC data error!");        
-        addErrorCounter(ERR_RTC_DATA);         
-        setNextState(STATE_ERROR, 0);       
-      }
+      // result: rtcReadDone
+      if (!I2CMan.read(DS1307_ADDRESS, 0x00, rtcBuf, 8, rtcReadDone, this, 3)) addErrorCounter(ERR_RTC_COMM);
       break;
 // rain--------------------------------------------------------------------------------------------------------
     case SEN_RAIN: if (digitalRead(pinRain)==LOW) return 1; break;
@@ -639,4 +671,4 @@ void Mower::configureBluetooth(boolean quick){
   bt.setParams(name, BLUETOOTH_PIN, BLUETOOTH_BAUDRATE, quick);
 }
 
-
+
@@ -11,6 +11,7 @@ choose your robot type, PCB version, baud rates, pin definitions etc.
 #include "robot.h"
 
 #include "drivers.h"
+#include "txbuffer.h"
 #include "bt.h"
 
 
@@ -119,22 +120,26 @@ choose your robot type, PCB version, baud rates, pin definitions etc.
 #define CONSOLE_BAUDRATE    19200       // baudrate used for console
 #define BLUETOOTH_BAUDRATE  19200      // baudrate used for communication with Bluetooth module (Ardumower default: 19200)
 #define ESP8266_BAUDRATE    115200      // baudrate used for communication with esp8266 Wifi module
+#define GPS_BAUDRATE        9600        // baudrate used for GPS (neo6m default: 9600, u-blox 10 Hz: 115200)
 #define BLUETOOTH_PIN       1234
 
 
 // ------ used serial ports for console, Bluetooth, ESP8266 -----------------------------
 #ifdef __AVR__
   // Arduino Mega
-  #define Console Serial
+  #define ConsolePort Serial
   #define ESP8266port Serial1
   #define Bluetooth Serial2
 #else 
   // Arduino Due  
    // Due has two serial ports: Native (SerialUSB) and Programming (Serial) - we want to use 'SerialUSB' for 'Console'
-  #define Console Serial
+  #define ConsolePort Serial
   #define ESP8266port Serial1
   #define Bluetooth Serial2  // Ardumower default
 #endif
+// console output is queued (txbuffer.h), the loop does not wait for the serial port
+#define Console ConsoleTx
+extern TxBuffer ConsoleTx;
 
 // ------- ultrasonic config ---------------------------------------------------------
 // ultrasonic sensor max echo time (WARNING: do not set too high, it consumes CPU time!)
@@ -150,6 +155,9 @@ choose your robot type, PCB version, baud rates, pin definitions etc.
 //#define SIGCODE_2  // Ardumower alternative perimeter signal
 //#define SIGCODE_3  // Ardumower alternative perimeter signal
 
+// ---- perimeter coils ----
+#define PERIMETER_COILS 1  // 1: left coil, 2: left and right coil (tracking on the left/right magnitude difference)
+
 
 /*
   Ardumower robot chassis
@@ -164,6 +172,9 @@ class Mower : public Robot
     virtual int readSensor(char type);
     virtual void setActuator(char type, int value);
     virtual void configureBluetooth(boolean quick);
+  private:
+    byte rtcBuf[8];       // async RTC read (I2CMan)
+    static void rtcReadDone(i2ctrans_t &t);
 };
 
 
@@ -0,0 +1,302 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "obstaclemap.h"
+#include "flashmem.h"
+#include "flashlog.h"
+#include "crc.h"
+
+#ifndef __AVR__
+  #include <chip.h>
+  // map area: in front of the flash log (addresses relative to settings flash, see flashmem.cpp)
+  #define OBSTMAP_ADDR (IFLASH1_SIZE - FLASHLOG_PAGES * FLASHLOG_PAGE_SIZE - OBSTMAP_FLASH_SIZE)
+#endif
+
+
+ObstacleMap::ObstacleMap(){
+  available = false;
+  dirty = false;
+  evictions = 0;
+  tileCount = 0;
+  poseX = poseY = poseHeading = 0;
+}
+
+
+#ifdef __AVR__
+
+void ObstacleMap::begin(){}
+void ObstacleMap::clear(){}
+void ObstacleMap::setPose(float x, float y, float heading){}
+void ObstacleMap::addSonar(float angle, unsigned int dist){}
+void ObstacleMap::addBumper(boolean left, boolean right){}
+boolean ObstacleMap::obstacleAhead(int range, int &dist){ return false; }
+int8_t ObstacleMap::getValue(float x, float y){ return 0; }
+boolean ObstacleMap::save(){ return false; }
+boolean ObstacleMap::load(){ return false; }
+int ObstacleMap::getOccupiedCount(){ return 0; }
+void ObstacleMap::print(Stream &s){
+  s.println(F("obstacle map not available"));
+}
+
+#else
+
+// a / b rounded towards minus infinity
+static int floorDiv(int a, int b){
+  return (a >= 0) ? a / b : -((-a - 1) / b) - 1;
+}
+
+static int cellIndex(float cm){
+  return (int)floor(cm / OBSTMAP_CELL_SIZE);
+}
+
+void ObstacleMap::begin(){
+  available = true;
+  if (!load()) clear();
+}
+
+void ObstacleMap::clear(){
+  tileCount = 0;
+  lastTile = 0;
+  dirty = true;
+}
+
+void ObstacleMap::setPose(float x, float y, float heading){
+  poseX = x;
+  poseY = y;
+  poseHeading = heading;
+}
+
+int ObstacleMap::findTile(int tx, int ty){
+  if ((lastTile < tileCount) && (tileX[lastTile] == tx) && (tileY[lastTile] == ty)) return lastTile;
+  for (int i=0; i < tileCount; i++){
+    if ((tileX[i] == tx) && (tileY[i] == ty)){
+      lastTile = i;
+      return i;
+    }
+  }
+  return -1;
+}
+
+// allocates tile (pool full: reuses the tile farthest away from the robot)
+int ObstacleMap::newTile(int tx, int ty){
+  int t;
+  if (tileCount < OBSTMAP_TILES) t = tileCount++;
+  else {
+    int rx = floorDiv(cellIndex(poseX), OBSTMAP_TILE_CELLS);
+    int ry = floorDiv(cellIndex(poseY), OBSTMAP_TILE_CELLS);
+    int maxDist = -1;
+    t = 0;
+    for (int i=0; i < tileCount; i++){
+      int d = max(abs(tileX[i] - rx), abs(tileY[i] - ry));
+      if (d > maxDist){
+        maxDist = d;
+        t = i;
+      }
+    }
+    evictions++;
+  }
+  tileX[t] = tx;
+  tileY[t] = ty;
+  memset(tiles[t], 0, OBSTMAP_TILE_SIZE);
+  lastTile = t;
+  return t;
+}
+
+// cell (NULL if outside the map or not allocated and create is false)
+int8_t *ObstacleMap::cell(int cx, int cy, boolean create){
+  int tx = floorDiv(cx, OBSTMAP_TILE_CELLS);
+  int ty = floorDiv(cy, OBSTMAP_TILE_CELLS);
+  if ((tx < -128) || (tx > 127) || (ty < -128) || (ty > 127)) return NULL;
+  int t = findTile(tx, ty);
+  if (t < 0) {
+    if (!create) return NULL;
+    t = newTile(tx, ty);
+  }
+  return &tiles[t][(cy - ty * OBSTMAP_TILE_CELLS) * OBSTMAP_TILE_CELLS + (cx - tx * OBSTMAP_TILE_CELLS)];
+}
+
+void ObstacleMap::update(float x, float y, int delta){
+  int8_t *c = cell(cellIndex(x), cellIndex(y), true);
+  if (c == NULL) return;
+  *c = constrain(*c + delta, OBSTMAP_MIN, OBSTMAP_MAX);
+  dirty = true;
+}
+
+// sonar ray from the robot front: cells up to 'range' are free, echo at 'dist' (0: none)
+void ObstacleMap::updateRay(float angle, int dist, int range){
+  float sh = sin(poseHeading);
+  float ch = cos(poseHeading);
+  float ox = poseX + OBSTMAP_SONAR_OFFSET * sh;
+  float oy = poseY + OBSTMAP_SONAR_OFFSET * ch;
+  float dx = sin(poseHeading + angle);
+  float dy = cos(poseHeading + angle);
+  int hitX = cellIndex(ox + dist * dx);
+  int hitY = cellIndex(oy + dist * dy);
+  int lastX = hitX;
+  int lastY = hitY;
+  for (int s=0; s <= range - OBSTMAP_CELL_SIZE/2; s += OBSTMAP_CELL_SIZE/2){
+    float x = ox + s * dx;
+    float y = oy + s * dy;
+    int cx = cellIndex(x);
+    int cy = cellIndex(y);
+    if ((cx == lastX) && (cy == lastY)) continue;
+    if ((dist != 0) && (cx == hitX) && (cy == hitY)) continue;
+    update(x, y, OBSTMAP_FREE);
+    lastX = cx;
+    lastY = cy;
+  }
+  if (dist != 0) update(ox + dist * dx, oy + dist * dy, OBSTMAP_HIT);
+}
+
+void ObstacleMap::addSonar(float angle, unsigned int dist){
+  if (!available) return;
+  if ((dist != 0) && (dist < OBSTMAP_SONAR_MIN)) return;
+  if ((dist == 0) || (dist > OBSTMAP_SONAR_RANGE)) updateRay(angle, 0, OBSTMAP_SONAR_RANGE);
+    else updateRay(angle, dist, dist);
+}
+
+void ObstacleMap::addBumper(boolean left, boolean right){
+  if ((!available) || ((!left) && (!right))) return;
+  int side = 0;
+  if (!right) side = -OBSTMAP_BUMPER_SIDE;
+    else if (!left) side = OBSTMAP_BUMPER_SIDE;
+  float sh = sin(poseHeading);
+  float ch = cos(poseHeading);
+  float ahead = OBSTMAP_SONAR_OFFSET + OBSTMAP_CELL_SIZE/2;
+  update(poseX + ahead * sh + side * ch, poseY + ahead * ch - side * sh, OBSTMAP_BUMP);
+}
+
+boolean ObstacleMap::obstacleAhead(int range, int &dist){
+  if ((!available) || (tileCount == 0)) return false;
+  float sh = sin(poseHeading);
+  float ch = cos(poseHeading);
+  for (int s=0; s <= range; s += OBSTMAP_CELL_SIZE/2){
+    float ahead = OBSTMAP_SONAR_OFFSET + s;
+    for (int side = -OBSTMAP_ROBOT_WIDTH/2; side <= OBSTMAP_ROBOT_WIDTH/2; side += OBSTMAP_ROBOT_WIDTH/2){
+      int8_t *c = cell(cellIndex(poseX + ahead * sh + side * ch), cellIndex(poseY + ahead * ch - side * sh), false);
+      if ((c != NULL) && (*c >= OBSTMAP_OCCUPIED)){
+        dist = s;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int8_t ObstacleMap::getValue(float x, float y){
+  if (!available) return 0;
+  int8_t *c = cell(cellIndex(x), cellIndex(y), false);
+  return (c == NULL) ? 0 : *c;
+}
+
+int ObstacleMap::getOccupiedCount(){
+  int count = 0;
+  for (int i=0; i < tileCount; i++)
+    for (int k=0; k < OBSTMAP_TILE_SIZE; k++) if (tiles[i][k] >= OBSTMAP_OCCUPIED) count++;
+  return count;
+}
+
+uint16_t ObstacleMap::crc(){
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i < tileCount; i++){
+    crc = crc16(crc, tileX[i]);
+    crc = crc16(crc, tileY[i]);
+    for (int k=0; k < OBSTMAP_TILE_SIZE; k++) crc = crc16(crc, tiles[i][k]);
+  }
+  return crc;
+}
+
+// tile pages first, header last (an interrupted save fails the CRC check on load)
+boolean ObstacleMap::save(){
+  if (!available) return false;
+  for (int i=0; i < tileCount; i++){
+    if (!Flash.write(OBSTMAP_ADDR + (uint32_t)(i + 1) * OBSTMAP_TILE_SIZE, (byte*)tiles[i], OBSTMAP_TILE_SIZE)) return false;
+  }
+  obstmapheader_t h;
+  memset(&h, 0, sizeof h);
+  h.magic = OBSTMAP_MAGIC;
+  h.version = OBSTMAP_VERSION;
+  h.count = tileCount;
+  h.crc = crc();
+  memcpy(h.tileX, tileX, sizeof tileX);
+  memcpy(h.tileY, tileY, sizeof tileY);
+  if (!Flash.write(OBSTMAP_ADDR, (byte*)&h, sizeof h)) return false;
+  dirty = false;
+  return true;
+}
+
+boolean ObstacleMap::load(){
+  if (!available) return false;
+  obstmapheader_t h;
+  memcpy(&h, Flash.readAddress(OBSTMAP_ADDR), sizeof h);
+  if ((h.magic != OBSTMAP_MAGIC) || (h.version != OBSTMAP_VERSION) || (h.count > OBSTMAP_TILES)) return false;
+  tileCount = h.count;
+  memcpy(tileX, h.tileX, sizeof tileX);
+  memcpy(tileY, h.tileY, sizeof tileY);
+  for (int i=0; i < tileCount; i++)
+    memcpy(tiles[i], Flash.readAddress(OBSTMAP_ADDR + (uint32_t)(i + 1) * OBSTMAP_TILE_SIZE), OBSTMAP_TILE_SIZE);
+  lastTile = 0;
+  if (crc() != h.crc){
+    clear();
+    return false;
+  }
+  dirty = false;
+  return true;
+}
+
+void ObstacleMap::print(Stream &s){
+  if (!available) {
+    s.println(F("obstacle map not available"));
+    return;
+  }
+  s.print(F("obstacle map: tiles="));
+  s.print(tileCount);
+  s.print(F(" occupied="));
+  s.print(getOccupiedCount());
+  s.print(F(" evictions="));
+  s.println(evictions);
+  if (tileCount == 0) return;
+  int x0 = tileX[0], x1 = tileX[0], y0 = tileY[0], y1 = tileY[0];
+  for (int i=1; i < tileCount; i++){
+    x0 = min(x0, tileX[i]);
+    x1 = max(x1, tileX[i]);
+    y0 = min(y0, tileY[i]);
+    y1 = max(y1, tileY[i]);
+  }
+  int rx = cellIndex(poseX);
+  int ry = cellIndex(poseY);
+  for (int cy = (y1 + 1) * OBSTMAP_TILE_CELLS - 1; cy >= y0 * OBSTMAP_TILE_CELLS; cy--){
+    for (int cx = x0 * OBSTMAP_TILE_CELLS; cx < (x1 + 1) * OBSTMAP_TILE_CELLS; cx++){
+      int8_t *c = cell(cx, cy, false);
+      char ch = ' ';
+      if ((cx == rx) && (cy == ry)) ch = 'R';
+        else if (c == NULL) ch = ' ';
+        else if (*c >= OBSTMAP_OCCUPIED) ch = '#';
+        else if (*c < 0) ch = '.';
+      s.write(ch);
+    }
+    s.println();
+  }
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+obstacle (occupancy) grid map from odometry, sonar and bumper events
+
+- map frame = odometry frame (cm, origin where the robot was powered on - normally the charging
+  station), heading clockwise from the y axis (see Robot::calcOdometry)
+- cells of OBSTMAP_CELL_SIZE cm hold an int8 log-odds value (0: unknown, > 0: occupied, < 0: free),
+  sonar echos and bumper hits add to a cell, the sonar ray in front of an echo (or the whole
+  range if there is none) subtracts, so obstacles that went away are forgotten again
+- only the tiles (OBSTMAP_TILE_CELLS x OBSTMAP_TILE_CELLS cells, 256 bytes) that were touched are
+  kept in a fixed pool of OBSTMAP_TILES tiles, if the pool is full the tile farthest away from
+  the robot is reused
+- the map can be saved in the settings flash (header page + one page per tile, area in front of
+  the flash log) and is loaded again on begin()
+- Arduino Mega: not available (RAM too small), all functions do nothing/fail
+
+How to use it (example):
+  obstacleMap.begin();                                    // loads saved map
+  obstacleMap.setPose(odometryX, odometryY, heading);     // on each odometry update
+  obstacleMap.addSonar(-OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, sonarDistLeft);
+  obstacleMap.addBumper(bumperLeft, bumperRight);
+  int dist;
+  if (obstacleMap.obstacleAhead(80, dist)) ...            // known obstacle 'dist' cm ahead
+  obstacleMap.save();
+  obstacleMap.print(Console);
+*/
+
+#ifndef OBSTACLEMAP_H
+#define OBSTACLEMAP_H
+
+#include <Arduino.h>
+
+#define OBSTMAP_CELL_SIZE 20         // cm
+#define OBSTMAP_TILE_CELLS 16        // cells per tile side
+#define OBSTMAP_TILE_SIZE (OBSTMAP_TILE_CELLS * OBSTMAP_TILE_CELLS)    // bytes (one flash page)
+#define OBSTMAP_TILES 48             // tile pool (48 tiles of 3.2 x 3.2m)
+#define OBSTMAP_MAGIC 0x4D4F
+#define OBSTMAP_VERSION 1
+#define OBSTMAP_FLASH_SIZE ((OBSTMAP_TILES + 1) * OBSTMAP_TILE_SIZE)
+
+// log-odds updates
+#define OBSTMAP_HIT 12               // sonar echo
+#define OBSTMAP_BUMP 48              // bumper hit
+#define OBSTMAP_FREE -3              // sonar ray in front of the echo
+#define OBSTMAP_MIN -60
+#define OBSTMAP_MAX 120
+#define OBSTMAP_OCCUPIED 24          // cell is an obstacle at this log-odds value (2 echos, 1 bumper hit)
+
+// robot geometry (cm, relative to the odometry point)
+#define OBSTMAP_SONAR_OFFSET 25      // sonars/bumper in front of the odometry point
+#define OBSTMAP_SONAR_ANGLE 30       // deg, left/right sonar
+#define OBSTMAP_SONAR_MIN 11         // cm, closer echos are ignored
+#define OBSTMAP_SONAR_RANGE 100      // cm, ray is free up to here if there is no echo
+#define OBSTMAP_BUMPER_SIDE 15       // lateral offset of a left/right bumper hit
+#define OBSTMAP_ROBOT_WIDTH 40       // corridor checked by obstacleAhead
+
+
+struct obstmapheader_t {
+  uint16_t magic;
+  byte version;
+  byte count;            // saved tiles
+  uint16_t crc;          // crc16 over keys and tiles
+  uint16_t reserved;
+  int8_t tileX[OBSTMAP_TILES];
+  int8_t tileY[OBSTMAP_TILES];
+  byte unused[OBSTMAP_TILE_SIZE - 8 - 2 * OBSTMAP_TILES];
+};
+
+typedef struct obstmapheader_t obstmapheader_t;
+
+
+class ObstacleMap
+{
+  public:
+    ObstacleMap();
+    // loads saved map
+    void begin();
+    void clear();
+    // robot pose (cm, heading rad)
+    void setPose(float x, float y, float heading);
+    // sonar reading at 'angle' (rad, clockwise) from the heading, dist cm (0 = no echo)
+    void addSonar(float angle, unsigned int dist);
+    void addBumper(boolean left, boolean right);
+    // first occupied cell in the corridor ahead (dist cm from the robot front), false if none within range
+    boolean obstacleAhead(int range, int &dist);
+    // log-odds at position (cm), 0 if unknown
+    int8_t getValue(float x, float y);
+    boolean isOccupied(float x, float y){ return (getValue(x, y) >= OBSTMAP_OCCUPIED); }
+    boolean save();
+    boolean load();
+    boolean isDirty(){ return dirty; }
+    int getTileCount(){ return tileCount; }
+    int getOccupiedCount();
+    unsigned long getEvictions(){ return evictions; }
+    // ASCII map (# occupied, . free, R robot)
+    void print(Stream &s);
+  private:
+    boolean available;
+    boolean dirty;
+    unsigned long evictions;
+    byte tileCount;
+    float poseX;
+    float poseY;
+    float poseHeading;
+#ifndef __AVR__
+    int8_t tileX[OBSTMAP_TILES];
+    int8_t tileY[OBSTMAP_TILES];
+    int8_t tiles[OBSTMAP_TILES][OBSTMAP_TILE_SIZE];
+    byte lastTile;
+#endif
+    int8_t *cell(int cx, int cy, boolean create);
+    int findTile(int tx, int ty);
+    int newTile(int tx, int ty);
+    void update(float x, float y, int delta);
+    void updateRay(float angle, int dist, int range);
+    uint16_t crc();
+};
+
+
+#endif
@@ -32,25 +32,40 @@
 //#define pinLED 13                  
 
   
+// sender signal codes (code 1..PERIMETER_CODES), see sender.ino
+const int8_t sigcodes[PERIMETER_CODES][SIGCODE_SIZE] PROGMEM = {
+  { 1, 1,-1,-1, 1,-1, 1,-1,-1,1, -1, 1, 1,-1,-1, 1,-1,-1, 1,-1,-1, 1, 1,-1 },
+  { 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1,-1 },
+  { 1, 1,-1,-1, 1,-1, 1, 1,-1, 1, 1,-1,-1, 1, 1,-1, 1,-1,-1, 1,-1,-1, 1,-1 },
+};
+
+// default code (signalCodeNo = 0)
 #if defined (SIGCODE_1)	
-  int8_t sigcode[] = { 1, 1,-1,-1, 1,-1, 1,-1,-1,1, -1, 1, 1,-1,-1, 1,-1,-1, 1,-1,-1, 1, 1,-1 };
+  #define SIGCODE_DEFAULT 1
 #elif defined (SIGCODE_2)   
-  int8_t sigcode[] = { 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1,-1 };
+  #define SIGCODE_DEFAULT 2
 #elif defined (SIGCODE_3)   
-  int8_t sigcode[] = { 1, 1,-1,-1, 1,-1, 1, 1,-1, 1, 1,-1,-1, 1, 1,-1, 1,-1,-1, 1,-1,-1, 1,-1 };
+  #define SIGCODE_DEFAULT 3
 #endif
 
 
 Perimeter::Perimeter(){      
-  // generate differential signal out of sender signal	
-  int8_t lastValue = sigcode[sizeof sigcode-1];
-  for (int i=0; i < sizeof sigcode; i++){
-    int8_t value = sigcode[i];
-    if (value == lastValue) sigcode[i] = 0;
-      else sigcode[i] = value;
-    lastValue = value;
-  }  
+  // generate differential signals out of sender signals
+  for (byte k=0; k < PERIMETER_CODES; k++){
+    int8_t lastValue = pgm_read_byte(&sigcodes[k][SIGCODE_SIZE-1]);
+    for (int i=0; i < SIGCODE_SIZE; i++){
+      int8_t value = pgm_read_byte(&sigcodes[k][i]);
+      if (value == lastValue) diffcodes[k][i] = 0;
+        else diffcodes[k][i] = value;
+      lastValue = value;
+    }  
+  }
+  signalCodeNo = 0;
+  codeMask = 0;
+  memset(codeMag, 0, sizeof codeMag);
+  memset(codeQuality, 0, sizeof codeQuality);
 	swapCoilPolarity = false;
+  dualCoil = false;
   timedOutIfBelowSmag = 300;
   timeOutSecIfNotInside = 8;
   callCounter = 0;
@@ -61,9 +76,10 @@ Perimeter::Perimeter(){
   lastInsideTime[0] = lastInsideTime[1] = 0;    
 }
 
-void Perimeter::setPins(byte idx0Pin, byte idx1Pin){
+void Perimeter::setPins(byte idx0Pin, byte idx1Pin, boolean dualCoil){
   idxPin[0] = idx0Pin;
   idxPin[1] = idx1Pin;  
+  this->dualCoil = dualCoil;
 
   switch (ADCMan.sampleRate){
     case SRATE_9615: subSample = 1; break;
@@ -71,21 +87,31 @@ void Perimeter::setPins(byte idx0Pin, byte idx1Pin){
     case SRATE_38462: subSample = 4; break;
   }
   
-  // use max. 255 samples and multiple of signalsize
-  int adcSampleCount = sizeof sigcode * subSample;
-  ADCMan.setCapture(idx0Pin, ((int)255 / adcSampleCount) * adcSampleCount, true); 
-  ADCMan.setCapture(idx1Pin, ((int)255 / adcSampleCount) * adcSampleCount, true); 
+  // use max. PERIMETER_MAX_SAMPLES samples and multiple of signalsize
+  int adcSampleCount = SIGCODE_SIZE * subSample;
+  int captureSize = (PERIMETER_MAX_SAMPLES / adcSampleCount) * adcSampleCount;
+  if (dualCoil) {
+    ADCMan.setCapturePair(idx0Pin, idx1Pin, captureSize, true);
+    // pins sampled alternately: half the sample rate per coil
+    int interleave = ADCMan.getInterleave(idx0Pin);
+    if (subSample < interleave) Console.println(F("perimeter error: dual coil requires a higher ADC sample rate"));
+    subSample = max(1, subSample / interleave);
+  } else {
+    ADCMan.setCapture(idx0Pin, captureSize, true); 
+    ADCMan.setCapture(idx1Pin, captureSize, true); 
+  }
  // ADCMan.setCapture(idx0Pin, adcSampleCount*2, true); 
  // ADCMan.setCapture(idx1Pin, adcSampleCount*2, true); 
   
   Console.print(F("matchSignal size="));
-  Console.println(sizeof sigcode);  
+  Console.println(SIGCODE_SIZE);  
   Console.print(F("subSample="));  
   Console.println((int)subSample);    
   Console.print(F("capture size="));
   Console.println(ADCMan.getCaptureSize(idx0Pin));  
 	// print signal	 
-  for (int i=0; i < sizeof sigcode; i++){
+  int8_t *sigcode = getCodeFilter();
+  for (int i=0; i < SIGCODE_SIZE; i++){
     Console.print(sigcode[i]);
     Console.print(F("\t"));
   }
@@ -101,6 +127,103 @@ void Perimeter::speedTest(){
   }
   Console.print(F("speedTest="));
   Console.println(loops);
+
+  // compare sliding-window filter against full dot product filter on current capture
+  int16_t sampleCount = ADCMan.getCaptureSize(idxPin[0]);
+  int8_t *samples = ADCMan.getCapture(idxPin[0]);
+  int8_t *sigcode = getCodeFilter();
+  int16_t sigcode_size = SIGCODE_SIZE;
+  int16_t nPts = sampleCount-sigcode_size*subSample;
+  float quality, qualityRef;
+  int16_t res = 0;
+  int16_t resRef = 0;
+  int loopsRef = 0;
+  loops = 0;
+  endTime = millis() + 1000;
+  while (millis() < endTime){
+    res = corrFilter(sigcode, subSample, sigcode_size, samples, nPts, quality);
+    loops++;
+  }
+  endTime = millis() + 1000;
+  while (millis() < endTime){
+    resRef = corrFilterRef(sigcode, subSample, sigcode_size, samples, nPts, qualityRef);
+    loopsRef++;
+  }
+  Console.print(F("corrFilter="));
+  Console.print(loops);
+  Console.print(F(" corrFilterRef="));
+  Console.print(loopsRef);
+  Console.print(F(" match="));
+  Console.println( ((res == resRef) && (quality == qualityRef)) ? 1 : 0 );
+
+  // compare dual coil filter (one pass) against two corrFilter calls (on copies: captures continue in background)
+  int8_t samples0[PERIMETER_MAX_SAMPLES];
+  int8_t samples1[PERIMETER_MAX_SAMPLES];
+  memcpy(samples0, ADCMan.getCapture(idxPin[0]), sampleCount);
+  memcpy(samples1, ADCMan.getCapture(idxPin[1]), sampleCount);
+  float quality1;
+  int16_t resDual0 = 0;
+  int16_t resDual1 = 0;
+  float qualityDual0, qualityDual1;
+  loops = 0;
+  endTime = millis() + 1000;
+  while (millis() < endTime){
+    corrFilterDual(sigcode, subSample, sigcode_size, samples0, samples1, nPts, resDual0, resDual1, qualityDual0, qualityDual1);
+    loops++;
+  }
+  res = corrFilter(sigcode, subSample, sigcode_size, samples0, nPts, quality);
+  int16_t res1 = corrFilter(sigcode, subSample, sigcode_size, samples1, nPts, quality1);
+  Console.print(F("corrFilterDual="));
+  Console.print(loops);
+  Console.print(F(" match="));
+  Console.println( ((resDual0 == res) && (resDual1 == res1) && (qualityDual0 == quality) && (qualityDual1 == quality1)) ? 1 : 0 );
+
+  // compare filter bank (all codes, one pass) against one corrFilter call per code
+  int16_t resBank[PERIMETER_CODES];
+  float qualityBank[PERIMETER_CODES];
+  byte allCodes = (1 << PERIMETER_CODES) - 1;
+  loops = 0;
+  endTime = millis() + 1000;
+  while (millis() < endTime){
+    corrFilterBank(diffcodes[0], allCodes, subSample, sigcode_size, samples0, nPts, resBank, qualityBank);
+    loops++;
+  }
+  boolean match = true;
+  for (byte k=0; k < PERIMETER_CODES; k++){
+    res = corrFilter(diffcodes[k], subSample, sigcode_size, samples0, nPts, quality);
+    if ((resBank[k] != res) || (qualityBank[k] != quality)) match = false;
+  }
+  Console.print(F("corrFilterBank="));
+  Console.print(loops);
+  Console.print(F(" codes="));
+  Console.print(PERIMETER_CODES);
+  Console.print(F(" match="));
+  Console.println(match ? 1 : 0);
+}
+
+// code number (1..PERIMETER_CODES) used for tracking
+byte Perimeter::getCode(){
+  if ((signalCodeNo >= 1) && (signalCodeNo <= PERIMETER_CODES)) return signalCodeNo;
+  return SIGCODE_DEFAULT;
+}
+
+int8_t* Perimeter::getCodeFilter(){
+  return diffcodes[getCode()-1];
+}
+
+// codes demodulated in addition to the tracking code (bit 0: code 1, ...)
+byte Perimeter::getBankMask(){
+  return ((codeMask | (1 << (getCode()-1))) & ((1 << PERIMETER_CODES) - 1));
+}
+
+int Perimeter::getCodeMagnitude(byte idx, byte code){
+  if ((code < 1) || (code > PERIMETER_CODES)) return 0;
+  return codeMag[idx][code-1];
+}
+
+float Perimeter::getCodeQuality(byte idx, byte code){
+  if ((code < 1) || (code > PERIMETER_CODES)) return 0;
+  return codeQuality[idx][code-1];
 }
 
 const int8_t* Perimeter::getRawSignalSample(byte idx) {
@@ -108,6 +231,17 @@ const int8_t* Perimeter::getRawSignalSample(byte idx) {
 }
 
 int Perimeter::getMagnitude(byte idx){  
+  if (dualCoil) {
+    // both coils are processed together
+    if ((ADCMan.isCaptureComplete(idxPin[0])) && (ADCMan.isCaptureComplete(idxPin[1]))) {
+      for (byte i=0; i < 2; i++){
+        memset(rawSignalSample[i], 0, RAW_SIGNAL_SAMPLE_SIZE);
+        memcpy(rawSignalSample[i], ADCMan.getCapture(idxPin[i]), min(ADCMan.getCaptureSize(idxPin[0]), RAW_SIGNAL_SAMPLE_SIZE));
+      }
+      matchedFilterDual();
+    }
+    return mag[idx];
+  }
   if (ADCMan.isCaptureComplete(idxPin[idx])) {
     // Keep a sample of the raw signal
     memset(rawSignalSample[idx], 0, RAW_SIGNAL_SAMPLE_SIZE);
@@ -142,20 +276,78 @@ void Perimeter::matchedFilter(byte idx){
   if (callCounter == 100) {
     // statistics only
     callCounter = 0;
-    signalMin[idx] = 9999;
-    signalMax[idx] = -9999;
-    signalAvg[idx] = 0;  
-    for (int i=0; i < sampleCount; i++){
-      int8_t v = samples[i];
-      signalAvg[idx] += v;
-      signalMin[idx] = min(signalMin[idx], v);
-      signalMax[idx] = max(signalMax[idx], v);
-    }
-    signalAvg[idx] = ((double)signalAvg[idx]) / ((double)(sampleCount));
+    signalStatistics(idx, samples, sampleCount);
   }
   // magnitude for tracking (fast but inaccurate)    
-  int16_t sigcode_size = sizeof sigcode;  
-  mag[idx] = corrFilter(sigcode, subSample, sigcode_size, samples, sampleCount-sigcode_size*subSample, filterQuality[idx]);
+  matchedFilterCodes(idx, samples, sampleCount);
+  updateMagnitude(idx);
+  ADCMan.restart(idxPin[idx]);    
+  if (idx == 0) callCounter++;
+}
+
+// tracking code only: corrFilter, several codes: filter bank (one pass for all codes)
+void Perimeter::matchedFilterCodes(byte idx, int8_t *samples, int16_t sampleCount){
+  int16_t sigcode_size = SIGCODE_SIZE;  
+  int16_t nPts = sampleCount-sigcode_size*subSample;
+  byte code = getCode()-1;
+  byte mask = getBankMask();
+  if (mask == (1 << code)) {
+    mag[idx] = corrFilter(diffcodes[code], subSample, sigcode_size, samples, nPts, filterQuality[idx]);
+    codeMag[idx][code] = mag[idx];
+    codeQuality[idx][code] = filterQuality[idx];
+  } else {
+    corrFilterBank(diffcodes[0], mask, subSample, sigcode_size, samples, nPts, codeMag[idx], codeQuality[idx]);
+    mag[idx] = codeMag[idx][code];
+    filterQuality[idx] = codeQuality[idx][code];
+  }
+}
+
+// dual coil: both captures (ADC pair) in one correlation pass
+void Perimeter::matchedFilterDual(){
+  int16_t sampleCount = ADCMan.getCaptureSize(idxPin[0]);
+  int8_t *samples0 = ADCMan.getCapture(idxPin[0]);
+  int8_t *samples1 = ADCMan.getCapture(idxPin[1]);
+  if (callCounter == 100) {
+    // statistics only
+    callCounter = 0;
+    signalStatistics(0, samples0, sampleCount);
+    signalStatistics(1, samples1, sampleCount);
+  }
+  byte code = getCode()-1;
+  if (getBankMask() == (1 << code)) {
+    int16_t sigcode_size = SIGCODE_SIZE;  
+    corrFilterDual(diffcodes[code], subSample, sigcode_size, samples0, samples1, sampleCount-sigcode_size*subSample, 
+      mag[0], mag[1], filterQuality[0], filterQuality[1]);
+    for (byte i=0; i < 2; i++){
+      codeMag[i][code] = mag[i];
+      codeQuality[i][code] = filterQuality[i];
+    }
+  } else {
+    // several codes: filter bank per coil
+    matchedFilterCodes(0, samples0, sampleCount);
+    matchedFilterCodes(1, samples1, sampleCount);
+  }
+  updateMagnitude(0);
+  updateMagnitude(1);
+  ADCMan.restart(idxPin[0]);   // restarts both pins
+  callCounter++;
+}
+
+void Perimeter::signalStatistics(byte idx, int8_t *samples, int16_t sampleCount){
+  signalMin[idx] = 9999;
+  signalMax[idx] = -9999;
+  signalAvg[idx] = 0;  
+  for (int i=0; i < sampleCount; i++){
+    int8_t v = samples[i];
+    signalAvg[idx] += v;
+    signalMin[idx] = min(signalMin[idx], v);
+    signalMax[idx] = max(signalMax[idx], v);
+  }
+  signalAvg[idx] = ((double)signalAvg[idx]) / ((double)(sampleCount));
+}
+
+// coil polarity, smoothed magnitude, inside/outside detection
+void Perimeter::updateMagnitude(byte idx){
   if (swapCoilPolarity) mag[idx] *= -1;        
   // smoothed magnitude used for signal-off detection
   smoothMag[idx] = 0.99 * smoothMag[idx] + 0.01 * ((float)abs(mag[idx]));
@@ -169,9 +361,6 @@ void Perimeter::matchedFilter(byte idx){
   if (signalCounter[idx] < 0){
     lastInsideTime[idx] = millis();
   } 
-    
-  ADCMan.restart(idxPin[idx]);    
-  if (idx == 0) callCounter++;
 }
 
 int16_t Perimeter::getSignalMin(byte idx){
@@ -216,6 +405,13 @@ boolean Perimeter::signalTimedOut(byte idx){
 // subsample is the number of times for each filter coeff to repeat 
 // ip[] holds input data (length > nPts + M )
 // nPts is the length of the required output data 
+// M <= SIGCODE_SIZE (transition tables)
+//
+// As the coeffs are piecewise constant (each repeated 'subsample' times), the correlation sum
+// only changes at coeff transitions when the window slides by one sample:
+//   sum[j+1] = sum[j] + sum over transitions i of (H[i-1]-H[i]) * ip[j + i*subsample]   (H[-1]=H[M]=0)
+// So only the first sum is computed in full, all others are updated with one multiply-add per
+// transition (at most M+1 instead of M*subsample). Results are identical to corrFilterRef().
 
 int16_t Perimeter::corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality){  
   int16_t sumMax = 0; // max correlation sum
@@ -227,6 +423,219 @@ int16_t Perimeter::corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_t *ip
   for (int16_t i=0; i<M; i++) Hsum += abs(H[i]); 
   Hsum *= subsample;
 
+  // compute coeff transitions (sample offset and coeff step)
+  int16_t transOfs[SIGCODE_SIZE+1];
+  int8_t transCoeff[SIGCODE_SIZE+1];
+  int16_t transCount = corrTransitions(H, subsample, M, transOfs, transCoeff);
+
+  // compute correlation
+  // first input value: full sum
+  int16_t sum = 0;
+  int8_t *Hi = H;
+  int8_t ss = 0;
+  for (int16_t i=0; i<Ms; i++)
+  {
+    sum += ((int16_t)(*Hi)) * ((int16_t)ip[i]);
+    ss++;
+    if (ss == subsample) {
+      ss=0;
+      Hi++; // next filter coeffs
+    }
+  }
+  // for each input value
+  for (int16_t j=0; j<nPts; j++)
+  {
+      if (sum > sumMax) sumMax = sum;
+      if (sum < sumMin) sumMin = sum;
+      if (j == nPts-1) break;
+      // slide window by one sample
+      for (int16_t t=0; t<transCount; t++)
+      {
+        sum += ((int16_t)transCoeff[t]) * ((int16_t)ip[transOfs[t]]);
+      }
+      ip++;
+  }      
+  return corrResult(sumMin, sumMax, Hsum, quality);
+}
+
+// dual coil: corrFilter for two inputs in one pass (transitions computed once, both windows slide together)
+// Both inputs are packed into one 32 bit value (ip0 + ip1 * 65536), so one multiply-add updates both
+// correlation sums (two 16 bit lanes, |sum| <= Hsum*127 < 32768 keeps the lanes apart).
+void Perimeter::corrFilterDual(int8_t *H, int8_t subsample, int16_t M, int8_t *ip0, int8_t *ip1, int16_t nPts, 
+    int16_t &res0, int16_t &res1, float &quality0, float &quality1){  
+  int16_t sumMax0 = 0; // max correlation sums
+  int16_t sumMax1 = 0;
+  int16_t sumMin0 = 0; // min correlation sums
+  int16_t sumMin1 = 0;
+  int16_t Ms = M * subsample; // number of filter coeffs including subsampling
+
+  // compute sum of absolute filter coeffs
+  int16_t Hsum = 0;
+  for (int16_t i=0; i<M; i++) Hsum += abs(H[i]); 
+  Hsum *= subsample;
+
+  // compute coeff transitions (sample offset and coeff step)
+  int16_t transOfs[SIGCODE_SIZE+1];
+  int8_t transCoeff[SIGCODE_SIZE+1];
+  int16_t transCount = corrTransitions(H, subsample, M, transOfs, transCoeff);
+
+  // pack inputs (nPts + Ms <= PERIMETER_MAX_SAMPLES)
+  int16_t count = min(nPts + Ms, PERIMETER_MAX_SAMPLES);
+  nPts = count - Ms;
+  int32_t packed[PERIMETER_MAX_SAMPLES];
+  for (int16_t i=0; i<count; i++) packed[i] = ((int32_t)ip0[i]) + ((int32_t)ip1[i]) * 65536;
+
+  // compute correlation
+  // first input value: full sum
+  int32_t sum = 0;
+  int32_t *ip = packed;
+  int8_t *Hi = H;
+  int8_t ss = 0;
+  for (int16_t i=0; i<Ms; i++)
+  {
+    sum += ((int32_t)(*Hi)) * ip[i];
+    ss++;
+    if (ss == subsample) {
+      ss=0;
+      Hi++; // next filter coeffs
+    }
+  }
+  // for each input value
+  for (int16_t j=0; j<nPts; j++)
+  {
+      int16_t sum0 = (int16_t)(sum & 0xFFFF);
+      int16_t sum1 = (sum - sum0) >> 16;
+      if (sum0 > sumMax0) sumMax0 = sum0;
+      if (sum0 < sumMin0) sumMin0 = sum0;
+      if (sum1 > sumMax1) sumMax1 = sum1;
+      if (sum1 < sumMin1) sumMin1 = sum1;
+      if (j == nPts-1) break;
+      // slide window by one sample
+      for (int16_t t=0; t<transCount; t++)
+      {
+        sum += ((int32_t)transCoeff[t]) * ip[transOfs[t]];
+      }
+      ip++;
+  }      
+  res0 = corrResult(sumMin0, sumMax0, Hsum, quality0);
+  res1 = corrResult(sumMin1, sumMax1, Hsum, quality1);
+}
+
+// filter bank: corrFilter for several codes (H: PERIMETER_CODES x M table, mask: codes to compute) in one
+// pass over the input. The transitions of all codes are merged (one input read per transition offset), the
+// coeff steps of two codes are packed into one 32 bit value (lanes as in corrFilterDual), so one multiply-add
+// updates two correlation sums. Results (res, quality: one entry per code) are identical to corrFilter().
+void Perimeter::corrFilterBank(int8_t *H, byte mask, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, 
+    int16_t *res, float *quality){
+  const byte pairs = (PERIMETER_CODES+1)/2;
+  int16_t sumMax[pairs*2]; // max correlation sums
+  int16_t sumMin[pairs*2]; // min correlation sums
+  int16_t Hsum[pairs*2];
+  int32_t sum[pairs];
+  memset(sumMax, 0, sizeof sumMax);
+  memset(sumMin, 0, sizeof sumMin);
+  memset(Hsum, 0, sizeof Hsum);
+  memset(sum, 0, sizeof sum);
+
+  // merged coeff transitions (sample offset and packed coeff steps) and first input value (full sums)
+  int16_t transOfs[SIGCODE_SIZE+1];
+  int32_t transCoeff[SIGCODE_SIZE+1][pairs];
+  memset(transCoeff, 0, sizeof transCoeff);
+  int16_t transCount = 0;
+  for (byte k=0; k < PERIMETER_CODES; k++){
+    if ((mask & (1 << k)) == 0) continue;
+    int8_t *Hk = H + k*M;
+    int16_t s = 0;
+    for (int16_t i=0; i<M; i++) {
+      Hsum[k] += abs(Hk[i]);
+      for (int16_t ss=0; ss<subsample; ss++) s += ((int16_t)Hk[i]) * ((int16_t)ip[i*subsample+ss]);
+    }
+    Hsum[k] *= subsample;
+    sum[k/2] += ((int32_t)s) * ((k%2) ? 65536 : 1);
+  }
+  for (int16_t i=0; i<=M; i++){
+    boolean trans = false;
+    for (byte k=0; k < PERIMETER_CODES; k++){
+      if ((mask & (1 << k)) == 0) continue;
+      int8_t *Hk = H + k*M;
+      int8_t coeff = (i < M) ? Hk[i] : 0;
+      int8_t lastCoeff = (i > 0) ? Hk[i-1] : 0;
+      if (coeff == lastCoeff) continue;
+      transCoeff[transCount][k/2] += ((int32_t)(lastCoeff - coeff)) * ((k%2) ? 65536 : 1);
+      trans = true;
+    }
+    if (trans) transOfs[transCount++] = i * subsample;
+  }
+
+  // for each input value
+  for (int16_t j=0; j<nPts; j++)
+  {
+      for (byte p=0; p < pairs; p++){
+        int16_t sum0 = (int16_t)(sum[p] & 0xFFFF);
+        int16_t sum1 = (sum[p] - sum0) >> 16;
+        if (sum0 > sumMax[2*p]) sumMax[2*p] = sum0;
+        if (sum0 < sumMin[2*p]) sumMin[2*p] = sum0;
+        if (sum1 > sumMax[2*p+1]) sumMax[2*p+1] = sum1;
+        if (sum1 < sumMin[2*p+1]) sumMin[2*p+1] = sum1;
+      }
+      if (j == nPts-1) break;
+      // slide window by one sample
+      for (int16_t t=0; t<transCount; t++)
+      {
+        int32_t v = ip[transOfs[t]];
+        for (byte p=0; p < pairs; p++) sum[p] += transCoeff[t][p] * v;
+      }
+      ip++;
+  }
+  for (byte k=0; k < PERIMETER_CODES; k++){
+    if (mask & (1 << k)) res[k] = corrResult(sumMin[k], sumMax[k], Hsum[k], quality[k]);
+  }
+}
+
+// coeff transitions of the subsampled filter: sample offset and coeff step (H[-1]=H[M]=0)
+int16_t Perimeter::corrTransitions(int8_t *H, int8_t subsample, int16_t M, int16_t *transOfs, int8_t *transCoeff){
+  int16_t transCount = 0;
+  int8_t lastCoeff = 0;
+  for (int16_t i=0; i<=M; i++){
+    int8_t coeff = (i < M) ? H[i] : 0;
+    if (coeff != lastCoeff){
+      transOfs[transCount] = i * subsample;
+      transCoeff[transCount] = lastCoeff - coeff;
+      transCount++;
+    }
+    lastCoeff = coeff;
+  }
+  return transCount;
+}
+
+// normalize correlation sums to 4095, result with the larger magnitude (quality: ratio max/min)
+int16_t Perimeter::corrResult(int16_t sumMin, int16_t sumMax, int16_t Hsum, float &quality){
+  // normalize to 4095
+  sumMin = ((float)sumMin) / ((float)(Hsum*127)) * 4095.0;
+  sumMax = ((float)sumMax) / ((float)(Hsum*127)) * 4095.0;
+  
+  // compute ratio min/max 
+  if (sumMax > -sumMin) {
+    quality = ((float)sumMax) / ((float)-sumMin);
+    return sumMax;
+  } else {
+    quality = ((float)-sumMin) / ((float)sumMax);
+    return sumMin;
+  }  
+}
+
+// reference implementation of corrFilter (full dot product for each input value)
+// kept for speedTest() comparison
+int16_t Perimeter::corrFilterRef(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality){  
+  int16_t sumMax = 0; // max correlation sum
+  int16_t sumMin = 0; // min correlation sum
+  int16_t Ms = M * subsample; // number of filter coeffs including subsampling
+
+  // compute sum of absolute filter coeffs
+  int16_t Hsum = 0;
+  for (int16_t i=0; i<M; i++) Hsum += abs(H[i]); 
+  Hsum *= subsample;
+
   // compute correlation
   // for each input value
   for (int16_t j=0; j<nPts; j++)
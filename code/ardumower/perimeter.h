@@ -24,11 +24,17 @@
 /*
 perimeter v2 receiver for Arduino sound sensors/LM386 using digital filter: matched filter - evaluates signal polarity of 'pulse3' signal on one ADC pin (for one coil)
  (for details see    http://wiki.ardumower.de/index.php?title=Perimeter_wire )
+dual coil: both ADC pins are captured together (ADC pair) and one correlation pass computes both magnitudes
+multi-code (zones, guide wire): signalCodeNo selects the tracking code at runtime, codeMask adds codes
+ that are demodulated in the same pass (filter bank) with magnitude/quality per code
 
 How to use it (example):    
   1. initialize ADC:        ADCMan.init(); 
   2. set perimeter pins:    Perimeter.setPins(pinPerimeterLeft, pinPerimeterRight);  
+                            (dual coil: Perimeter.setPins(pinPerimeterLeft, pinPerimeterRight, true); )
   3. read perimeter:        int value = Perimeter.getMagnitude(0);  
+                            (dual coil: int right = Perimeter.getMagnitude(1); )
+  4. other codes:           Perimeter.codeMask = 0x06;  int zone2 = Perimeter.getCodeMagnitude(0, 2);
     
 */
 
@@ -38,14 +44,18 @@ How to use it (example):
 #include <Arduino.h>
 
 #define RAW_SIGNAL_SAMPLE_SIZE 32
+#define PERIMETER_CODES 3     // sender signal codes (SIGCODE_1..3)
+#define SIGCODE_SIZE 24
+#define PERIMETER_MAX_SAMPLES 255   // capture size per coil (see setPins)
 
 
 class Perimeter
 {
   public:
     Perimeter();
-    // set ADC pins
-    void setPins(byte idx0Pin, byte idx1Pin);
+    // set ADC pins (dualCoil: both coils are read)
+    void setPins(byte idx0Pin, byte idx1Pin, boolean dualCoil = false);
+    boolean isDualCoil(){ return dualCoil; }
     const int8_t* getRawSignalSample(byte idx);
     // get perimeter magnitude
     int getMagnitude(byte idx);    
@@ -58,14 +68,21 @@ class Perimeter
     int16_t getSignalMax(byte idx);    
     int16_t getSignalAvg(byte idx);
     float getFilterQuality(byte idx); 
+    // magnitude/quality of code (1..PERIMETER_CODES, tracking code or in codeMask)
+    int getCodeMagnitude(byte idx, byte code);
+    float getCodeQuality(byte idx, byte code);
+    // tracking code (1..PERIMETER_CODES)
+    byte getCode();
     void speedTest();
-		byte signalCodeNo; // not used yet
+		byte signalCodeNo; // tracking code (1..PERIMETER_CODES, 0: compile-time SIGCODE_x)
+    byte codeMask;     // codes demodulated in addition (bit 0: code 1, ...)
     int16_t timedOutIfBelowSmag;
     int16_t timeOutSecIfNotInside;    
     // swap coil polarity?
     bool swapCoilPolarity;  
     char subSample;
   private:
+    boolean dualCoil;
     unsigned long lastInsideTime[2];
     byte idxPin[2]; // channel for idx
     int callCounter;
@@ -77,8 +94,24 @@ class Perimeter
     int16_t signalAvg[2];    
     int signalCounter[2];    
     int8_t rawSignalSample[2][RAW_SIGNAL_SAMPLE_SIZE];
+    int8_t diffcodes[PERIMETER_CODES][SIGCODE_SIZE]; // differential signals (matched filters)
+    int16_t codeMag[2][PERIMETER_CODES];
+    float codeQuality[2][PERIMETER_CODES];
+    int8_t* getCodeFilter();
+    byte getBankMask();
+    void matchedFilterCodes(byte idx, int8_t *samples, int16_t sampleCount);
     void matchedFilter(byte idx);
+    void matchedFilterDual();
+    void signalStatistics(byte idx, int8_t *samples, int16_t sampleCount);
+    void updateMagnitude(byte idx);
     int16_t corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality);
+    void corrFilterDual(int8_t *H, int8_t subsample, int16_t M, int8_t *ip0, int8_t *ip1, int16_t nPts, 
+      int16_t &res0, int16_t &res1, float &quality0, float &quality1);
+    void corrFilterBank(int8_t *H, byte mask, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, 
+      int16_t *res, float *quality);
+    int16_t corrTransitions(int8_t *H, int8_t subsample, int16_t M, int16_t *transOfs, int8_t *transCoeff);
+    int16_t corrResult(int16_t sumMin, int16_t sumMax, int16_t Hsum, float &quality);
+    int16_t corrFilterRef(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality);
     void printADCMinMax(int8_t *samples);
 };
 
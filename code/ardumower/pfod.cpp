@@ -39,6 +39,7 @@ RemoteControl::RemoteControl(){
   testmode = 0;
   nextPlotTime = 0;  
   perimeterCaptureIdx = 0;  
+  menuItems = shownMenuItems = NULL;
 }
 
 void RemoteControl::setRobot(Robot *aRobot){
@@ -48,18 +49,14 @@ void RemoteControl::setRobot(Robot *aRobot){
 void RemoteControl::initSerial(HardwareSerial* _serialPort, uint32_t baudrate){
   this->serialPort = _serialPort;
   serialPort->begin(baudrate);   
+  telemetry.begin(serialPort);
 }
 
-float RemoteControl::stringToFloat(String &s){
-  float v;
-  char tmp[20];  
-  s.toCharArray(tmp, sizeof(tmp));
-  v = atof(tmp);    
-  //v = strtod(tmp, NULL);
-  /*Console.print(s);
-  Console.print("=");
-  Console.println(v, 6);   */
-  return v;
+// slider result (cmd`value)
+float RemoteControl::sliderValue(const String &result){
+  int idx = result.indexOf('`');
+  if (idx < 0) return 0;
+  return atof(result.c_str() + idx + 1);
 }
 
 void RemoteControl::sendYesNo(int value){
@@ -95,83 +92,105 @@ void RemoteControl::sendTimer(ttimer_t timer){
 
 
 // NOTE: pfodApp rev57 changed slider protocol:  displayValue = (sliderValue + offset) * scale
-void RemoteControl::sendSlider(String cmd, String title, float value, String unit, double scale, float maxvalue, float minvalue){
+void RemoteControl::sendSlider(const char *cmd, const __FlashStringHelper *title, float value, double scale, float maxvalue, float minvalue){
   serialPort->print("|");
   serialPort->print(cmd);
   serialPort->print("~");
   serialPort->print(title);
-  serialPort->print(" `");
-  serialPort->print(((int)(value/scale)));
-  serialPort->print("`");
-  serialPort->print(((int)(maxvalue/scale)));
-  serialPort->print("`");
-  serialPort->print(((int)(minvalue/scale)));
-  serialPort->print("~ ~");
-  if (scale == 10) serialPort->print("10");
-    else if (scale == 1) serialPort->print("1");
-    else if (scale == 0.1) serialPort->print("0.1");
-    else if (scale == 0.01) serialPort->print("0.01");
-    else if (scale == 0.001) serialPort->print("0.001");
-    else if (scale == 0.0001) serialPort->print("0.0001");
+  sendSliderValue(value, scale, maxvalue, minvalue);
 }
 
-void RemoteControl::sendPIDSlider(String cmd, String title, PID &pid, double scale, float maxvalue){
-  sendSlider(cmd + "p", title + "_P", pid.Kp, "", scale, maxvalue);
-  sendSlider(cmd + "i", title + "_I", pid.Ki, "", scale, maxvalue);
-  sendSlider(cmd + "d", title + "_D", pid.Kd, "", scale, maxvalue);  
+void RemoteControl::sendSlider(const char *cmd, const char *title, float value, double scale, float maxvalue, float minvalue){
+  serialPort->print("|");
+  serialPort->print(cmd);
+  serialPort->print("~");
+  serialPort->print(title);
+  sendSliderValue(value, scale, maxvalue, minvalue);
 }
 
-void RemoteControl::processSlider(String result, float &value, double scale){
-  int idx = result.indexOf('`');
-  String s = result.substring(idx + 1);      
-  float v = stringToFloat(s);
-  value = v * scale;  
+void RemoteControl::sendSliderValue(float value, double scale, float maxvalue, float minvalue){
+  serialPort->print(" `");
+  serialPort->print(lround(value/scale));
+  serialPort->print("`");
+  serialPort->print(lround(maxvalue/scale));
+  serialPort->print("`");
+  serialPort->print(lround(minvalue/scale));
+  serialPort->print("~ ~");
+  if (scale >= 1) serialPort->print(lround(scale));
+    else serialPort->print(scale, (int)lround(-log10(scale)));
 }
 
-void RemoteControl::processPIDSlider(String result, String cmd, PID &pid, double scale, float maxvalue){
-  int idx = result.indexOf('`');
-  String s = result.substring(idx + 1);      
-  //Console.println(tmp);
-  float v = stringToFloat(s);
-  if (pfodCmd.startsWith(cmd + "p")){
-    pid.Kp = v * scale;
-    if (pid.Kp < scale) pid.Kp = 0.0;
-  }
-  else if (pfodCmd.startsWith(cmd + "i")){
-    pid.Ki = v * scale;
-    if (pid.Ki < scale) pid.Ki = 0.0;
-  }
-  else if (pfodCmd.startsWith(cmd + "d")){ 
-    pid.Kd = v * scale;      
-    if (pid.Kd < scale) pid.Kd = 0.0;
-  }
+void RemoteControl::processSlider(const String &result, float &value, double scale){
+  value = sliderValue(result) * scale;  
 }
 
-
-void RemoteControl::processSlider(String result, long &value, double scale){
+void RemoteControl::processSlider(const String &result, long &value, double scale){
   float v;
   processSlider(result, v, scale);
   value = v;
 }
 
-void RemoteControl::processSlider(String result, int &value, double scale){
+void RemoteControl::processSlider(const String &result, int &value, double scale){
   float v;
   processSlider(result, v, scale);
   value = v;
 }
 
-void RemoteControl::processSlider(String result, byte &value, double scale){
+void RemoteControl::processSlider(const String &result, byte &value, double scale){
   float v;
   processSlider(result, v, scale);
   value = v;
 }
 
-void RemoteControl::processSlider(String result, short &value, double scale){
+void RemoteControl::processSlider(const String &result, short &value, double scale){
   float v;
   processSlider(result, v, scale);
   value = v;
 }
-    
+
+// send setting items of a menu table, for an update (same menu shown) only the items whose
+// value changed since the last frame
+void RemoteControl::sendMenuItems(const pfoditem_t *items, byte count, boolean update){
+  if (items != shownMenuItems) update = false;
+  menuItems = items;
+  pfoditem_t item;
+  setting_t info;
+  for (byte i=0; i < count; i++){
+    memcpy_P(&item, &items[i], sizeof item);
+    if ((item.type & PFOD_ITEM_DEVELOPER) && (!robot->developerActive)) continue;
+    if (!getSettingInfoById(item.setting, info)) continue;
+    float value = getSettingFloat(info, robot->settingValue(item.setting));
+    long raw = (info.scale > 0) ? lround(value / info.scale) : 0;
+    if ((update) && (i < PFOD_MENU_ITEMS_MAX) && (menuItemSent[i] == raw)) continue;
+    if (i < PFOD_MENU_ITEMS_MAX) menuItemSent[i] = raw;
+    if ((item.type & ~PFOD_ITEM_DEVELOPER) == PFOD_ITEM_YESNO){
+      serialPort->print("|");
+      serialPort->print(item.cmd);
+      serialPort->print("~");
+      serialPort->print(item.title);
+      serialPort->print(" ");
+      sendYesNo(value != 0);
+    } else sendSlider(item.cmd, item.title, value, info.scale, info.maxValue, info.minValue);
+  }
+}
+
+// command for a setting item of the table: toggle (yes/no) or slider value
+boolean RemoteControl::processMenuItems(const pfoditem_t *items, byte count){
+  pfoditem_t item;
+  setting_t info;
+  for (byte i=0; i < count; i++){
+    memcpy_P(&item, &items[i], sizeof item);
+    unsigned int len = strlen(item.cmd);
+    if ((!pfodCmd.startsWith(item.cmd)) || ((pfodCmd.length() > len) && (pfodCmd[len] != '`'))) continue;
+    if (!getSettingInfoById(item.setting, info)) return false;
+    void *value = robot->settingValue(item.setting);
+    if ((item.type & ~PFOD_ITEM_DEVELOPER) == PFOD_ITEM_YESNO) setSettingFloat(info, value, getSettingFloat(info, value) == 0);
+      else setSettingFloat(info, value, constrain(sliderValue(pfodCmd) * info.scale, info.minValue, info.maxValue));
+    return true;
+  }
+  return false;
+}
+
 void RemoteControl::sendMainMenu(boolean update){
   if (update) serialPort->print("{:"); else {
     serialPort->print(F("{.Ardumower"));
@@ -208,9 +227,131 @@ void RemoteControl::sendADCMenu(boolean update){
 void RemoteControl::sendPlotMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Plot"));
   serialPort->print(F("|y7~Sensors|y5~Sensor counters|y3~IMU|y6~Perimeter|y8~GPS"));
-  serialPort->println(F("|y1~Battery|y2~Odometry2D|y11~Motor control|y10~GPS2D}"));
+  serialPort->println(F("|y1~Battery|y2~Odometry2D|y11~Motor control|y10~GPS2D|y12~Binary telemetry}"));
 }  
 
+void RemoteControl::sendTelemetryMenu(boolean update){
+  if (update) serialPort->print("{:"); else serialPort->print(F("{.Binary telemetry"));
+  for (byte i=0; i < TELE_GROUP_COUNT; i++){
+    serialPort->print(F("|yt"));
+    serialPort->print(i);
+    serialPort->print("~");
+    serialPort->print((const __FlashStringHelper*)teleGroupNames[i]);
+    serialPort->print(" ");
+    sendOnOff((telemetry.getGroupMask() & (1 << i)) != 0);
+  }
+  serialPort->print(F("|ytr~Rate (Hz) "));
+  serialPort->print(1000 / telemetry.getPeriod());
+  serialPort->print(F("|yts~Start stream (host decoder)"));
+  serialPort->print(F("|ytx~Frames "));
+  serialPort->print(telemetry.getFrameCount());
+  serialPort->print(F(" dropped "));
+  serialPort->print(telemetry.getDropCount());
+  serialPort->print(F(" size "));
+  serialPort->print(telemetry.getDataFrameSize());
+  serialPort->println("}");
+}
+
+void RemoteControl::processTelemetryMenu(const String &pfodCmd){
+  const unsigned int periods[] = {1000, 200, 100, 50, 20, 10};
+  byte mask = telemetry.getGroupMask();
+  unsigned int period = telemetry.getPeriod();
+  if (pfodCmd == "ytr") {
+    byte i = 0;
+    while ((i < 5) && (periods[i] != period)) i++;
+    period = periods[(i+1) % 6];
+  } else if (pfodCmd == "yts") {
+    telemetry.setup(mask, period);
+    robot->scheduler.setPeriod(TASK_TELEMETRY, period);
+    serialPort->println(F("{=Binary telemetry}"));
+    pfodState = PFOD_TELEMETRY;
+    return;
+  } else if ((pfodCmd.length() == 3) && (pfodCmd[2] >= '0') && (pfodCmd[2] < '0'+TELE_GROUP_COUNT)) {
+    mask ^= (1 << (pfodCmd[2]-'0'));
+  }
+  if ((mask != telemetry.getGroupMask()) || (period != telemetry.getPeriod())) telemetry.setup(mask, period);
+  sendTelemetryMenu(true);
+}
+
+// channel value as fixed-point integer (see teleChannels for decimals)
+long RemoteControl::telemetryRaw(byte ch){
+  switch (ch){
+    case TELE_STATE:         return robot->stateCurr;
+    case TELE_YAW:           return robot->imu.ypr.yaw/PI*18000;
+    case TELE_PITCH:         return robot->imu.ypr.pitch/PI*18000;
+    case TELE_ROLL:          return robot->imu.ypr.roll/PI*18000;
+    case TELE_GYRO_X:        return robot->imu.gyro.x/PI*1800;
+    case TELE_GYRO_Y:        return robot->imu.gyro.y/PI*1800;
+    case TELE_GYRO_Z:        return robot->imu.gyro.z/PI*1800;
+    case TELE_ACC_X:         return robot->imu.acc.x*1000;
+    case TELE_ACC_Y:         return robot->imu.acc.y*1000;
+    case TELE_ACC_Z:         return robot->imu.acc.z*1000;
+    case TELE_COM_X:         return robot->imu.com.x*1000;
+    case TELE_COM_Y:         return robot->imu.com.y*1000;
+    case TELE_COM_Z:         return robot->imu.com.z*1000;
+    case TELE_LRPM_CURR:     return robot->motorLeftRpmCurr*10;
+    case TELE_RRPM_CURR:     return robot->motorRightRpmCurr*10;
+    case TELE_LRPM_SET:      return robot->motorLeftSpeedRpmSet*10L;
+    case TELE_RRPM_SET:      return robot->motorRightSpeedRpmSet*10L;
+    case TELE_LPWM:          return robot->motorLeftPWMCurr;
+    case TELE_RPWM:          return robot->motorRightPWMCurr;
+    case TELE_LERR:          return robot->motorLeftPID.eold*10;
+    case TELE_RERR:          return robot->motorRightPID.eold*10;
+    case TELE_MOW_PWM:       return robot->motorMowPWMCurr;
+    case TELE_MOT_L_SENSE:   return robot->motorLeftSense;
+    case TELE_MOT_R_SENSE:   return robot->motorRightSense;
+    case TELE_MOT_M_SENSE:   return robot->motorMowSense;
+    case TELE_SON_L:         return robot->sonarDistLeft;
+    case TELE_SON_C:         return robot->sonarDistCenter;
+    case TELE_SON_R:         return robot->sonarDistRight;
+    case TELE_BUMPER_L:      return robot->bumperLeft;
+    case TELE_BUMPER_R:      return robot->bumperRight;
+    case TELE_DROP_L:        return robot->dropLeft;
+    case TELE_DROP_R:        return robot->dropRight;
+    case TELE_LAWN:          return robot->lawnSensor;
+    case TELE_RAIN:          return robot->rain;
+    case TELE_BAT_VOLT:      return robot->batVoltage*100;
+    case TELE_CHG_VOLT:      return robot->chgVoltage*100;
+    case TELE_CHG_CURR:      return robot->chgCurrent*1000;
+    case TELE_BAT_CAPACITY:  return robot->batCapacity;
+    case TELE_ODO_LEFT:      return robot->odometryLeft;
+    case TELE_ODO_RIGHT:     return robot->odometryRight;
+    case TELE_ODO_X:         return robot->odometryX*10;
+    case TELE_ODO_Y:         return robot->odometryY*10;
+    case TELE_PERI_MAG:      return robot->perimeterMag;
+    case TELE_PERI_SMAG:     return robot->perimeter.getSmoothMagnitude(0);
+    case TELE_PERI_INSIDE:   return robot->perimeter.isInside(0);
+    case TELE_PERI_CNT:      return robot->perimeterCounter;
+    case TELE_PERI_ON:       return !robot->perimeter.signalTimedOut(0);
+    case TELE_PERI_QTY:      return robot->perimeter.getFilterQuality(0)*1000;
+    case TELE_GPS_HDOP:      return robot->gps.hdop();
+    case TELE_GPS_SATS:      return robot->gps.satellites();
+    case TELE_GPS_SPEED:     return robot->gps.speed();
+    case TELE_GPS_COURSE:    return robot->gps.course();
+    case TELE_GPS_ALT:       return robot->gps.altitude();
+    case TELE_GPS_LAT:
+    case TELE_GPS_LON:       {
+                               long lat, lon;
+                               robot->gps.get_position(&lat, &lon);
+                               return (ch == TELE_GPS_LAT) ? lat : lon;
+                             }
+    case TELE_GPS_X:         return robot->gpsX*100;
+    case TELE_GPS_Y:         return robot->gpsY*100;
+    case TELE_POSE_X:        return robot->fusion.getPose().x*10;
+    case TELE_POSE_Y:        return robot->fusion.getPose().y*10;
+    case TELE_POSE_HEADING:  return robot->fusion.getPose().heading/PI*18000;
+    case TELE_POSE_SPEED:    return robot->fusion.getPose().speed*10;
+    case TELE_POSE_STD:      return robot->fusion.getPose().posStd*10;
+    case TELE_POSE_VALID:    return robot->fusion.getPose().valid;
+  }
+  return 0;
+}
+
+void RemoteControl::runTelemetry(){
+  if (pfodState != PFOD_TELEMETRY) return;
+  telemetry.send(this, &RemoteControl::telemetryRaw);
+}
+
 
 void RemoteControl::sendSettingsMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Settings"));
@@ -266,7 +407,7 @@ void RemoteControl::sendErrorMenu(boolean update){
   serialPort->println("}");
 }  
 
-void RemoteControl::processErrorMenu(String pfodCmd){      
+void RemoteControl::processErrorMenu(const String &pfodCmd){      
   if (pfodCmd == "z00") {
     robot->resetErrorCounters();
     robot->setNextState(STATE_OFF, 0);
@@ -275,6 +416,23 @@ void RemoteControl::processErrorMenu(String pfodCmd){
 }
 
 
+// settings menu items: command, type, setting, title
+const pfoditem_t motorMenuItems[] PROGMEM = {
+  {"a02", PFOD_ITEM_SLIDER, SETTING_MOTOR_POWER_MAX,        "Power max"},
+  {"a15", PFOD_ITEM_SLIDER, SETTING_MOTOR_SPEED_MAX_PWM,    "Speed max in pwm"},
+  {"a11", PFOD_ITEM_SLIDER, SETTING_MOTOR_ACCEL,            "Accel"},
+  {"a18", PFOD_ITEM_SLIDER, SETTING_MOTOR_POWER_IGNORE_TIME, "Power ignore time"},
+  {"a07", PFOD_ITEM_SLIDER, SETTING_MOTOR_ROLL_TIME_MAX,    "Roll time max"},
+  {"a08", PFOD_ITEM_SLIDER, SETTING_MOTOR_REVERSE_TIME,     "Reverse time"},
+  {"a09", PFOD_ITEM_SLIDER, SETTING_MOTOR_FORW_TIME_MAX,    "Forw time max"},
+  {"a12", PFOD_ITEM_SLIDER, SETTING_MOTOR_BI_DIR_SPEED_RATIO1, "Bidir speed ratio 1"},
+  {"a13", PFOD_ITEM_SLIDER, SETTING_MOTOR_BI_DIR_SPEED_RATIO2, "Bidir speed ratio 2"},
+  {"a20", PFOD_ITEM_SLIDER | PFOD_ITEM_DEVELOPER, SETTING_MOTOR_SENSE_LEFT_SCALE,  "MotorSenseLeftScale"},
+  {"a21", PFOD_ITEM_SLIDER | PFOD_ITEM_DEVELOPER, SETTING_MOTOR_SENSE_RIGHT_SCALE, "MotorSenseRightScale"},
+  {"a16", PFOD_ITEM_YESNO,  SETTING_MOTOR_LEFT_SWAP_DIR,    "Swap left direction"},
+  {"a17", PFOD_ITEM_YESNO,  SETTING_MOTOR_RIGHT_SWAP_DIR,   "Swap right direction"},
+};
+
 void RemoteControl::sendMotorMenu(boolean update){  
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Motor`1000"));
   serialPort->println(F("|a00~Overload Counter l, r "));
@@ -289,68 +447,30 @@ void RemoteControl::sendMotorMenu(boolean update){
   serialPort->print(robot->motorLeftSenseCurrent);
   serialPort->print(", ");
   serialPort->print(robot->motorRightSenseCurrent);
-  //Console.print("motorpowermax=");
-  //Console.println(robot->motorPowerMax);
-  sendSlider("a02", F("Power max"), robot->motorPowerMax, "", 0.1, 100);  
-  sendSlider("a03", F("calibrate left motor "), robot->motorLeftSenseCurrent, "", 1, 1000, 0);       
-  sendSlider("a04", F("calibrate right motor"), robot->motorRightSenseCurrent, "", 1, 1000, 0);      
+  sendSlider("a03", F("calibrate left motor "), robot->motorLeftSenseCurrent, 1, 1000, 0);       
+  sendSlider("a04", F("calibrate right motor"), robot->motorRightSenseCurrent, 1, 1000, 0);      
   serialPort->print(F("|a05~Speed l, r pwm"));
   serialPort->print(robot->motorLeftPWMCurr);
   serialPort->print(", ");
   serialPort->print(robot->motorRightPWMCurr);
-  sendSlider("a15", F("Speed max in pwm"), robot->motorSpeedMaxPwm, "", 1, 255);      
-  sendSlider("a11", F("Accel"), robot->motorAccel, "", 1, 2000, 500);  
-  sendSlider("a18", F("Power ignore time"), robot->motorPowerIgnoreTime, "", 1, 8000);     
-  sendSlider("a07", F("Roll time max"), robot->motorRollTimeMax, "", 1, 8000); 
-  sendSlider("a19", F("Roll time min"), robot->motorRollTimeMin, "", 1, (robot->motorRollTimeMax - 500)); 
-  sendSlider("a08", F("Reverse time"), robot->motorReverseTime, "", 1, 8000);     
-  sendSlider("a09", F("Forw time max"), robot->motorForwTimeMax, "", 10, 80000);       
-  sendSlider("a12", F("Bidir speed ratio 1"), robot->motorBiDirSpeedRatio1, "", 0.01, 1.0);       
-  sendSlider("a13", F("Bidir speed ratio 2"), robot->motorBiDirSpeedRatio2, "", 0.01, 1.0);       
+  sendMenuItems(motorMenuItems, sizeof motorMenuItems / sizeof motorMenuItems[0], update);
+  sendSlider("a19", F("Roll time min"), robot->motorRollTimeMin, 1, (robot->motorRollTimeMax - 500)); 
   serialPort->println(F("|a10~Testing is"));
   switch (testmode){
     case 0: serialPort->print(F("OFF")); break;
     case 1: serialPort->print(F("Left motor forw")); break;
     case 2: serialPort->print(F("Right motor forw")); break;
   }
-  
-  //bb add
-  if (robot->developerActive)
-  {
-    sendSlider("a20", F("MotorSenseLeftScale"), robot->motorSenseLeftScale, "", 0.01, 30.0);
-    sendSlider("a21", F("MotorSenseRightScale"), robot->motorSenseRightScale, "", 0.01, 30.0);
-  }
-  //end add
-  
   serialPort->print(F("|a14~for config file:"));
   serialPort->print(F("motorSenseScale l, r"));
   serialPort->print(robot->motorSenseLeftScale);
   serialPort->print(", ");
   serialPort->print(robot->motorSenseRightScale);
-  serialPort->print(F("|a16~Swap left direction "));
-  sendYesNo(robot->motorLeftSwapDir);
-  serialPort->print(F("|a17~Swap right direction "));
-  sendYesNo(robot->motorRightSwapDir);
   serialPort->println("}");
 }
 
-void RemoteControl::processMotorMenu(String pfodCmd){      
-  
-  //bb add
-  if (robot->developerActive)
-  {
-    if (pfodCmd.startsWith("a20")) processSlider(pfodCmd, robot->motorSenseLeftScale, 0.01);
-    if (pfodCmd.startsWith("a21")) processSlider(pfodCmd, robot->motorSenseRightScale, 0.01);
-  }
-  //end add
-    
-  if (pfodCmd.startsWith("a02")) 
-  {
-    processSlider(pfodCmd, robot->motorPowerMax, 0.1);
-    //Console.print("motorpowermax=");
-    //Console.println(robot->motorPowerMax);
-  }
-
+void RemoteControl::processMotorMenu(const String &pfodCmd){      
+  if (processMenuItems(motorMenuItems, sizeof motorMenuItems / sizeof motorMenuItems[0])) {}
   else if (pfodCmd.startsWith("a03"))
   {
       processSlider(pfodCmd, robot->motorLeftSenseCurrent, 1);
@@ -366,17 +486,7 @@ void RemoteControl::processMotorMenu(String pfodCmd){
       robot->motorSenseRightScale = robot->motorRightSenseCurrent / max(1.0, (float)robot->motorRightSenseADC); 
   
   }      
-    else if (pfodCmd.startsWith("a15")) processSlider(pfodCmd, robot->motorSpeedMaxPwm, 1);
-    else if (pfodCmd.startsWith("a07")) processSlider(pfodCmd, robot->motorRollTimeMax, 1); 
     else if (pfodCmd.startsWith("a19")) processSlider(pfodCmd, robot->motorRollTimeMin, 1); 
-    else if (pfodCmd.startsWith("a08")) processSlider(pfodCmd, robot->motorReverseTime, 1);
-    else if (pfodCmd.startsWith("a09")) processSlider(pfodCmd, robot->motorForwTimeMax, 10);
-    else if (pfodCmd.startsWith("a11")) processSlider(pfodCmd, robot->motorAccel, 1);    
-    else if (pfodCmd.startsWith("a12")) processSlider(pfodCmd, robot->motorBiDirSpeedRatio1, 0.01);    
-    else if (pfodCmd.startsWith("a13")) processSlider(pfodCmd, robot->motorBiDirSpeedRatio2, 0.01);    
-    else if (pfodCmd.startsWith("a16")) robot->motorLeftSwapDir = !robot->motorLeftSwapDir;
-    else if (pfodCmd.startsWith("a17")) robot->motorRightSwapDir = !robot->motorRightSwapDir;  
-    else if (pfodCmd.startsWith("a18")) processSlider(pfodCmd, robot->motorPowerIgnoreTime, 1);        
     else if (pfodCmd == "a10") { 
       testmode = (testmode + 1) % 3;
       switch (testmode){
@@ -388,29 +498,34 @@ void RemoteControl::processMotorMenu(String pfodCmd){
   sendMotorMenu(true);
 }
   
+const pfoditem_t mowMenuItems[] PROGMEM = {
+  {"o12", PFOD_ITEM_YESNO,  SETTING_MOTOR_MOW_FORCE_OFF,    "Force mowing off:"},
+  {"o02", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_POWER_MAX,    "Power max"},
+  {"o05", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_SPEED_MAX_PWM, "Speed max"},
+  {"o08", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_RPM_SET,      "RPM set"},
+  {"o09p", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_PID_KP,      "RPM_P"},
+  {"o09i", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_PID_KI,      "RPM_I"},
+  {"o09d", PFOD_ITEM_SLIDER, SETTING_MOTOR_MOW_PID_KD,      "RPM_D"},
+};
+
 void RemoteControl::sendMowMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Mow`1000"));
-  serialPort->print(F("|o12~Force mowing off: "));
-  sendYesNo(robot->motorMowForceOff);	
 	serialPort->print(F("|o00~Overload Counter "));
   serialPort->print(robot->motorMowSenseCounter);
   serialPort->print(F("|o01~Power in Watt "));
   serialPort->print(robot->motorMowSense);
   serialPort->print(F("|o11~current in mA "));
   serialPort->print(robot->motorMowSenseCurrent);
-  sendSlider("o02", F("Power max"), robot->motorMowPowerMax, "", 0.1, 100);         
-  sendSlider("o03", F("calibrate mow motor "), robot->motorMowSenseCurrent, "", 1, 3000, 0);          
+  sendSlider("o03", F("calibrate mow motor "), robot->motorMowSenseCurrent, 1, 3000, 0);          
   serialPort->print(F("|o04~Speed "));
   serialPort->print(robot->motorMowPWMCurr);
-  sendSlider("o05", F("Speed max"), robot->motorMowSpeedMaxPwm, "", 1, 255);       
   if (robot->developerActive) {
     serialPort->print(F("|o06~Modulate "));
     sendYesNo(robot->motorMowModulate);
   }      
   serialPort->print(F("|o07~RPM "));
   serialPort->print(robot->motorMowRpmCurr);
-  sendSlider("o08", F("RPM set"), robot->motorMowRPMSet, "", 1, 4500);     
-  sendPIDSlider("o09", "RPM", robot->motorMowPID, 0.01, 1.0);      
+  sendMenuItems(mowMenuItems, sizeof mowMenuItems / sizeof mowMenuItems[0], update);
   serialPort->println(F("|o10~Testing is"));
   switch (testmode){
     case 0: serialPort->print(F("OFF")); break;
@@ -422,17 +537,13 @@ void RemoteControl::sendMowMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processMowMenu(String pfodCmd){      
-  if (pfodCmd.startsWith("o02")) processSlider(pfodCmd, robot->motorMowPowerMax, 0.1);
-    else if (pfodCmd.startsWith("o12")) robot->motorMowForceOff = !robot->motorMowForceOff;
+void RemoteControl::processMowMenu(const String &pfodCmd){      
+  if (processMenuItems(mowMenuItems, sizeof mowMenuItems / sizeof mowMenuItems[0])) {}
 		else if (pfodCmd.startsWith("o03")){
             processSlider(pfodCmd, robot->motorMowSenseCurrent, 1);
             robot->motorMowSenseScale = robot->motorMowSenseCurrent / max(0,(float)robot->motorMowSenseADC);
          } 
-    else if (pfodCmd.startsWith("o05")) processSlider(pfodCmd, robot->motorMowSpeedMaxPwm, 1);
     else if (pfodCmd == "o06") robot->motorMowModulate = !robot->motorMowModulate;    
-    else if (pfodCmd.startsWith("o08")) processSlider(pfodCmd, robot->motorMowRPMSet, 1);    
-    else if (pfodCmd.startsWith("o09")) processPIDSlider(pfodCmd, "o09", robot->motorMowPID, 0.01, 1.0);
     else if (pfodCmd == "o10") { 
       testmode = (testmode + 1) % 2;
       switch (testmode){
@@ -443,10 +554,14 @@ void RemoteControl::processMowMenu(String pfodCmd){
   sendMowMenu(true);
 }
 
+const pfoditem_t bumperMenuItems[] PROGMEM = {
+  {"b00", PFOD_ITEM_YESNO, SETTING_BUMPER_USE, "Use bumper"},
+  {"b03", PFOD_ITEM_YESNO, SETTING_TILT_USE,   "Use tilt"},
+};
+
 void RemoteControl::sendBumperMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.BumperDuino`1000"));  
-  serialPort->print(F("|b00~Use bumper "));
-  sendYesNo(robot->bumperUse);    
+  sendMenuItems(bumperMenuItems, sizeof bumperMenuItems / sizeof bumperMenuItems[0], update);
   serialPort->println(F("|b01~Bumper counter l, r "));
   serialPort->print(robot->bumperLeftCounter);
   serialPort->print(", ");
@@ -455,17 +570,18 @@ void RemoteControl::sendBumperMenu(boolean update){
   serialPort->print(robot->bumperLeft);
   serialPort->print(", ");
   serialPort->print(robot->bumperRight);
-  serialPort->print(F("|b03~Use tilt "));
-  sendYesNo(robot->tiltUse);    
   serialPort->println(F("|b04~Tilt value "));
   serialPort->print(robot->tilt);
   serialPort->println("}");
 }
 
+const pfoditem_t dropMenuItems[] PROGMEM = {
+  {"u00", PFOD_ITEM_YESNO, SETTING_DROP_USE, "Use"},
+};
+
 void RemoteControl::sendDropMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Drop`1000"));
-  serialPort->print(F("|u00~Use "));
-  sendYesNo(robot->dropUse);    
+  sendMenuItems(dropMenuItems, sizeof dropMenuItems / sizeof dropMenuItems[0], update);
   serialPort->println(F("|u01~Counter l, r "));
   serialPort->print(robot->dropLeftCounter);
   serialPort->print(", ");
@@ -478,28 +594,30 @@ void RemoteControl::sendDropMenu(boolean update){
 }
 
 
-void RemoteControl::processBumperMenu(String pfodCmd){      
-  if (pfodCmd == "b00") robot->bumperUse = !robot->bumperUse;    
-  else if (pfodCmd == "b03") robot->tiltUse = !robot->tiltUse;    
+void RemoteControl::processBumperMenu(const String &pfodCmd){      
+  processMenuItems(bumperMenuItems, sizeof bumperMenuItems / sizeof bumperMenuItems[0]);
   sendBumperMenu(true);
 }
 
-void RemoteControl::processDropMenu(String pfodCmd){      
-  if (pfodCmd == "u00") robot->dropUse = !robot->dropUse;    
+void RemoteControl::processDropMenu(const String &pfodCmd){      
+  processMenuItems(dropMenuItems, sizeof dropMenuItems / sizeof dropMenuItems[0]);
   sendDropMenu(true);
 }
 
 
+const pfoditem_t sonarMenuItems[] PROGMEM = {
+  {"d00", PFOD_ITEM_YESNO,  SETTING_SONAR_USE,           "Use"},
+  {"d04", PFOD_ITEM_YESNO,  SETTING_SONAR_LEFT_USE,      "Use left"},
+  {"d05", PFOD_ITEM_YESNO,  SETTING_SONAR_CENTER_USE,    "Use center"},
+  {"d06", PFOD_ITEM_YESNO,  SETTING_SONAR_RIGHT_USE,     "Use right"},
+  {"d03", PFOD_ITEM_SLIDER, SETTING_SONAR_TRIGGER_BELOW, "Trigger below (cm)(0=off)"},
+  {"d07", PFOD_ITEM_SLIDER, SETTING_SONAR_SLOW_BELOW,    "Slow below (cm)"},
+  {"d08", PFOD_ITEM_YESNO,  SETTING_OBSTACLE_MAP_USE,    "Use obstacle map"},
+  {"d09", PFOD_ITEM_SLIDER, SETTING_OBSTACLE_MAP_SLOW_BELOW, "Map slow below (cm)"},
+};
+
 void RemoteControl::sendSonarMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Sonar`1000"));         
-  serialPort->print(F("|d00~Use "));
-  sendYesNo(robot->sonarUse);
-  serialPort->print(F("|d04~Use left "));
-  sendYesNo(robot->sonarLeftUse);
-  serialPort->print(F("|d05~Use center "));
-  sendYesNo(robot->sonarCenterUse);
-  serialPort->print(F("|d06~Use right "));
-  sendYesNo(robot->sonarRightUse);
   serialPort->print(F("|d01~Counter "));
   serialPort->print(robot->sonarDistCounter);    
   serialPort->println(F("|d02~Value l, c, r"));
@@ -508,84 +626,97 @@ void RemoteControl::sendSonarMenu(boolean update){
   serialPort->print(robot->sonarDistCenter);
   serialPort->print(", ");
   serialPort->print(robot->sonarDistRight);  
-  sendSlider("d03", F("Trigger below (cm)(0=off)"), robot->sonarTriggerBelow, "", 1, 100);       
-	sendSlider("d07", F("Slow below (cm)"), robot->sonarSlowBelow, "", 1, 100);       
+  sendMenuItems(sonarMenuItems, sizeof sonarMenuItems / sizeof sonarMenuItems[0], update);
+  serialPort->print(F("|d10~Map tiles, occupied "));
+  serialPort->print(robot->obstacleMap.getTileCount());
+  serialPort->print(", ");
+  serialPort->print(robot->obstacleMap.getOccupiedCount());
+  serialPort->print(F("|d11~Save map|d12~Clear map"));
   serialPort->println("}"); 
 }
 
-void RemoteControl::processSonarMenu(String pfodCmd){      
-  if (pfodCmd == "d00") robot->sonarUse = !robot->sonarUse;
-    else if (pfodCmd.startsWith("d07")) processSlider(pfodCmd, robot->sonarSlowBelow, 1);
-		else if (pfodCmd.startsWith("d03")) processSlider(pfodCmd, robot->sonarTriggerBelow, 1);
-    else if (pfodCmd == "d04") robot->sonarLeftUse = !robot->sonarLeftUse;
-    else if (pfodCmd == "d05") robot->sonarCenterUse = !robot->sonarCenterUse;
-    else if (pfodCmd == "d06") robot->sonarRightUse = !robot->sonarRightUse;
+void RemoteControl::processSonarMenu(const String &pfodCmd){      
+  if (processMenuItems(sonarMenuItems, sizeof sonarMenuItems / sizeof sonarMenuItems[0])) {}
+    else if (pfodCmd == "d11") robot->obstacleMap.save();
+    else if (pfodCmd == "d12") robot->obstacleMap.clear();
   sendSonarMenu(true);
 }
 
+const pfoditem_t perimeterMenuItems[] PROGMEM = {
+  {"e00", PFOD_ITEM_YESNO,  SETTING_PERIMETER_USE,                  "Use"},
+  {"e08", PFOD_ITEM_SLIDER, SETTING_PERIMETER_TIMED_OUT_IF_BELOW_SMAG, "Timed-out if below smag"},
+  {"e14", PFOD_ITEM_SLIDER, SETTING_PERIMETER_TIME_OUT_SEC_IF_NOT_INSIDE, "Timeout (s) if not inside"},
+  {"e04", PFOD_ITEM_SLIDER, SETTING_PERIMETER_TRIGGER_TIMEOUT,      "Trigger timeout"},
+  {"e05", PFOD_ITEM_SLIDER, SETTING_PERIMETER_OUT_ROLL_TIME_MAX,    "Perimeter out roll time max"},
+  {"e06", PFOD_ITEM_SLIDER, SETTING_PERIMETER_OUT_ROLL_TIME_MIN,    "Perimeter out roll time min"},
+  {"e15", PFOD_ITEM_SLIDER, SETTING_PERIMETER_OUT_REV_TIME,         "Perimeter out reverse time"},
+  {"e16", PFOD_ITEM_SLIDER, SETTING_PERIMETER_TRACK_ROLL_TIME,      "Perimeter tracking roll time"},
+  {"e17", PFOD_ITEM_SLIDER, SETTING_PERIMETER_TRACK_REV_TIME,       "Perimeter tracking reverse time"},
+  {"e07p", PFOD_ITEM_SLIDER, SETTING_PERIMETER_PID_KP,              "Track_P"},
+  {"e07i", PFOD_ITEM_SLIDER, SETTING_PERIMETER_PID_KI,              "Track_I"},
+  {"e07d", PFOD_ITEM_SLIDER, SETTING_PERIMETER_PID_KD,              "Track_D"},
+  {"e10", PFOD_ITEM_YESNO,  SETTING_PERIMETER_SWAP_COIL_POLARITY,   "Swap coil polarity"},
+  {"e27", PFOD_ITEM_SLIDER, SETTING_PERIMETER_SIGNAL_CODE_NO,       "Signal code (0=default)"},
+  {"e28", PFOD_ITEM_SLIDER, SETTING_PERIMETER_CODE_MASK,            "Other codes (mask)"},
+  {"e13", PFOD_ITEM_YESNO,  SETTING_TRACKING_BLOCK_INNER_WHEEL_WHILE_PERIMETER_STRUGGLING, "Block inner wheel"},
+  {"e24", PFOD_ITEM_YESNO,  SETTING_LOCALIZE_USE,                   "Use localization (experimental)"},
+};
+
 void RemoteControl::sendPerimeterMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Perimeter`1000"));
-  serialPort->print(F("|e00~Use "));
-  sendYesNo(robot->perimeterUse);  
   serialPort->println(F("|e02~Value "));
   serialPort->print(robot->perimeterMag);
+  if (robot->perimeter.isDualCoil()) {
+    serialPort->print(", ");
+    serialPort->print(robot->perimeterMagRight);
+  }
   if (robot->perimeterMag < 0) serialPort->print(" (inside)");
     else serialPort->print(" (outside)");
   serialPort->print(F("|e22~smag "));
 	serialPort->print(robot->perimeter.getSmoothMagnitude(0));
   serialPort->print(F("|e23~timeout "));
   serialPort->print(robot->perimeter.signalTimedOut(0));
-  sendSlider("e08", F("Timed-out if below smag"), robot->perimeter.timedOutIfBelowSmag, "", 1, 2000);  
-  sendSlider("e14", F("Timeout (s) if not inside"), robot->perimeter.timeOutSecIfNotInside, "", 1, 20, 1);  
-  sendSlider("e04", F("Trigger timeout"), robot->perimeterTriggerTimeout, "", 1, 2000);
-  sendSlider("e05", F("Perimeter out roll time max"), robot->perimeterOutRollTimeMax, "", 1, 8000);       
-  sendSlider("e06", F("Perimeter out roll time min"), robot->perimeterOutRollTimeMin, "", 1, 8000); 
-  sendSlider("e15", F("Perimeter out reverse time"), robot->perimeterOutRevTime, "", 1, 8000); 
-  sendSlider("e16", F("Perimeter tracking roll time"), robot->perimeterTrackRollTime, "", 1, 8000); 
-  sendSlider("e17", F("Perimeter tracking reverse time"), robot->perimeterTrackRevTime, "", 1, 8000); 
-  sendSlider("e11", F("Transition timeout"), robot->trackingPerimeterTransitionTimeOut, "", 1, 10000);
-  sendSlider("e12", F("Track error timeout"), robot->trackingErrorTimeOut, "", 1, 10000);             
-  sendPIDSlider("e07", F("Track"), robot->perimeterPID, 0.1, 100);  
-  //serialPort->print(F("|e09~Use differential signal "));
-  //sendYesNo(robot->perimeter.useDifferentialPerimeterSignal);    
-  serialPort->print(F("|e10~Swap coil polarity "));
-  sendYesNo(robot->perimeter.swapCoilPolarity);
-  serialPort->print(F("|e13~Block inner wheel  "));
-  sendYesNo(robot->trackingBlockInnerWheelWhilePerimeterStruggling);
+  sendMenuItems(perimeterMenuItems, sizeof perimeterMenuItems / sizeof perimeterMenuItems[0], update);
+  sendSlider("e11", F("Transition timeout"), robot->trackingPerimeterTransitionTimeOut, 1, 10000);
+  sendSlider("e12", F("Track error timeout"), robot->trackingErrorTimeOut, 1, 10000);             
 	serialPort->print(F("|e18~State "));  
 	serialPort->print(robot->stateName());
 	serialPort->print(F("|e18~Last trigger "));
 	serialPort->print(robot->lastSensorTriggeredName());
+  serialPort->print(F("|e25~Localization "));
+  if (robot->localizer.isReady()){
+    serialPort->print((int)robot->localizer.getX());
+    serialPort->print(", ");
+    serialPort->print((int)robot->localizer.getY());
+    serialPort->print(" +-");
+    serialPort->print((int)robot->localizer.getSpread());
+  } else {
+    serialPort->print(F("wire points "));
+    serialPort->print(robot->localizer.getWirePointCount());
+  }
+  serialPort->print(F("|e26~Clear wire"));
 	serialPort->print(F("|e19~OFF|e20~Home|e21~Track"));
   serialPort->println("}");
 }
 
-void RemoteControl::processPerimeterMenu(String pfodCmd){        
-	if (pfodCmd == "e00") robot->perimeterUse = !robot->perimeterUse;
-    else if (pfodCmd.startsWith("e04")) processSlider(pfodCmd, robot->perimeterTriggerTimeout, 1);  
-    else if (pfodCmd.startsWith("e05")) processSlider(pfodCmd, robot->perimeterOutRollTimeMax, 1);
-    else if (pfodCmd.startsWith("e06")) processSlider(pfodCmd, robot->perimeterOutRollTimeMin, 1);
-    else if (pfodCmd.startsWith("e15")) processSlider(pfodCmd, robot->perimeterOutRevTime, 1);
-    else if (pfodCmd.startsWith("e16")) processSlider(pfodCmd, robot->perimeterTrackRollTime, 1);
-    else if (pfodCmd.startsWith("e17")) processSlider(pfodCmd, robot->perimeterTrackRevTime, 1);
-    else if (pfodCmd.startsWith("e07")) processPIDSlider(pfodCmd, "e07", robot->perimeterPID, 0.1, 100);    
-    else if (pfodCmd.startsWith("e08")) processSlider(pfodCmd, robot->perimeter.timedOutIfBelowSmag, 1);    
-    //else if (pfodCmd.startsWith("e09")) robot->perimeter.useDifferentialPerimeterSignal = !robot->perimeter.useDifferentialPerimeterSignal;
-    else if (pfodCmd.startsWith("e10")) robot->perimeter.swapCoilPolarity = !robot->perimeter.swapCoilPolarity;
+void RemoteControl::processPerimeterMenu(const String &pfodCmd){        
+	if (processMenuItems(perimeterMenuItems, sizeof perimeterMenuItems / sizeof perimeterMenuItems[0])) {}
     else if (pfodCmd.startsWith("e11")) processSlider(pfodCmd, robot->trackingPerimeterTransitionTimeOut, 1);
     else if (pfodCmd.startsWith("e12")) processSlider(pfodCmd, robot->trackingErrorTimeOut, 1);
-    else if (pfodCmd.startsWith("e13")) robot->trackingBlockInnerWheelWhilePerimeterStruggling = !robot->trackingBlockInnerWheelWhilePerimeterStruggling;          
-    else if (pfodCmd.startsWith("e14")) processSlider(pfodCmd, robot->perimeter.timeOutSecIfNotInside, 1);     
     else if (pfodCmd.startsWith("e19")) robot->setNextState(STATE_OFF, 0);          
 		else if (pfodCmd.startsWith("e20")) robot->setNextState(STATE_PERI_FIND, 0);                      
 		else if (pfodCmd.startsWith("e21")) robot->setNextState(STATE_PERI_TRACK, 0);                          
+    else if (pfodCmd == "e26") robot->localizer.clearWire();
   sendPerimeterMenu(true);
 }
 
+const pfoditem_t lawnSensorMenuItems[] PROGMEM = {
+  {"f00", PFOD_ITEM_YESNO, SETTING_LAWN_SENSOR_USE, "Use"},
+};
+
 void RemoteControl::sendLawnSensorMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Lawn sensor`1000"));
-  serialPort->print(F("|f00~Use "));
-  sendYesNo(robot->lawnSensorUse);  
+  sendMenuItems(lawnSensorMenuItems, sizeof lawnSensorMenuItems / sizeof lawnSensorMenuItems[0], update);
   serialPort->print(F("|f01~Counter "));
   serialPort->print(robot->lawnSensorCounter);
   serialPort->println(F("|f02~Value f, b"));
@@ -595,15 +726,18 @@ void RemoteControl::sendLawnSensorMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processLawnSensorMenu(String pfodCmd){      
-  if (pfodCmd == "f00") robot->lawnSensorUse = !robot->lawnSensorUse;
+void RemoteControl::processLawnSensorMenu(const String &pfodCmd){      
+  processMenuItems(lawnSensorMenuItems, sizeof lawnSensorMenuItems / sizeof lawnSensorMenuItems[0]);
   sendLawnSensorMenu(true);
 }
 
+const pfoditem_t rainMenuItems[] PROGMEM = {
+  {"m00", PFOD_ITEM_YESNO, SETTING_RAIN_USE, "Use"},
+};
+
 void RemoteControl::sendRainMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Rain`1000"));
-  serialPort->print(F("|m00~Use "));
-  sendYesNo(robot->rainUse);  
+  sendMenuItems(rainMenuItems, sizeof rainMenuItems / sizeof rainMenuItems[0], update);
   serialPort->print(F("|m01~Counter "));
   serialPort->print(robot->rainCounter);
   serialPort->println(F("|m02~Value"));
@@ -611,32 +745,44 @@ void RemoteControl::sendRainMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processRainMenu(String pfodCmd){      
-  if (pfodCmd == "m00") robot->rainUse = !robot->rainUse;
+void RemoteControl::processRainMenu(const String &pfodCmd){      
+  processMenuItems(rainMenuItems, sizeof rainMenuItems / sizeof rainMenuItems[0]);
   sendRainMenu(true);
 }
 
+const pfoditem_t gpsMenuItems[] PROGMEM = {
+  {"q00", PFOD_ITEM_YESNO,  SETTING_GPS_USE,                  "Use"},
+  {"q01", PFOD_ITEM_SLIDER, SETTING_STUCK_IF_GPS_SPEED_BELOW, "Stuck if GPS speed is below"},
+  {"q03", PFOD_ITEM_YESNO,  SETTING_FUSION_USE,               "Use pose fusion"},
+};
+
 void RemoteControl::sendGPSMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.GPS`1000"));
-  serialPort->print(F("|q00~Use "));
-  sendYesNo(robot->gpsUse);
-  sendSlider("q01", F("Stuck if GPS speed is below"), robot->stuckIfGpsSpeedBelow, "", 0.1, 3); 
-  sendSlider("q02", F("GPS speed ignore time"), robot->gpsSpeedIgnoreTime, "", 1, 10000, robot->motorReverseTime);       
+  sendMenuItems(gpsMenuItems, sizeof gpsMenuItems / sizeof gpsMenuItems[0], update);
+  sendSlider("q02", F("GPS speed ignore time"), robot->gpsSpeedIgnoreTime, 1, 10000, robot->motorReverseTime);       
   serialPort->println("}");
 }
 
-void RemoteControl::processGPSMenu(String pfodCmd){      
-  if (pfodCmd == "q00") robot->gpsUse = !robot->gpsUse;
-  else if (pfodCmd.startsWith("q01")) processSlider(pfodCmd, robot->stuckIfGpsSpeedBelow, 0.1);  
+void RemoteControl::processGPSMenu(const String &pfodCmd){      
+  if (processMenuItems(gpsMenuItems, sizeof gpsMenuItems / sizeof gpsMenuItems[0])) {}
   else if (pfodCmd.startsWith("q02")) processSlider(pfodCmd, robot->gpsSpeedIgnoreTime, 1);  
   sendGPSMenu(true);
 }
 
 
+const pfoditem_t imuMenuItems[] PROGMEM = {
+  {"g00", PFOD_ITEM_YESNO,   SETTING_IMU_USE,         "Use"},
+  {"g04", PFOD_ITEM_YESNO,   SETTING_IMU_CORRECT_DIR, "Correct dir"},
+  {"g05p", PFOD_ITEM_SLIDER, SETTING_IMU_DIR_PID_KP,  "Dir_P"},
+  {"g05i", PFOD_ITEM_SLIDER, SETTING_IMU_DIR_PID_KI,  "Dir_I"},
+  {"g05d", PFOD_ITEM_SLIDER, SETTING_IMU_DIR_PID_KD,  "Dir_D"},
+  {"g06p", PFOD_ITEM_SLIDER, SETTING_IMU_ROLL_PID_KP, "Roll_P"},
+  {"g06i", PFOD_ITEM_SLIDER, SETTING_IMU_ROLL_PID_KI, "Roll_I"},
+  {"g06d", PFOD_ITEM_SLIDER, SETTING_IMU_ROLL_PID_KD, "Roll_D"},
+};
+
 void RemoteControl::sendImuMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.IMU`1000"));
-  serialPort->print(F("|g00~Use "));
-  sendYesNo(robot->imuUse);
   serialPort->print(F("|g01~Yaw "));
   serialPort->print(robot->imu.ypr.yaw/PI*180);
   serialPort->print(F(" deg"));
@@ -649,114 +795,101 @@ void RemoteControl::sendImuMenu(boolean update){
   serialPort->print(F("|g03~Roll "));
   serialPort->print(robot->imu.ypr.roll/PI*180);
   serialPort->print(F(" deg"));
-  serialPort->print(F("|g04~Correct dir "));
-  sendYesNo(robot->imuCorrectDir);  
-  sendPIDSlider("g05", F("Dir"), robot->imuDirPID, 0.1, 20);
-  sendPIDSlider("g06", F("Roll"), robot->imuRollPID, 0.1, 30);    
+  sendMenuItems(imuMenuItems, sizeof imuMenuItems / sizeof imuMenuItems[0], update);
   serialPort->print(F("|g07~Acc cal next side"));
   serialPort->print(F("|g08~Com cal start/stop"));
   serialPort->println("}");
 }
 
-void RemoteControl::processImuMenu(String pfodCmd){      
-  if (pfodCmd == "g00" ) robot->imuUse = !robot->imuUse;
-    else if (pfodCmd == "g04" ) robot->imuCorrectDir = !robot->imuCorrectDir;
-    else if (pfodCmd.startsWith("g05")) processPIDSlider(pfodCmd, "g05", robot->imuDirPID, 0.1, 20);    
-    else if (pfodCmd.startsWith("g06")) processPIDSlider(pfodCmd, "g06", robot->imuRollPID, 0.1, 30);    
+void RemoteControl::processImuMenu(const String &pfodCmd){      
+  if (processMenuItems(imuMenuItems, sizeof imuMenuItems / sizeof imuMenuItems[0])) {}
     else if (pfodCmd == "g07") robot->imu.calibAccNextAxis();
     else if (pfodCmd == "g08") robot->imu.calibComStartStop();
   sendImuMenu(true);
 }
 
+const pfoditem_t remoteMenuItems[] PROGMEM = {
+  {"h00", PFOD_ITEM_YESNO, SETTING_REMOTE_USE, "Use"},
+};
+
 void RemoteControl::sendRemoteMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Remote R/C`1000"));
-  serialPort->print(F("|h00~Use "));
-  sendYesNo(robot->remoteUse);  
+  sendMenuItems(remoteMenuItems, sizeof remoteMenuItems / sizeof remoteMenuItems[0], update);
   serialPort->println("}");
 }
 
-void RemoteControl::processRemoteMenu(String pfodCmd){      
-  if (pfodCmd == "h00" ) robot->remoteUse = !robot->remoteUse;    
+void RemoteControl::processRemoteMenu(const String &pfodCmd){      
+  processMenuItems(remoteMenuItems, sizeof remoteMenuItems / sizeof remoteMenuItems[0]);
   sendRemoteMenu(true);
 }
 
+const pfoditem_t batteryMenuItems[] PROGMEM = {
+  {"j01", PFOD_ITEM_YESNO,  SETTING_BAT_MONITOR,          "Monitor"},
+  {"j09", PFOD_ITEM_SLIDER | PFOD_ITEM_DEVELOPER, SETTING_BAT_CHG_FACTOR, "Calibrate batChgFactor"},
+  {"j05", PFOD_ITEM_SLIDER | PFOD_ITEM_DEVELOPER, SETTING_BAT_FACTOR,     "Calibrate batFactor "},
+  {"j12", PFOD_ITEM_SLIDER, SETTING_BAT_SWITCH_OFF_IF_IDLE, "Switch off if idle minutes"},
+  {"j08", PFOD_ITEM_SLIDER, SETTING_CHG_FACTOR,           "Charge factor"},
+};
+
 void RemoteControl::sendBatteryMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Battery`1000"));
   serialPort->print(F("|j00~Battery "));
   serialPort->print(robot->batVoltage);
   serialPort->print(" V");
-  serialPort->print(F("|j01~Monitor "));
-  sendYesNo(robot->batMonitor);
-  
-  //bb remove
-  //if (robot->developerActive) sendSlider("j05", F("Calibrate batFactor "), robot->batFactor, "", 0.01, 1.0);   
-  //bb remove end
-  //bb add
-  if (robot->developerActive)
-  {
-    sendSlider("j09", F("Calibrate batChgFactor"), robot->batChgFactor, "", 0.001, 0.30, 0.55);
-    sendSlider("j05", F("Calibrate batFactor "), robot->batFactor, "", 0.001, 0.30, 0.55);
-  }
-  //end add
-  
-  //Console.print("batFactor=");
-  //Console.println(robot->batFactor);   
-  sendSlider("j02", F("Go home if below Volt"), robot->batGoHomeIfBelow, "", 0.1, robot->batFull, (robot->batFull*0.72));  // for Sony Konion cells 4.2V * 0,72= 3.024V which is pretty safe to use 
-  sendSlider("j12", F("Switch off if idle minutes"), robot->batSwitchOffIfIdle, "", 1, 300, 1);  
-  sendSlider("j03", F("Switch off if below Volt"), robot->batSwitchOffIfBelow, "", 0.1, robot->batFull, (robot->batFull*0.72));  
   serialPort->print(F("|j04~Charge "));
   serialPort->print(robot->chgVoltage);
   serialPort->print("V ");
   serialPort->print(robot->chgCurrent);
   serialPort->print("A");
-  sendSlider("j08", F("Charge factor"), robot->chgFactor, "", 0.001, 0.01, 0.06);       
-  sendSlider("j10", F("charging starts if Voltage is below"), robot->startChargingIfBelow, "", 0.1, robot->batFull);       
-  sendSlider("j11", F("Battery is fully charged if current is below"), robot->batFullCurrent, "", 0.1, robot->batChargingCurrentMax);       
+  sendMenuItems(batteryMenuItems, sizeof batteryMenuItems / sizeof batteryMenuItems[0], update);
+  // ranges depend on the battery type
+  sendSlider("j02", F("Go home if below Volt"), robot->batGoHomeIfBelow, 0.1, robot->batFull, (robot->batFull*0.72));  // for Sony Konion cells 4.2V * 0,72= 3.024V which is pretty safe to use 
+  sendSlider("j03", F("Switch off if below Volt"), robot->batSwitchOffIfBelow, 0.1, robot->batFull, (robot->batFull*0.72));  
+  sendSlider("j10", F("charging starts if Voltage is below"), robot->startChargingIfBelow, 0.1, robot->batFull);       
+  sendSlider("j11", F("Battery is fully charged if current is below"), robot->batFullCurrent, 0.1, robot->batChargingCurrentMax);       
   serialPort->println("}");
 }
 
-void RemoteControl::processBatteryMenu(String pfodCmd){      
-  if (pfodCmd == "j01") robot->batMonitor = !robot->batMonitor;
-    else if (pfodCmd.startsWith("j02")) {
-      processSlider(pfodCmd, robot->batGoHomeIfBelow, 0.1);
-      //Console.print("gohomeifbelow=");
-      //Console.println(robot->batGoHomeIfBelow);
-    }
+void RemoteControl::processBatteryMenu(const String &pfodCmd){      
+  if (processMenuItems(batteryMenuItems, sizeof batteryMenuItems / sizeof batteryMenuItems[0])) {}
+    else if (pfodCmd.startsWith("j02")) processSlider(pfodCmd, robot->batGoHomeIfBelow, 0.1);
     else if (pfodCmd.startsWith("j03")) processSlider(pfodCmd, robot->batSwitchOffIfBelow, 0.1); 
-    //bb change
-    //else if (pfodCmd.startsWith("j05")) processSlider(pfodCmd, robot->batFactor, 0.01);
-    else if (pfodCmd.startsWith("j05")) processSlider(pfodCmd, robot->batFactor, 0.001);    
-    else if (pfodCmd.startsWith("j08")) processSlider(pfodCmd, robot->chgFactor, 0.001);    
-    //bb change
-    //else if (pfodCmd.startsWith("j09")) processSlider(pfodCmd, robot->batChgFactor, 0.01);
-    else if (pfodCmd.startsWith("j09")) processSlider(pfodCmd, robot->batChgFactor, 0.001);
     else if (pfodCmd.startsWith("j10")) processSlider(pfodCmd, robot->startChargingIfBelow, 0.1);
     else if (pfodCmd.startsWith("j11")) processSlider(pfodCmd, robot->batFullCurrent, 0.1);
-    else if (pfodCmd.startsWith("j12")) processSlider(pfodCmd, robot->batSwitchOffIfIdle, 1);
   sendBatteryMenu(true);
 }
 
+const pfoditem_t stationMenuItems[] PROGMEM = {
+  {"k00", PFOD_ITEM_SLIDER, SETTING_STATION_REV_TIME,   "Reverse time"},
+  {"k01", PFOD_ITEM_SLIDER, SETTING_STATION_ROLL_TIME,  "Roll time"},
+  {"k02", PFOD_ITEM_SLIDER, SETTING_STATION_FORW_TIME,  "Forw time"},
+  {"k03", PFOD_ITEM_SLIDER, SETTING_STATION_CHECK_TIME, "Station reverse check time"},
+};
+
 void RemoteControl::sendStationMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Station`1000"));
-  sendSlider("k00", F("Reverse time"), robot->stationRevTime, "", 1, 8000);     
-  sendSlider("k01", F("Roll time"), robot->stationRollTime, "", 1, 8000);       
-  sendSlider("k02", F("Forw time"), robot->stationForwTime, "", 1, 8000);         
-  sendSlider("k03", F("Station reverse check time"), robot->stationCheckTime, "", 1, 8000);         
+  sendMenuItems(stationMenuItems, sizeof stationMenuItems / sizeof stationMenuItems[0], update);
   serialPort->println("}");
 }
 
-void RemoteControl::processStationMenu(String pfodCmd){      
-  if (pfodCmd.startsWith("k00")) processSlider(pfodCmd, robot->stationRevTime, 1);
-    else if (pfodCmd.startsWith("k01")) processSlider(pfodCmd, robot->stationRollTime, 1);
-    else if (pfodCmd.startsWith("k02")) processSlider(pfodCmd, robot->stationForwTime, 1);
-    else if (pfodCmd.startsWith("k03")) processSlider(pfodCmd, robot->stationCheckTime, 1);
+void RemoteControl::processStationMenu(const String &pfodCmd){      
+  processMenuItems(stationMenuItems, sizeof stationMenuItems / sizeof stationMenuItems[0]);
   sendStationMenu(true);
 }
 
+const pfoditem_t odometryMenuItems[] PROGMEM = {
+  {"l00", PFOD_ITEM_YESNO,   SETTING_ODOMETRY_USE,            "Use"},
+  {"l06", PFOD_ITEM_SLIDER,  SETTING_MOTOR_SPEED_MAX_RPM,     "Speed max in rpm"},
+  {"l07p", PFOD_ITEM_SLIDER, SETTING_MOTOR_LEFT_PID_KP,       "RPM_P"},
+  {"l07i", PFOD_ITEM_SLIDER, SETTING_MOTOR_LEFT_PID_KI,       "RPM_I"},
+  {"l07d", PFOD_ITEM_SLIDER, SETTING_MOTOR_LEFT_PID_KD,       "RPM_D"},
+  {"l04", PFOD_ITEM_SLIDER,  SETTING_ODOMETRY_TICKS_PER_REVOLUTION, "Ticks per one full revolution"},
+  {"l01", PFOD_ITEM_SLIDER,  SETTING_ODOMETRY_TICKS_PER_CM,   "Ticks per cm"},
+  {"l02", PFOD_ITEM_SLIDER,  SETTING_ODOMETRY_WHEEL_BASE_CM,  "Wheel base cm"},
+};
+
 void RemoteControl::sendOdometryMenu(boolean update){
   if (update) serialPort->print("{:"); else serialPort->print(F("{.Odometry2D`1000"));
-  serialPort->print(F("|l00~Use "));
-  sendYesNo(robot->odometryUse);  
   serialPort->print(F("|l01~Value l, r "));
   serialPort->print(robot->odometryLeft);
   serialPort->print(", ");
@@ -765,11 +898,7 @@ void RemoteControl::sendOdometryMenu(boolean update){
   serialPort->print(robot->motorLeftRpmCurr);
   serialPort->print(", ");
   serialPort->println(robot->motorRightRpmCurr);
-  sendSlider("l06", F("Speed max in rpm"), robot->motorSpeedMaxRpm, "", 1, 100);    
-  sendPIDSlider("l07", "RPM", robot->motorLeftPID, 0.01, 3.0);        
-  sendSlider("l04", F("Ticks per one full revolution"), robot->odometryTicksPerRevolution, "", 1, 2120);       
-  sendSlider("l01", F("Ticks per cm"), robot->odometryTicksPerCm, "", 0.1, 35);       
-  sendSlider("l02", F("Wheel base cm"), robot->odometryWheelBaseCm, "", 0.1, 50);    
+  sendMenuItems(odometryMenuItems, sizeof odometryMenuItems / sizeof odometryMenuItems[0], update);
 	serialPort->println(F("|l05~Testing is"));
   switch (testmode){
     case 0: serialPort->print(F("OFF")); break;
@@ -780,13 +909,8 @@ void RemoteControl::sendOdometryMenu(boolean update){
 }
 
 
-void RemoteControl::processOdometryMenu(String pfodCmd){      
-  if (pfodCmd == "l00") robot->odometryUse = !robot->odometryUse;
-    else if (pfodCmd.startsWith("l01")) processSlider(pfodCmd, robot->odometryTicksPerCm, 0.1);
-    else if (pfodCmd.startsWith("l02")) processSlider(pfodCmd, robot->odometryWheelBaseCm, 0.1); 
-    else if (pfodCmd.startsWith("l04")) processSlider(pfodCmd, robot->odometryTicksPerRevolution, 1);    
-    //else if (pfodCmd.startsWith("l08")) robot->twoWayOdometrySensorUse = !robot->twoWayOdometrySensorUse;    
-    else if (pfodCmd == "l05") { 
+void RemoteControl::processOdometryMenu(const String &pfodCmd){      
+  if (pfodCmd == "l05") { 
       testmode = (testmode + 1) % 3;
       switch (testmode){
         case 0: robot->setNextState(STATE_OFF,0); break;
@@ -794,8 +918,7 @@ void RemoteControl::processOdometryMenu(String pfodCmd){
         case 2: robot->setNextState(STATE_MANUAL,0); robot->motorLeftSpeedRpmSet  = 0; robot->motorRightSpeedRpmSet = robot->motorSpeedMaxRpm; break;      
       }
     }
-    else if (pfodCmd.startsWith("l06")) processSlider(pfodCmd, robot->motorSpeedMaxRpm, 1);
-    else if (pfodCmd.startsWith("l07")) processPIDSlider(pfodCmd, "l07", robot->motorLeftPID, 0.01, 3.0);
+    else processMenuItems(odometryMenuItems, sizeof odometryMenuItems / sizeof odometryMenuItems[0]);
   sendOdometryMenu(true);
 }
 
@@ -805,16 +928,16 @@ void RemoteControl::sendDateTimeMenu(boolean update){
   serialPort->print(date2str(robot->datetime.date));
   serialPort->print(", ");
   serialPort->print(time2str(robot->datetime.time));
-  sendSlider("t01", dayOfWeek[robot->datetime.date.dayOfWeek], robot->datetime.date.dayOfWeek, "", 1, 6, 0);       
-  sendSlider("t02", "Day ", robot->datetime.date.day, "", 1, 31, 1);       
-  sendSlider("t03", "Month ", robot->datetime.date.month, "", 1, 12, 1);       
-  sendSlider("t04", "Year ", robot->datetime.date.year, "", 1, 2020, 2013);       
-  sendSlider("t05", "Hour ", robot->datetime.time.hour, "", 1, 23, 0);       
-  sendSlider("t06", "Minute ", robot->datetime.time.minute, "", 1, 59, 0);           
+  sendSlider("t01", dayOfWeek[robot->datetime.date.dayOfWeek], robot->datetime.date.dayOfWeek, 1, 6, 0);       
+  sendSlider("t02", F("Day "), robot->datetime.date.day, 1, 31, 1);       
+  sendSlider("t03", F("Month "), robot->datetime.date.month, 1, 12, 1);       
+  sendSlider("t04", F("Year "), robot->datetime.date.year, 1, 2020, 2013);       
+  sendSlider("t05", F("Hour "), robot->datetime.time.hour, 1, 23, 0);       
+  sendSlider("t06", F("Minute "), robot->datetime.time.minute, 1, 59, 0);           
   serialPort->println("}");
 }
 
-void RemoteControl::processDateTimeMenu(String pfodCmd){      
+void RemoteControl::processDateTimeMenu(const String &pfodCmd){      
   if (pfodCmd.startsWith("t01")) processSlider(pfodCmd, robot->datetime.date.dayOfWeek, 1);    
     else if (pfodCmd.startsWith("t02")) processSlider(pfodCmd, robot->datetime.date.day, 1);
     else if (pfodCmd.startsWith("t03")) processSlider(pfodCmd, robot->datetime.date.month, 1);
@@ -835,11 +958,12 @@ void RemoteControl::sendTimerDetailMenu(int timerIdx, boolean update){
   sendYesNo(robot->timer[timerIdx].active);        
   int startm = time2minutes(robot->timer[timerIdx].startTime);
   int stopm = time2minutes(robot->timer[timerIdx].stopTime);
-  String sidx = String(timerIdx);
-  sendSlider("p1"+sidx, F("Start hour "), robot->timer[timerIdx].startTime.hour, "", 1, 23, 0);       
-  sendSlider("p2"+sidx, F("Start minute "), robot->timer[timerIdx].startTime.minute, "", 1, 59, 0);         
-  sendSlider("p3"+sidx, F("Stop hour "), robot->timer[timerIdx].stopTime.hour, "", 1, 23, 0);       
-  sendSlider("p4"+sidx, F("Stop minute "), robot->timer[timerIdx].stopTime.minute, "", 1, 59, 0);             
+  char cmd[] = "p10";
+  cmd[2] = '0' + timerIdx;
+  cmd[1] = '1'; sendSlider(cmd, F("Start hour "), robot->timer[timerIdx].startTime.hour, 1, 23, 0);       
+  cmd[1] = '2'; sendSlider(cmd, F("Start minute "), robot->timer[timerIdx].startTime.minute, 1, 59, 0);         
+  cmd[1] = '3'; sendSlider(cmd, F("Stop hour "), robot->timer[timerIdx].stopTime.hour, 1, 23, 0);       
+  cmd[1] = '4'; sendSlider(cmd, F("Stop minute "), robot->timer[timerIdx].stopTime.minute, 1, 59, 0);             
   for (int i=0; i < 7; i++){
     serialPort->print("|p5");
     serialPort->print(timerIdx);
@@ -855,7 +979,7 @@ void RemoteControl::sendTimerDetailMenu(int timerIdx, boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processTimerDetailMenu(String pfodCmd){      
+void RemoteControl::processTimerDetailMenu(const String &pfodCmd){      
   timehm_t time;
   boolean checkStop = false;
   boolean checkStart = false;
@@ -911,7 +1035,7 @@ void RemoteControl::sendTimerMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processTimerMenu(String pfodCmd){      
+void RemoteControl::processTimerMenu(const String &pfodCmd){      
   if (pfodCmd.startsWith("i0")) {
     int timerIdx = pfodCmd[2]-'0';
     sendTimerDetailMenu(timerIdx, false);  
@@ -927,7 +1051,7 @@ void RemoteControl::sendFactorySettingsMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processFactorySettingsMenu(String pfodCmd){      
+void RemoteControl::processFactorySettingsMenu(const String &pfodCmd){      
   if (pfodCmd == "x0") robot->deleteUserSettings();
   sendFactorySettingsMenu(true);
 }
@@ -962,6 +1086,23 @@ void RemoteControl::sendInfoMenu(boolean update){
   serialPort->print(robot->statsBatteryChargingCapacityTotal / 1000);    
   serialPort->print(F("|v08~Battery recharged capacity average (mAh)"));
   serialPort->print(robot->statsBatteryChargingCapacityAverage);        
+  // loop stages with highest CPU time (avg/max us, cpu%)
+  uint8_t ids[8];
+  uint8_t count = robot->profiler.topStages(ids, 8);
+  serialPort->print(F("|v09~Profiler reset"));
+  for (uint8_t i=0; i < count; i++){
+    serialPort->print(F("|vp"));
+    serialPort->print(i);
+    serialPort->print("~");
+    serialPort->print(robot->profiler.getName(ids[i]));
+    serialPort->print(" ");
+    serialPort->print(robot->profiler.getAvgUs(ids[i]));
+    serialPort->print("/");
+    serialPort->print(robot->profiler.getMaxUs(ids[i]));
+    serialPort->print(F(" us "));
+    serialPort->print(((float)robot->profiler.getLoadPermille(ids[i]))/10.0, 1);
+    serialPort->print("%");
+  }
   //serialPort->print("|d01~Perimeter v");
   //serialPort->print(verToString(readPerimeterVer()));
   //serialPort->print("|d02~IMU v");
@@ -971,9 +1112,10 @@ void RemoteControl::sendInfoMenu(boolean update){
   serialPort->println("}");
 }
 
-void RemoteControl::processInfoMenu(String pfodCmd){      
+void RemoteControl::processInfoMenu(const String &pfodCmd){      
   if (pfodCmd == "v01") robot->developerActive = !robot->developerActive;
   if (pfodCmd == "v04") robot->statsOverride = !robot->statsOverride; robot->saveUserSettings();
+  if (pfodCmd == "v09") robot->profiler.reset();
 
   sendInfoMenu(true);
 }
@@ -1004,7 +1146,7 @@ void RemoteControl::sendCommandMenu(boolean update){
   serialPort->println();
 }
 
-void RemoteControl::processCommandMenu(String pfodCmd){
+void RemoteControl::processCommandMenu(const String &pfodCmd){
   if (pfodCmd == "ro"){
     // cmd: off      
     robot->setNextState(STATE_OFF, 0);          
@@ -1042,6 +1184,7 @@ void RemoteControl::processCommandMenu(String pfodCmd){
   } else if (pfodCmd == "rp"){
     // cmd: pattern
     robot->mowPatternCurr = (robot->mowPatternCurr + 1 ) % 3;      
+    robot->lanePlanner.stop();
     robot->setNextState(STATE_OFF, 0);            
     sendCommandMenu(true);
   } else if (pfodCmd == "r1"){
@@ -1079,7 +1222,7 @@ void RemoteControl::sendCompassMenu(boolean update){
   serialPort->println(F("|cs~South|cm~Mow}"));
 }
 
-void RemoteControl::processCompassMenu(String pfodCmd){
+void RemoteControl::processCompassMenu(const String &pfodCmd){
  if (pfodCmd == "cm"){
     robot->motorMowEnable = !robot->motorMowEnable;            
     sendCompassMenu(true);
@@ -1102,7 +1245,7 @@ void RemoteControl::processCompassMenu(String pfodCmd){
   }
 }
 
-void RemoteControl::processManualMenu(String pfodCmd){
+void RemoteControl::processManualMenu(const String &pfodCmd){
   if (pfodCmd == "nl"){
     // manual: left
     robot->setNextState(STATE_MANUAL, 0);          
@@ -1145,22 +1288,23 @@ void RemoteControl::processManualMenu(String pfodCmd){
   }  
 }
 
-void RemoteControl::processSettingsMenu(String pfodCmd){   
-  if (pfodCmd == "s1") sendMotorMenu(false);
-      else if (pfodCmd == "s2") sendMowMenu(false);
-      else if (pfodCmd == "s3") sendBumperMenu(false);
-      else if (pfodCmd == "s4") sendSonarMenu(false);
-      else if (pfodCmd == "s5") sendPerimeterMenu(false);
-      else if (pfodCmd == "s6") sendLawnSensorMenu(false);
-      else if (pfodCmd == "s7") sendImuMenu(false);
-      else if (pfodCmd == "s8") sendRemoteMenu(false);
-      else if (pfodCmd == "s9") sendBatteryMenu(false);
-      else if (pfodCmd == "s10") sendStationMenu(false);
-      else if (pfodCmd == "s11") sendOdometryMenu(false);
+// settings sub menus: a re-request of the menu shown (pfodApp refresh) is answered with an update
+void RemoteControl::processSettingsMenu(const String &pfodCmd){   
+  if (pfodCmd == "s1") sendMotorMenu(shownMenuItems == motorMenuItems);
+      else if (pfodCmd == "s2") sendMowMenu(shownMenuItems == mowMenuItems);
+      else if (pfodCmd == "s3") sendBumperMenu(shownMenuItems == bumperMenuItems);
+      else if (pfodCmd == "s4") sendSonarMenu(shownMenuItems == sonarMenuItems);
+      else if (pfodCmd == "s5") sendPerimeterMenu(shownMenuItems == perimeterMenuItems);
+      else if (pfodCmd == "s6") sendLawnSensorMenu(shownMenuItems == lawnSensorMenuItems);
+      else if (pfodCmd == "s7") sendImuMenu(shownMenuItems == imuMenuItems);
+      else if (pfodCmd == "s8") sendRemoteMenu(shownMenuItems == remoteMenuItems);
+      else if (pfodCmd == "s9") sendBatteryMenu(shownMenuItems == batteryMenuItems);
+      else if (pfodCmd == "s10") sendStationMenu(shownMenuItems == stationMenuItems);
+      else if (pfodCmd == "s11") sendOdometryMenu(shownMenuItems == odometryMenuItems);
       else if (pfodCmd == "s12") sendDateTimeMenu(false);      
-      else if (pfodCmd == "s13") sendRainMenu(false);            
-      else if (pfodCmd == "s15") sendDropMenu(false);
-      else if (pfodCmd == "s14") sendGPSMenu(false);
+      else if (pfodCmd == "s13") sendRainMenu(shownMenuItems == rainMenuItems);            
+      else if (pfodCmd == "s15") sendDropMenu(shownMenuItems == dropMenuItems);
+      else if (pfodCmd == "s14") sendGPSMenu(shownMenuItems == gpsMenuItems);
       else if (pfodCmd == "sx") sendFactorySettingsMenu(false);
       else if (pfodCmd == "sz") { robot->saveUserSettings(); sendSettingsMenu(true); }
       else sendSettingsMenu(true);  
@@ -1440,6 +1584,8 @@ bool RemoteControl::readSerial(){
       Console.print("pfod cmd=");
       Console.println(pfodCmd);
       pfodState = PFOD_MENU;    
+      shownMenuItems = menuItems;
+      menuItems = NULL;
       if (pfodCmd == ".") sendMainMenu(false);      
         else if (pfodCmd == "m1") {
           // log raw sensors
@@ -1515,6 +1661,8 @@ bool RemoteControl::readSerial(){
           nextPlotTime = 0;
           pfodState = PFOD_PLOT_MOTOR;
         }              
+        else if (pfodCmd == "y12") sendTelemetryMenu(false);
+        else if (pfodCmd.startsWith("yt")) processTelemetryMenu(pfodCmd);
         else if (pfodCmd == "yp") sendPlotMenu(false);
         else if (pfodCmd == "y4")sendErrorMenu(false);
         else if (pfodCmd == "y9")sendADCMenu(false);
@@ -41,12 +41,30 @@
 #include "drivers.h"
 #include "pid.h"
 #include "perimeter.h"
+#include "telemetry.h"
+#include "usersettings.h"
 
 // pfodApp state
 enum { PFOD_OFF, PFOD_MENU, PFOD_LOG_SENSORS, 
        PFOD_PLOT_BAT, PFOD_PLOT_ODO2D, PFOD_PLOT_IMU, PFOD_PLOT_SENSOR_COUNTERS, 
        PFOD_PLOT_SENSORS, PFOD_PLOT_PERIMETER, PFOD_PLOT_GPS, PFOD_PLOT_GPS2D,
-       PFOD_PLOT_MOTOR };
+       PFOD_PLOT_MOTOR, PFOD_TELEMETRY };
+
+// menu item bound to a user setting (usersettings.h): value, scale and range are taken from
+// the settings table, menu tables are kept in program memory (see pfod.cpp)
+enum { PFOD_ITEM_YESNO, PFOD_ITEM_SLIDER };
+
+#define PFOD_ITEM_DEVELOPER 0x80       // item type flag: only shown if developer mode is active
+#define PFOD_MENU_ITEMS_MAX 24
+
+struct pfoditem_t {
+  char cmd[5];
+  byte type;
+  uint16_t setting;
+  char title[46];
+};
+
+typedef struct pfoditem_t pfoditem_t;
 
 class Robot;
 
@@ -58,6 +76,9 @@ class RemoteControl
     void initSerial(HardwareSerial* serialPort, uint32_t baudrate);
     bool readSerial();
     void run();    
+    // binary telemetry stream (if started in pfodApp plot menu)
+    void runTelemetry();
+    Telemetry telemetry;
   private:
     HardwareSerial* serialPort;
     Robot *robot;    
@@ -68,23 +89,28 @@ class RemoteControl
     unsigned long nextPlotTime;
     int8_t perimeterCapture[RAW_SIGNAL_SAMPLE_SIZE];
     int perimeterCaptureIdx;        
-    float stringToFloat(String &s);   
+    float sliderValue(const String &result);
 
     // generic
     void sendYesNo(int value);
     void sendOnOff(int value);
 
-    // PID slider
-    void sendPIDSlider(String cmd, String title, PID &pid, double scale, float maxvalue);
-    void processPIDSlider(String result, String cmd, PID &pid, double scale, float maxvalue);
-    
     // generic slider
-    void sendSlider(String cmd, String title, float value, String unit, double scale, float maxvalue, float minvalue = 0);    
-    void processSlider(String result, float &value, double scale);
-    void processSlider(String result, long &value, double scale);
-    void processSlider(String result, int &value, double scale);
-    void processSlider(String result, byte &value, double scale);
-    void processSlider(String result, short &value, double scale);
+    void sendSlider(const char *cmd, const __FlashStringHelper *title, float value, double scale, float maxvalue, float minvalue = 0);
+    void sendSlider(const char *cmd, const char *title, float value, double scale, float maxvalue, float minvalue = 0);
+    void sendSliderValue(float value, double scale, float maxvalue, float minvalue);
+    void processSlider(const String &result, float &value, double scale);
+    void processSlider(const String &result, long &value, double scale);
+    void processSlider(const String &result, int &value, double scale);
+    void processSlider(const String &result, byte &value, double scale);
+    void processSlider(const String &result, short &value, double scale);
+
+    // setting menu items (update: only items changed since the last frame are sent)
+    const pfoditem_t *menuItems;       // table of the menu shown
+    const pfoditem_t *shownMenuItems;  // table shown before the current command (refresh detection)
+    long menuItemSent[PFOD_MENU_ITEMS_MAX];
+    void sendMenuItems(const pfoditem_t *items, byte count, boolean update);
+    boolean processMenuItems(const pfoditem_t *items, byte count);
 
 
     // send timer menu details
@@ -95,15 +121,18 @@ class RemoteControl
     void sendErrorMenu(boolean update);
     void sendInfoMenu(boolean update);
     void sendCommandMenu(boolean update);
-    void processCommandMenu(String pfodCmd);
+    void processCommandMenu(const String &pfodCmd);
     void sendManualMenu(boolean update);
     void sendCompassMenu(boolean update);
-    void processCompassMenu(String pfodCmd);
-    void processManualMenu(String pfodCmd);
-    void processSettingsMenu(String pfodCmd);      
+    void processCompassMenu(const String &pfodCmd);
+    void processManualMenu(const String &pfodCmd);
+    void processSettingsMenu(const String &pfodCmd);      
     
     // plotting
     void sendPlotMenu(boolean update);
+    void sendTelemetryMenu(boolean update);
+    void processTelemetryMenu(const String &pfodCmd);
+    long telemetryRaw(byte ch);
     
     // settings
     void sendSettingsMenu(boolean update);
@@ -125,30 +154,30 @@ class RemoteControl
     void sendFactorySettingsMenu(boolean update);    
     void sendADCMenu(boolean update);
     
-    void processMotorMenu(String pfodCmd);    
-    void processErrorMenu(String pfodCmd);        
-    void processMowMenu(String pfodCmd);
-    void processBumperMenu(String pfodCmd);
-    void processSonarMenu(String pfodCmd);    
-    void processPerimeterMenu(String pfodCmd); 
-    void processLawnSensorMenu(String pfodCmd);   
-    void processRainMenu(String pfodCmd);       
-    void processDropMenu(String pfodCmd);    
-    void processGPSMenu(String pfodCmd);           
-    void processImuMenu(String pfodCmd);         
-    void processRemoteMenu(String pfodCmd);      
-    void processBatteryMenu(String pfodCmd);
-    void processStationMenu(String pfodCmd);
-    void processOdometryMenu(String pfodCmd);      
-    void processDateTimeMenu(String pfodCmd);
-    void processFactorySettingsMenu(String pfodCmd); 
-    void processInfoMenu(String pfodCmd);
+    void processMotorMenu(const String &pfodCmd);    
+    void processErrorMenu(const String &pfodCmd);        
+    void processMowMenu(const String &pfodCmd);
+    void processBumperMenu(const String &pfodCmd);
+    void processSonarMenu(const String &pfodCmd);    
+    void processPerimeterMenu(const String &pfodCmd); 
+    void processLawnSensorMenu(const String &pfodCmd);   
+    void processRainMenu(const String &pfodCmd);       
+    void processDropMenu(const String &pfodCmd);    
+    void processGPSMenu(const String &pfodCmd);           
+    void processImuMenu(const String &pfodCmd);         
+    void processRemoteMenu(const String &pfodCmd);      
+    void processBatteryMenu(const String &pfodCmd);
+    void processStationMenu(const String &pfodCmd);
+    void processOdometryMenu(const String &pfodCmd);      
+    void processDateTimeMenu(const String &pfodCmd);
+    void processFactorySettingsMenu(const String &pfodCmd); 
+    void processInfoMenu(const String &pfodCmd);
 
     // timer
     void sendTimerDetailMenu(int timerIdx, boolean update);
-    void processTimerDetailMenu(String pfodCmd);    
+    void processTimerDetailMenu(const String &pfodCmd);    
     void sendTimerMenu(boolean update);
-    void processTimerMenu(String pfodCmd);
+    void processTimerMenu(const String &pfodCmd);
               
 };
 
@@ -0,0 +1,188 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "printfmt.h"
+#include <math.h>
+
+
+PGM_P fmtNext(Print &out, PGM_P format, fmtspec_t &spec){
+  // literal text (written in runs)
+  char text[16];
+  uint8_t len = 0;
+  while (true){
+    char ch = pgm_read_byte(format);
+    if ((ch == '%') && (pgm_read_byte(format+1) == '%')) format++;
+      else if ((ch == '%') || (ch == 0)) break;
+    text[len++] = ch;
+    format++;
+    if (len == sizeof text) {
+      out.write((const uint8_t*)text, len);
+      len = 0;
+    }
+  }
+  if (len > 0) out.write((const uint8_t*)text, len);
+  if (pgm_read_byte(format) == 0) return NULL;
+  // conversion: %[flags][width][.precision][length]conv
+  format++;
+  spec.flags = 0;
+  spec.width = 0;
+  spec.precision = -1;
+  char ch;
+  while (true){
+    ch = pgm_read_byte(format);
+    if (ch == '-') spec.flags |= FMT_LEFT;
+      else if (ch == '0') spec.flags |= FMT_ZERO;
+      else break;
+    format++;
+  }
+  while ((ch >= '0') && (ch <= '9')){
+    spec.width = spec.width * 10 + (ch - '0');
+    ch = pgm_read_byte(++format);
+  }
+  if (ch == '.'){
+    spec.precision = 0;
+    ch = pgm_read_byte(++format);
+    while ((ch >= '0') && (ch <= '9')){
+      spec.precision = spec.precision * 10 + (ch - '0');
+      ch = pgm_read_byte(++format);
+    }
+  }
+  while ((ch == 'l') || (ch == 'h')) ch = pgm_read_byte(++format);
+  if (ch == 0) return NULL;
+  spec.conv = ch;
+  if (ch == 'x') spec.flags |= FMT_HEX;
+  return format+1;
+}
+
+// digits (and sign) padded to width
+static void printPadded(Print &out, const char *digits, uint8_t len, bool neg, uint8_t width, uint8_t flags){
+  uint8_t total = len + (neg ? 1 : 0);
+  uint8_t pad = (width > total) ? width - total : 0;
+  if ((flags & FMT_LEFT) == 0){
+    if (flags & FMT_ZERO){
+      if (neg) out.write('-');
+      neg = false;
+      for (; pad > 0; pad--) out.write('0');
+    } else {
+      for (; pad > 0; pad--) out.write(' ');
+    }
+  }
+  if (neg) out.write('-');
+  out.write((const uint8_t*)digits, len);
+  for (; pad > 0; pad--) out.write(' ');
+}
+
+// digits of value (right-aligned in buf), returns the first digit
+static char *toDigits(char *end, unsigned long value, uint8_t base){
+  char *p = end;
+  do {
+    uint8_t d = value % base;
+    *--p = (d < 10) ? '0' + d : 'a' + d - 10;
+    value /= base;
+  } while (value != 0);
+  return p;
+}
+
+static void printNumber(Print &out, unsigned long value, bool neg, uint8_t width, uint8_t flags){
+  char buf[12];
+  char *p = toDigits(buf + sizeof buf, value, (flags & FMT_HEX) ? 16 : 10);
+  printPadded(out, p, buf + sizeof buf - p, neg, width, flags);
+}
+
+void printDec(Print &out, long value, uint8_t width, uint8_t flags){
+  bool neg = (value < 0);
+  printNumber(out, neg ? 0UL - (unsigned long)value : (unsigned long)value, neg, width, flags);
+}
+
+void printUDec(Print &out, unsigned long value, uint8_t width, uint8_t flags){
+  printNumber(out, value, false, width, flags);
+}
+
+void printFixed(Print &out, long value, uint8_t decimals, uint8_t width, uint8_t flags){
+  bool neg = (value < 0);
+  unsigned long v = neg ? 0UL - (unsigned long)value : (unsigned long)value;
+  char buf[14];
+  char *end = buf + sizeof buf;
+  char *p = end;
+  for (uint8_t i=0; i < decimals; i++){
+    *--p = '0' + (v % 10);
+    v /= 10;
+  }
+  if (decimals > 0) *--p = '.';
+  p = toDigits(p, v, 10);
+  printPadded(out, p, end - p, neg, width, flags & ~FMT_HEX);
+}
+
+void printFloat(Print &out, double value, uint8_t decimals, uint8_t width, uint8_t flags){
+  if (decimals > 6) decimals = 6;
+  if (isnan(value) || isinf(value) || (fabs(value) >= 2e9)) {
+    printText(out, isnan(value) ? "nan" : "ovf", width, flags);
+    return;
+  }
+  long scale = 1;
+  for (uint8_t i=0; i < decimals; i++) scale *= 10;
+  double scaled = value * scale;
+  if (fabs(scaled) >= 2e9) {
+    // too large for the fixed-point writer: fewer decimals
+    printFloat(out, value, decimals - 1, width, flags);
+    return;
+  }
+  long v = (long)(scaled + ((scaled < 0) ? -0.5 : 0.5));
+  printFixed(out, v, decimals, width, flags);
+}
+
+void printText(Print &out, const char *text, uint8_t width, uint8_t flags){
+  uint8_t len = strlen(text);
+  uint8_t pad = (width > len) ? width - len : 0;
+  if ((flags & FMT_LEFT) == 0) for (; pad > 0; pad--) out.write(' ');
+  out.write((const uint8_t*)text, len);
+  for (; pad > 0; pad--) out.write(' ');
+}
+
+void fmtArg(Print &out, const fmtspec_t &spec, long value){
+  if (spec.conv == 'f') printFixed(out, value, 0, spec.width, spec.flags);
+    else if (spec.conv == 'c') out.write((char)value);
+    else if ((spec.conv == 'u') || (spec.conv == 'x')) printUDec(out, (unsigned long)value, spec.width, spec.flags);
+    else printDec(out, value, spec.width, spec.flags);
+}
+
+void fmtArg(Print &out, const fmtspec_t &spec, unsigned long value){
+  if (spec.conv == 'c') out.write((char)value);
+    else printUDec(out, value, spec.width, spec.flags);
+}
+
+void fmtArg(Print &out, const fmtspec_t &spec, double value){
+  if ((spec.conv == 'd') || (spec.conv == 'i') || (spec.conv == 'u')) printFloat(out, value, 0, spec.width, spec.flags);
+    else printFloat(out, value, (spec.precision < 0) ? 6 : spec.precision, spec.width, spec.flags);
+}
+
+void fmtArg(Print &out, const fmtspec_t &spec, const char *value){
+  printText(out, (value == NULL) ? "" : value, spec.width, spec.flags);
+}
+
+void fmtArg(Print &out, const fmtspec_t &spec, char value){
+  if (spec.conv == 'c') {
+    char text[2] = { value, 0 };
+    printText(out, text, spec.width, spec.flags);
+  } else printDec(out, value, spec.width, spec.flags);
+}
@@ -0,0 +1,113 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+formatted output without buffers or heap (Streamprint): the format string stays in program memory and
+is written to the Print piece by piece, each argument is written by a writer for its C++ type
+(variadic template), so there is no vsnprintf, no format copy and no result buffer
+
+- conversions: %d %i %u %x %s %c %f %% with flags '-' (left-justify) and '0' (zero pad), width
+  and precision (%f: decimals, default 6, rounded half away from zero), length modifiers (l, h) are accepted and ignored - the
+  argument type decides (e.g. %d with an unsigned long prints the unsigned value)
+- integer writer: digits into a small stack array, then padded; fixed-point writer: float scaled to
+  an integer (no dtostrf)
+- arguments without a conversion are ignored, conversions without an argument are printed as is
+
+How to use it (example):
+  Streamprint(Console, "bat %4.1f V  t%6u\r\n", batVoltage, millis()/1000);
+  printDec(Console, value, 5);                   // width 5
+  printFixed(Console, 253, 1);                   // fixed-point value 25.3
+*/
+
+#ifndef PRINTFMT_H
+#define PRINTFMT_H
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  // host build (simulator)
+  #include <stdint.h>
+  #include "Print.h"
+  #include "avr/pgmspace.h"
+#endif
+
+#define Streamprint(stream,format, ...) streamPrintFmt(stream,PSTR(format),##__VA_ARGS__)
+
+// conversion flags
+#define FMT_LEFT 1
+#define FMT_ZERO 2
+#define FMT_HEX  4
+
+struct fmtspec_t {
+  uint8_t flags;
+  uint8_t width;
+  int8_t precision;      // -1: none
+  char conv;
+};
+
+typedef struct fmtspec_t fmtspec_t;
+
+
+// writes the literal text up to the next conversion and parses it (NULL: end of format)
+PGM_P fmtNext(Print &out, PGM_P format, fmtspec_t &spec);
+
+// writers
+void printDec(Print &out, long value, uint8_t width = 0, uint8_t flags = 0);
+void printUDec(Print &out, unsigned long value, uint8_t width = 0, uint8_t flags = 0);
+// fixed-point value (value / 10^decimals)
+void printFixed(Print &out, long value, uint8_t decimals, uint8_t width = 0, uint8_t flags = 0);
+void printFloat(Print &out, double value, uint8_t decimals, uint8_t width = 0, uint8_t flags = 0);
+void printText(Print &out, const char *text, uint8_t width = 0, uint8_t flags = 0);
+
+void fmtArg(Print &out, const fmtspec_t &spec, long value);
+void fmtArg(Print &out, const fmtspec_t &spec, unsigned long value);
+void fmtArg(Print &out, const fmtspec_t &spec, double value);
+void fmtArg(Print &out, const fmtspec_t &spec, const char *value);
+void fmtArg(Print &out, const fmtspec_t &spec, char value);
+inline void fmtArg(Print &out, const fmtspec_t &spec, int value){ fmtArg(out, spec, (long)value); }
+inline void fmtArg(Print &out, const fmtspec_t &spec, unsigned int value){ fmtArg(out, spec, (unsigned long)value); }
+inline void fmtArg(Print &out, const fmtspec_t &spec, char *value){ fmtArg(out, spec, (const char*)value); }
+
+inline void streamPrintFmt(Print &out, PGM_P format){
+  fmtspec_t spec;
+  while (format != NULL){
+    format = fmtNext(out, format, spec);
+    if (format != NULL) {
+      // conversion without argument
+      out.print('%');
+      out.print(spec.conv);
+    }
+  }
+}
+
+template <typename T, typename... Args>
+void streamPrintFmt(Print &out, PGM_P format, T value, Args... args){
+  fmtspec_t spec;
+  format = fmtNext(out, format, spec);
+  if (format == NULL) return;
+  fmtArg(out, spec, value);
+  streamPrintFmt(out, format, args...);
+}
+
+
+#endif
@@ -0,0 +1,198 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "profiler.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifndef ARDUINO
+  #include <chrono>
+#endif
+
+
+#ifndef ARDUINO
+static uint64_t hostNanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+
+Profiler::Profiler(){
+  memset(stages, 0, sizeof stages);
+  windowStartMillis = 0;
+}
+
+void Profiler::begin(){
+#if defined(ARDUINO) && !defined(__AVR__)
+  // Due: enable DWT cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  reset();
+}
+
+void Profiler::addStage(uint8_t id, const char *name){
+  if (id >= PROF_MAX_STAGES) return;
+  stages[id].name = name;
+}
+
+uint32_t Profiler::ticks(){
+#ifndef ARDUINO
+  return (uint32_t)hostNanos();
+#elif defined(__AVR__)
+  return micros();
+#else
+  return DWT->CYCCNT;
+#endif
+}
+
+uint32_t Profiler::ticksPerUs(){
+#ifndef ARDUINO
+  return 1000;
+#elif defined(__AVR__)
+  return 1;
+#else
+  return F_CPU / 1000000L;
+#endif
+}
+
+uint32_t Profiler::windowMillis(){
+#ifdef ARDUINO
+  return millis() - windowStartMillis;
+#else
+  return (uint32_t)(hostNanos() / 1000000ULL) - windowStartMillis;
+#endif
+}
+
+uint32_t Profiler::binLimitUs(uint8_t bin){
+  if (bin >= PROF_HIST_BINS-1) return 0;
+  return 16UL << (2*bin);
+}
+
+uint32_t Profiler::mark(uint8_t id, uint32_t startTicks){
+  uint32_t now = ticks();
+  record(id, now - startTicks);
+  return now;
+}
+
+void Profiler::record(uint8_t id, uint32_t duration){
+  if (id >= PROF_MAX_STAGES) return;
+  profstage_t &st = stages[id];
+  if ((st.count == 0) || (duration < st.min)) st.min = duration;
+  if (duration > st.max) st.max = duration;
+  st.count++;
+  st.sum += duration;
+  uint32_t us = duration / ticksPerUs();
+  uint8_t bin = 0;
+  while ((bin < PROF_HIST_BINS-1) && (us >= binLimitUs(bin))) bin++;
+  if (st.hist[bin] < 0xFFFF) st.hist[bin]++;
+}
+
+uint32_t Profiler::getCount(uint8_t id){
+  if (id >= PROF_MAX_STAGES) return 0;
+  return stages[id].count;
+}
+
+uint32_t Profiler::getMinUs(uint8_t id){
+  if (id >= PROF_MAX_STAGES) return 0;
+  return stages[id].min / ticksPerUs();
+}
+
+uint32_t Profiler::getAvgUs(uint8_t id){
+  if ((id >= PROF_MAX_STAGES) || (stages[id].count == 0)) return 0;
+  return (uint32_t)(stages[id].sum / stages[id].count / ticksPerUs());
+}
+
+uint32_t Profiler::getMaxUs(uint8_t id){
+  if (id >= PROF_MAX_STAGES) return 0;
+  return stages[id].max / ticksPerUs();
+}
+
+int Profiler::getLoadPermille(uint8_t id){
+  if (id >= PROF_MAX_STAGES) return 0;
+  uint32_t window = windowMillis();
+  if (window == 0) return 0;
+  return (int)(stages[id].sum / ticksPerUs() / window);
+}
+
+const char *Profiler::getName(uint8_t id){
+  if ((id >= PROF_MAX_STAGES) || (stages[id].name == NULL)) return "";
+  return stages[id].name;
+}
+
+uint8_t Profiler::topStages(uint8_t *ids, uint8_t n){
+  uint8_t found = 0;
+  for (uint8_t id=0; id < PROF_MAX_STAGES; id++){
+    if ((stages[id].name == NULL) || (stages[id].count == 0)) continue;
+    // insertion sort (descending total time)
+    uint8_t pos = found;
+    while ((pos > 0) && (stages[ids[pos-1]].sum < stages[id].sum)) {
+      if (pos < n) ids[pos] = ids[pos-1];
+      pos--;
+    }
+    if (pos < n) ids[pos] = id;
+    if (found < n) found++;
+  }
+  return found;
+}
+
+void Profiler::reset(){
+  for (int id=0; id < PROF_MAX_STAGES; id++){
+    profstage_t &st = stages[id];
+    st.count = st.min = st.max = 0;
+    st.sum = 0;
+    memset(st.hist, 0, sizeof st.hist);
+  }
+  windowStartMillis += windowMillis();
+}
+
+void Profiler::printReport(Print &s){
+  char buf[80];
+  snprintf(buf, sizeof buf, "---profiler %lu ms---\r\n", (unsigned long)windowMillis());
+  s.print(buf);
+  s.print("stage          count  min_us  avg_us  max_us  cpu%");
+  for (uint8_t bin=0; bin < PROF_HIST_BINS; bin++){
+    uint32_t limit = binLimitUs(bin);
+    if (limit == 0) snprintf(buf, sizeof buf, "    >=%lu", (unsigned long)binLimitUs(bin-1));
+      else snprintf(buf, sizeof buf, "  <%6lu", (unsigned long)limit);
+    s.print(buf);
+  }
+  s.print("\r\n");
+  for (uint8_t id=0; id < PROF_MAX_STAGES; id++){
+    profstage_t &st = stages[id];
+    if (st.name == NULL) continue;
+    int permille = getLoadPermille(id);
+    snprintf(buf, sizeof buf, "%-12s %7lu %7lu %7lu %7lu %3d.%01d",
+      st.name, (unsigned long)st.count, (unsigned long)getMinUs(id),
+      (unsigned long)getAvgUs(id), (unsigned long)getMaxUs(id), permille/10, permille%10);
+    s.print(buf);
+    for (uint8_t bin=0; bin < PROF_HIST_BINS; bin++){
+      snprintf(buf, sizeof buf, " %8u", (unsigned int)st.hist[bin]);
+      s.print(buf);
+    }
+    s.print("\r\n");
+  }
+}
+
@@ -0,0 +1,103 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+lightweight stage profiler (fixed RAM table, no heap)
+
+- time base:  Due:  DWT cycle counter (CYCCNT, 84 ticks per us)
+              Mega: micros() (4 us resolution)
+              host: steady clock (1000 ticks per us), e.g. for the simulator
+- per stage: count, min, avg, max and a histogram (bins: <16us, <64us, <256us ... >=64ms)
+
+How to use it (example):
+  1. register stage:  profiler.addStage(PROF_ADCMAN, "adcman");
+  2. measure stages:  uint32_t t = profiler.ticks();
+                      ADCMan.run();
+                      t = profiler.mark(PROF_ADCMAN, t);  // stage time is now-t, returns now
+                      readSerial();
+                      t = profiler.mark(PROF_SERIAL, t);
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  // host build (simulator)
+  #include <stdint.h>
+  #include "Print.h"
+#endif
+
+#define PROF_MAX_STAGES 32
+#define PROF_HIST_BINS  8
+
+
+struct profstage_t {
+  const char *name;
+  uint32_t count;
+  uint32_t min;       // ticks
+  uint32_t max;       // ticks
+  uint64_t sum;       // ticks
+  uint16_t hist[PROF_HIST_BINS];
+};
+
+typedef struct profstage_t profstage_t;
+
+
+class Profiler
+{
+  public:
+    Profiler();
+    // enable time base (cycle counter)
+    void begin();
+    void addStage(uint8_t id, const char *name);
+    // current time base value
+    uint32_t ticks();
+    uint32_t ticksPerUs();
+    // record stage time (now-startTicks), returns now (start of next stage)
+    uint32_t mark(uint8_t id, uint32_t startTicks);
+    void record(uint8_t id, uint32_t duration);
+    // statistics in microseconds
+    uint32_t getCount(uint8_t id);
+    uint32_t getMinUs(uint8_t id);
+    uint32_t getAvgUs(uint8_t id);
+    uint32_t getMaxUs(uint8_t id);
+    // share of measurement window (permille)
+    int getLoadPermille(uint8_t id);
+    const char *getName(uint8_t id);
+    // ids of up to n stages with highest total time (returns number of ids)
+    uint8_t topStages(uint8_t *ids, uint8_t n);
+    // upper limit of histogram bin (us), 0 = unlimited
+    static uint32_t binLimitUs(uint8_t bin);
+    void printReport(Print &s);
+    void reset();
+  private:
+    profstage_t stages[PROF_MAX_STAGES];
+    uint32_t windowStartMillis;
+    uint32_t windowMillis();
+};
+
+
+#endif
+
@@ -26,6 +26,7 @@
 #include "robot.h"
 #include "config.h"
 #include "flashmem.h"
+#include "crc.h"
 
 #define MAGIC 52
 
@@ -33,6 +34,7 @@
 #define ADDR_USER_SETTINGS 0
 #define ADDR_ERR_COUNTERS 400
 #define ADDR_ROBOT_STATS 800
+#define ADDR_SETTINGS_IMAGE 1024
 
 const char* stateNames[] ={"OFF ", "RC  ", "FORW", "ROLL", "REV ", "CIRC", "ERR ", "PFND", "PTRK", "PROL", "PREV", "STAT", "CHARG", "STCHK",
   "STREV", "STROL", "STFOR", "MANU", "ROLW", "POUTFOR", "POUTREV", "POUTROLL", "TILT", "BUMPREV", "BUMPFORW"};
@@ -44,7 +46,7 @@ const char* sensorNames[] ={"SEN_PERIM_LEFT", "SEN_PERIM_RIGHT", "SEN_PERIM_LEFT
 
 const char* mowPatternNames[] = {"RAND", "LANE", "BIDIR"};
 
-const char* consoleModeNames[] ={"sen_counters", "sen_values", "perimeter", "off"}; 
+const char* consoleModeNames[] ={"sen_counters", "sen_values", "perimeter", "profiler", "off"}; 
 
 
 // --- split robot class ----
@@ -135,6 +137,7 @@ Robot::Robot(){
   imuRollDir = LEFT;  
   
   perimeterMag = 1;
+  perimeterMagRight = 1;
   perimeterMagMedian.add(perimeterMag);
   perimeterInside = true;
   perimeterCounter = 0;  
@@ -154,6 +157,11 @@ Robot::Robot(){
   tempSonarDistCounter = 0;
   sonarObstacleTimeout = 0;  
 
+  obstacleMapTimeout = 0;
+  obstacleMapSlowState = 0;
+  nextTimeCheckLanes = 0;
+  nextTimeCheckObstacleMap = 0;
+
   batADC = 0;
   batVoltage = 0;
   batRefFactor = 0;
@@ -174,27 +182,13 @@ Robot::Robot(){
 
   consoleMode = CONSOLE_SENSOR_COUNTERS; 
   nextTimeButtonCheck = 0;
-  nextTimeInfo = 0;
-  nextTimeMotorSense = 0;
-  nextTimeIMU = 0;
   nextTimeCheckTilt = 0;
-  nextTimeOdometry = 0;
   nextTimeOdometryInfo = 0;
-  nextTimeBumper = 0;
-  nextTimeDrop = 0;                                                                                                                    // Dropsensor - Absturzsensor
-  nextTimeSonar = 0;
-  nextTimeBattery = 0;
   nextTimeCheckBattery = 0;
-  nextTimePerimeter = 0;
-  nextTimeLawnSensor = 0;
-  nextTimeLawnSensorCheck = 0;
+  nextTimeBatteryLog = 0;
   nextTimePrintErrors = 0;
   nextTimeTimer = millis() + 60000;
-  nextTimeRTC = 0;
-  nextTimeGPS = 0;
   nextTimeCheckIfStuck = 0;
-  nextTimePfodLoop = 0;
-  nextTimeRain = 0;
   lastMotorMowRpmTime = millis();
   nextTimeButton = 0;
   nextTimeErrorCounterReset = 0;    
@@ -202,7 +196,6 @@ Robot::Robot(){
   nextTimeMotorControl = 0;  
   nextTimeMotorImuControl = 0;
   nextTimeMotorPerimeterControl = 0;
-  nextTimeMotorMowControl = 0;
   nextTimeRotationChange = 0;
 
   nextTimeRobotStats = 0;
@@ -260,8 +253,13 @@ void Robot::setUserSwitches(){
 void Robot::setup()  {     
   setDefaultTime();
   setMotorPWM(0, 0, false);
+  FlashLog.begin();
+  obstacleMap.begin();
+  localizer.begin(1);
+  FlashLog.add(FLOG_BOOT, 0, &datetime, sizeof datetime);
   loadSaveErrorCounters(true);
   loadUserSettings();
+  encoders.begin(odometryTicksPerCm, odometryWheelBaseCm);
   if (!statsOverride) loadSaveRobotStats(true);
   else loadSaveRobotStats(false);
   setUserSwitches();	
@@ -274,6 +272,8 @@ void Robot::setup()  {
     setNextState(STATE_FORWARD,0);
   }  
     
+  setupTasks();
+  setupProfiler();
   stateStartTime = millis();  
   beep(1);  
   Console.println(F("START"));  
@@ -340,6 +340,7 @@ void Robot::checkButton(){
         motorMowEnable = true;
         //motorMowModulate = true;
         mowPatternCurr = MOW_LANES;
+        lanePlanner.stop();   // new job
         setNextState(STATE_FORWARD, 0);                
       } else if (buttonCounter == 6){
         // track perimeter
@@ -366,235 +367,346 @@ void Robot::checkButton(){
   }
 }
 
-void Robot::readSensors(){
-//NOTE: this function should only read in sensors into variables - it should NOT change any state!
-
-  if (millis() >= nextTimeMotorSense){    
-    nextTimeMotorSense = millis() +  50;
-    double accel = 0.05;
-    motorRightSenseADC = readSensor(SEN_MOTOR_RIGHT);
-    motorLeftSenseADC = readSensor(SEN_MOTOR_LEFT);
-    motorMowSenseADC = readSensor(SEN_MOTOR_MOW);
-    
-    motorRightSenseCurrent = motorRightSenseCurrent * (1.0-accel) + ((double)motorRightSenseADC) * motorSenseRightScale * accel;
-    motorLeftSenseCurrent = motorLeftSenseCurrent * (1.0-accel) + ((double)motorLeftSenseADC) * motorSenseLeftScale * accel;
-    motorMowSenseCurrent = motorMowSenseCurrent * (1.0-accel) + ((double)motorMowSenseADC) * motorMowSenseScale * accel;
-   
-    if (batVoltage > 8){
-      motorRightSense = motorRightSenseCurrent * batVoltage /1000;   // conversion to power in Watt
-      motorLeftSense  = motorLeftSenseCurrent  * batVoltage /1000;
-      motorMowSense   = motorMowSenseCurrent   * batVoltage /1000;
-    }
-    else{
-      motorRightSense = motorRightSenseCurrent * batFull /1000;   // conversion to power in Watt in absence of battery voltage measurement
-      motorLeftSense  = motorLeftSenseCurrent  * batFull /1000;
-      motorMowSense   = motorMowSenseCurrent   * batFull /1000;
-    }
+// read motor current, mower motor rpm
+void Robot::readSensorMotor(){
+  double accel = 0.05;
+  motorRightSenseADC = readSensor(SEN_MOTOR_RIGHT);
+  motorLeftSenseADC = readSensor(SEN_MOTOR_LEFT);
+  motorMowSenseADC = readSensor(SEN_MOTOR_MOW);
   
-    if ((millis() - lastMotorMowRpmTime) >= 500){                  
-      motorMowRpmCurr = readSensor(SEN_MOTOR_MOW_RPM);    
-      if ((motorMowRpmCurr == 0) && (motorMowRpmCounter != 0)){
-        // rpm may be updated via interrupt
-        motorMowRpmCurr = (int) ((((double)motorMowRpmCounter) / ((double)(millis() - lastMotorMowRpmTime))) * 60000.0);
-        motorMowRpmCounter = 0;        
-      }       
-      lastMotorMowRpmTime = millis();     
-      if (!ADCMan.calibrationDataAvail()) {
-        //Console.println(F("Error: missing ADC calibration data"));
-        //addErrorCounter(ERR_ADC_CALIB);
-        //setNextState(STATE_ERROR, 0);
-      }
-    }
-  }  
+  motorRightSenseCurrent = motorRightSenseCurrent * (1.0-accel) + ((double)motorRightSenseADC) * motorSenseRightScale * accel;
+  motorLeftSenseCurrent = motorLeftSenseCurrent * (1.0-accel) + ((double)motorLeftSenseADC) * motorSenseLeftScale * accel;
+  motorMowSenseCurrent = motorMowSenseCurrent * (1.0-accel) + ((double)motorMowSenseADC) * motorMowSenseScale * accel;
+ 
+  if (batVoltage > 8){
+    motorRightSense = motorRightSenseCurrent * batVoltage /1000;   // conversion to power in Watt
+    motorLeftSense  = motorLeftSenseCurrent  * batVoltage /1000;
+    motorMowSense   = motorMowSenseCurrent   * batVoltage /1000;
+  }
+  else{
+    motorRightSense = motorRightSenseCurrent * batFull /1000;   // conversion to power in Watt in absence of battery voltage measurement
+    motorLeftSense  = motorLeftSenseCurrent  * batFull /1000;
+    motorMowSense   = motorMowSenseCurrent   * batFull /1000;
+  }
 
+  if ((millis() - lastMotorMowRpmTime) >= 500){                  
+    motorMowRpmCurr = readSensor(SEN_MOTOR_MOW_RPM);    
+    if ((motorMowRpmCurr == 0) && (motorMowRpmCounter != 0)){
+      // rpm may be updated via interrupt
+      motorMowRpmCurr = (int) ((((double)motorMowRpmCounter) / ((double)(millis() - lastMotorMowRpmTime))) * 60000.0);
+      motorMowRpmCounter = 0;        
+    }       
+    lastMotorMowRpmTime = millis();     
+    if (!ADCMan.calibrationDataAvail()) {
+      //Console.println(F("Error: missing ADC calibration data"));
+      //addErrorCounter(ERR_ADC_CALIB);
+      //setNextState(STATE_ERROR, 0);
+    }
+  }
+}
 
-  if ((perimeterUse) && (millis() >= nextTimePerimeter)){    
-    if (stateCurr == STATE_PERI_TRACK) nextTimePerimeter = millis() +  30;   
-    else nextTimePerimeter = millis() +  50;   // 50
-    perimeterMag = readSensor(SEN_PERIM_LEFT);
-    if (stateCurr == STATE_PERI_FIND)perimeterMagMedian.add(abs(perimeterMag));
-    if ((perimeter.isInside(0) != perimeterInside)){      
-      perimeterCounter++;
+// read perimeter
+void Robot::readSensorPerimeter(){
+  if (!perimeterUse) return;
+  // read faster while tracking perimeter
+  if (stateCurr == STATE_PERI_TRACK) scheduler.setPeriod(TASK_SENSOR_PERIMETER, 30);
+    else scheduler.setPeriod(TASK_SENSOR_PERIMETER, 50);
+  perimeterMag = readSensor(SEN_PERIM_LEFT);
+  if (perimeter.isDualCoil()) perimeterMagRight = readSensor(SEN_PERIM_RIGHT);
+  if (stateCurr == STATE_PERI_FIND)perimeterMagMedian.add(abs(perimeterMag));
+  // dual coil: inside if both coils are inside (the first coil crossing the wire triggers)
+  boolean inside = perimeter.isInside(0);
+  if (perimeter.isDualCoil()) inside = inside && perimeter.isInside(1);
+  if ((inside != perimeterInside)){      
+    perimeterCounter++;
 			setSensorTriggered(SEN_PERIM_LEFT);
-      perimeterLastTransitionTime = millis();
-      perimeterInside = perimeter.isInside(0);
-    }    
-    static boolean LEDstate = false;
-    if (perimeterInside && !LEDstate) {
-      setActuator(ACT_LED, HIGH);
-      LEDstate = true;
+    perimeterLastTransitionTime = millis();
+    perimeterInside = inside;
+  }    
+  static boolean LEDstate = false;
+  if (perimeterInside && !LEDstate) {
+    setActuator(ACT_LED, HIGH);
+    LEDstate = true;
 	}
-    if (!perimeterInside && LEDstate) {
-      setActuator(ACT_LED, LOW);
-      LEDstate = false;
+  if (!perimeterInside && LEDstate) {
+    setActuator(ACT_LED, LOW);
+    LEDstate = false;
 	  }
-    if ((!perimeterInside) && (perimeterTriggerTime == 0)){
-      // set perimeter trigger time      
-      if (millis() > stateStartTime + 2000){ // far away from perimeter?
-        perimeterTriggerTime = millis() + perimeterTriggerTimeout;  
-      } else {  
-        perimeterTriggerTime = millis();
-      }
+  if ((!perimeterInside) && (perimeterTriggerTime == 0)){
+    // set perimeter trigger time      
+    if (millis() > stateStartTime + 2000){ // far away from perimeter?
+      perimeterTriggerTime = millis() + perimeterTriggerTimeout;  
+    } else {  
+      perimeterTriggerTime = millis();
     }
-    if (perimeter.signalTimedOut(0))  {      
-      if ( (stateCurr != STATE_OFF) && (stateCurr != STATE_MANUAL) && (stateCurr != STATE_STATION) 
-      	&& (stateCurr != STATE_STATION_CHARGING) && (stateCurr != STATE_STATION_CHECK) 
-      	&& (stateCurr != STATE_STATION_REV) && (stateCurr != STATE_STATION_ROLL) 
-      	&& (stateCurr != STATE_STATION_FORW) && (stateCurr != STATE_REMOTE) && (stateCurr != STATE_PERI_OUT_FORW)
-        && (stateCurr != STATE_PERI_OUT_REV) && (stateCurr != STATE_PERI_OUT_ROLL) && (stateCurr != STATE_PERI_TRACK)) {
-        Console.println("Error: perimeter too far away");
-        addErrorCounter(ERR_PERIMETER_TIMEOUT);
-        setNextState(STATE_ERROR,0);
-      }
+  }
+  if (perimeter.signalTimedOut(0))  {      
+    if ( (stateCurr != STATE_OFF) && (stateCurr != STATE_MANUAL) && (stateCurr != STATE_STATION) 
+    	&& (stateCurr != STATE_STATION_CHARGING) && (stateCurr != STATE_STATION_CHECK) 
+    	&& (stateCurr != STATE_STATION_REV) && (stateCurr != STATE_STATION_ROLL) 
+    	&& (stateCurr != STATE_STATION_FORW) && (stateCurr != STATE_REMOTE) && (stateCurr != STATE_PERI_OUT_FORW)
+      && (stateCurr != STATE_PERI_OUT_REV) && (stateCurr != STATE_PERI_OUT_ROLL) && (stateCurr != STATE_PERI_TRACK)) {
+      Console.println("Error: perimeter too far away");
+      addErrorCounter(ERR_PERIMETER_TIMEOUT);
+      setNextState(STATE_ERROR,0);
     }
   }
+}
 
+// read lawn sensor capacity
+void Robot::readSensorLawn(){
+  if (!lawnSensorUse) return;
+  double accel = 0.03;
+  lawnSensorFront = (1.0-accel) * lawnSensorFront + accel * ((double)readSensor(SEN_LAWN_FRONT));
+  lawnSensorBack  = (1.0-accel) * lawnSensorBack  + accel * ((double)readSensor(SEN_LAWN_BACK));        
+}
 
-  if ((lawnSensorUse) && (millis() >= nextTimeLawnSensor)){    
-    nextTimeLawnSensor = millis() + 100;               
-    double accel = 0.03;
-    lawnSensorFront = (1.0-accel) * lawnSensorFront + accel * ((double)readSensor(SEN_LAWN_FRONT));
-    lawnSensorBack  = (1.0-accel) * lawnSensorBack  + accel * ((double)readSensor(SEN_LAWN_BACK));        
-  }
- if ((lawnSensorUse) && (millis() >= nextTimeLawnSensorCheck)){          
-    nextTimeLawnSensorCheck = millis() + 2000;               
-    double deltaFront = lawnSensorFront/lawnSensorFrontOld * 100.0;    
-    double deltaBack = lawnSensorBack/lawnSensorBackOld * 100.0;        
-    if ((deltaFront <= 95) || (deltaBack <= 95)){
-      Console.print(F("LAWN "));
-      Console.print(deltaFront);
-      Console.print(",");
-      Console.println(deltaBack);
-      lawnSensorCounter++;
+// check lawn sensor capacity change
+void Robot::checkSensorLawn(){
+  if (!lawnSensorUse) return;
+  double deltaFront = lawnSensorFront/lawnSensorFrontOld * 100.0;    
+  double deltaBack = lawnSensorBack/lawnSensorBackOld * 100.0;        
+  if ((deltaFront <= 95) || (deltaBack <= 95)){
+    Console.print(F("LAWN "));
+    Console.print(deltaFront);
+    Console.print(",");
+    Console.println(deltaBack);
+    lawnSensorCounter++;
 			setSensorTriggered(SEN_LAWN_FRONT);
-      lawnSensor=true;
-    }
-    lawnSensorFrontOld = lawnSensorFront;
-    lawnSensorBackOld  = lawnSensorBack;
+    lawnSensor=true;
   }
+  lawnSensorFrontOld = lawnSensorFront;
+  lawnSensorBackOld  = lawnSensorBack;
+}
 
-
- if ((sonarUse) && (millis() >= nextTimeSonar)){
-    static char senSonarTurn = SEN_SONAR_CENTER;    
-    nextTimeSonar = millis() + 250;
-    
-    switch(senSonarTurn) {
-      case SEN_SONAR_RIGHT:
-        if (sonarRightUse) sonarDistRight = readSensor(SEN_SONAR_RIGHT);
-        senSonarTurn = SEN_SONAR_LEFT;
-        break;
-      case SEN_SONAR_LEFT:
-        if (sonarLeftUse) sonarDistLeft = readSensor(SEN_SONAR_LEFT);
-        senSonarTurn = SEN_SONAR_CENTER;
-        break;
-      case SEN_SONAR_CENTER:
-        if (sonarCenterUse) sonarDistCenter = readSensor(SEN_SONAR_CENTER);
-        senSonarTurn = SEN_SONAR_RIGHT;
-        break;
-      default:
-        senSonarTurn = SEN_SONAR_CENTER;
-        break;
-    }   
+// read sonar (one sensor per call)
+void Robot::readSensorSonar(){
+  if (!sonarUse) return;
+  static char senSonarTurn = SEN_SONAR_CENTER;    
+  
+  switch(senSonarTurn) {
+    case SEN_SONAR_RIGHT:
+      if (sonarRightUse) sonarDistRight = readSensor(SEN_SONAR_RIGHT);
+      senSonarTurn = SEN_SONAR_LEFT;
+      break;
+    case SEN_SONAR_LEFT:
+      if (sonarLeftUse) sonarDistLeft = readSensor(SEN_SONAR_LEFT);
+      senSonarTurn = SEN_SONAR_CENTER;
+      break;
+    case SEN_SONAR_CENTER:
+      if (sonarCenterUse) sonarDistCenter = readSensor(SEN_SONAR_CENTER);
+      senSonarTurn = SEN_SONAR_RIGHT;
+      break;
+    default:
+      senSonarTurn = SEN_SONAR_CENTER;
+      break;
+  }   
 /*
-    if (sonarRightUse) sonarDistRight = readSensor(SEN_SONAR_RIGHT);    
-    if (sonarLeftUse) sonarDistLeft = readSensor(SEN_SONAR_LEFT);    
-    if (sonarCenterUse) sonarDistCenter = readSensor(SEN_SONAR_CENTER); 
+  if (sonarRightUse) sonarDistRight = readSensor(SEN_SONAR_RIGHT);    
+  if (sonarLeftUse) sonarDistLeft = readSensor(SEN_SONAR_LEFT);    
+  if (sonarCenterUse) sonarDistCenter = readSensor(SEN_SONAR_CENTER); 
 */         
-  }
-
+}
 
-  if ((bumperUse) && (millis() >= nextTimeBumper)){    
-    nextTimeBumper = millis() + 100;               
-    tilt = (readSensor(SEN_TILT) == 0);
-        
-    if (readSensor(SEN_BUMPER_LEFT) == 0) {
-      bumperLeftCounter++;
+// read bumper, tilt
+void Robot::readSensorBumper(){
+  if (!bumperUse) return;
+  tilt = (readSensor(SEN_TILT) == 0);
+      
+  if (readSensor(SEN_BUMPER_LEFT) == 0) {
+    bumperLeftCounter++;
 			setSensorTriggered(SEN_BUMPER_LEFT);
-      bumperLeft=true;
-    }
-
-    if (readSensor(SEN_BUMPER_RIGHT) == 0) {
-      bumperRightCounter++;
-			setSensorTriggered(SEN_BUMPER_RIGHT);
-      bumperRight=true;
-    } 
+    bumperLeft=true;
   }
 
+  if (readSensor(SEN_BUMPER_RIGHT) == 0) {
+    bumperRightCounter++;
+			setSensorTriggered(SEN_BUMPER_RIGHT);
+    bumperRight=true;
+  } 
+}
 
-  if ((dropUse) && (millis() >= nextTimeDrop)){                                                                          // Dropsensor - Absturzsensor
-    nextTimeDrop = millis() + 100;                                                                                          // Dropsensor - Absturzsensor
-    if (readSensor(SEN_DROP_LEFT) == dropcontact) {                                                                         // Dropsensor - Absturzsensor
-      dropLeftCounter++;                                                                                                    // Dropsensor - Absturzsensor
+// read drop sensors                                                                                                               // Dropsensor - Absturzsensor
+void Robot::readSensorDrop(){
+  if (!dropUse) return;
+  if (readSensor(SEN_DROP_LEFT) == dropcontact) {                                                                         // Dropsensor - Absturzsensor
+    dropLeftCounter++;                                                                                                    // Dropsensor - Absturzsensor
 			setSensorTriggered(SEN_DROP_LEFT);	
 			dropLeft=true;                                                                                                        // Dropsensor - Absturzsensor
-    }                                                                                                                       // Dropsensor - Absturzsensor
+  }                                                                                                                       // Dropsensor - Absturzsensor
  
-    if (readSensor(SEN_DROP_RIGHT) == dropcontact) {                                                                          // Dropsensor - Absturzsensor
-      dropRightCounter++;                                                                                                   // Dropsensor - Absturzsensor
-      setSensorTriggered(SEN_DROP_RIGHT);
+  if (readSensor(SEN_DROP_RIGHT) == dropcontact) {                                                                          // Dropsensor - Absturzsensor
+    dropRightCounter++;                                                                                                   // Dropsensor - Absturzsensor
+    setSensorTriggered(SEN_DROP_RIGHT);
 			dropRight=true;                                                                                                       // Dropsensor - Absturzsensor
-    } 
+  } 
+}
+
+// read RTC
+void Robot::readSensorRTC(){
+  if (!timerUse) return;
+  readSensor(SEN_RTC);       // queue RTC read (see Mower::rtcReadDone)
+}
+
+// read IMU
+void Robot::readSensorIMU(){
+  if (!imuUse) return;
+  readSensor(SEN_IMU);
+  if (imu.getErrorCounter()>0) {
+    addErrorCounter(ERR_IMU_COMM);
+    Console.println(F("IMU comm error"));    
   }    
-  
-  if ((timerUse) && (millis() >= nextTimeRTC)) {
-    nextTimeRTC = millis() + 60000;    
-    readSensor(SEN_RTC);       // read RTC             
-    Console.print(F("RTC date received: "));
-    Console.println(date2str(datetime.date));  
+  if (!imu.calibrationAvail) {
+    Console.println(F("Error: missing IMU calibration data"));
+    addErrorCounter(ERR_IMU_CALIB);
+    setNextState(STATE_ERROR, 0);
   }
+}
 
-  
-  if ((imuUse) && (millis() >= nextTimeIMU)) {
-    // IMU
-    readSensor(SEN_IMU);
-    nextTimeIMU = millis() + 200;   // 5 hz    
-    if (imu.getErrorCounter()>0) {
-      addErrorCounter(ERR_IMU_COMM);
-      Console.println(F("IMU comm error"));    
-    }    
-    if (!imu.calibrationAvail) {
-      Console.println(F("Error: missing IMU calibration data"));
-      addErrorCounter(ERR_IMU_CALIB);
-      setNextState(STATE_ERROR, 0);
-    }
+// read battery, charging
+void Robot::readSensorBattery(){
+  if ((abs(chgCurrent) > 0.04) && (chgVoltage > 5)){
+    // charging
+    batCapacity += (chgCurrent / 36.0);
   }
-
-
-  if (millis() >= nextTimeBattery){
-    // read battery
-    nextTimeBattery = millis() + 100;       
-    if ((abs(chgCurrent) > 0.04) && (chgVoltage > 5)){
-      // charging
-      batCapacity += (chgCurrent / 36.0);
-    }
-    // convert to double  
-    batADC = readSensor(SEN_BAT_VOLTAGE);
+  // convert to double  
+  batADC = readSensor(SEN_BAT_VOLTAGE);
 		int currentADC = readSensor(SEN_CHG_CURRENT);
 		int chgADC = readSensor(SEN_CHG_VOLTAGE);    
 		//Console.println(currentADC);
-    double batvolt = ((double)batADC) * batFactor / 10;  // / 10 due to arduremote bug, can be removed after fixing    
-    double chgvolt = ((double)chgADC) * batChgFactor / 10;  // / 10 due to arduremote bug, can be removed after fixing    
+  double batvolt = ((double)batADC) * batFactor / 10;  // / 10 due to arduremote bug, can be removed after fixing    
+  double chgvolt = ((double)chgADC) * batChgFactor / 10;  // / 10 due to arduremote bug, can be removed after fixing    
 		double curramp = ((double)currentADC) * chgFactor / 10;  // / 10 due to arduremote bug, can be removed after fixing		
-    // low-pass filter
-    double accel = 0.01;
+  // low-pass filter
+  double accel = 0.01;
 		//double accel = 1.0;
-    if (abs(batVoltage-batvolt)>5)   batVoltage = batvolt; else batVoltage = (1.0-accel) * batVoltage + accel * batvolt;
-    if (abs(chgVoltage-chgvolt)>5)   chgVoltage = chgvolt; else chgVoltage = (1.0-accel) * chgVoltage + accel * chgvolt;
+  if (abs(batVoltage-batvolt)>5)   batVoltage = batvolt; else batVoltage = (1.0-accel) * batVoltage + accel * batvolt;
+  if (abs(chgVoltage-chgvolt)>5)   chgVoltage = chgvolt; else chgVoltage = (1.0-accel) * chgVoltage + accel * chgvolt;
 		if (abs(chgCurrent-curramp)>0.5) chgCurrent = curramp; else chgCurrent = (1.0-accel) * chgCurrent + accel * curramp;       
-  } 
+}
 
-  if ((rainUse) && (millis() >= nextTimeRain)) {
-    // read rain sensor
-    nextTimeRain = millis() + 5000;
-    rain = (readSensor(SEN_RAIN) != 0);  
-    if (rain) {
+// read rain
+void Robot::readSensorRain(){
+  if (!rainUse) return;
+  rain = (readSensor(SEN_RAIN) != 0);  
+  if (rain) {
 		  rainCounter++;	
 		  setSensorTriggered(SEN_RAIN);
-    }
-  }  
+  }
+}
+
+void Robot::readSensors(){
+//NOTE: this function should only read in sensors into variables - it should NOT change any state!
+  runTasks(TASK_SENSOR_MOTOR, TASK_SENSOR_RAIN);
+}
+
+// register periodic tasks (period ms, priority 0=highest, deadline ms)
+void Robot::setupTasks(){
+  scheduler.addTask(TASK_SENSOR_MOTOR,      "motorSense",  50, 0,   25);
+  scheduler.addTask(TASK_SENSOR_PERIMETER,  "perimeter",   50, 0,   25);
+  scheduler.addTask(TASK_SENSOR_LAWN,       "lawn",       100, 3,  100);
+  scheduler.addTask(TASK_SENSOR_LAWN_CHECK, "lawnCheck", 2000, 4, 1000);
+  scheduler.addTask(TASK_SENSOR_SONAR,      "sonar",      250, 2,  100);
+  scheduler.addTask(TASK_SENSOR_BUMPER,     "bumper",     100, 1,   50);
+  scheduler.addTask(TASK_SENSOR_DROP,       "drop",       100, 1,   50);
+  scheduler.addTask(TASK_SENSOR_RTC,        "rtc",      60000, 5, 5000);
+  scheduler.addTask(TASK_SENSOR_IMU,        "imu",        200, 1,  100);
+  scheduler.addTask(TASK_SENSOR_BATTERY,    "battery",    100, 2,  100);
+  scheduler.addTask(TASK_SENSOR_RAIN,       "rain",      5000, 5, 1000);
+  scheduler.addTask(TASK_ODOMETRY,          "odometry",   100, 1,   50);
+  scheduler.addTask(TASK_LOCALIZE,          "localize",   100, 2,   50);
+  scheduler.addTask(TASK_MOTOR_MOW_CONTROL, "mowControl", 100, 2,  100);
+  scheduler.addTask(TASK_IMU,               "imuAHRS", IMU_AHRS_PERIOD, 0, 5);
+  scheduler.addTask(TASK_PFOD,              "pfod",       200, 6,  200);
+  scheduler.addTask(TASK_TELEMETRY,         "telemetry",   50, 3,   50);
+  scheduler.addTask(TASK_INFO,              "info",      1000, 7, 1000);
+  scheduler.resetStats();
+}
+
+// register profiler stages (loop stages and scheduler tasks)
+void Robot::setupProfiler(){
+  profiler.addStage(PROF_LOOP,           "loop");
+  profiler.addStage(PROF_ADCMAN,         "adcman");
+  profiler.addStage(PROF_I2CMAN,         "i2cman");
+  profiler.addStage(PROF_SERIAL,         "serial");
+  profiler.addStage(PROF_RC_SERIAL,      "rcSerial");
+  profiler.addStage(PROF_SENSORS,        "sensors");
+  profiler.addStage(PROF_CHECKS,         "checks");
+  profiler.addStage(PROF_MOTOR_TASKS,    "motorTasks");
+  profiler.addStage(PROF_FAULTS,         "faults");
+  profiler.addStage(PROF_IMU,            "imu.update");
+  profiler.addStage(PROF_GPS,            "gps");
+  profiler.addStage(PROF_PFOD_INFO,      "pfodInfo");
+  profiler.addStage(PROF_STATE_MACHINE,  "states");
+  profiler.addStage(PROF_MOTOR_CONTROL,  "motorCtrl");
+  for (byte id=0; id < TASK_ENUM_COUNT; id++) 
+    profiler.addStage(PROF_TASK + id, scheduler.getName(id));
+  profiler.begin();
+}
+
+// run all due tasks (in range firstTask..lastTask) in priority order
+void Robot::runTasks(byte firstTask, byte lastTask){
+  int id;
+  while ((id = scheduler.nextDueTask(firstTask, lastTask)) != -1){
+    scheduler.beginTask(id);
+    uint32_t t = profiler.ticks();
+    runTask(id);
+    profiler.mark(PROF_TASK + id, t);
+    scheduler.endTask(id);
+  }
+}
+
+void Robot::runTask(byte id){
+  switch (id){
+    case TASK_SENSOR_MOTOR:      readSensorMotor(); break;
+    case TASK_SENSOR_PERIMETER:  readSensorPerimeter(); break;
+    case TASK_SENSOR_LAWN:       readSensorLawn(); break;
+    case TASK_SENSOR_LAWN_CHECK: checkSensorLawn(); break;
+    case TASK_SENSOR_SONAR:      readSensorSonar(); break;
+    case TASK_SENSOR_BUMPER:     readSensorBumper(); break;
+    case TASK_SENSOR_DROP:       readSensorDrop(); break;                                                                                   // Dropsensor - Absturzsensor
+    case TASK_SENSOR_RTC:        readSensorRTC(); break;
+    case TASK_SENSOR_IMU:        readSensorIMU(); break;
+    case TASK_SENSOR_BATTERY:    readSensorBattery(); break;
+    case TASK_SENSOR_RAIN:       readSensorRain(); break;
+    case TASK_ODOMETRY:          calcOdometry(); break;
+    case TASK_LOCALIZE:          runLocalizer(); break;
+    case TASK_MOTOR_MOW_CONTROL: motorMowControl(); break;
+    case TASK_IMU:               imu.update(); break;
+    case TASK_PFOD:              rc.run(); break;
+    case TASK_TELEMETRY:         rc.runTelemetry(); break;
+    case TASK_INFO:              runInfo(); break;
+  }
+}
+
+// print info, compute loops per second and check CPU speed
+void Robot::runInfo(){
+  printInfo(Console);    
+  printErrors();
+  ledState = ~ledState;    
+  /*if (ledState) setActuator(ACT_LED, HIGH);
+    else setActuator(ACT_LED, LOW);        */
+  //checkErrorCounter();  
+  if (stateCurr == STATE_REMOTE) printRemote();    
+  loopsPerSec = loopsPerSecCounter;					
+	if (stateCurr != STATE_ERROR){		
+		if (loopsPerSec < 10) { // loopsPerSec too low
+			if (loopsPerSecLowCounter < 255) loopsPerSecLowCounter++;
+		} else if (loopsPerSecLowCounter > 0) loopsPerSecLowCounter--; // loopsPerSec OK
+		if (loopsPerSecLowCounter > 10) { // too long I2C cables can be a reason for this
+			Console.println(F("Error: loopsPerSec too low (check I2C cables)"));
+			scheduler.printReport(Console);  // which tasks consumed the CPU time?
+			profiler.printReport(Console);
+			addErrorCounter(ERR_CPU_SPEED);
+			setNextState(STATE_ERROR,0);    //mower is switched into ERROR
+		}
+	} else loopsPerSecLowCounter = 0; // reset counter to zero
+  if (loopsPerSec > 0) loopsTa = 1000.0 / ((double)loopsPerSec);    
+  loopsPerSecCounter = 0;    
 }
 
 
+
 void Robot::setDefaults(){
   motorLeftSpeedRpmSet = motorRightSpeedRpmSet = 0;    
   motorMowEnable = false;                
@@ -782,6 +894,7 @@ void Robot::checkBumpers(){
   if ((mowPatternCurr == MOW_BIDIR) && (millis() < stateStartTime + 4000)) return;
 
   if ((bumperLeft || bumperRight)) {    
+      if (obstacleMapUse) obstacleMap.addBumper(bumperLeft, bumperRight);
       if (bumperLeft) {
         reverseOrBidirBumper(RIGHT);          
       } else {
@@ -903,6 +1016,12 @@ void Robot::checkSonar(){
   if (millis() < nextTimeCheckSonar) return;
   nextTimeCheckSonar = millis() + 500;
   if ((mowPatternCurr == MOW_BIDIR) && (millis() < stateStartTime + 4000)) return;
+  if (obstacleMapUse){
+    // unfiltered readings (no echo clears the sonar ray in the map)
+    if (sonarLeftUse) obstacleMap.addSonar(-OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, sonarDistLeft);
+    if (sonarCenterUse) obstacleMap.addSonar(0, sonarDistCenter);
+    if (sonarRightUse) obstacleMap.addSonar(OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, sonarDistRight);
+  }
   if (sonarDistCenter < 11 || sonarDistCenter > 100) sonarDistCenter = NO_ECHO; // Objekt ist zu nah am Sensor Wert ist unbrauchbar
   if (sonarDistRight < 11 || sonarDistRight > 100) sonarDistRight = NO_ECHO; // Object is too close to the sensor. Sensor value is useless
   if (sonarDistLeft < 11 || sonarDistLeft  > 100) sonarDistLeft = NO_ECHO; // Filters spiks under the possible detection limit
@@ -952,6 +1071,74 @@ void Robot::checkSonar(){
 }
 
 
+// slow down before obstacles known from the obstacle map
+void Robot::checkObstacleMap(){
+  if (!obstacleMapUse) return;
+  if (millis() < nextTimeCheckObstacleMap) return;
+  nextTimeCheckObstacleMap = millis() + 200;
+  // state changed meanwhile (new motor speeds)
+  if ((obstacleMapTimeout != 0) && (obstacleMapSlowState != stateStartTime)) obstacleMapTimeout = 0;
+  int dist;
+  boolean ahead = obstacleMap.obstacleAhead(obstacleMapSlowBelow, dist);
+  if (obstacleMapTimeout == 0) {
+    if (ahead) {
+      motorLeftSpeedRpmSet /= 1.5;
+      motorRightSpeedRpmSet /= 1.5;
+      obstacleMapTimeout = millis() + 3000;
+      obstacleMapSlowState = stateStartTime;
+    }
+  } else if (ahead) {
+    obstacleMapTimeout = millis() + 3000;
+  } else if (millis() > obstacleMapTimeout) {
+    obstacleMapTimeout = 0;
+    motorLeftSpeedRpmSet *= 1.5;
+    motorRightSpeedRpmSet *= 1.5;
+  }
+}
+
+
+// lane mow pattern: pose to the lane planner, drive heading from the lane planner
+void Robot::checkLanes(){
+  if (mowPatternCurr != MOW_LANES) return;
+  if (millis() < nextTimeCheckLanes) return;
+  nextTimeCheckLanes = millis() + 100;
+  lanePlanner.setPose(odometryX, odometryY, (imuUse) ? imu.ypr.yaw : odometryTheta, (!perimeterUse) || (perimeterInside));
+  if (lanePlanner.isDone()){
+    // all lanes and gaps done
+    Console.println(F("lanes done"));
+    if (perimeterUse) setNextState(STATE_PERI_FIND, 0);
+      else setNextState(STATE_OFF, 0);
+    return;
+  }
+  imuDriveHeading = lanePlanner.getHeading();
+  if (lanePlanner.getRollRequest()) setNextState(STATE_ROLL, rollDir);
+}
+
+
+// particle filter localization: the wire is recorded on the first full perimeter loop (start tracking
+// next to the station), then the filter runs on odometry and perimeter magnitude
+// (experimental, localizeUse is off by default: the estimate is only displayed, see localize.h)
+void Robot::runLocalizer(){
+  if ((!localizeUse) || (!odometryUse)) return;
+  if (!localizer.isReady()){
+    if (stateCurr == STATE_PERI_TRACK){
+      localizer.addWirePoint(odometryX, odometryY, LOC_WIRE_STEP);
+      if (localizer.isLoopComplete(odometryX, odometryY)){
+        Console.println(F("localize: wire recorded"));
+        localizer.closeLoop(false);
+        localizer.setScale(0);
+        localizer.reset(odometryX, odometryY, 20);
+      }
+    }
+    localizer.prepare();
+    return;
+  }
+  localizer.predict(odometryX, odometryY, (imuUse) ? imu.ypr.yaw : odometryTheta);
+  // magnitude is negative inside
+  if ((perimeterUse) && (!perimeter.signalTimedOut(0))) localizer.sense(-perimeterMag);
+}
+
+
 // check BumperDuino tilt, IMU tilt
 void Robot::checkTilt(){
   if (millis() < nextTimeCheckTilt) return;
@@ -1039,21 +1226,35 @@ void Robot::checkIfStuck(){
 }
 
 
+// new GPS fix: position in the local frame (ENU projection, no trig per fix), pose fusion measurement
 void Robot::processGPSData()
 {
-  if (millis() < nextTimeGPS) return;
-  nextTimeGPS = millis() + 1000;
-  float nlat, nlon;
+  long lat, lon;
   unsigned long age;
-  gps.f_get_position(&nlat, &nlon, &age);
-  if (nlat == GPS::GPS_INVALID_F_ANGLE ) return;
-  if (gpsLon == 0){
-    gpsLon = nlon;  // this is xy (0,0)
-    gpsLat = nlat;
+  gps.get_position_e7(&lat, &lon, &age);
+  if (lat == GPS::GPS_INVALID_ANGLE) return;
+  if (!gpsProjection.isValid()){
+    gpsProjection.setOrigin(lat, lon);  // this is xy (0,0)
+    gpsLat = lat / 1e7;
+    gpsLon = lon / 1e7;
+  }
+  gpsProjection.toLocal(lat, lon, gpsX, gpsY);
+  if (!fusionUse) return;
+  // accuracy (cm): UBX estimate, NMEA: HDOP
+  float sigma;
+  if (gps.ubxActive()) sigma = gps.hAcc() / 10.0;
+    else if (gps.hdop() != GPS::GPS_INVALID_HDOP) sigma = gps.hdop() / 100.0 * FUSION_GPS_UERE;
+    else return;
+  sigma = max(sigma, 1.0f);
+  if (!fusion.isInitialized()){
+    // heading: IMU yaw (compass), without IMU aligned by the GPS track
+    if (imuUse) fusion.reset(gpsX * 100, gpsY * 100, imu.ypr.yaw, FUSION_IMU_HEADING_SIGMA, sigma);
+      else fusion.reset(gpsX * 100, gpsY * 100, 0, PI, sigma);
     return;
   }
-  gpsX = (float)gps.distance_between(nlat,  gpsLon,  gpsLat, gpsLon);
-  gpsY = (float)gps.distance_between(gpsLat, nlon,   gpsLat, gpsLon);
+  fusion.updatePosition(gpsX * 100, gpsY * 100, sigma);
+  if (gps.speed() != GPS::GPS_INVALID_SPEED)
+    fusion.updateVelocity(gps.f_speed_mps() * 100, gps.f_course() / 180.0 * PI, FUSION_GPS_SPEED_SIGMA);
 }
 
 void Robot::checkTimeout(){
@@ -1091,6 +1292,21 @@ void Robot::setNextState(byte stateNew, byte dir){
       stateNew = STATE_STATION_CHECK;         
     } 
   }  
+  if (mowPatternCurr == MOW_LANES){
+    // lanes: perimeter reached - roll to the next lane (instead of a random roll)
+    if (stateNew == STATE_PERI_OUT_ROLL) stateNew = STATE_ROLL;
+    if ((stateCurr == STATE_FORWARD) 
+      && ((stateNew == STATE_REVERSE) || (stateNew == STATE_BUMPER_REVERSE) || (stateNew == STATE_PERI_OUT_REV))) {
+      lanePlanner.laneEnd(stateNew == STATE_PERI_OUT_REV);
+    }
+    if (stateNew == STATE_FORWARD){
+      // new job (lanes along the current heading), after charging/off: back to the last lane
+      boolean start = (stateCurr == STATE_STATION_FORW) || (stateCurr == STATE_OFF);
+      if ((lanePlanner.getMode() == PLAN_OFF) || ((start) && (lanePlanner.isDone())))
+        lanePlanner.begin(odometryX, odometryY, (imuUse) ? imu.ypr.yaw : odometryTheta, laneWidth);
+      else if (start) lanePlanner.resume();
+    }
+  }
   // evaluate new state
   stateNext = stateNew;
   rollDir = dir;
@@ -1181,14 +1397,19 @@ void Robot::setNextState(byte stateNew, byte dir){
     stateEndTime = millis() + motorReverseTime + motorZeroSettleTime;
   }  
 	else if (stateNew == STATE_ROLL) {                  
-      imuDriveHeading = scalePI(imuDriveHeading + PI); // toggle heading 180 degree (IMU)
-      if (imuRollDir == LEFT){
-        imuRollHeading = scalePI(imuDriveHeading - PI/20);        
-        imuRollDir = RIGHT;
+      if (mowPatternCurr == MOW_LANES){
+        // heading of next lane/gap (lane planner)
+        imuDriveHeading = imuRollHeading = lanePlanner.getHeading();
       } else {
-        imuRollHeading = scalePI(imuDriveHeading + PI/20);        
-        imuRollDir = LEFT;
-      }      
+        imuDriveHeading = scalePI(imuDriveHeading + PI); // toggle heading 180 degree (IMU)
+        if (imuRollDir == LEFT){
+          imuRollHeading = scalePI(imuDriveHeading - PI/20);        
+          imuRollDir = RIGHT;
+        } else {
+          imuRollHeading = scalePI(imuDriveHeading + PI/20);        
+          imuRollDir = LEFT;
+        }      
+      }
       stateEndTime = millis() + random(motorRollTimeMin,motorRollTimeMax) + motorZeroSettleTime;
       if (dir == RIGHT){
 	     motorLeftSpeedRpmSet = motorSpeedMaxRpm/1.25;
@@ -1212,6 +1433,7 @@ void Robot::setNextState(byte stateNew, byte dir){
     setDefaults(); 
     statsMowTimeTotalStart = false;  // stop stats mowTime counter
     loadSaveRobotStats(false);        //save robot stats
+    if ((obstacleMapUse) && (obstacleMap.isDirty())) obstacleMap.save();
        
   }
   if (stateNew == STATE_STATION_CHARGING){
@@ -1245,6 +1467,7 @@ void Robot::setNextState(byte stateNew, byte dir){
     perimeterMagMaxValue = perimeterMagMedian.getHighest();
     setActuator(ACT_CHGRELAY, 0);
     perimeterPID.reset();
+    if ((localizeUse) && (!localizer.isReady())) localizer.clearWire();   // record wire from here
     //beep(6);
   }   
   if (stateNew != STATE_REMOTE){
@@ -1253,6 +1476,7 @@ void Robot::setNextState(byte stateNew, byte dir){
  
   sonarObstacleTimeout = 0;
   // state has changed    
+  FlashLog.add(FLOG_STATE, stateNext, &stateCurr, 1);
   stateStartTime = millis();
   stateLast = stateCurr;
   stateCurr = stateNext;    
@@ -1264,54 +1488,44 @@ void Robot::setNextState(byte stateNew, byte dir){
 void Robot::loop()  {
   stateTime = millis() - stateStartTime;
   int steer;
+  uint32_t loopStart = profiler.ticks();
+  uint32_t t = loopStart;
   ADCMan.run();
+  t = profiler.mark(PROF_ADCMAN, t);
+  I2CMan.run();
+  t = profiler.mark(PROF_I2CMAN, t);
+  ConsoleTx.run();
   readSerial();   
+  t = profiler.mark(PROF_SERIAL, t);
   if (rc.readSerial()) resetIdleTime();
+  t = profiler.mark(PROF_RC_SERIAL, t);
   readSensors(); 
+  t = profiler.mark(PROF_SENSORS, t);
   checkBattery(); 
   checkIfStuck();
   checkRobotStats();
-  calcOdometry();
+  FlashLog.run();
+  t = profiler.mark(PROF_CHECKS, t);
+  if (odometryUse) encoders.run();    // drain the edge rings each loop
+  runTasks(TASK_ODOMETRY, TASK_MOTOR_MOW_CONTROL);  // odometry, localization, mower motor control
+  t = profiler.mark(PROF_MOTOR_TASKS, t);
   checkOdometryFaults();    
   checkButton(); 
-  motorMowControl(); 
   checkTilt(); 
+  t = profiler.mark(PROF_FAULTS, t);
   
-  if (imuUse) imu.update();  
+  if (imuUse) {
+    runTasks(TASK_IMU, TASK_IMU);  // fixed rate AHRS update
+    t = profiler.mark(PROF_IMU, t);
+  }
 
   if (gpsUse) { 
-    gps.feed();
-    processGPSData();    
+    if (gps.feed()) processGPSData();    
+    t = profiler.mark(PROF_GPS, t);
   }
 
-  if (millis() >= nextTimePfodLoop){
-    nextTimePfodLoop = millis() + 200;
-    rc.run();        
-  }
-   
-  if (millis() >= nextTimeInfo) {        
-    nextTimeInfo = millis() + 1000; 
-    printInfo(Console);    
-    printErrors();
-    ledState = ~ledState;    
-    /*if (ledState) setActuator(ACT_LED, HIGH);
-      else setActuator(ACT_LED, LOW);        */
-    //checkErrorCounter();  
-    if (stateCurr == STATE_REMOTE) printRemote();    
-    loopsPerSec = loopsPerSecCounter;					
-		if (stateCurr != STATE_ERROR){		
-			if (loopsPerSec < 10) { // loopsPerSec too low
-				if (loopsPerSecLowCounter < 255) loopsPerSecLowCounter++;
-			} else if (loopsPerSecLowCounter > 0) loopsPerSecLowCounter--; // loopsPerSec OK
-			if (loopsPerSecLowCounter > 10) { // too long I2C cables can be a reason for this
-				Console.println(F("Error: loopsPerSec too low (check I2C cables)"));
-				addErrorCounter(ERR_CPU_SPEED);
-				setNextState(STATE_ERROR,0);    //mower is switched into ERROR
-			}
-		} else loopsPerSecLowCounter = 0; // reset counter to zero
-    if (loopsPerSec > 0) loopsTa = 1000.0 / ((double)loopsPerSec);    
-    loopsPerSecCounter = 0;    
-  }   
+  runTasks(TASK_PFOD, TASK_INFO);  // pfodApp, console info     
+  t = profiler.mark(PROF_PFOD_INFO, t);
      
    // state machine - things to do *PERMANENTLY* for current state
    // robot state machine
@@ -1377,6 +1591,8 @@ void Robot::loop()  {
       checkBumpers();
       checkDrop();                                                                                                                            // Dropsensor - Absturzsensor
       checkSonar();             
+      checkObstacleMap();
+      checkLanes();
       checkPerimeterBoundary(); 
       checkLawn();      
       checkTimeout();      
@@ -1570,6 +1786,7 @@ void Robot::loop()  {
       if (millis() >= stateEndTime) setNextState(STATE_FORWARD,0);				        
       break;      
   } // end switch  
+  t = profiler.mark(PROF_STATE_MACHINE, t);
       
 
   // next line deactivated (issue with RC failsafe)
@@ -1585,6 +1802,7 @@ void Robot::loop()  {
        && (imuCorrectDir || (mowPatternCurr == MOW_LANES))        
        ) motorControlImuDir();                                   //&& (millis() > stateStartTime + 3000)
       else motorControl();  
+  profiler.mark(PROF_MOTOR_CONTROL, t);
   
   if (stateCurr != STATE_REMOTE) motorMowSpeedPWMSet = motorMowSpeedMaxPwm;
     
@@ -1596,6 +1814,7 @@ void Robot::loop()  {
   dropLeft = false;                                                                                                                              // Dropsensor - Absturzsensor
                              
   loopsPerSecCounter++;  
+  profiler.mark(PROF_LOOP, loopStart);
 }
 
 
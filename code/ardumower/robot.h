@@ -40,9 +40,19 @@
 #include "pid.h"
 #include "imu.h"
 #include "adcman.h"
+#include "i2cman.h"
 #include "perimeter.h"
 #include "gps.h"
+#include "fusion.h"
+#include "encoder.h"
 #include "pfod.h"
+#include "scheduler.h"
+#include "flashlog.h"
+#include "obstaclemap.h"
+#include "lanes.h"
+#include "localize.h"
+#include "usersettings.h"
+#include "profiler.h"
 #include "RunningMedian.h"
 
 //#include "QueueList.h"
@@ -161,6 +171,51 @@ enum {
   STATE_BUMPER_FORWARD,      // drive forward	
 };
 
+// scheduler tasks
+enum {
+  TASK_SENSOR_MOTOR,
+  TASK_SENSOR_PERIMETER,
+  TASK_SENSOR_LAWN,
+  TASK_SENSOR_LAWN_CHECK,
+  TASK_SENSOR_SONAR,
+  TASK_SENSOR_BUMPER,
+  TASK_SENSOR_DROP,
+  TASK_SENSOR_RTC,
+  TASK_SENSOR_IMU,
+  TASK_SENSOR_BATTERY,
+  TASK_SENSOR_RAIN,       // <---- last sensor task (see readSensors)
+  TASK_ODOMETRY,
+  TASK_LOCALIZE,          // particle filter (after odometry)
+  TASK_MOTOR_MOW_CONTROL,
+  TASK_IMU,               // AHRS update (fixed rate)
+  TASK_PFOD,
+  TASK_TELEMETRY,
+  TASK_INFO,
+  TASK_ENUM_COUNT,
+};
+
+// profiler stages (loop stages, followed by one stage per scheduler task)
+enum {
+  PROF_LOOP,
+  PROF_ADCMAN,
+  PROF_I2CMAN,
+  PROF_SERIAL,
+  PROF_RC_SERIAL,
+  PROF_SENSORS,
+  PROF_CHECKS,
+  PROF_MOTOR_TASKS,
+  PROF_FAULTS,
+  PROF_IMU,
+  PROF_GPS,
+  PROF_PFOD_INFO,
+  PROF_STATE_MACHINE,
+  PROF_MOTOR_CONTROL,
+  PROF_TASK,              // <---- first scheduler task (PROF_TASK + TASK_xxx)
+};
+
+// one profiler stage per loop stage and scheduler task (Profiler::addStage ignores ids out of range)
+static_assert(PROF_TASK + TASK_ENUM_COUNT <= PROF_MAX_STAGES, "profiler: increase PROF_MAX_STAGES");
+
 // roll types
 enum { LEFT, RIGHT };
 
@@ -168,7 +223,10 @@ enum { LEFT, RIGHT };
 enum { MOW_RANDOM, MOW_LANES, MOW_BIDIR };
 
 // console mode
-enum { CONSOLE_SENSOR_COUNTERS, CONSOLE_SENSOR_VALUES, CONSOLE_PERIMETER, CONSOLE_OFF };
+enum { CONSOLE_SENSOR_COUNTERS, CONSOLE_SENSOR_VALUES, CONSOLE_PERIMETER, CONSOLE_PROFILER, CONSOLE_OFF };
+
+// max. length of the info line (skipped if the console TX buffer has no room for it)
+#define CONSOLE_INFO_SIZE 200
 
 
 #define MAX_TIMERS 5
@@ -202,14 +260,17 @@ class Robot
     // -------- mow pattern -----------------------------    
     byte mowPatternCurr;
     const char *mowPatternName();
+    LanePlanner lanePlanner;     // MOW_LANES
+    int laneWidth;               // lane distance (cm)
+    unsigned long nextTimeCheckLanes;
     // -------- gps state -------------------------------
     GPS gps;
     char gpsUse            ;       // use GPS?        
     float gpsLat;
     float gpsLon;
-    float gpsX ;   // X position (m)
-    float gpsY ;   // Y position (m)
-    unsigned long nextTimeGPS ;
+    EnuProjection gpsProjection;  // local frame (origin: first fix)
+    float gpsX ;   // X position (m, east of the first fix)
+    float gpsY ;   // Y position (m, north of the first fix)
     unsigned long nextTimeCheckIfStuck ;
     float stuckIfGpsSpeedBelow ;
     int gpsSpeedIgnoreTime ; // how long gpsSpeed is ignored when robot switches into a new STATE (in ms)
@@ -232,10 +293,10 @@ class Robot
     float odometryTheta; // theta angle (radiant)
     float odometryX ;   // X map position (cm)
     float odometryY ;   // Y map position (cm)    
+    EncoderOdometry encoders;   // edge timestamps (odometry interrupts), pose per edge, wheel speeds
     float motorLeftRpmCurr ; // left wheel rpm    
     float motorRightRpmCurr ; // right wheel rpm    
     unsigned long lastMotorRpmTime ;     
-    unsigned long nextTimeOdometry ;
     unsigned long nextTimeOdometryInfo ; 
 		boolean odoLeftRightCorrection;
     // -------- RC remote control state -----------------    
@@ -252,7 +313,6 @@ class Robot
     boolean remoteSpeedLastState ;
     boolean remoteMowLastState ;
     boolean remoteSwitchLastState ;
-    unsigned long nextTimeRTC ;
     // -------- mower motor state -----------------------
     int motorMowRpmCounter ;  // mower motor speed state
     boolean motorMowRpmLastState ;
@@ -290,7 +350,6 @@ class Robot
     int motorZeroSettleTime;     // how long (ms) to wait for motor to settle at zero speed
     int motorLeftSenseCounter ;  // motor current counter
     int motorRightSenseCounter ;
-    unsigned long nextTimeMotorSense ;
     unsigned long lastSetMotorSpeedTime;
     unsigned long motorLeftZeroTimeout;
     unsigned long motorRightZeroTimeout;
@@ -318,7 +377,6 @@ class Robot
     unsigned long nextTimeMotorControl;
     unsigned long nextTimeMotorImuControl ;
     unsigned long nextTimeMotorPerimeterControl;
-    unsigned long nextTimeMotorMowControl;
     int lastMowSpeedPWM;
     unsigned long lastSetMotorMowSpeedTime;
     unsigned long nextTimeCheckCurrent;
@@ -332,7 +390,6 @@ class Robot
     boolean bumperLeft ;          
     int bumperRightCounter ;
     boolean bumperRight ;
-    unsigned long nextTimeBumper ;
     // --------- drop state ---------------------------
     // bumper state (true = pressed)                                                                                                  // Dropsensor - Absturzsensor vorhanden ?
     char dropUse       ;      // has drops?                                                                                           // Dropsensor - Absturzsensor Zähler links
@@ -340,7 +397,6 @@ class Robot
     boolean dropLeft ;                                                                                                                // Dropsensor - Absturzsensor links betätigt ?
     int dropRightCounter ;                                                                                                            // Dropsensor - Absturzsensor
     boolean dropRight ;                                                                                                               // Dropsensor - Absturzsensor rechts betätigt ?
-    unsigned long nextTimeDrop ;                                                                                                      // Dropsensor - Absturzsensor
     char dropcontact ; // contact 0-openers 1-closers                                                                                 // Dropsensor Kontakt 0 für Öffner - 1 Schließer
     // ------- IMU state --------------------------------
     IMU imu;
@@ -353,7 +409,6 @@ class Robot
     byte   imuRollDir;
     //point_float_t accMin;
     //point_float_t accMax;
-    unsigned long nextTimeIMU ; //read IMU data
     unsigned long nextTimeCheckTilt; // check if
     // ------- perimeter state --------------------------
     Perimeter perimeter;
@@ -365,7 +420,8 @@ class Robot
     int perimeterTrackRevTime ; // perimeter tracking reverse time (ms)
     PID perimeterPID ;             // perimeter PID controller
     int perimeterMag ;             // perimeter magnitude
-    RunningMedian perimeterMagMedian = RunningMedian(300);
+    int perimeterMagRight ;        // perimeter magnitude right coil (dual coil)
+    RunningMedian<int, 19> perimeterMagMedian;  // max. magnitude while finding perimeter
     float PeriCoeffAccel;
     int leftSpeedperi;
     int rightSpeedperi;
@@ -377,7 +433,6 @@ class Robot
     int perimeterTriggerTimeout;   // perimeter trigger timeout (ms)
     unsigned long perimeterLastTransitionTime;
     int perimeterCounter ;         // counts perimeter transitions
-    unsigned long nextTimePerimeter ;
     int trackingPerimeterTransitionTimeOut;
     int trackingErrorTimeOut;    
     char trackingBlockInnerWheelWhilePerimeterStruggling;
@@ -389,13 +444,10 @@ class Robot
     float lawnSensorFrontOld ;
     float lawnSensorBack ;   // back lawn sensor capacity (time)
     float lawnSensorBackOld ;
-    unsigned long nextTimeLawnSensor ;
-    unsigned long nextTimeLawnSensorCheck ;
     // --------- rain -----------------------------------
     boolean rain;
     boolean rainUse;
     int rainCounter; 
-    unsigned long nextTimeRain ;   
     // --------- sonar ----------------------------------
     // ultra sonic sensor distance-to-obstacle (cm)
     char sonarUse          ;      // use ultra sonic sensor?
@@ -410,11 +462,22 @@ class Robot
     unsigned int sonarDistCounter ;
     unsigned int tempSonarDistCounter ;
     unsigned long sonarObstacleTimeout ;
-    unsigned long nextTimeSonar ;
     unsigned long nextTimeCheckSonar ;
+    // --------- obstacle map -----------------------------
+    ObstacleMap obstacleMap;
+    char obstacleMapUse;          // build obstacle map, slow down before known obstacles?
+    int obstacleMapSlowBelow;     // slow down distance (cm) to known obstacles
+    unsigned long obstacleMapTimeout;
+    unsigned long obstacleMapSlowState;   // stateStartTime of the slowed down state
+    unsigned long nextTimeCheckObstacleMap;
+    // --------- localization -----------------------------
+    Localizer localizer;
+    char localizeUse;             // particle filter localization (perimeter wire recorded while tracking), experimental: off by default
+    // --------- pose fusion ------------------------------
+    PoseFusion fusion;
+    char fusionUse;               // GPS/odometry/IMU pose fusion (Kalman filter)?
     // --------- pfodApp ----------------------------------
     RemoteControl rc; // pfodApp
-    unsigned long nextTimePfodLoop ;    
     // ----- other -----------------------------------------
     char lastSensorTriggered;          // last triggered sensor
 		unsigned long lastSensorTriggeredTime;
@@ -451,8 +514,8 @@ class Robot
     int stationRollTime    ;    // charge station roll time (ms)
     int stationForwTime    ;    // charge station forward time (ms)
     int stationCheckTime   ;    // charge station reverse check time (ms)
-    unsigned long nextTimeBattery ;    
     unsigned long nextTimeCheckBattery;
+    unsigned long nextTimeBatteryLog;
     int statsBatteryChargingCounter;
     int statsBatteryChargingCounterTotal;
     float  statsBatteryChargingCapacityTrip;
@@ -470,8 +533,9 @@ class Robot
     byte buttonCounter ;
     byte ledState ;
     byte consoleMode ;
+    Scheduler scheduler;  // periodic tasks (sensors, motor, pfodApp, info)
+    Profiler profiler;    // loop stage timing
     unsigned long nextTimeButtonCheck ;    
-    unsigned long nextTimeInfo ;                    
     byte rollDir;
     unsigned long nextTimeButton ;
     unsigned long nextTimeErrorCounterReset;    
@@ -524,6 +588,8 @@ class Robot
     virtual void deleteUserSettings();        
     virtual void saveUserSettings();
     virtual void deleteRobotStats();
+    // user setting (usersettings.h) by id
+    void *settingValue(uint16_t id);
     
     // other
     virtual void beep(int numberOfBeeps, boolean shortbeep);    
@@ -541,11 +607,32 @@ protected:
     virtual void loadSaveUserSettings(boolean readflag);
     virtual void loadSaveRobotStats(boolean readflag);
     virtual void loadUserSettings();
+    virtual void saveSettingsImage();
+    virtual boolean loadSettingsImage();
+    virtual boolean loadLegacySettings();
     virtual void checkErrorCounter();
     virtual void printSettingSerial();
     
     // read sensors
     virtual void readSensors();            
+    virtual void readSensorMotor();
+    virtual void readSensorPerimeter();
+    virtual void readSensorLawn();
+    virtual void checkSensorLawn();
+    virtual void readSensorSonar();
+    virtual void readSensorBumper();
+    virtual void readSensorDrop();                                                                                                  // Dropsensor - Absturzsensor
+    virtual void readSensorRTC();
+    virtual void readSensorIMU();
+    virtual void readSensorBattery();
+    virtual void readSensorRain();
+    
+    // periodic tasks
+    virtual void setupTasks();
+    virtual void runTasks(byte firstTask, byte lastTask);
+    virtual void runTask(byte id);
+    virtual void runInfo();
+    virtual void setupProfiler();
     
     // read serial
     virtual void readSerial();    
@@ -562,6 +649,9 @@ protected:
     virtual void checkPerimeterFind();
     virtual void checkLawn();
     virtual void checkSonar();
+    virtual void checkObstacleMap();
+    virtual void checkLanes();
+    virtual void runLocalizer();
     virtual void checkTilt();
     virtual void checkRain();
     virtual void checkTimeout();
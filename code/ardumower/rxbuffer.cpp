@@ -0,0 +1,115 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+
+#include "rxbuffer.h"
+
+
+#ifdef __AVR__
+RxBuffer::RxBuffer(HardwareSerial &port) : port(port) {
+#else
+RxBuffer::RxBuffer(HardwareSerial &port, Usart *usart) : port(port), usart(usart) {
+#endif
+  head = tail = 0;
+  pendingMax = 0;
+  received = overflows = 0;
+}
+
+void RxBuffer::begin(unsigned long baud){
+  port.begin(baud);
+  head = tail = 0;
+#ifndef __AVR__
+  // the core interrupt must not read RHR (it still sends the TX buffer)
+  usart->US_IDR = US_IDR_RXRDY;
+  usart->US_PTCR = US_PTCR_RXTDIS;
+  usart->US_RPR = (uint32_t)(uintptr_t)buf;
+  usart->US_RCR = RXBUFFER_SIZE;
+  usart->US_RNPR = (uint32_t)(uintptr_t)buf;
+  usart->US_RNCR = RXBUFFER_SIZE;
+  usart->US_PTCR = US_PTCR_RXTEN;
+#endif
+}
+
+void RxBuffer::update(){
+#ifdef __AVR__
+  while (port.available()){
+    int next = (head + 1) % RXBUFFER_SIZE;
+    if (next == tail) {
+      // ring full: unread bytes dropped
+      overflows++;
+      tail = head;
+    }
+    buf[head] = port.read();
+    head = next;
+    received++;
+  }
+#else
+  uint32_t nextCount = usart->US_RNCR;
+  uint32_t count = usart->US_RCR;
+  if (count == 0) {
+    // both buffers full: PDC stopped (USART overrun), restart with an empty ring
+    overflows++;
+    usart->US_PTCR = US_PTCR_RXTDIS;
+    usart->US_CR = US_CR_RSTSTA;
+    usart->US_RPR = (uint32_t)(uintptr_t)buf;
+    usart->US_RCR = RXBUFFER_SIZE;
+    usart->US_RNPR = (uint32_t)(uintptr_t)buf;
+    usart->US_RNCR = RXBUFFER_SIZE;
+    usart->US_PTCR = US_PTCR_RXTEN;
+    head = tail = 0;
+    return;
+  }
+  int pos = RXBUFFER_SIZE - count;
+  // PDC switched to the next buffer (wrapped around)?
+  boolean wrapped = ((nextCount == 0) || (pos < head));
+  int bytes = pos - head + (wrapped ? RXBUFFER_SIZE : 0);
+  if (pending() + bytes >= RXBUFFER_SIZE) {
+    // unread bytes overwritten
+    overflows++;
+    tail = pos;
+  }
+  head = pos;
+  received += bytes;
+  if (usart->US_RNCR == 0) {
+    usart->US_RNPR = (uint32_t)(uintptr_t)buf;
+    usart->US_RNCR = RXBUFFER_SIZE;
+  }
+#endif
+  pendingMax = max(pendingMax, pending());
+}
+
+int RxBuffer::available(){
+  update();
+  return pending();
+}
+
+int RxBuffer::peek(const uint8_t **data){
+  update();
+  *data = buf + tail;
+  if (head >= tail) return head - tail;
+  return RXBUFFER_SIZE - tail;
+}
+
+void RxBuffer::consume(int count){
+  tail = (tail + count) % RXBUFFER_SIZE;
+}
@@ -0,0 +1,90 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+serial RX ring buffer (GPS): received bytes are collected in a large RAM ring, so a slow loop does
+not lose data at high baud rates (u-blox at 10 Hz with UBX and all NMEA sentences)
+
+- Due: the USART writes into the ring with PDC (DMA) - no interrupt per byte and no 128 byte core
+  buffer; the ring is handed to the PDC twice (current and next buffer), update() re-arms the next
+  buffer, so the loop may take up to one ring (2048 bytes, ~180 ms at 115200 baud) between updates
+- Mega: the serial interrupt of the core fills its buffer, update() moves it into the ring
+- the parser processes the received bytes in place as contiguous blocks (peek/consume), no copy
+- overflow (loop too slow): the unread bytes are dropped and counted, reception continues
+
+How to use it (example):
+  RxBuffer rx(Serial3, USART3);      // Mega: RxBuffer rx(Serial3);
+  rx.begin(115200);
+  const uint8_t *data;
+  int len = rx.peek(&data);          // each loop
+  parse(data, len);
+  rx.consume(len);
+*/
+
+#ifndef RXBUFFER_H
+#define RXBUFFER_H
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+  #define RXBUFFER_SIZE 256
+#else
+  #define RXBUFFER_SIZE 2048
+#endif
+
+
+class RxBuffer
+{
+  public:
+#ifdef __AVR__
+    RxBuffer(HardwareSerial &port);
+#else
+    RxBuffer(HardwareSerial &port, Usart *usart);
+#endif
+    void begin(unsigned long baud);
+    // collects the received bytes (called by available/peek)
+    void update();
+    int available();
+    // contiguous received bytes (returns count, data points into the ring)
+    int peek(const uint8_t **data);
+    // processed bytes are released
+    void consume(int count);
+    unsigned long getReceived(){ return received; }
+    unsigned long getOverflows(){ return overflows; }
+    int getPendingMax(){ return pendingMax; }
+  private:
+    HardwareSerial &port;
+#ifndef __AVR__
+    Usart *usart;
+#endif
+    uint8_t buf[RXBUFFER_SIZE];
+    int head;              // next received byte
+    int tail;              // next unread byte
+    int pendingMax;
+    unsigned long received;
+    unsigned long overflows;
+    int pending(){ return (head - tail + RXBUFFER_SIZE) % RXBUFFER_SIZE; }
+};
+
+
+#endif
@@ -0,0 +1,133 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+  
+  Private-use only! (you need to ask for a commercial-use)
+ 
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "scheduler.h"
+#include "drivers.h"
+
+
+Scheduler::Scheduler(){
+  memset(tasks, 0, sizeof tasks);
+  statsStartMicros = 0;
+}
+
+void Scheduler::addTask(byte id, const char *name, unsigned int period, byte priority, unsigned int deadline){
+  if (id >= MAX_TASKS) return;
+  task_t &t = tasks[id];
+  t.name = name;
+  t.used = true;
+  t.enabled = true;
+  t.priority = priority;
+  t.period = period;
+  t.deadline = deadline;
+  t.nextRun = micros();
+}
+
+void Scheduler::setPeriod(byte id, unsigned int period){
+  if (id >= MAX_TASKS) return;
+  if (tasks[id].period == period) return;
+  // keep phase of last run
+  tasks[id].nextRun = tasks[id].nextRun - tasks[id].period * 1000UL + period * 1000UL;
+  tasks[id].period = period;
+}
+
+void Scheduler::setEnabled(byte id, boolean enabled){
+  if (id >= MAX_TASKS) return;
+  if ((enabled) && (!tasks[id].enabled)) tasks[id].nextRun = micros();
+  tasks[id].enabled = enabled;
+}
+
+int Scheduler::nextDueTask(byte firstId, byte lastId){
+  unsigned long now = micros();
+  int best = -1;
+  for (int id=firstId; (id <= lastId) && (id < MAX_TASKS); id++){
+    task_t &t = tasks[id];
+    if ((!t.used) || (!t.enabled)) continue;
+    if ((long)(now - t.nextRun) < 0) continue; // not due yet (overflow-safe)
+    if ((best == -1) || (t.priority < tasks[best].priority)) best = id;
+  }
+  return best;
+}
+
+void Scheduler::beginTask(byte id){
+  task_t &t = tasks[id];
+  unsigned long now = micros();
+  unsigned long delay = now - t.nextRun;
+  t.runs++;
+  t.jitterSum += delay;
+  if (delay > t.jitterMax) t.jitterMax = delay;
+  if (delay > t.deadline * 1000UL) t.overruns++;
+  // fixed rate: next run is relative to scheduled time, not to actual start time
+  t.nextRun += t.period * 1000UL;
+  if ((long)(now - t.nextRun) >= 0) {
+    // missed at least one complete period - resync instead of running a burst
+    t.nextRun = now + t.period * 1000UL;
+  }
+  t.startMicros = micros();
+}
+
+void Scheduler::endTask(byte id){
+  task_t &t = tasks[id];
+  unsigned long duration = micros() - t.startMicros;
+  t.timeSum += duration;
+  if (duration > t.timeMax) t.timeMax = duration;
+}
+
+unsigned long Scheduler::getOverruns(byte id){
+  if (id >= MAX_TASKS) return 0;
+  return tasks[id].overruns;
+}
+
+const char *Scheduler::getName(byte id){
+  if ((id >= MAX_TASKS) || (!tasks[id].used)) return "";
+  return tasks[id].name;
+}
+
+void Scheduler::resetStats(){
+  for (int id=0; id < MAX_TASKS; id++){
+    task_t &t = tasks[id];
+    t.runs = t.overruns = t.jitterSum = t.jitterMax = t.timeSum = t.timeMax = 0;
+  }
+  statsStartMicros = micros();
+}
+
+void Scheduler::printReport(Stream &s){
+  unsigned long window = micros() - statsStartMicros;
+  if (window == 0) window = 1;
+  unsigned long busy = 0;
+  Streamprint(s, "---task report %lu ms (jitter, run time: us)---\r\n", window/1000);
+  Streamprint(s, "task         period prio    runs overrun ");
+  Streamprint(s, "jit_avg jit_max   t_avg   t_max  cpu%%\r\n");
+  for (int id=0; id < MAX_TASKS; id++){
+    task_t &t = tasks[id];
+    if (!t.used) continue;
+    unsigned long runs = max(1UL, t.runs);
+    int permille = ((float)t.timeSum) * 1000.0 / ((float)window);
+    busy += t.timeSum;
+    Streamprint(s, "%-12s %6u %4d %7lu %7lu ", t.name, t.period, (int)t.priority, t.runs, t.overruns);
+    Streamprint(s, "%7lu %7lu %7lu %7lu ", t.jitterSum/runs, t.jitterMax, t.timeSum/runs, t.timeMax);
+    Streamprint(s, "%3d.%01d\r\n", permille/10, permille%10);
+  }
+  int permille = ((float)busy) * 1000.0 / ((float)window);
+  Streamprint(s, "tasks cpu%% %d.%01d\r\n", permille/10, permille%10);
+}
+
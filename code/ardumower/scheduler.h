@@ -0,0 +1,97 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+  
+  Private-use only! (you need to ask for a commercial-use)
+ 
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+fixed-rate cooperative task scheduler
+
+- periodic tasks run at a fixed rate (next run = last scheduled run + period, no drift)
+- task times are in micros() (1 ms millis() steps would hide the start jitter of 10-20 ms tasks),
+  all time comparisons are overflow-safe (periods below 35 minutes)
+- due tasks are returned in priority order (0 = highest priority)
+- per-task statistics: runs, overruns (started later than deadline), start jitter, run time, CPU share
+
+How to use it (example):
+  1. register task:   scheduler.addTask(TASK_BATTERY, "battery", 100, 2, 50);
+  2. program loop:    int id;
+                      while ((id = scheduler.nextDueTask(0, TASK_ENUM_COUNT-1)) != -1){
+                        scheduler.beginTask(id);
+                        ... run task id ...
+                        scheduler.endTask(id);
+                      }
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define MAX_TASKS 20
+
+
+struct task_t {
+  const char *name;
+  boolean used;
+  boolean enabled;
+  byte priority;           // 0 = highest priority
+  unsigned int period;     // ms
+  unsigned int deadline;   // max. start delay (ms) before counted as overrun
+  unsigned long nextRun;   // scheduled time of next run (us)
+  // statistics
+  unsigned long runs;
+  unsigned long overruns;
+  unsigned long jitterSum; // sum of start delays (us)
+  unsigned long jitterMax; // max. start delay (us)
+  unsigned long timeSum;   // sum of run times (us)
+  unsigned long timeMax;   // max. run time (us)
+  unsigned long startMicros;
+};
+
+typedef struct task_t task_t;
+
+
+class Scheduler
+{
+  public:
+    Scheduler();
+    // register task: period, deadline in ms, priority 0 = highest
+    void addTask(byte id, const char *name, unsigned int period, byte priority, unsigned int deadline);
+    void setPeriod(byte id, unsigned int period);
+    void setEnabled(byte id, boolean enabled);
+    // highest priority task (in range firstId..lastId) that is due (-1 if none)
+    int nextDueTask(byte firstId, byte lastId);
+    // call before and after running a task returned by nextDueTask
+    void beginTask(byte id);
+    void endTask(byte id);
+    // jitter/CPU share report since last resetStats()
+    void printReport(Stream &s);
+    void resetStats();
+    unsigned long getOverruns(byte id);
+    const char *getName(byte id);
+  private:
+    task_t tasks[MAX_TASKS];
+    unsigned long statsStartMicros;
+};
+
+
+#endif
+
@@ -3,6 +3,21 @@
 void Robot::loadSaveRobotStats(boolean readflag){
   if (readflag) Console.println(F("loadSaveRobotStats: read"));
     else Console.println(F("loadSaveRobotStats: write"));
+#ifndef __AVR__
+  // Due: robot stats are appended to the flash log (wear-levelled), EEPROM area only read once for migration
+  byte blob[FLASHLOG_BLOB_SIZE];
+  int idx = 0;
+  if ((!readflag) || (FlashLog.loadBlob(FLOG_BLOB_STATS, blob, sizeof blob))) {
+    blobreadwrite(readflag, blob, idx, statsMowTimeMinutesTrip);
+    blobreadwrite(readflag, blob, idx, statsMowTimeMinutesTotal);
+    blobreadwrite(readflag, blob, idx, statsBatteryChargingCounterTotal);
+    blobreadwrite(readflag, blob, idx, statsBatteryChargingCapacityTrip);
+    blobreadwrite(readflag, blob, idx, statsBatteryChargingCapacityTotal);
+    blobreadwrite(readflag, blob, idx, statsBatteryChargingCapacityAverage);
+    if (!readflag) FlashLog.saveBlob(FLOG_BLOB_STATS, blob, idx);
+    return;
+  }
+#endif
   int addr = ADDR_ROBOT_STATS;
   short magic = 0;
   if (!readflag) magic = MAGIC;  
@@ -24,6 +39,16 @@ void Robot::loadSaveRobotStats(boolean readflag){
 void Robot::loadSaveErrorCounters(boolean readflag){
   if (readflag) Console.println(F("loadSaveErrorCounters: read"));
     else Console.println(F("loadSaveErrorCounters: write"));
+#ifndef __AVR__
+  // Due: error counters are appended to the flash log (wear-levelled), EEPROM area only read once for migration
+  byte blob[FLASHLOG_BLOB_SIZE];
+  int idx = 0;
+  if ((!readflag) || (FlashLog.loadBlob(FLOG_BLOB_ERRORS, blob, sizeof blob))) {
+    blobreadwrite(readflag, blob, idx, errorCounterMax);
+    if (!readflag) FlashLog.saveBlob(FLOG_BLOB_ERRORS, blob, idx);
+    return;
+  }
+#endif
   int addr = ADDR_ERR_COUNTERS;
   short magic = 0;
   if (!readflag) magic = MAGIC;  
@@ -40,116 +65,267 @@ void Robot::loadSaveErrorCounters(boolean readflag){
   Console.println(addr);
 }
 
-void Robot::loadSaveUserSettings(boolean readflag){
+// --- settings schema (see usersettings.h) ---------------------------------
+
+#define SETTING_NAME(id, name, member, minValue, maxValue, scale, flags) \
+  const char settingName##id[] PROGMEM = #member;
+USER_SETTINGS(SETTING_NAME)
+
+#define SETTING_KIND(member) settingkind<decltype(((Robot*)0)->member)>::value
+
+#define SETTING_DESC(id, name, member, minValue, maxValue, scale, flags) \
+  { id, SETTING_KIND(member), (SETTING_KIND(member) == SET_STRING) ? 0 : sizeof(((Robot*)0)->member), \
+    flags, settingName##id, minValue, maxValue, scale },
+
+const setting_t userSettings[SETTING_COUNT] PROGMEM = {
+  USER_SETTINGS(SETTING_DESC)
+};
+
+void getSettingInfo(int idx, setting_t &info){
+  memcpy_P(&info, &userSettings[idx], sizeof info);
+}
+
+boolean getSettingInfoById(uint16_t id, setting_t &info){
+  for (int idx=0; idx < SETTING_COUNT; idx++){
+    getSettingInfo(idx, info);
+    if (info.id == id) return true;
+  }
+  return false;
+}
+
+float getSettingFloat(const setting_t &info, void *value){
+  switch (info.kind){
+    case SET_BOOL:  return *(bool*)value;
+    case SET_FLOAT: return (info.size == sizeof(float)) ? *(float*)value : *(double*)value;
+    case SET_INT:
+      switch (info.size){
+        case 1: return *(int8_t*)value;
+        case 2: return *(int16_t*)value;
+        case 4: return *(int32_t*)value;
+        case 8: return *(int64_t*)value;
+      }
+      break;
+    case SET_UINT:
+      switch (info.size){
+        case 1: return *(uint8_t*)value;
+        case 2: return *(uint16_t*)value;
+        case 4: return *(uint32_t*)value;
+        case 8: return *(uint64_t*)value;
+      }
+      break;
+  }
+  return 0;
+}
+
+void setSettingFloat(const setting_t &info, void *value, float v){
+  long i = (long)round(v);
+  switch (info.kind){
+    case SET_BOOL:  *(bool*)value = (v != 0); break;
+    case SET_FLOAT:
+      if (info.size == sizeof(float)) *(float*)value = v;
+        else *(double*)value = v;
+      break;
+    case SET_INT:
+    case SET_UINT:
+      switch (info.size){
+        case 1: *(uint8_t*)value = i; break;
+        case 2: *(uint16_t*)value = i; break;
+        case 4: *(uint32_t*)value = i; break;
+        case 8: *(uint64_t*)value = i; break;
+      }
+      break;
+  }
+}
+
+// setting id => member (NULL if unknown)
+void *Robot::settingValue(uint16_t id){
+  #define SETTING_VALUE(id, name, member, minValue, maxValue, scale, flags) case id: return &member;
+  switch (id){
+    USER_SETTINGS(SETTING_VALUE)
+  }
+  return NULL;
+}
+
+// write image byte (Mega: directly to EEPROM, Due: into RAM image)
+static void settingsPut(byte *image, int &pos, byte value, uint16_t &crc){
+  if (image != NULL) image[pos] = value;
+    else Flash.write(ADDR_SETTINGS_IMAGE + pos, value);
+  if (pos >= SETTINGS_HEADER_SIZE) crc = crc16(crc, value);
+  pos++;
+}
+
+static void settingsPut16(byte *image, int &pos, uint16_t value, uint16_t &crc){
+  settingsPut(image, pos, value & 0xFF, crc);
+  settingsPut(image, pos, value >> 8, crc);
+}
+
+static uint16_t settingsRead16(int addr){
+  return Flash.read(addr) | (((uint16_t)Flash.read(addr+1)) << 8);
+}
+
+// stored integer (little-endian, sign-extended)
+static long settingsReadInt(int addr, byte kind, byte size){
+  unsigned long v = 0;
+  for (int i=size-1; i >= 0; i--) v = (v << 8) | Flash.read(addr + i);
+  if ((kind == SET_INT) && (size < sizeof v) && (v & (1UL << (size*8-1)))) v |= ~0UL << (size*8);
+  return (long)v;
+}
+
+void Robot::saveSettingsImage(){
+#ifdef __AVR__
+  byte *image = NULL;       // written byte by byte (EEPROM.update only writes changed bytes)
+#else
+  byte image[SETTINGS_IMAGE_SIZE];   // written with one flash write (page-wise erase/program)
+#endif
+  setting_t info;
+  uint16_t crc = 0xFFFF;
+  int pos = SETTINGS_HEADER_SIZE;
+  int count = 0;
+  for (int idx=0; idx < SETTING_COUNT; idx++){
+    getSettingInfo(idx, info);
+    byte *data = (byte*)settingValue(info.id);
+    int size = info.size;
+    if (info.kind == SET_STRING) {
+      String &s = *(String*)data;
+      data = (byte*)s.c_str();
+      size = min((int)s.length(), SETTINGS_STRING_MAX);
+    }
+    if (pos + 4 + size > SETTINGS_IMAGE_SIZE) {
+      Console.println(F("ERROR: settings image too large"));
+      break;
+    }
+    settingsPut16(image, pos, info.id, crc);
+    settingsPut(image, pos, info.kind, crc);
+    settingsPut(image, pos, size, crc);
+    for (int i=0; i < size; i++) settingsPut(image, pos, data[i], crc);
+    count++;
+  }
+  // header last (an interrupted save leaves an image with a wrong CRC)
+  int size = pos;
+  uint16_t dummy;
+  pos = 0;
+  settingsPut16(image, pos, SETTINGS_IMAGE_MAGIC, dummy);
+  settingsPut(image, pos, SETTINGS_IMAGE_VERSION, dummy);
+  settingsPut(image, pos, 0, dummy);
+  settingsPut16(image, pos, count, dummy);
+  settingsPut16(image, pos, size - SETTINGS_HEADER_SIZE, dummy);
+  settingsPut16(image, pos, crc, dummy);
+  settingsPut16(image, pos, 0, dummy);
+#ifndef __AVR__
+  while (size & 3) image[size++] = 0xFF;   // flash write: multiple of 4 bytes
+  if (!Flash.write(ADDR_SETTINGS_IMAGE, image, size)) Console.println(F("ERROR: settings image write failed"));
+#endif
+  Console.print(F("settings saved: count="));
+  Console.print(count);
+  Console.print(F(" bytes="));
+  Console.println(size);
+}
+
+// load settings image: records are looked up by id and converted to the current member type,
+// unknown ids are skipped, missing settings keep their defaults
+boolean Robot::loadSettingsImage(){
+  int addr = ADDR_SETTINGS_IMAGE;
+  if (settingsRead16(addr) != SETTINGS_IMAGE_MAGIC) return false;
+  if (Flash.read(addr+2) != SETTINGS_IMAGE_VERSION) {
+    Console.println(F("settings image: unknown version"));
+    return false;
+  }
+  int count = settingsRead16(addr+4);
+  int size = settingsRead16(addr+6);
+  if (size > SETTINGS_IMAGE_SIZE - SETTINGS_HEADER_SIZE) return false;
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i < size; i++) crc = crc16(crc, Flash.read(addr + SETTINGS_HEADER_SIZE + i));
+  if (crc != settingsRead16(addr+8)) {
+    Console.println(F("settings image: CRC error"));
+    return false;
+  }
+  setting_t info;
+  int loaded = 0;
+  int pos = addr + SETTINGS_HEADER_SIZE;
+  int end = pos + size;
+  for (int n=0; (n < count) && (pos + 4 <= end); n++){
+    uint16_t id = settingsRead16(pos);
+    byte kind = Flash.read(pos+2);
+    byte len = Flash.read(pos+3);
+    int data = pos + 4;
+    pos = data + len;
+    if (pos > end) break;
+    byte *value = (byte*)settingValue(id);
+    if (value == NULL) continue;     // setting removed
+    getSettingInfoById(id, info);
+    if (info.kind == SET_STRING) {
+      if (kind != SET_STRING) continue;
+      String &s = *(String*)value;
+      s = "";
+      for (int i=0; i < len; i++) s += (char)Flash.read(data + i);
+    } else if (info.kind == SET_BLOB) {
+      if ((kind != SET_BLOB) || (len != info.size)) continue;
+      for (int i=0; i < len; i++) value[i] = Flash.read(data + i);
+    } else {
+      // number: convert stored type/size to member type/size
+      if ((kind == SET_STRING) || (kind == SET_BLOB) || (len == 0) || (len > sizeof(long))) continue;
+      float f;
+      long v;
+      if (kind == SET_FLOAT) {
+        if (len != sizeof f) continue;
+        for (int i=0; i < len; i++) ((byte*)&f)[i] = Flash.read(data + i);
+        v = (long)round(f);
+      } else {
+        v = settingsReadInt(data, kind, len);
+        f = v;
+      }
+      if (info.kind == SET_FLOAT) {
+        if (info.size == sizeof(float)) *(float*)value = f;
+          else *(double*)value = f;
+      } else if (info.kind == SET_BOOL) {
+        *(bool*)value = (v != 0);
+      } else {
+        for (unsigned int i=0; i < info.size; i++) value[i] = (i < sizeof v) ? ((unsigned long)v >> (i*8)) & 0xFF : 0;
+      }
+    }
+    loaded++;
+  }
+  Console.print(F("settings loaded: "));
+  Console.print(loaded);
+  Console.print(F("/"));
+  Console.println(SETTING_COUNT);
+  return true;
+}
+
+// old layout (MAGIC, hand-ordered eereadwrite list = SETF_LEGACY settings in list order)
+boolean Robot::loadLegacySettings(){
   int addr = ADDR_USER_SETTINGS;
   short magic = 0;
-  if (!readflag) magic = MAGIC;  
-  eereadwrite(readflag, addr, magic); // magic
-  if ((readflag) && (magic != MAGIC)) {
-    Console.println(F("EEPROM USERDATA: NO EEPROM USER DATA"));
-    Console.println(F("PLEASE CHECK AND SAVE YOUR SETTINGS"));
-    //addErrorCounter(ERR_EEPROM_DATA);
-    //setNextState(STATE_ERROR, 0);
-    return;
+  eeread(addr, magic);
+  if (magic != MAGIC) return false;
+  setting_t info;
+  for (int idx=0; idx < SETTING_COUNT; idx++){
+    getSettingInfo(idx, info);
+    if ((info.flags & SETF_LEGACY) == 0) continue;
+    byte *value = (byte*)settingValue(info.id);
+    if (info.kind == SET_STRING) eereadwriteString(true, addr, *(String*)value);
+      else for (int i=0; i < info.size; i++) value[i] = Flash.read(addr++);
   }
-  eereadwrite(readflag, addr, developerActive);          
-  eereadwrite(readflag, addr, motorAccel);    
-  eereadwrite(readflag, addr, motorSpeedMaxRpm);
-  eereadwrite(readflag, addr, motorSpeedMaxPwm); 
-  eereadwrite(readflag, addr, motorPowerMax);
-  eereadwrite(readflag, addr, motorSenseRightScale);
-  eereadwrite(readflag, addr, motorSenseLeftScale);
-  eereadwrite(readflag, addr, motorRollTimeMax);
-  eereadwrite(readflag, addr, motorRollTimeMin);
-  eereadwrite(readflag, addr, motorReverseTime);
-  eereadwrite(readflag, addr, motorPowerIgnoreTime);
-  eereadwrite(readflag, addr, motorForwTimeMax);
-  eereadwrite(readflag, addr, motorMowSpeedMaxPwm);
-  eereadwrite(readflag, addr, motorMowPowerMax);
-  eereadwrite(readflag, addr, motorMowRPMSet);
-  eereadwrite(readflag, addr, motorMowSenseScale);
-  eereadwrite(readflag, addr, motorLeftPID.Kp);
-  eereadwrite(readflag, addr, motorLeftPID.Ki);
-  eereadwrite(readflag, addr, motorLeftPID.Kd);
-  eereadwrite(readflag, addr, motorMowPID.Kp);
-  eereadwrite(readflag, addr, motorMowPID.Ki);
-  eereadwrite(readflag, addr, motorMowPID.Kd);
-  eereadwrite(readflag, addr, motorBiDirSpeedRatio1);
-  eereadwrite(readflag, addr, motorBiDirSpeedRatio2);  
-  eereadwrite(readflag, addr, motorLeftSwapDir);
-  eereadwrite(readflag, addr, motorRightSwapDir);  
-  eereadwrite(readflag, addr, bumperUse);
-  eereadwrite(readflag, addr, sonarUse);
-  eereadwrite(readflag, addr, sonarCenterUse);
-  eereadwrite(readflag, addr, sonarLeftUse);
-  eereadwrite(readflag, addr, sonarRightUse);  
-  eereadwrite(readflag, addr, sonarTriggerBelow);
-  eereadwrite(readflag, addr, perimeterUse);
-  eereadwrite(readflag, addr, perimeter.timedOutIfBelowSmag);        
-  eereadwrite(readflag, addr, perimeterTriggerTimeout);
-  eereadwrite(readflag, addr, perimeterOutRollTimeMax);
-  eereadwrite(readflag, addr, perimeterOutRollTimeMin);
-  eereadwrite(readflag, addr, perimeterOutRevTime);
-  eereadwrite(readflag, addr, perimeterTrackRollTime );
-  eereadwrite(readflag, addr, perimeterTrackRevTime);
-  eereadwrite(readflag, addr, perimeterPID.Kp);
-  eereadwrite(readflag, addr, perimeterPID.Ki);
-  eereadwrite(readflag, addr, perimeterPID.Kd);
-  eereadwrite(readflag, addr, perimeter.signalCodeNo);        
-  eereadwrite(readflag, addr, perimeter.swapCoilPolarity);  
-  eereadwrite(readflag, addr, perimeter.timeOutSecIfNotInside);  
-  eereadwrite(readflag, addr, trackingBlockInnerWheelWhilePerimeterStruggling);  
-  eereadwrite(readflag, addr, lawnSensorUse);
-  eereadwrite(readflag, addr, imuUse);
-  eereadwrite(readflag, addr, imuCorrectDir);
-  eereadwrite(readflag, addr, imuDirPID.Kp);
-  eereadwrite(readflag, addr, imuDirPID.Ki);
-  eereadwrite(readflag, addr, imuDirPID.Kd);  
-  eereadwrite(readflag, addr, imuRollPID.Kp);    
-  eereadwrite(readflag, addr, imuRollPID.Ki);    
-  eereadwrite(readflag, addr, imuRollPID.Kd);      
-  eereadwrite(readflag, addr, remoteUse);
-  eereadwrite(readflag, addr, batMonitor);
-  eereadwrite(readflag, addr, batGoHomeIfBelow);
-  eereadwrite(readflag, addr, batSwitchOffIfBelow);  
-  eereadwrite(readflag, addr, batSwitchOffIfIdle);  
-  eereadwrite(readflag, addr, batFactor);
-  eereadwrite(readflag, addr, batChgFactor);
-  eereadwrite(readflag, addr, chgSenseZero);
-  eereadwrite(readflag, addr, chgFactor);
-  eereadwrite(readflag, addr, batFullCurrent);
-  eereadwrite(readflag, addr, startChargingIfBelow);
-  eereadwrite(readflag, addr, stationRevTime);
-  eereadwrite(readflag, addr, stationRollTime);
-  eereadwrite(readflag, addr, stationForwTime);
-  eereadwrite(readflag, addr, stationCheckTime);
-  eereadwrite(readflag, addr, odometryUse);
-  eereadwrite(readflag, addr, odometryTicksPerRevolution);
-  eereadwrite(readflag, addr, odometryTicksPerCm);
-  eereadwrite(readflag, addr, odometryWheelBaseCm);
-  eereadwrite(readflag, addr, odometryLeftSwapDir);
-  eereadwrite(readflag, addr, odometryRightSwapDir);
-  eereadwrite(readflag, addr, twoWayOdometrySensorUse);
-  eereadwrite(readflag, addr, buttonUse);
-  eereadwrite(readflag, addr, userSwitch1);
-  eereadwrite(readflag, addr, userSwitch2);
-  eereadwrite(readflag, addr, userSwitch3);    
-  eereadwrite(readflag, addr, timerUse);
-  eereadwrite(readflag, addr, timer);  
-  eereadwrite(readflag, addr, rainUse);
-  eereadwrite(readflag, addr, gpsUse);
-  eereadwrite(readflag, addr, stuckIfGpsSpeedBelow);
-  eereadwrite(readflag, addr, gpsSpeedIgnoreTime);
-  eereadwrite(readflag, addr, dropUse);   
-  eereadwrite(readflag, addr, statsOverride);   
-  eereadwrite(readflag, addr, bluetoothUse);
-  eereadwrite(readflag, addr, esp8266Use);
-  eereadwriteString(readflag, addr, esp8266ConfigString);
-  eereadwrite(readflag, addr, tiltUse);
-  eereadwrite(readflag, addr, sonarSlowBelow);
-	eereadwrite(readflag, addr, motorMowForceOff);	
-  Console.print(F("loadSaveUserSettings addrstop="));
+  Console.print(F("loadLegacySettings addrstop="));
   Console.println(addr);
+  return true;
+}
+
+void Robot::loadSaveUserSettings(boolean readflag){
+  if (!readflag) {
+    saveSettingsImage();
+    return;
+  }
+  if (loadSettingsImage()) return;
+  if (loadLegacySettings()) {
+    Console.println(F("EEPROM USERDATA: old settings layout converted"));
+    saveSettingsImage();
+    return;
+  }
+  Console.println(F("EEPROM USERDATA: NO EEPROM USER DATA"));
+  Console.println(F("PLEASE CHECK AND SAVE YOUR SETTINGS"));
+  //addErrorCounter(ERR_EEPROM_DATA);
+  //setNextState(STATE_ERROR, 0);
 }
 
 void Robot::loadUserSettings(){  
@@ -511,9 +687,11 @@ void Robot::saveUserSettings(){
 
 void Robot::deleteUserSettings(){
   loadSaveRobotStats(true);
-  int addr = 0;
+  int addr = ADDR_USER_SETTINGS;
   Console.println(F("ALL USER SETTINGS ARE DELETED"));
   eewrite(addr, (short)0); // magic  
+  addr = ADDR_SETTINGS_IMAGE;
+  eewrite(addr, (short)0); // settings image magic
   loadSaveRobotStats(false);
 }
 
@@ -528,6 +706,8 @@ void Robot::addErrorCounter(byte errType){
   // increase error counters (both temporary and maximum error counters)
   if (errorCounter[errType] < 255) errorCounter[errType]++;
   if (errorCounterMax[errType] < 255) errorCounterMax[errType]++;    
+  // event history: first error of this type within the error counter period
+  if (errorCounter[errType] == 1) FlashLog.add(FLOG_ERROR, errType, &errorCounterMax[errType], 1);
 }
 
 void Robot::resetErrorCounters(){
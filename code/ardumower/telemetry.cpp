@@ -0,0 +1,225 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "telemetry.h"
+#include "crc.h"
+
+
+const char teleGroupNames[TELE_GROUP_COUNT][TELE_NAME_SIZE] PROGMEM = {"IMU", "Motor", "Sensors", "Battery", "Odometry", "Perimeter", "GPS", "Pose"};
+
+// name, group, type, decimals
+constexpr telechannel_t teleChannels[TELE_CHANNEL_COUNT] PROGMEM = {
+  {"state",     0,                   TELE_INT16, 0},
+  {"yaw",       TELE_GROUP_IMU,      TELE_INT16, 2},       // deg
+  {"pitch",     TELE_GROUP_IMU,      TELE_INT16, 2},
+  {"roll",      TELE_GROUP_IMU,      TELE_INT16, 2},
+  {"gyroX",     TELE_GROUP_IMU,      TELE_INT16, 1},       // deg/s
+  {"gyroY",     TELE_GROUP_IMU,      TELE_INT16, 1},
+  {"gyroZ",     TELE_GROUP_IMU,      TELE_INT16, 1},
+  {"accX",      TELE_GROUP_IMU,      TELE_INT16, 3},       // g
+  {"accY",      TELE_GROUP_IMU,      TELE_INT16, 3},
+  {"accZ",      TELE_GROUP_IMU,      TELE_INT16, 3},
+  {"comX",      TELE_GROUP_IMU,      TELE_INT16, 3},
+  {"comY",      TELE_GROUP_IMU,      TELE_INT16, 3},
+  {"comZ",      TELE_GROUP_IMU,      TELE_INT16, 3},
+  {"lrpm_curr", TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"rrpm_curr", TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"lrpm_set",  TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"rrpm_set",  TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"lpwm",      TELE_GROUP_MOTOR,    TELE_INT16, 0},
+  {"rpwm",      TELE_GROUP_MOTOR,    TELE_INT16, 0},
+  {"lerr",      TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"rerr",      TELE_GROUP_MOTOR,    TELE_INT16, 1},
+  {"mowpwm",    TELE_GROUP_MOTOR,    TELE_INT16, 0},
+  {"motL",      TELE_GROUP_SENSORS,  TELE_INT16, 0},       // W (motor power)
+  {"motR",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"motM",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"sonL",      TELE_GROUP_SENSORS,  TELE_INT16, 0},       // cm
+  {"sonC",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"sonR",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"bumL",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"bumR",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"dropL",     TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"dropR",     TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"lawn",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"rain",      TELE_GROUP_SENSORS,  TELE_INT16, 0},
+  {"batV",      TELE_GROUP_BATTERY,  TELE_INT16, 2},       // V
+  {"chgV",      TELE_GROUP_BATTERY,  TELE_INT16, 2},       // V
+  {"chgA",      TELE_GROUP_BATTERY,  TELE_INT16, 3},       // A
+  {"capacity",  TELE_GROUP_BATTERY,  TELE_INT32, 0},       // mAh
+  {"odoL",      TELE_GROUP_ODOMETRY, TELE_INT32, 0},       // ticks
+  {"odoR",      TELE_GROUP_ODOMETRY, TELE_INT32, 0},
+  {"odoX",      TELE_GROUP_ODOMETRY, TELE_INT32, 1},       // cm
+  {"odoY",      TELE_GROUP_ODOMETRY, TELE_INT32, 1},
+  {"mag",       TELE_GROUP_PERIMETER, TELE_INT32, 0},
+  {"smag",      TELE_GROUP_PERIMETER, TELE_INT32, 0},
+  {"in",        TELE_GROUP_PERIMETER, TELE_INT16, 0},
+  {"cnt",       TELE_GROUP_PERIMETER, TELE_INT16, 0},
+  {"on",        TELE_GROUP_PERIMETER, TELE_INT16, 0},
+  {"qty",       TELE_GROUP_PERIMETER, TELE_INT16, 3},
+  {"hdop",      TELE_GROUP_GPS,      TELE_INT32, 2},
+  {"sats",      TELE_GROUP_GPS,      TELE_INT16, 0},
+  {"speed_kn",  TELE_GROUP_GPS,      TELE_INT32, 2},
+  {"course",    TELE_GROUP_GPS,      TELE_INT32, 2},       // deg
+  {"alt",       TELE_GROUP_GPS,      TELE_INT32, 2},       // m
+  {"lat",       TELE_GROUP_GPS,      TELE_INT32, 5},       // deg
+  {"lon",       TELE_GROUP_GPS,      TELE_INT32, 5},
+  {"gpsX",      TELE_GROUP_GPS,      TELE_INT32, 2},       // m
+  {"gpsY",      TELE_GROUP_GPS,      TELE_INT32, 2},
+  {"poseX",     TELE_GROUP_POSE,     TELE_INT32, 1},       // cm (east)
+  {"poseY",     TELE_GROUP_POSE,     TELE_INT32, 1},       // cm (north)
+  {"poseHdg",   TELE_GROUP_POSE,     TELE_INT16, 2},       // deg
+  {"poseSpeed", TELE_GROUP_POSE,     TELE_INT16, 1},       // cm/s
+  {"poseStd",   TELE_GROUP_POSE,     TELE_INT16, 1},       // cm
+  {"poseValid", TELE_GROUP_POSE,     TELE_INT16, 0},
+};
+
+// data frame payload with all groups selected (schema id, millis, values)
+static constexpr int teleDataSize(int ch){
+  return (ch >= TELE_CHANNEL_COUNT) ? 5 : ((teleChannels[ch].type == TELE_INT32) ? 4 : 2) + teleDataSize(ch + 1);
+}
+
+static_assert(teleDataSize(0) <= TELE_MAX_PAYLOAD, "telemetry: increase TELE_MAX_PAYLOAD");
+static_assert(TELE_MAX_PAYLOAD <= 255, "telemetry: payload length is one byte");
+
+
+Telemetry::Telemetry(){
+  serialPort = NULL;
+  groupMask = TELE_GROUP_IMU | TELE_GROUP_MOTOR;
+  period = 50;
+  schemaId = 0;
+  seq = 0;
+  nextSchemaTime = 0;
+  frameCount = dropCount = 0;
+  schemaChannel = TELE_CHANNEL_COUNT;
+  schemaIdx = 0;
+  len = 0;
+  overflow = false;
+}
+
+void Telemetry::begin(HardwareSerial *aSerialPort){
+  serialPort = aSerialPort;
+  nextSchemaTime = millis();
+}
+
+// new schema id only if the selection or the rate changes, schema is sent again
+void Telemetry::setup(byte aGroupMask, unsigned int aPeriod){
+  if ((aGroupMask != groupMask) || (aPeriod != period)) schemaId++;
+  groupMask = aGroupMask;
+  period = aPeriod;
+  nextSchemaTime = millis();
+}
+
+boolean Telemetry::isSelected(byte ch){
+  byte group = pgm_read_byte(&teleChannels[ch].group);
+  return ((group == 0) || (groupMask & group));
+}
+
+int Telemetry::getDataFrameSize(){
+  int size = 8 + 5;
+  for (byte ch=0; ch < TELE_CHANNEL_COUNT; ch++){
+    if (isSelected(ch)) size += (pgm_read_byte(&teleChannels[ch].type) == TELE_INT32) ? 4 : 2;
+  }
+  return size;
+}
+
+void Telemetry::beginFrame(byte type){
+  frame[0] = TELE_SYNC1;
+  frame[1] = TELE_SYNC2;
+  frame[2] = TELE_VERSION;
+  frame[3] = type;
+  frame[4] = seq++;
+  len = 0;
+  overflow = false;
+}
+
+void Telemetry::add8(byte value){
+  if (len < TELE_MAX_PAYLOAD) frame[6 + len++] = value;
+    else overflow = true;
+}
+
+void Telemetry::add16(uint16_t value){
+  add8(value & 0xFF);
+  add8(value >> 8);
+}
+
+void Telemetry::add32(uint32_t value){
+  add16(value & 0xFFFF);
+  add16(value >> 16);
+}
+
+// complete frame (length, CRC) and send it - dropped if it does not fit into the free TX buffer
+boolean Telemetry::endFrame(){
+  if (serialPort == NULL) return false;
+  if (overflow) {
+    dropCount++;
+    return false;
+  }
+  frame[5] = len;
+  uint16_t crc = 0xFFFF;
+  for (int i=2; i < 6 + len; i++) crc = crc16(crc, frame[i]);
+  frame[6 + len] = crc & 0xFF;
+  frame[7 + len] = crc >> 8;
+  int size = 8 + len;
+  if (serialPort->availableForWrite() < size) {
+    dropCount++;
+    return false;
+  }
+  serialPort->write(frame, size);
+  frameCount++;
+  return true;
+}
+
+// schema header (channel frames follow one per data frame, see sendSchemaChannel)
+void Telemetry::sendSchema(){
+  byte count = 0;
+  for (byte ch=0; ch < TELE_CHANNEL_COUNT; ch++) if (isSelected(ch)) count++;
+  beginFrame(TELE_FRAME_SCHEMA);
+  add8(schemaId);
+  add8(groupMask);
+  add16(period);
+  add8(count);
+  if (endFrame()) {
+    schemaChannel = 0;
+    schemaIdx = 0;
+  }
+}
+
+// next channel description of the schema (if any left)
+void Telemetry::sendSchemaChannel(){
+  while ((schemaChannel < TELE_CHANNEL_COUNT) && (!isSelected(schemaChannel))) schemaChannel++;
+  if (schemaChannel >= TELE_CHANNEL_COUNT) return;
+  telechannel_t c;
+  memcpy_P(&c, &teleChannels[schemaChannel], sizeof c);
+  beginFrame(TELE_FRAME_CHANNEL);
+  add8(schemaId);
+  add8(schemaIdx);
+  add8(schemaChannel);
+  add8(c.type);
+  add8(c.decimals);
+  for (byte i=0; (i < TELE_NAME_SIZE) && (c.name[i]); i++) add8(c.name[i]);
+  if (endFrame()) {
+    schemaChannel++;
+    schemaIdx++;
+  }
+}
@@ -0,0 +1,172 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+binary telemetry stream (framed, versioned, CRC protected, fixed-point values)
+
+frame:   0xA5 0x5A | version | type | seq | len | payload (len bytes) | crc16 (lo, hi)
+         crc16 = CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over version..payload
+         all multi-byte values are little-endian
+
+types:   TELE_FRAME_SCHEMA   payload: schemaId, groupMask, periodMs (u16), channel count
+         TELE_FRAME_CHANNEL  payload: schemaId, index, channel id, value type, decimals, name
+         TELE_FRAME_DATA     payload: schemaId, millis (u32), one value per selected channel
+                             (in schema order, TELE_INT16 or TELE_INT32, physical value = raw / 10^decimals)
+
+The schema is sent on start and every TELE_SCHEMA_INTERVAL ms (one channel frame along with each
+data frame), so a decoder can join any time (see tools/telemetry_decode.py). Frames are dropped (not delayed) unless the
+whole frame fits into the free serial TX buffer (the frame size must stay below the TX buffer size, e.g. 64 bytes on the
+Mega: select fewer groups or increase SERIAL_TX_BUFFER_SIZE).
+The channel table and the group names are in program memory (PROGMEM).
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+#define TELE_VERSION 1
+#define TELE_SYNC1 0xA5
+#define TELE_SYNC2 0x5A
+#define TELE_MAX_PAYLOAD 168      // data frame with all groups: 165 bytes (checked in telemetry.cpp)
+#define TELE_SCHEMA_INTERVAL 5000
+#define TELE_NAME_SIZE 10
+
+// frame types
+enum { TELE_FRAME_SCHEMA = 1, TELE_FRAME_CHANNEL = 2, TELE_FRAME_DATA = 3 };
+
+// value types
+enum { TELE_INT16 = 1, TELE_INT32 = 2 };
+
+// channel groups (selectable)
+enum {
+  TELE_GROUP_IMU       = 1,
+  TELE_GROUP_MOTOR     = 2,
+  TELE_GROUP_SENSORS   = 4,
+  TELE_GROUP_BATTERY   = 8,
+  TELE_GROUP_ODOMETRY  = 16,
+  TELE_GROUP_PERIMETER = 32,
+  TELE_GROUP_GPS       = 64,
+  TELE_GROUP_POSE      = 128,
+};
+
+#define TELE_GROUP_COUNT 8
+
+// channels
+enum {
+  TELE_STATE,
+  TELE_YAW, TELE_PITCH, TELE_ROLL,
+  TELE_GYRO_X, TELE_GYRO_Y, TELE_GYRO_Z,
+  TELE_ACC_X, TELE_ACC_Y, TELE_ACC_Z,
+  TELE_COM_X, TELE_COM_Y, TELE_COM_Z,
+  TELE_LRPM_CURR, TELE_RRPM_CURR, TELE_LRPM_SET, TELE_RRPM_SET,
+  TELE_LPWM, TELE_RPWM, TELE_LERR, TELE_RERR, TELE_MOW_PWM,
+  TELE_MOT_L_SENSE, TELE_MOT_R_SENSE, TELE_MOT_M_SENSE,       // motor power (W)
+  TELE_SON_L, TELE_SON_C, TELE_SON_R,
+  TELE_BUMPER_L, TELE_BUMPER_R, TELE_DROP_L, TELE_DROP_R,
+  TELE_LAWN, TELE_RAIN,
+  TELE_BAT_VOLT, TELE_CHG_VOLT, TELE_CHG_CURR, TELE_BAT_CAPACITY,
+  TELE_ODO_LEFT, TELE_ODO_RIGHT, TELE_ODO_X, TELE_ODO_Y,
+  TELE_PERI_MAG, TELE_PERI_SMAG, TELE_PERI_INSIDE, TELE_PERI_CNT, TELE_PERI_ON, TELE_PERI_QTY,
+  TELE_GPS_HDOP, TELE_GPS_SATS, TELE_GPS_SPEED, TELE_GPS_COURSE, TELE_GPS_ALT,
+  TELE_GPS_LAT, TELE_GPS_LON, TELE_GPS_X, TELE_GPS_Y,
+  TELE_POSE_X, TELE_POSE_Y, TELE_POSE_HEADING, TELE_POSE_SPEED, TELE_POSE_STD, TELE_POSE_VALID,
+  TELE_CHANNEL_COUNT,
+};
+
+
+struct telechannel_t {
+  char name[TELE_NAME_SIZE];
+  byte group;       // 0 = always sent
+  byte type;
+  byte decimals;    // raw = value * 10^decimals
+};
+
+typedef struct telechannel_t telechannel_t;
+
+extern const telechannel_t teleChannels[TELE_CHANNEL_COUNT] PROGMEM;
+extern const char teleGroupNames[TELE_GROUP_COUNT][TELE_NAME_SIZE] PROGMEM;
+
+
+class Telemetry
+{
+  public:
+    Telemetry();
+    void begin(HardwareSerial *aSerialPort);
+    // select channel groups and rate, starts a new schema
+    void setup(byte aGroupMask, unsigned int aPeriod);
+    byte getGroupMask(){ return groupMask; }
+    unsigned int getPeriod(){ return period; }
+    boolean isSelected(byte ch);
+    // send schema (part) and one data frame, values are fetched (fixed-point) with getRaw
+    template <class T> void send(T *obj, long (T::*getRaw)(byte ch));
+    unsigned long getFrameCount(){ return frameCount; }
+    unsigned long getDropCount(){ return dropCount; }
+    // data frame size (bytes) of the selected groups
+    int getDataFrameSize();
+  private:
+    HardwareSerial *serialPort;
+    byte groupMask;
+    unsigned int period;
+    byte schemaId;
+    byte seq;
+    unsigned long nextSchemaTime;
+    unsigned long frameCount;
+    unsigned long dropCount;
+    byte frame[TELE_MAX_PAYLOAD + 8];
+    byte len;
+    boolean overflow;    // payload exceeded TELE_MAX_PAYLOAD: frame is dropped
+    void beginFrame(byte type);
+    void add8(byte value);
+    void add16(uint16_t value);
+    void add32(uint32_t value);
+    boolean endFrame();
+    byte schemaChannel;  // next channel to describe
+    byte schemaIdx;
+    void sendSchema();
+    void sendSchemaChannel();
+};
+
+
+template <class T> void Telemetry::send(T *obj, long (T::*getRaw)(byte ch)){
+  if ((long)(millis() - nextSchemaTime) >= 0){
+    nextSchemaTime = millis() + TELE_SCHEMA_INTERVAL;
+    sendSchema();
+  } else sendSchemaChannel();
+  beginFrame(TELE_FRAME_DATA);
+  add8(schemaId);
+  add32(millis());
+  for (byte ch=0; ch < TELE_CHANNEL_COUNT; ch++){
+    if (!isSelected(ch)) continue;
+    long raw = (obj->*getRaw)(ch);
+    if (pgm_read_byte(&teleChannels[ch].type) == TELE_INT16) {
+      raw = max(-32768L, min(32767L, raw));
+      add16((uint16_t)((int16_t)raw));
+    } else add32((uint32_t)raw);
+  }
+  endFrame();
+}
+
+
+#endif
+
@@ -0,0 +1,121 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "txbuffer.h"
+
+
+TxBuffer::TxBuffer(HardwareSerial &port) : port(port) {
+  head = tail = 0;
+  pendingMax = 0;
+  droppedLines = 0;
+  waits = 0;
+}
+
+void TxBuffer::begin(unsigned long baud){
+  port.begin(baud);
+}
+
+boolean TxBuffer::reserve(int size){
+  run();
+  if (TXBUFFER_SIZE - 1 - getPending() >= size) return true;
+  droppedLines++;
+  return false;
+}
+
+void TxBuffer::run(){
+  while (head != tail){
+    int room = port.availableForWrite();
+    if (room <= 0) return;
+    // contiguous part of the queued bytes
+    int count = (head > tail) ? head - tail : TXBUFFER_SIZE - tail;
+    count = min(count, room);
+    port.write(buf + tail, count);
+    tail = (tail + count) % TXBUFFER_SIZE;
+  }
+}
+
+int TxBuffer::availableForWrite(){
+  return TXBUFFER_SIZE - 1 - getPending();
+}
+
+size_t TxBuffer::write(uint8_t c){
+  return write(&c, 1);
+}
+
+size_t TxBuffer::write(const uint8_t *buffer, size_t size){
+  size_t written = size;
+  if (head == tail) {
+    // nothing queued: straight into the port as far as it has room
+    int count = min((int)size, port.availableForWrite());
+    if (count > 0) {
+      port.write(buffer, count);
+      buffer += count;
+      size -= count;
+    }
+  }
+  boolean waited = false;
+  while (size > 0){
+    int next = (head + 1) % TXBUFFER_SIZE;
+    if (next == tail) {
+      // buffer full: wait for the port
+      waited = true;
+      run();
+      continue;
+    }
+    buf[head] = *buffer++;
+    head = next;
+    size--;
+  }
+  if (waited) waits++;
+  pendingMax = max(pendingMax, getPending());
+  run();
+  return written;
+}
+
+void TxBuffer::flush(){
+  while (head != tail) run();
+  port.flush();
+}
+
+int TxBuffer::available(){
+  return port.available();
+}
+
+int TxBuffer::read(){
+  return port.read();
+}
+
+int TxBuffer::peek(){
+  return port.peek();
+}
+
+void TxBuffer::printReport(Print &s){
+  s.print(F("console tx: size="));
+  s.print(TXBUFFER_SIZE);
+  s.print(F(" pending max="));
+  s.print(pendingMax);
+  s.print(F(" dropped lines="));
+  s.print(droppedLines);
+  s.print(F(" waits="));
+  s.println(waits);
+}
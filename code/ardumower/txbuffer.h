@@ -0,0 +1,90 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+serial TX ring buffer (console): output is queued in RAM and moved into the interrupt driven TX buffer
+of the serial port as far as it has room (availableForWrite), so printing costs a memory copy and the
+loop does not wait for the UART
+
+- run() (robot loop) and each write move queued bytes to the port, never waiting
+- log lines that may be dropped (periodic info): reserve(size) returns false if the buffer cannot take
+  them without waiting, the caller skips the line (counted), so a slow or stalled port (e.g. Bluetooth
+  back-pressure) never blocks the loop
+- other output (menus, replies): waits for room when the buffer is full (like a plain serial write)
+- input (available/read/peek) is read from the port, i.e. the buffer replaces the port as 'Console'
+
+How to use it (example):
+  TxBuffer ConsoleTx(Serial);
+  ConsoleTx.begin(115200);
+  if (ConsoleTx.reserve(100)) Streamprint(ConsoleTx, "t%6u\r\n", value);
+  ConsoleTx.run();                                         // each loop
+*/
+
+#ifndef TXBUFFER_H
+#define TXBUFFER_H
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+  #define TXBUFFER_SIZE 256
+#else
+  #define TXBUFFER_SIZE 2048
+#endif
+
+
+class TxBuffer : public Stream
+{
+  public:
+    TxBuffer(HardwareSerial &port);
+    void begin(unsigned long baud);
+    // room for a line of 'size' bytes without waiting? (false: line dropped, counted)
+    boolean reserve(int size);
+    // moves queued bytes to the port (does not wait)
+    void run();
+    int getPending(){ return (head - tail + TXBUFFER_SIZE) % TXBUFFER_SIZE; }
+    int getPendingMax(){ return pendingMax; }
+    unsigned long getDroppedLines(){ return droppedLines; }
+    unsigned long getWaits(){ return waits; }
+    void printReport(Print &s);
+    // Stream
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    int availableForWrite();
+    operator bool() { return true; }
+  private:
+    HardwareSerial &port;
+    uint8_t buf[TXBUFFER_SIZE];
+    int head;              // next free slot
+    int tail;              // next byte to send
+    int pendingMax;
+    unsigned long droppedLines;
+    unsigned long waits;
+};
+
+
+#endif
@@ -0,0 +1,218 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+  
+  Private-use only! (you need to ask for a commercial-use)
+ 
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+user settings schema: every persistent user setting is listed once (USER_SETTINGS below) with
+
+  id      stable record id (never reuse or renumber an id, append new settings with a new id)
+  name    id constant (e.g. for pfod menu items)
+  member  Robot member (type and size are taken from the member declaration)
+  min/max value range (pfod sliders)
+  scale   slider resolution (pfod sliders)
+  flags   SETF_LEGACY: part of the old (MAGIC 52) EEPROM layout, read in list order for migration
+
+The settings image (ADDR_SETTINGS_IMAGE) is written in one piece:
+
+  header:  magic (u16) | version | reserved | count (u16) | payload size (u16) | crc16 (u16, payload) | reserved (u16)
+  payload: one record per setting: id (u16) | kind | size | value (size bytes, little-endian)
+
+Loading looks up each record by id and converts the value to the current member type (e.g. int
+is 2 bytes on Mega, 4 bytes on Due), unknown ids are skipped and missing settings keep their
+default (Mower constructor), so settings can be added, removed or reordered without
+invalidating saved settings.
+*/
+
+#ifndef USERSETTINGS_H
+#define USERSETTINGS_H
+
+#include <Arduino.h>
+
+#define SETTINGS_IMAGE_MAGIC 0x5453
+#define SETTINGS_IMAGE_VERSION 1
+#define SETTINGS_IMAGE_SIZE 1024
+#define SETTINGS_HEADER_SIZE 12
+#define SETTINGS_STRING_MAX 64
+
+// value kinds
+enum { SET_BOOL = 1, SET_INT, SET_UINT, SET_FLOAT, SET_STRING, SET_BLOB };
+
+// flags
+#define SETF_LEGACY 1
+
+
+// id    name                                                           member                                           min     max     scale  flags
+#define USER_SETTINGS(X) \
+  X(  1, SETTING_DEVELOPER_ACTIVE,                                      developerActive,                                 0,      1,      1,     SETF_LEGACY) \
+  X(  2, SETTING_MOTOR_ACCEL,                                           motorAccel,                                      500,    2000,   1,     SETF_LEGACY) \
+  X(  3, SETTING_MOTOR_SPEED_MAX_RPM,                                   motorSpeedMaxRpm,                                0,      100,    1,     SETF_LEGACY) \
+  X(  4, SETTING_MOTOR_SPEED_MAX_PWM,                                   motorSpeedMaxPwm,                                0,      255,    1,     SETF_LEGACY) \
+  X(  5, SETTING_MOTOR_POWER_MAX,                                       motorPowerMax,                                   0,      100,    0.1,   SETF_LEGACY) \
+  X(  6, SETTING_MOTOR_SENSE_RIGHT_SCALE,                               motorSenseRightScale,                            0,      30,     0.01,  SETF_LEGACY) \
+  X(  7, SETTING_MOTOR_SENSE_LEFT_SCALE,                                motorSenseLeftScale,                             0,      30,     0.01,  SETF_LEGACY) \
+  X(  8, SETTING_MOTOR_ROLL_TIME_MAX,                                   motorRollTimeMax,                                0,      8000,   1,     SETF_LEGACY) \
+  X(  9, SETTING_MOTOR_ROLL_TIME_MIN,                                   motorRollTimeMin,                                0,      8000,   1,     SETF_LEGACY) \
+  X( 10, SETTING_MOTOR_REVERSE_TIME,                                    motorReverseTime,                                0,      8000,   1,     SETF_LEGACY) \
+  X( 11, SETTING_MOTOR_POWER_IGNORE_TIME,                               motorPowerIgnoreTime,                            0,      8000,   1,     SETF_LEGACY) \
+  X( 12, SETTING_MOTOR_FORW_TIME_MAX,                                   motorForwTimeMax,                                0,      80000,  10,    SETF_LEGACY) \
+  X( 13, SETTING_MOTOR_MOW_SPEED_MAX_PWM,                               motorMowSpeedMaxPwm,                             0,      255,    1,     SETF_LEGACY) \
+  X( 14, SETTING_MOTOR_MOW_POWER_MAX,                                   motorMowPowerMax,                                0,      100,    0.1,   SETF_LEGACY) \
+  X( 15, SETTING_MOTOR_MOW_RPM_SET,                                     motorMowRPMSet,                                  0,      4500,   1,     SETF_LEGACY) \
+  X( 16, SETTING_MOTOR_MOW_SENSE_SCALE,                                 motorMowSenseScale,                              0,      30,     0.01,  SETF_LEGACY) \
+  X( 17, SETTING_MOTOR_LEFT_PID_KP,                                     motorLeftPID.Kp,                                 0,      3,      0.01,  SETF_LEGACY) \
+  X( 18, SETTING_MOTOR_LEFT_PID_KI,                                     motorLeftPID.Ki,                                 0,      3,      0.01,  SETF_LEGACY) \
+  X( 19, SETTING_MOTOR_LEFT_PID_KD,                                     motorLeftPID.Kd,                                 0,      3,      0.01,  SETF_LEGACY) \
+  X( 20, SETTING_MOTOR_MOW_PID_KP,                                      motorMowPID.Kp,                                  0,      1,      0.01,  SETF_LEGACY) \
+  X( 21, SETTING_MOTOR_MOW_PID_KI,                                      motorMowPID.Ki,                                  0,      1,      0.01,  SETF_LEGACY) \
+  X( 22, SETTING_MOTOR_MOW_PID_KD,                                      motorMowPID.Kd,                                  0,      1,      0.01,  SETF_LEGACY) \
+  X( 23, SETTING_MOTOR_BI_DIR_SPEED_RATIO1,                             motorBiDirSpeedRatio1,                           0,      1,      0.01,  SETF_LEGACY) \
+  X( 24, SETTING_MOTOR_BI_DIR_SPEED_RATIO2,                             motorBiDirSpeedRatio2,                           0,      1,      0.01,  SETF_LEGACY) \
+  X( 25, SETTING_MOTOR_LEFT_SWAP_DIR,                                   motorLeftSwapDir,                                0,      1,      1,     SETF_LEGACY) \
+  X( 26, SETTING_MOTOR_RIGHT_SWAP_DIR,                                  motorRightSwapDir,                               0,      1,      1,     SETF_LEGACY) \
+  X( 27, SETTING_BUMPER_USE,                                            bumperUse,                                       0,      1,      1,     SETF_LEGACY) \
+  X( 28, SETTING_SONAR_USE,                                             sonarUse,                                        0,      1,      1,     SETF_LEGACY) \
+  X( 29, SETTING_SONAR_CENTER_USE,                                      sonarCenterUse,                                  0,      1,      1,     SETF_LEGACY) \
+  X( 30, SETTING_SONAR_LEFT_USE,                                        sonarLeftUse,                                    0,      1,      1,     SETF_LEGACY) \
+  X( 31, SETTING_SONAR_RIGHT_USE,                                       sonarRightUse,                                   0,      1,      1,     SETF_LEGACY) \
+  X( 32, SETTING_SONAR_TRIGGER_BELOW,                                   sonarTriggerBelow,                               0,      100,    1,     SETF_LEGACY) \
+  X( 33, SETTING_PERIMETER_USE,                                         perimeterUse,                                    0,      1,      1,     SETF_LEGACY) \
+  X( 34, SETTING_PERIMETER_TIMED_OUT_IF_BELOW_SMAG,                     perimeter.timedOutIfBelowSmag,                   0,      2000,   1,     SETF_LEGACY) \
+  X( 35, SETTING_PERIMETER_TRIGGER_TIMEOUT,                             perimeterTriggerTimeout,                         0,      2000,   1,     SETF_LEGACY) \
+  X( 36, SETTING_PERIMETER_OUT_ROLL_TIME_MAX,                           perimeterOutRollTimeMax,                         0,      8000,   1,     SETF_LEGACY) \
+  X( 37, SETTING_PERIMETER_OUT_ROLL_TIME_MIN,                           perimeterOutRollTimeMin,                         0,      8000,   1,     SETF_LEGACY) \
+  X( 38, SETTING_PERIMETER_OUT_REV_TIME,                                perimeterOutRevTime,                             0,      8000,   1,     SETF_LEGACY) \
+  X( 39, SETTING_PERIMETER_TRACK_ROLL_TIME,                             perimeterTrackRollTime,                          0,      8000,   1,     SETF_LEGACY) \
+  X( 40, SETTING_PERIMETER_TRACK_REV_TIME,                              perimeterTrackRevTime,                           0,      8000,   1,     SETF_LEGACY) \
+  X( 41, SETTING_PERIMETER_PID_KP,                                      perimeterPID.Kp,                                 0,      100,    0.1,   SETF_LEGACY) \
+  X( 42, SETTING_PERIMETER_PID_KI,                                      perimeterPID.Ki,                                 0,      100,    0.1,   SETF_LEGACY) \
+  X( 43, SETTING_PERIMETER_PID_KD,                                      perimeterPID.Kd,                                 0,      100,    0.1,   SETF_LEGACY) \
+  X( 44, SETTING_PERIMETER_SIGNAL_CODE_NO,                              perimeter.signalCodeNo,                          0,      3,      1,     SETF_LEGACY) \
+  X( 45, SETTING_PERIMETER_SWAP_COIL_POLARITY,                          perimeter.swapCoilPolarity,                      0,      1,      1,     SETF_LEGACY) \
+  X( 46, SETTING_PERIMETER_TIME_OUT_SEC_IF_NOT_INSIDE,                  perimeter.timeOutSecIfNotInside,                 1,      20,     1,     SETF_LEGACY) \
+  X( 47, SETTING_TRACKING_BLOCK_INNER_WHEEL_WHILE_PERIMETER_STRUGGLING, trackingBlockInnerWheelWhilePerimeterStruggling, 0,      1,      1,     SETF_LEGACY) \
+  X( 48, SETTING_LAWN_SENSOR_USE,                                       lawnSensorUse,                                   0,      1,      1,     SETF_LEGACY) \
+  X( 49, SETTING_IMU_USE,                                               imuUse,                                          0,      1,      1,     SETF_LEGACY) \
+  X( 50, SETTING_IMU_CORRECT_DIR,                                       imuCorrectDir,                                   0,      1,      1,     SETF_LEGACY) \
+  X( 51, SETTING_IMU_DIR_PID_KP,                                        imuDirPID.Kp,                                    0,      20,     0.1,   SETF_LEGACY) \
+  X( 52, SETTING_IMU_DIR_PID_KI,                                        imuDirPID.Ki,                                    0,      20,     0.1,   SETF_LEGACY) \
+  X( 53, SETTING_IMU_DIR_PID_KD,                                        imuDirPID.Kd,                                    0,      20,     0.1,   SETF_LEGACY) \
+  X( 54, SETTING_IMU_ROLL_PID_KP,                                       imuRollPID.Kp,                                   0,      30,     0.1,   SETF_LEGACY) \
+  X( 55, SETTING_IMU_ROLL_PID_KI,                                       imuRollPID.Ki,                                   0,      30,     0.1,   SETF_LEGACY) \
+  X( 56, SETTING_IMU_ROLL_PID_KD,                                       imuRollPID.Kd,                                   0,      30,     0.1,   SETF_LEGACY) \
+  X( 57, SETTING_REMOTE_USE,                                            remoteUse,                                       0,      1,      1,     SETF_LEGACY) \
+  X( 58, SETTING_BAT_MONITOR,                                           batMonitor,                                      0,      1,      1,     SETF_LEGACY) \
+  X( 59, SETTING_BAT_GO_HOME_IF_BELOW,                                  batGoHomeIfBelow,                                0,      30,     0.1,   SETF_LEGACY) \
+  X( 60, SETTING_BAT_SWITCH_OFF_IF_BELOW,                               batSwitchOffIfBelow,                             0,      30,     0.1,   SETF_LEGACY) \
+  X( 61, SETTING_BAT_SWITCH_OFF_IF_IDLE,                                batSwitchOffIfIdle,                              1,      300,    1,     SETF_LEGACY) \
+  X( 62, SETTING_BAT_FACTOR,                                            batFactor,                                       0.30,   0.55,   0.001, SETF_LEGACY) \
+  X( 63, SETTING_BAT_CHG_FACTOR,                                        batChgFactor,                                    0.30,   0.55,   0.001, SETF_LEGACY) \
+  X( 64, SETTING_CHG_SENSE_ZERO,                                        chgSenseZero,                                    0,      1023,   1,     SETF_LEGACY) \
+  X( 65, SETTING_CHG_FACTOR,                                            chgFactor,                                       0.01,   0.06,   0.001, SETF_LEGACY) \
+  X( 66, SETTING_BAT_FULL_CURRENT,                                      batFullCurrent,                                  0,      10,     0.1,   SETF_LEGACY) \
+  X( 67, SETTING_START_CHARGING_IF_BELOW,                               startChargingIfBelow,                            0,      30,     0.1,   SETF_LEGACY) \
+  X( 68, SETTING_STATION_REV_TIME,                                      stationRevTime,                                  0,      8000,   1,     SETF_LEGACY) \
+  X( 69, SETTING_STATION_ROLL_TIME,                                     stationRollTime,                                 0,      8000,   1,     SETF_LEGACY) \
+  X( 70, SETTING_STATION_FORW_TIME,                                     stationForwTime,                                 0,      8000,   1,     SETF_LEGACY) \
+  X( 71, SETTING_STATION_CHECK_TIME,                                    stationCheckTime,                                0,      8000,   1,     SETF_LEGACY) \
+  X( 72, SETTING_ODOMETRY_USE,                                          odometryUse,                                     0,      1,      1,     SETF_LEGACY) \
+  X( 73, SETTING_ODOMETRY_TICKS_PER_REVOLUTION,                         odometryTicksPerRevolution,                      0,      2120,   1,     SETF_LEGACY) \
+  X( 74, SETTING_ODOMETRY_TICKS_PER_CM,                                 odometryTicksPerCm,                              0,      35,     0.1,   SETF_LEGACY) \
+  X( 75, SETTING_ODOMETRY_WHEEL_BASE_CM,                                odometryWheelBaseCm,                             0,      50,     0.1,   SETF_LEGACY) \
+  X( 76, SETTING_ODOMETRY_LEFT_SWAP_DIR,                                odometryLeftSwapDir,                             0,      1,      1,     SETF_LEGACY) \
+  X( 77, SETTING_ODOMETRY_RIGHT_SWAP_DIR,                               odometryRightSwapDir,                            0,      1,      1,     SETF_LEGACY) \
+  X( 78, SETTING_TWO_WAY_ODOMETRY_SENSOR_USE,                           twoWayOdometrySensorUse,                         0,      1,      1,     SETF_LEGACY) \
+  X( 79, SETTING_BUTTON_USE,                                            buttonUse,                                       0,      1,      1,     SETF_LEGACY) \
+  X( 80, SETTING_USER_SWITCH1,                                          userSwitch1,                                     0,      1,      1,     SETF_LEGACY) \
+  X( 81, SETTING_USER_SWITCH2,                                          userSwitch2,                                     0,      1,      1,     SETF_LEGACY) \
+  X( 82, SETTING_USER_SWITCH3,                                          userSwitch3,                                     0,      1,      1,     SETF_LEGACY) \
+  X( 83, SETTING_TIMER_USE,                                             timerUse,                                        0,      1,      1,     SETF_LEGACY) \
+  X( 84, SETTING_TIMER,                                                 timer,                                           0,      0,      0,     SETF_LEGACY) \
+  X( 85, SETTING_RAIN_USE,                                              rainUse,                                         0,      1,      1,     SETF_LEGACY) \
+  X( 86, SETTING_GPS_USE,                                               gpsUse,                                          0,      1,      1,     SETF_LEGACY) \
+  X( 87, SETTING_STUCK_IF_GPS_SPEED_BELOW,                              stuckIfGpsSpeedBelow,                            0,      3,      0.1,   SETF_LEGACY) \
+  X( 88, SETTING_GPS_SPEED_IGNORE_TIME,                                 gpsSpeedIgnoreTime,                              0,      10000,  1,     SETF_LEGACY) \
+  X( 89, SETTING_DROP_USE,                                              dropUse,                                         0,      1,      1,     SETF_LEGACY) \
+  X( 90, SETTING_STATS_OVERRIDE,                                        statsOverride,                                   0,      1,      1,     SETF_LEGACY) \
+  X( 91, SETTING_BLUETOOTH_USE,                                         bluetoothUse,                                    0,      1,      1,     SETF_LEGACY) \
+  X( 92, SETTING_ESP8266_USE,                                           esp8266Use,                                      0,      1,      1,     SETF_LEGACY) \
+  X( 93, SETTING_ESP8266_CONFIG_STRING,                                 esp8266ConfigString,                             0,      0,      0,     SETF_LEGACY) \
+  X( 94, SETTING_TILT_USE,                                              tiltUse,                                         0,      1,      1,     SETF_LEGACY) \
+  X( 95, SETTING_SONAR_SLOW_BELOW,                                      sonarSlowBelow,                                  0,      100,    1,     SETF_LEGACY) \
+  X( 96, SETTING_MOTOR_MOW_FORCE_OFF,                                   motorMowForceOff,                                0,      1,      1,     SETF_LEGACY) \
+  X( 97, SETTING_OBSTACLE_MAP_USE,                                      obstacleMapUse,                                  0,      1,      1,     0) \
+  X( 98, SETTING_OBSTACLE_MAP_SLOW_BELOW,                               obstacleMapSlowBelow,                            0,      200,    1,     0) \
+  X( 99, SETTING_LANE_WIDTH,                                            laneWidth,                                       10,     100,    1,     0) \
+  X(100, SETTING_LOCALIZE_USE,                                          localizeUse,                                     0,      1,      1,     0) \
+  X(101, SETTING_PERIMETER_CODE_MASK,                                   perimeter.codeMask,                              0,      7,      1,     0) \
+  X(102, SETTING_FUSION_USE,                                            fusionUse,                                       0,      1,      1,     0)
+
+
+// setting descriptor (stored in program memory on the Mega, read with memcpy_P)
+struct setting_t {
+  uint16_t id;
+  byte kind;
+  byte size;       // member size (bytes)
+  byte flags;
+  const char *name;
+  float minValue;
+  float maxValue;
+  float scale;
+};
+
+typedef struct setting_t setting_t;
+
+
+// value kind of a member type
+template <class T> struct settingkind { static const byte value = SET_BLOB; };
+template <> struct settingkind<bool> { static const byte value = SET_BOOL; };
+template <> struct settingkind<char> { static const byte value = SET_INT; };
+template <> struct settingkind<signed char> { static const byte value = SET_INT; };
+template <> struct settingkind<unsigned char> { static const byte value = SET_UINT; };
+template <> struct settingkind<short> { static const byte value = SET_INT; };
+template <> struct settingkind<unsigned short> { static const byte value = SET_UINT; };
+template <> struct settingkind<int> { static const byte value = SET_INT; };
+template <> struct settingkind<unsigned int> { static const byte value = SET_UINT; };
+template <> struct settingkind<long> { static const byte value = SET_INT; };
+template <> struct settingkind<unsigned long> { static const byte value = SET_UINT; };
+template <> struct settingkind<float> { static const byte value = SET_FLOAT; };
+template <> struct settingkind<double> { static const byte value = SET_FLOAT; };
+template <> struct settingkind<String> { static const byte value = SET_STRING; };
+
+
+#define SETTING_ID_ENTRY(id, name, member, minValue, maxValue, scale, flags) name = id,
+enum { USER_SETTINGS(SETTING_ID_ENTRY) };
+
+#define SETTING_COUNT_ENTRY(id, name, member, minValue, maxValue, scale, flags) +1
+#define SETTING_COUNT (0 USER_SETTINGS(SETTING_COUNT_ENTRY))
+
+extern const setting_t userSettings[SETTING_COUNT] PROGMEM;
+
+// descriptor of setting (index 0..SETTING_COUNT-1)
+void getSettingInfo(int idx, setting_t &info);
+boolean getSettingInfoById(uint16_t id, setting_t &info);
+
+// numeric setting value (bool, integer or float member) as float
+float getSettingFloat(const setting_t &info, void *value);
+void setSettingFloat(const setting_t &info, void *value, float v);
+
+
+#endif
@@ -1,26 +1,68 @@
-// running median filter   
-//
-// usage:
-//   RunningMedian<unsigned int,32> myMedian;
-//   if (myMedian.getStatus() == myMedian.OK)  myMedian.getMedian(_median);
-
-
-#ifndef RunningMedian_h
-#define RunningMedian_h
 //
 //    FILE: RunningMedian.h
 //  AUTHOR: Rob dot Tillaart at gmail dot com
 // PURPOSE: RunningMedian library for Arduino
-// VERSION: 0.2.00 - template edition
+// VERSION: 0.3.00 - template edition, incremental
 //     URL: http://arduino.cc/playground/Main/RunningMedian
-// HISTORY: 0.2.00 first template version by Ronny
+// HISTORY: 0.1.00 - 2011-02-16 initial version
+//          ...
+//          0.1.13 - 2015-10-30 fix getElement(n) - kudos to Gdunge
+//          0.2.00 first template version by Ronny (sender)
 //          0.2.01 added getAverage(uint8_t nMedians, float val)
+//          0.3.00 one template for robot and sender (value type T, N values), the buffer is no
+//                 longer re-sorted: the values are kept in two indexed heaps (see below)
 //
 // Released to the public domain
 //
+// running median filter (last N values, N <= 255)
+//
+// The values are kept in two heaps of ring buffer slots: a max-heap with the lower half and a
+// min-heap with the upper half of the values (lower root <= upper root). add() overwrites the
+// oldest value in its heap position and sifts it up/down (and swaps the roots if they are out
+// of order), i.e. O(log N) per value, the median is read from the roots, O(1). Highest/lowest scan the
+// heap leaves (O(N/2)), other order statistics select on a copy of the values (O(N), stack).
+//
+// usage:
+//   RunningMedian<int16_t,32> myMedian;
+//   myMedian.add(value);
+//   int16_t m = myMedian.getMedian();       (0 if empty, see getCount)
+//   if (myMedian.getStatus() == myMedian.OK)  myMedian.getMedian(_median);   (sender API)
+//
 
+#ifndef RunningMedian_h
+#define RunningMedian_h
+
+#include <Arduino.h>
 #include <inttypes.h>
 
+
+// n'th smallest of a[0..count-1] (a is reordered), average O(count)
+template <typename T> T selectElement(T *a, int count, int n){
+  int left = 0;
+  int right = count - 1;
+  while (left < right){
+    T pivot = a[(left + right) / 2];
+    int i = left;
+    int j = right;
+    while (i <= j){
+      while (a[i] < pivot) i++;
+      while (pivot < a[j]) j--;
+      if (i <= j){
+        T t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+        i++;
+        j--;
+      }
+    }
+    if (n <= j) right = j;
+      else if (n >= i) left = i;
+      else break;
+  }
+  return a[n];
+}
+
+
 template <typename T, int N> class RunningMedian {
 
 public:
@@ -28,109 +70,241 @@ public:
     enum STATUS {OK = 0, NOK = 1};
 
     RunningMedian() {
-        _size = N;
         clear();
     };
 
     void clear() {
         _cnt = 0;
         _idx = 0;
+        _nlo = _nhi = 0;
+    };
+
+    // adds a new value, replacing the oldest if full
+    void add(const T value) {
+        uint8_t slot = _idx;
+        _ar[slot] = value;
+        if (++_idx >= N) _idx = 0;   // wrap around
+        if (_cnt < N) {
+            _cnt++;
+            push((_nlo > 0) && (_ar[_heap[0]] < value), slot);
+            // balance: _nlo == _nhi or _nlo == _nhi + 1
+            if (_nlo > _nhi + 1) move(false);
+              else if (_nhi > _nlo) move(true);
+            return;
+        }
+        bool upper = (_pos[slot] >= _nlo);
+        siftDown(upper, siftUp(upper, index(slot)));
+        if ((_nhi > 0) && (_ar[_heap[N-1]] < _ar[_heap[0]])) {
+            // new value crossed the median: exchange roots
+            uint8_t lo = _heap[0];
+            uint8_t hi = _heap[N-1];
+            _heap[0] = hi;
+            _pos[hi] = 0;
+            _heap[N-1] = lo;
+            _pos[lo] = N-1;
+            siftDown(false, 0);
+            siftDown(true, 0);
+        }
     };
 
-    void add(T value) {
-        _ar[_idx++] = value;
-        if (_idx >= _size) _idx = 0; // wrap around
-        if (_cnt < _size) _cnt++;
+    // median (mean of the two middle values if count is even), 0 if empty
+    T getMedian() {
+        if (_cnt == 0) return 0;
+        T lo = _ar[_heap[0]];
+        if (_cnt & 0x01) return lo;
+        return lo + (_ar[_heap[N-1]] - lo) / 2;
     };
 
-    STATUS getMedian(T& value) {
-        if (_cnt > 0) {
-            sort();
-            value = _as[_cnt/2];
-            return OK;
-        }
-        return NOK;
+    float getAverage() {
+        if (_cnt == 0) return 0;
+        float sum = 0;
+        for (uint8_t i=0; i < _cnt; i++) sum += _ar[i];
+        return sum / _cnt;
     };
 
-    STATUS getAverage(float &value) {
-        if (_cnt > 0) {
-            float sum = 0;
-            for (uint8_t i=0; i< _cnt; i++) sum += _ar[i];
-            value = sum / _cnt;
-            return OK;
-        }
-        return NOK;
+    // average of the middle nMedians values (removes noise from outliers)
+    float getAverage(uint8_t nMedians) {
+        if ((_cnt == 0) || (nMedians == 0)) return 0;
+        if (_cnt < nMedians) nMedians = _cnt;     // when filling the array for first time
+        uint8_t start = ((_cnt - nMedians)/2);
+        T sorted[N];
+        copy(sorted);
+        selectElement(sorted, _cnt, start);
+        selectElement(sorted + start, _cnt - start, nMedians - 1);
+        float sum = 0;
+        for (uint8_t i = start; i < start + nMedians; i++) sum += sorted[i];
+        return sum / nMedians;
     };
 
-    STATUS getAverage(uint8_t nMedians, float &value) {
-        if ((_cnt > 0) && (nMedians > 0))
-        {
-            if (_cnt < nMedians) nMedians = _cnt;     // when filling the array for first time
-            uint8_t start = ((_cnt - nMedians)/2);
-            uint8_t stop = start + nMedians;
-            sort();
-            float sum = 0;
-            for (uint8_t i = start; i < stop; i++) sum += _as[i];
-            value = sum / nMedians;
-            return OK;
-        }
-        return NOK;
-    }
+    T getHighest() {
+        if (_cnt == 0) return 0;
+        if (_nhi == 0) return _ar[_heap[0]];
+        T value = _ar[_heap[N-1]];
+        for (uint8_t k = _nhi/2; k < _nhi; k++)
+            if (value < _ar[_heap[N-1-k]]) value = _ar[_heap[N-1-k]];
+        return value;
+    };
 
-    STATUS getHighest(T& value) {
-        if (_cnt > 0) {
-            sort();
-            value = _as[_cnt-1];
-            return OK;
-        }
-        return NOK;
+    T getLowest() {
+        if (_cnt == 0) return 0;
+        T value = _ar[_heap[0]];
+        for (uint8_t k = _nlo/2; k < _nlo; k++)
+            if (_ar[_heap[k]] < value) value = _ar[_heap[k]];
+        return value;
     };
 
-    STATUS getLowest(T& value) {
-        if (_cnt > 0) {
-            sort();
-            value =  _as[0];
-            return OK;
-        }
-        return NOK;
+    // n'th value in time order (0 = oldest)
+    T getElement(const uint8_t n) {
+        if (n >= _cnt) return 0;
+        uint16_t pos = ((_cnt < N) ? 0 : _idx) + n;
+        if (pos >= N) pos -= N;
+        return _ar[pos];
+    };
+
+    // n'th value in size order (0 = lowest)
+    T getSortedElement(const uint8_t n) {
+        if (n >= _cnt) return 0;
+        if (n == _cnt/2) return (_cnt & 0x01) ? _ar[_heap[0]] : _ar[_heap[N-1]];
+        if (((_cnt & 0x01) == 0) && (n + 1 == _cnt/2)) return _ar[_heap[0]];
+        T sorted[N];
+        copy(sorted);
+        return selectElement(sorted, _cnt, n);
+    };
+
+    // predict the max change of median after n additions (n < count/2)
+    T predict(const uint8_t n) {
+        if (n >= _cnt/2) return 0;
+        T med = getMedian();
+        uint8_t c = _cnt/2;
+        if (_cnt & 0x01) return max(med - getSortedElement(c - n), getSortedElement(c + n) - med);
+        T f1 = (getSortedElement(c - n) + getSortedElement(c - n - 1)) / 2;
+        T f2 = (getSortedElement(c + n) + getSortedElement(c + n - 1)) / 2;
+        return max(med - f1, f2 - med) / 2;
     };
 
     unsigned getSize() {
-        return _size;
+        return N;
     };
 
     unsigned getCount() {
         return _cnt;
-    }
+    };
+
+    // --- sender API (result in value, NOK if empty) ---
+
+    // middle value (upper one if count is even)
+    STATUS getMedian(T& value) {
+        if (_cnt == 0) return NOK;
+        value = (_cnt & 0x01) ? _ar[_heap[0]] : _ar[_heap[N-1]];
+        return OK;
+    };
+
+    STATUS getAverage(float &value) {
+        if (_cnt == 0) return NOK;
+        value = getAverage();
+        return OK;
+    };
+
+    STATUS getAverage(uint8_t nMedians, float &value) {
+        if ((_cnt == 0) || (nMedians == 0)) return NOK;
+        value = getAverage(nMedians);
+        return OK;
+    };
+
+    STATUS getHighest(T& value) {
+        if (_cnt == 0) return NOK;
+        value = getHighest();
+        return OK;
+    };
+
+    STATUS getLowest(T& value) {
+        if (_cnt == 0) return NOK;
+        value = getLowest();
+        return OK;
+    };
 
     STATUS getStatus() {
         return (_cnt > 0 ? OK : NOK);
     };
 
 private:
-    uint8_t _size;
     uint8_t _cnt;
-    uint8_t _idx;
-    T _ar[N];
-    T _as[N];
-    void sort() {
-        // copy
-        for (uint8_t i=0; i< _cnt; i++) _as[i] = _ar[i];
-
-        // sort all
-        for (uint8_t i=0; i< _cnt-1; i++) {
-            uint8_t m = i;
-            for (uint8_t j=i+1; j< _cnt; j++) {
-                if (_as[j] < _as[m]) m = j;
-            }
-            if (m != i) {
-                T t = _as[m];
-                _as[m] = _as[i];
-                _as[i] = t;
-            }
+    uint8_t _idx;      // next slot (oldest value if full)
+    uint8_t _nlo;      // lower half: max-heap in _heap[0.._nlo-1]
+    uint8_t _nhi;      // upper half: min-heap in _heap[N-1..N-_nhi] (reversed)
+    T _ar[N];          // values (ring buffer)
+    uint8_t _heap[N];  // heap position -> slot
+    uint8_t _pos[N];   // slot -> heap position
+
+    // k'th element of a heap
+    uint8_t &heapAt(bool upper, uint8_t k) {
+        return upper ? _heap[N-1-k] : _heap[k];
+    };
+
+    uint8_t index(uint8_t slot) {
+        return (_pos[slot] >= _nlo) ? N-1-_pos[slot] : _pos[slot];
+    };
+
+    // slot a belongs nearer to the root than slot b
+    bool before(bool upper, uint8_t a, uint8_t b) {
+        return upper ? (_ar[a] < _ar[b]) : (_ar[b] < _ar[a]);
+    };
+
+    void exchange(bool upper, uint8_t i, uint8_t j) {
+        uint8_t &a = heapAt(upper, i);
+        uint8_t &b = heapAt(upper, j);
+        uint8_t t = a;
+        a = b;
+        b = t;
+        _pos[a] = upper ? N-1-i : i;
+        _pos[b] = upper ? N-1-j : j;
+    };
+
+    uint8_t siftUp(bool upper, uint8_t k) {
+        while (k > 0) {
+            uint8_t parent = (k - 1) / 2;
+            if (!before(upper, heapAt(upper, k), heapAt(upper, parent))) break;
+            exchange(upper, k, parent);
+            k = parent;
+        }
+        return k;
+    };
+
+    void siftDown(bool upper, uint8_t k) {
+        uint8_t count = upper ? _nhi : _nlo;
+        while (true) {
+            uint16_t child = 2 * k + 1;
+            if (child >= count) break;
+            if ((child + 1 < count) && (before(upper, heapAt(upper, child + 1), heapAt(upper, child)))) child++;
+            if (!before(upper, heapAt(upper, child), heapAt(upper, k))) break;
+            exchange(upper, k, child);
+            k = child;
         }
     };
+
+    void push(bool upper, uint8_t slot) {
+        uint8_t k = upper ? _nhi++ : _nlo++;
+        heapAt(upper, k) = slot;
+        _pos[slot] = upper ? N-1-k : k;
+        siftUp(upper, k);
+    };
+
+    // move root of one heap to the other heap
+    void move(bool fromUpper) {
+        uint8_t slot = heapAt(fromUpper, 0);
+        uint8_t last = fromUpper ? --_nhi : --_nlo;
+        if (last > 0) {
+            heapAt(fromUpper, 0) = heapAt(fromUpper, last);
+            _pos[heapAt(fromUpper, 0)] = fromUpper ? N-1 : 0;
+            siftDown(fromUpper, 0);
+        }
+        push(!fromUpper, slot);
+    };
+
+    void copy(T *values) {
+        for (uint8_t i=0; i < _cnt; i++) values[i] = _ar[i];
+    };
 };
 
 #endif
-
+// END OF FILE
@@ -0,0 +1,119 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2014 by Alexander Grau
+  Copyright (c) 2013-2014 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+#include "currentctl.h"
+
+
+CurrentControl::CurrentControl(){
+  begin(0);
+}
+
+void CurrentControl::begin(float target){
+  this->target = target;
+  restart();
+  resetStatistics();
+}
+
+void CurrentControl::restart(){
+  duty = integral = CURRENTCTL_DUTY_MIN;
+  gain = CURRENTCTL_GAIN_MIN;
+  open = false;
+  holdUpdates = 0;
+  lastError = target;
+}
+
+void CurrentControl::resetStatistics(){
+  updates = saturated = faults = 0;
+  currentMin = 9999;
+  currentMax = 0;
+  currentSum = errorSqSum = 0;
+}
+
+float CurrentControl::update(float current, boolean fault){
+  float error = target - current;
+  lastError = error;
+  updates++;
+  currentMin = min(currentMin, current);
+  currentMax = max(currentMax, current);
+  currentSum += current;
+  errorSqSum += error * error;
+
+  if (fault){
+    // driver fault (over-current): back off, hold, then ramp up again
+    faults++;
+    integral = duty = max((float)CURRENTCTL_DUTY_MIN, duty / 2);
+    holdUpdates = CURRENTCTL_FAULT_HOLD;
+    return duty;
+  }
+  if (holdUpdates > 0){
+    holdUpdates--;
+    return duty;
+  }
+  // loop gain estimate (current of the last duty)
+  gain = max((float)CURRENTCTL_GAIN_MIN, current / duty);
+  // PI with the integrator clamped to the duty range (anti-windup)
+  integral = constrain(integral + CURRENTCTL_KI * error / gain, CURRENTCTL_DUTY_MIN, CURRENTCTL_DUTY_MAX);
+  float value = constrain(integral + CURRENTCTL_KP * error / gain, CURRENTCTL_DUTY_MIN, CURRENTCTL_DUTY_MAX);
+  duty = min(value, duty + CURRENTCTL_DUTY_SLEW);
+  integral = min(integral, duty);   // no windup while ramping
+  if ((duty >= CURRENTCTL_DUTY_MAX) || (duty <= CURRENTCTL_DUTY_MIN)) saturated++;
+  open = ((duty >= CURRENTCTL_DUTY_MAX) && (current < CURRENTCTL_OPEN_CURRENT));
+  return duty;
+}
+
+boolean CurrentControl::isSettled(){
+  return ((holdUpdates == 0) && (abs(lastError) <= 0.05 * target));
+}
+
+float CurrentControl::getCurrentAvg(){
+  if (updates == 0) return 0;
+  return currentSum / updates;
+}
+
+float CurrentControl::getErrorRms(){
+  if (updates == 0) return 0;
+  return sqrt(errorSqSum / updates);
+}
+
+void CurrentControl::print(Print &s){
+  s.print("target=");
+  s.print(target, 3);
+  s.print("\tduty=");
+  s.print(duty, 3);
+  s.print("\tgain=");
+  s.print(gain, 2);
+  s.print("\tcurrent min=");
+  s.print((updates == 0) ? 0 : currentMin, 3);
+  s.print("\tmax=");
+  s.print(currentMax, 3);
+  s.print("\tavg=");
+  s.print(getCurrentAvg(), 3);
+  s.print("\terrRms=");
+  s.print(getErrorRms(), 3);
+  s.print("\tsaturated=");
+  s.print(updates == 0 ? 0 : 100.0 * saturated / updates, 1);
+  s.print("%\tfaults=");
+  s.print(faults);
+  s.print("\topen=");
+  s.println(open);
+}
@@ -0,0 +1,105 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2014 by Alexander Grau
+  Copyright (c) 2013-2014 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+*/
+
+/*
+  perimeter loop current controller (sender): PI controller on the measured loop current, output is
+  the PWM duty of the motor driver
+
+  - loop current ~ duty * voltage / loop resistance: long or wet loops need more duty, short loops less
+  - adaptive: the loop gain (current per duty, i.e. voltage / resistance) is estimated from the
+    measurements and the PI gains are divided by it, so every loop settles equally fast (gains are
+    fractions of the current error corrected per update)
+  - integrator clamped to the duty range and the ramp (no windup while saturated, e.g. open loop at
+    max. duty)
+  - start and after a driver fault: duty ramps up from dutyMin (a fault halves the duty and holds it
+    for CURRENTCTL_FAULT_HOLD updates), i.e. a short loop never sees full duty
+  - open loop: max. duty and current below openCurrent
+  - statistics: current min/max/avg, rms error, saturated updates, faults
+
+  How to use it (example):
+    CurrentControl ctl;
+    ctl.begin(0.5);                                        // target loop current (A)
+    duty = ctl.update(periCurrentAvg, faultPinLow);        // every CURRENTCTL_PERIOD ms
+    if (ctl.isOpen()) ...                                  // wire broken
+    ctl.print(Serial);
+*/
+
+#ifndef CURRENTCTL_H
+#define CURRENTCTL_H
+
+#include <Arduino.h>
+
+#define CURRENTCTL_PERIOD       100      // ms, update period
+#define CURRENTCTL_KP           0.2      // fraction of the error (normalized by the loop gain)
+#define CURRENTCTL_KI           0.3      // fraction of the error per update (normalized by the loop gain)
+#define CURRENTCTL_GAIN_MIN     0.5      // A per duty, min. loop gain estimate (open loop, start)
+#define CURRENTCTL_DUTY_MIN     0.02
+#define CURRENTCTL_DUTY_MAX     1.0
+#define CURRENTCTL_DUTY_SLEW    0.05     // max. duty increase per update (ramp)
+#define CURRENTCTL_FAULT_HOLD   50       // updates
+#define CURRENTCTL_OPEN_CURRENT 0.03     // A
+
+
+class CurrentControl
+{
+  public:
+    CurrentControl();
+    void begin(float target);
+    // ramp up from dutyMin again (sender switched on)
+    void restart();
+    void setTarget(float value){ target = value; }
+    float getTarget(){ return target; }
+    // measured loop current (A), driver fault: returns the new duty (0..1)
+    float update(float current, boolean fault);
+    float getDuty(){ return duty; }
+    // estimated loop gain (A per duty)
+    float getGain(){ return gain; }
+    boolean isOpen(){ return open; }
+    boolean isSettled();
+    unsigned long getFaults(){ return faults; }
+    float getCurrentMin(){ return currentMin; }
+    float getCurrentMax(){ return currentMax; }
+    float getCurrentAvg();
+    float getErrorRms();
+    void resetStatistics();
+    void print(Print &s);
+  private:
+    float target;
+    float duty;
+    float integral;
+    float gain;
+    boolean open;
+    int holdUpdates;
+    float lastError;
+    // statistics
+    unsigned long updates;
+    unsigned long saturated;
+    unsigned long faults;
+    float currentMin;
+    float currentMax;
+    float currentSum;
+    float errorSqSum;
+};
+
+
+#endif
@@ -31,9 +31,10 @@
 #include "TimerOne.h"
 #include "EEPROM.h"
 #include "RunningMedian.h"
+#include "currentctl.h"
 
 
-// ---- choose only one perimeter signal code ----
+// ---- choose only one perimeter signal code (default, press 'c' to select another code, stored in EEPROM) ----
 #define SIGCODE_1  // Ardumower default perimeter signal
 //#define SIGCODE_2  // Ardumower alternative perimeter signal
 //#define SIGCODE_3  // Ardumower alternative perimeter signal
@@ -57,8 +58,14 @@
 #define pinFeedback A0  // M1_FB
 #define PERI_CURRENT_MIN    0.03     // minimum Ampere for perimeter-is-closed detection 
 
+// ---- sender current control (closed loop, requires USE_PERI_CURRENT) ----
+// duty-cycle is adjusted to hold the target loop current (long/wet loops: more duty, short loops: less)
+#define USE_CURRENT_CONTROL   1     // regulate loop current? (set to '0' for fixed duty)
+#define PERI_CURRENT_TARGET 0.5     // target loop current (Ampere), potentiometer: 0..PERI_CURRENT_TARGET_MAX
+#define PERI_CURRENT_TARGET_MAX 1.5
+
 // ---- sender current control (via potentiometer) ----
-// sender modulates signal (PWM), based on duty-cycle set via this potentiometer
+// sender modulates signal (PWM), based on duty-cycle (current control: target current) set via this potentiometer
 #define USE_POT      0  // use potentiometer for current control? (set to '0' if not connected!)
 #define pinPot      A3  // 100k potentiometer (current control)   
 
@@ -93,6 +100,7 @@ boolean isCharging = false;
 boolean stateLED = false;
 unsigned int chargeADCZero = 0;
 RunningMedian<unsigned int,16> periCurrentMeasurements;
+CurrentControl currentControl;
 RunningMedian<unsigned int,96> chargeCurrentMeasurements;
 
 int timeSeconds = 0;
@@ -108,14 +116,25 @@ int robotOutOfStationTimeMins = 0;
 // http://grauonline.de/alexwww/ardumower/filter/filter.html    
 // "pseudonoise4_pw" signal (sender)
 
+int8_t sigcodes[3][24] = {
+  { 1, 1,-1,-1, 1,-1, 1,-1,-1,1, -1, 1, 1,-1,-1, 1,-1,-1, 1,-1,-1, 1, 1,-1 },   // SIGCODE_1
+  { 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1,-1 },   // SIGCODE_2
+  { 1, 1,-1,-1, 1,-1, 1, 1,-1, 1, 1,-1,-1, 1, 1,-1, 1,-1,-1, 1,-1,-1, 1,-1 },   // SIGCODE_3
+};
+
 #if defined (SIGCODE_1)	
-  int8_t sigcode[] = { 1, 1,-1,-1, 1,-1, 1,-1,-1,1, -1, 1, 1,-1,-1, 1,-1,-1, 1,-1,-1, 1, 1,-1 };
+  #define SIGCODE_DEFAULT 1
 #elif defined (SIGCODE_2)   
-  int8_t sigcode[] = { 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1,-1 };
+  #define SIGCODE_DEFAULT 2
 #elif defined (SIGCODE_3)   
-  int8_t sigcode[] = { 1, 1,-1,-1, 1,-1, 1, 1,-1, 1, 1,-1,-1, 1, 1,-1, 1,-1,-1, 1,-1,-1, 1,-1 };
+  #define SIGCODE_DEFAULT 3
 #endif
 
+#define ADDR_SIGCODE 3   // EEPROM: selected code (1..3, otherwise default)
+
+int sigcodeNo = SIGCODE_DEFAULT;
+int8_t * volatile sigcode = sigcodes[SIGCODE_DEFAULT-1];
+
 
 // using transparently 5v / 1.1v ref
 int analogReadMillivolt(int pin){
@@ -151,7 +170,7 @@ void timerCallback(){
       digitalWrite(pinEnable, LOW);
     } 
     step ++;    
-    if (step == sizeof sigcode) {      
+    if (step == sizeof sigcodes[0]) {      
       step = 0;      
     }    
   } else {
@@ -166,6 +185,25 @@ void readEEPROM(){
   } else Serial.println("no EEPROM data found, using default calibration (INA169)");
   Serial.print("chargeADCZero=");
   Serial.println(chargeADCZero);  
+  int code = EEPROM.read(ADDR_SIGCODE);
+  setSigcode( ((code >= 1) && (code <= 3)) ? code : SIGCODE_DEFAULT );
+}
+
+// switches the signal code (starts at the beginning of the code)
+void setSigcode(int code){
+  noInterrupts();
+  sigcodeNo = code;
+  sigcode = sigcodes[code-1];
+  step = 0;
+  interrupts();
+  Serial.print("SIGCODE_");
+  Serial.println(sigcodeNo);
+}
+
+// next code, stored in EEPROM (robot must use the same code: perimeter signalCodeNo)
+void selectNextSigcode(){
+  setSigcode( (sigcodeNo % 3) + 1 );
+  EEPROM.write(ADDR_SIGCODE, sigcodeNo);
 }
 
 
@@ -211,14 +249,6 @@ void setup() {
   Serial.println("START");
   Serial.print("Ardumower Sender ");
   Serial.println(VER);
-  #if defined (SIGCODE_1)	
-		Serial.println("SIGCODE_1");
-	#elif defined (SIGCODE_2)   
-		Serial.println("SIGCODE_2");
-	#elif defined (SIGCODE_3)   
-		Serial.println("SIGCODE_3");
-	#endif
-  
   Serial.print("USE_PERI_FAULT=");
   Serial.println(USE_PERI_FAULT);
   Serial.print("USE_PERI_CURRENT=");
@@ -227,9 +257,13 @@ void setup() {
   Serial.println(USE_CHG_CURRENT ); 
   //Serial.println("press...");
   //Serial.println("  1  for current sensor calibration");  
+  Serial.println("press c to select the next signal code, s for current control statistics");  
   //Serial.println();
   
   readEEPROM();
+  currentControl.begin(PERI_CURRENT_TARGET);
+  Serial.print("USE_CURRENT_CONTROL=");
+  Serial.println(USE_CURRENT_CONTROL);
   Serial.print("T=");
   Serial.println(T);    
   Serial.print("f=");
@@ -260,6 +294,13 @@ void checkKey(){
         case '1': 
           calibrateChargeCurrentSensor();           
           break;
+        case 'c': 
+          selectNextSigcode();
+          break;
+        case 's': 
+          currentControl.print(Serial);   // current control statistics
+          currentControl.resetStatistics();
+          break;
       }
   }             
 }
@@ -284,13 +325,28 @@ void fault(){
 
 void loop(){    
   if (millis() >= nextTimeControl){                    
-    nextTimeControl = millis() + 100;
-    dutyPWM = ((int)(duty * 255.0));
+    nextTimeControl = millis() + CURRENTCTL_PERIOD;
+    if (USE_PERI_CURRENT) {
+      // determine perimeter current (Ampere)
+      float v = 0;
+      periCurrentMeasurements.getAverage(v);    
+      periCurrentAvg = ((double)v) / 1023.0 * 1.1 / 0.525;   // 525 mV per amp    
+    }
     if  ( (isCharging) || (robotOutOfStationTimeMins >= ROBOT_OUT_OF_STATION_TIMEOUT_MINS) ){
       // switch off perimeter 
       enableSender = false;
+      if (USE_CURRENT_CONTROL) currentControl.restart();   // ramp up again when switched on
+    } else if (USE_CURRENT_CONTROL && USE_PERI_CURRENT) {
+      // switch on perimeter, closed loop duty (driver fault: controller backs off, sender stays on)
+      enableSender = true;
+      boolean driverFault = ( USE_PERI_FAULT && (digitalRead(pinFault) == LOW) );
+      duty = currentControl.update(periCurrentAvg, driverFault);
+      dutyPWM = ((int)(duty * 255.0));
+      analogWrite(pinPWM, dutyPWM);
+      if (driverFault) fault();
     } else {
       // switch on perimeter
+      dutyPWM = ((int)(duty * 255.0));
       enableSender = true;
       //analogWrite(pinPWM, 255);
       analogWrite(pinPWM, dutyPWM);
@@ -327,9 +383,6 @@ void loop(){
     }  
     
     if (USE_PERI_CURRENT) {
-      // determine perimeter current (Ampere)
-      periCurrentMeasurements.getAverage(v);    
-      periCurrentAvg = ((double)v) / 1023.0 * 1.1 / 0.525;   // 525 mV per amp    
       unsigned int h;
       periCurrentMeasurements.getHighest(h);    
       periCurrentMax = ((double)h) / 1023.0 * 1.1 / 0.525;   // 525 mV per amp    
@@ -353,15 +406,25 @@ void loop(){
     Serial.print(duty);
     Serial.print("\tdutyPWM=");        
     Serial.print(dutyPWM);        
+    if (USE_CURRENT_CONTROL) {
+      Serial.print("\ttarget=");
+      Serial.print(currentControl.getTarget());
+      Serial.print("\topen=");
+      Serial.print(currentControl.isOpen());
+    }
     Serial.print("\tfaults=");
     Serial.print(faults); 
+    Serial.print("\tcode=");
+    Serial.print(sigcodeNo);
     Serial.print("\ttout=");    
     Serial.print(robotOutOfStationTimeMins);
     Serial.println();
     
     if (USE_POT){
       // read potentiometer
-      duty = max(0.01, ((float)map(analogRead(pinPot),  0,1023,   0,1000))  /1000.0 );
+      float value = max(0.01, ((float)map(analogRead(pinPot),  0,1023,   0,1000))  /1000.0 );
+      if (USE_CURRENT_CONTROL) currentControl.setTarget(value * PERI_CURRENT_TARGET_MAX);
+        else duty = value;
     }              
   }
   
@@ -0,0 +1,51 @@
+#include "coverage.h"
+#include <string.h>
+
+
+SimCoverage::SimCoverage(){
+  sizeX = sizeY = 0;
+  tilesX = tilesY = 0;
+  tileCount = 0;
+}
+
+
+SimCoverage::~SimCoverage(){
+  init(0, 0);
+}
+
+
+void SimCoverage::init(int aSizeX, int aSizeY){
+  for (unsigned int i=0; i < tiles.size(); i++) delete[] tiles[i];
+  sizeX = aSizeX;
+  sizeY = aSizeY;
+  tilesX = (sizeX + COVERAGE_TILE_SIZE-1) / COVERAGE_TILE_SIZE;
+  tilesY = (sizeY + COVERAGE_TILE_SIZE-1) / COVERAGE_TILE_SIZE;
+  tiles.assign(tilesX * tilesY, (unsigned char*)NULL);
+  tileCount = 0;
+}
+
+
+// two cells (nibbles) per byte: low nibble = even x, high nibble = odd x
+int SimCoverage::get(int x, int y){
+  if ((x < 0) || (y < 0) || (x >= sizeX) || (y >= sizeY)) return 0;
+  unsigned char *tile = tiles[(y / COVERAGE_TILE_SIZE) * tilesX + x / COVERAGE_TILE_SIZE];
+  if (tile == NULL) return 0;
+  int idx = (y % COVERAGE_TILE_SIZE) * COVERAGE_TILE_SIZE + (x % COVERAGE_TILE_SIZE);
+  return (tile[idx/2] >> ((idx & 1) * 4)) & 0x0F;
+}
+
+
+int SimCoverage::add(int x, int y){
+  if ((x < 0) || (y < 0) || (x >= sizeX) || (y >= sizeY)) return COVERAGE_MAX_PASSES;
+  unsigned char *&tile = tiles[(y / COVERAGE_TILE_SIZE) * tilesX + x / COVERAGE_TILE_SIZE];
+  if (tile == NULL){
+    tile = new unsigned char[COVERAGE_TILE_SIZE * COVERAGE_TILE_SIZE / 2];
+    memset(tile, 0, COVERAGE_TILE_SIZE * COVERAGE_TILE_SIZE / 2);
+    tileCount++;
+  }
+  int idx = (y % COVERAGE_TILE_SIZE) * COVERAGE_TILE_SIZE + (x % COVERAGE_TILE_SIZE);
+  int shift = (idx & 1) * 4;
+  int count = (tile[idx/2] >> shift) & 0x0F;
+  if (count < COVERAGE_MAX_PASSES) tile[idx/2] += (1 << shift);
+  return count;
+}
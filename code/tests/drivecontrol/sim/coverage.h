@@ -0,0 +1,57 @@
+/*
+  Ardumower (www.ardumower.de)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <vector>
+
+
+// tile size (cells, one cell = 1 cm)
+#define COVERAGE_TILE_SIZE 64
+
+// max. pass count per cell (4 bit)
+#define COVERAGE_MAX_PASSES 15
+
+
+/*
+  sparse lawn coverage map: pass count (4 bit) per 1 cm cell, stored in tiles that are
+  allocated on first touch (untouched lawn costs no memory)
+*/
+class SimCoverage
+{
+    int sizeX, sizeY;
+    int tilesX, tilesY;
+    std::vector<unsigned char*> tiles;  // NULL = not touched yet
+    int tileCount;
+  public:
+    SimCoverage();
+    ~SimCoverage();
+    // clears map, size in cells
+    void init(int aSizeX, int aSizeY);
+    // pass count of cell
+    int get(int x, int y);
+    // increments pass count of cell (saturated), returns previous count
+    int add(int x, int y);
+    // number of allocated tiles
+    int getTileCount(){ return tileCount; };
+    // allocated memory (bytes)
+    long getMemory(){ return (long)tileCount * COVERAGE_TILE_SIZE * COVERAGE_TILE_SIZE / 2; };
+};
+
+
+#endif
@@ -1,10 +1,17 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "sim.h"
 #include "simrobot.h"
 #include "world.h"
+#include "scenario.h"
 #include "../config.h"
 
 
@@ -13,10 +20,23 @@
 // World   -- simulator world (garden with perimeter loop etc.)
 // Robot   -- simulator robot
 
+// usage:
+//   sim [scenario]                                      interactive (OpenCV windows)
+//   sim --headless scenario [-n steps] [-p pattern] [-o results] [-c coverage]
+//                                                       one scenario, no windows, as fast as possible
+//   sim --batch [-j jobs] [-n steps] [-p pattern] [-c prefix] -o results scenario1 scenario2 ...
+//                                                       scenarios run in parallel (one headless process each)
+// coverage: coverage over time (CSV), batch: one file per scenario (prefix + scenario name + .csv)
+// pattern: overrides the mowing pattern of the scenario (random, lanes, bidir, planner)
 
 
-int main()
-{
+static double wallTime(){
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+
+int interactive(SimScenario &scenario){
 	//MotorCtrl.setup();
 	//Console.println("START");
 
@@ -27,6 +47,7 @@ int main()
 	printf("s   - skip tracking\n");
 	printf("ESC - exit\n");
 
+    Sim.setup(scenario);
     int stepWait = 10;
 	while( 1 ){
 		// Exit on esc key
@@ -57,3 +78,129 @@ int main()
 	return 0;
 }
 
+
+int headless(SimScenario &scenario, const char *resultsFile, const char *coverageFile){
+  FILE *coverageLog = NULL;
+  if (coverageFile != NULL){
+    coverageLog = fopen(coverageFile, "w");
+    if (coverageLog == NULL){
+      printf("cannot write %s\n", coverageFile);
+      return 1;
+    }
+  }
+  double startTime = wallTime();
+  Sim.verbose = false;
+  Sim.setup(scenario);
+  Sim.run(scenario, coverageLog);
+  double duration = wallTime() - startTime;
+  if (coverageLog != NULL) fclose(coverageLog);
+  printf("%s/%s: steps=%d time=%.1fs coverage=%.1f%% distance=%.1fm collisions=%d dock=%.1fs docks=%d (%.2fs)\n",
+         scenario.name.c_str(), SimScenario::patternName(scenario.pattern), Sim.stepCounter, Sim.simTime,
+         World.getCoverage(), Robot.totalDistance, Robot.num_collision, Robot.dockTime, Robot.docks, duration);
+  printf("  localization: error=%.1fcm (odometry %.1fcm) update=%.1fus\n", Sim.getLocError(), Sim.getOdoError(),
+         Sim.getLocUpdateTime());
+  if (scenario.gpsNoise > 0)
+    printf("  fusion: error=%.1fcm heading=%.2fdeg (gps %.1fcm) aligned=%.1fs bias=%.4frad/s rejects=%lu update=%.1fus\n",
+           Sim.getFusionError(), Sim.getFusionHeadingError() / M_PI * 180, Sim.getGpsError(), Sim.fusionAlignTime,
+           Sim.fusion.getGyroBias(), Sim.fusion.getRejects(), Sim.getFusionUpdateTime());
+  if (resultsFile == NULL) return 0;
+  return Sim.writeResult(resultsFile, scenario, duration) ? 0 : 1;
+}
+
+
+// runs each scenario in its own headless process (simulator state is global), 'jobs' at a time
+int batch(const char *program, std::vector<std::string> &scenarios, int jobs, long steps, const char *pattern,
+          const char *resultsFile, const char *coveragePrefix){
+  double startTime = wallTime();
+  std::vector<std::string> partFiles;
+  for (unsigned int i=0; i < scenarios.size(); i++){
+    char buf[32];
+    sprintf(buf, ".part%u", i);
+    partFiles.push_back(std::string(resultsFile) + buf);
+    remove(partFiles[i].c_str());
+  }
+  std::atomic<unsigned int> next(0);
+  std::atomic<int> failed(0);
+  std::vector<std::thread> workers;
+  for (int j=0; j < jobs; j++){
+    workers.push_back(std::thread([&](){
+      unsigned int i;
+      while ((i = next++) < scenarios.size()){
+        std::string cmd = "\"" + std::string(program) + "\" --headless \"" + scenarios[i] + "\" -o \"" + partFiles[i] + "\"";
+        if (steps > 0) cmd += " -n " + std::to_string(steps);
+        if (pattern != NULL) cmd += " -p " + std::string(pattern);
+        if (coveragePrefix != NULL)
+          cmd += " -c \"" + std::string(coveragePrefix) + SimScenario::nameFromFile(scenarios[i].c_str()) + ".csv\"";
+        if (system(cmd.c_str()) != 0) failed++;
+      }
+    }));
+  }
+  for (unsigned int j=0; j < workers.size(); j++) workers[j].join();
+
+  // merge results (scenario order)
+  FILE *out = fopen(resultsFile, "w");
+  if (out == NULL){
+    printf("cannot write %s\n", resultsFile);
+    return 1;
+  }
+  bool header = true;
+  for (unsigned int i=0; i < partFiles.size(); i++){
+    FILE *f = fopen(partFiles[i].c_str(), "r");
+    if (f == NULL) continue;
+    char line[512];
+    for (int lineNo=0; fgets(line, sizeof line, f) != NULL; lineNo++){
+      if ((lineNo == 0) && (!header)) continue;
+      fputs(line, out);
+    }
+    header = false;
+    fclose(f);
+    remove(partFiles[i].c_str());
+  }
+  fclose(out);
+  printf("%u scenarios, %d jobs, %d failed: %.1fs -> %s\n", (unsigned int)scenarios.size(), jobs, (int)failed,
+         wallTime() - startTime, resultsFile);
+  return (failed == 0) ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+  bool optHeadless = false;
+  bool optBatch = false;
+  int jobs = std::thread::hardware_concurrency();
+  long steps = 0;
+  const char *resultsFile = NULL;
+  const char *coverageFile = NULL;
+  const char *pattern = NULL;
+  std::vector<std::string> scenarios;
+  for (int i=1; i < argc; i++){
+    if (strcmp(argv[i], "--headless") == 0) optHeadless = true;
+      else if (strcmp(argv[i], "--batch") == 0) optBatch = true;
+      else if ((strcmp(argv[i], "-j") == 0) && (i+1 < argc)) jobs = atoi(argv[++i]);
+      else if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc)) steps = atol(argv[++i]);
+      else if ((strcmp(argv[i], "-o") == 0) && (i+1 < argc)) resultsFile = argv[++i];
+      else if ((strcmp(argv[i], "-c") == 0) && (i+1 < argc)) coverageFile = argv[++i];
+      else if ((strcmp(argv[i], "-p") == 0) && (i+1 < argc)) pattern = argv[++i];
+      else scenarios.push_back(argv[i]);
+  }
+  if (jobs < 1) jobs = 1;
+  if ((pattern != NULL) && (SimScenario::patternFromName(pattern) < 0)){
+    printf("unknown pattern %s\n", pattern);
+    return 1;
+  }
+
+  if (optBatch){
+    if ((resultsFile == NULL) || (scenarios.empty())){
+      printf("usage: sim --batch [-j jobs] [-n steps] [-p pattern] [-c prefix] -o results scenario1 scenario2 ...\n");
+      return 1;
+    }
+    return batch(argv[0], scenarios, jobs, steps, pattern, resultsFile, coverageFile);
+  }
+
+  SimScenario scenario;
+  if ((!scenarios.empty()) && (!scenario.load(scenarios[0].c_str()))) return 1;
+  if (steps > 0) scenario.steps = steps;
+  if (pattern != NULL) scenario.pattern = SimScenario::patternFromName(pattern);
+  if (optHeadless) return headless(scenario, resultsFile, coverageFile);
+  return interactive(scenario);
+}
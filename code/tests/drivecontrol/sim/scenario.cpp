@@ -0,0 +1,149 @@
+#include "scenario.h"
+#include "simrobot.h"
+#include <stdio.h>
+#include <string.h>
+
+
+SimScenario::SimScenario(){
+  name = "default";
+  // perimeter lines coordinates (cm)
+  perimeter.push_back( (point_t) {30, 35 } );
+  perimeter.push_back( (point_t) {50, 15 } );
+  perimeter.push_back( (point_t) {400, 40 } );
+  perimeter.push_back( (point_t) {410, 50 } );
+  perimeter.push_back( (point_t) {420, 90 } );
+  perimeter.push_back( (point_t) {350, 160 } );
+  perimeter.push_back( (point_t) {320, 190 } );
+  perimeter.push_back( (point_t) {210, 250 } );
+  perimeter.push_back( (point_t) {40, 300 } );
+  perimeter.push_back( (point_t) {20, 290 } );
+  perimeter.push_back( (point_t) {30, 230 } );
+  chgStationX = 35;
+  chgStationY = 150;
+  steering_noise    = 0.01;
+  distance_noise    = 0.2;
+  measurement_noise = 0.5;
+  motor_noise       = 10;
+  odometryDrift     = 0;
+  gpsNoise          = 0;
+  gpsRate           = 5;
+  coils             = 1;
+  motorSpeed = 30;
+  cutterWidth = 25;
+  mowTime = 600;
+  chargeTime = 0;
+  pattern = PATTERN_RANDOM;
+  steps = 100000;
+  seed = 0;
+}
+
+
+std::string SimScenario::nameFromFile(const char *fileName){
+  const char *base = strrchr(fileName, '/');
+  if (base == NULL) base = strrchr(fileName, '\\');
+  std::string name = (base != NULL) ? base+1 : fileName;
+  if (name.rfind('.') != std::string::npos) name = name.substr(0, name.rfind('.'));
+  return name;
+}
+
+
+static const char *patternNames[] = { "random", "lanes", "bidir", "planner" };
+
+int SimScenario::patternFromName(const char *patternName){
+  for (unsigned int i=0; i < sizeof patternNames / sizeof patternNames[0]; i++)
+    if (strcmp(patternName, patternNames[i]) == 0) return i;
+  return -1;
+}
+
+const char *SimScenario::patternName(int pattern){
+  return patternNames[pattern];
+}
+
+
+bool SimScenario::load(const char *fileName){
+  FILE *f = fopen(fileName, "r");
+  if (f == NULL){
+    printf("cannot open scenario %s\n", fileName);
+    return false;
+  }
+  name = nameFromFile(fileName);
+  perimeter.clear();
+  islands.clear();
+  char line[256];
+  int lineNo = 0;
+  bool ok = true;
+  while (fgets(line, sizeof line, f) != NULL){
+    lineNo++;
+    char *comment = strchr(line, '#');
+    if (comment != NULL) *comment = 0;
+    char key[32];
+    if (sscanf(line, "%31s", key) != 1) continue;
+    const char *args = strstr(line, key) + strlen(key);
+    float a, b, c, d;
+    long l;
+    int n = 0;
+    if (strcmp(key, "perimeter") == 0){
+      if ((n = sscanf(args, "%f %f", &a, &b)) == 2) perimeter.push_back( (point_t) {a, b} );
+      n -= 2;
+    } else if (strcmp(key, "island") == 0){
+      std::vector<point_t> island;
+      int len;
+      while (sscanf(args, "%f %f%n", &a, &b, &len) == 2){
+        island.push_back( (point_t) {a, b} );
+        args += len;
+      }
+      if (island.size() >= 3) islands.push_back(island);
+        else n = -1;
+    } else if (strcmp(key, "station") == 0){
+      if ((n = sscanf(args, "%f %f", &a, &b)) == 2) { chgStationX = a; chgStationY = b; }
+      n -= 2;
+    } else if (strcmp(key, "noise") == 0){
+      if ((n = sscanf(args, "%f %f %f %f", &a, &b, &c, &d)) == 4) {
+        steering_noise = a; distance_noise = b; measurement_noise = c; motor_noise = d;
+      }
+      n -= 4;
+    } else if (strcmp(key, "drift") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) odometryDrift = a;
+      n -= 1;
+    } else if (strcmp(key, "gps") == 0){
+      if ((n = sscanf(args, "%f %f", &a, &b)) == 2) { gpsNoise = a; gpsRate = (b > 0) ? b : 1; }
+      n -= 2;
+    } else if (strcmp(key, "coils") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) coils = (a >= 2) ? 2 : 1;
+      n -= 1;
+    } else if (strcmp(key, "speed") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) motorSpeed = a;
+      n -= 1;
+    } else if (strcmp(key, "cutter") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) cutterWidth = a;
+      n -= 1;
+    } else if (strcmp(key, "mowtime") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) mowTime = a;
+      n -= 1;
+    } else if (strcmp(key, "charge") == 0){
+      if ((n = sscanf(args, "%f", &a)) == 1) chargeTime = a;
+      n -= 1;
+    } else if (strcmp(key, "pattern") == 0){
+      char value[32];
+      if (((n = sscanf(args, "%31s", value)) == 1) && ((pattern = patternFromName(value)) < 0)) n = -1;
+      n -= 1;
+    } else if (strcmp(key, "steps") == 0){
+      if ((n = sscanf(args, "%ld", &l)) == 1) steps = l;
+      n -= 1;
+    } else if (strcmp(key, "seed") == 0){
+      if ((n = sscanf(args, "%ld", &l)) == 1) seed = l;
+      n -= 1;
+    } else n = -1;
+    if (n != 0){
+      printf("%s:%d: invalid line: %s\n", fileName, lineNo, key);
+      ok = false;
+    }
+  }
+  fclose(f);
+  if (perimeter.size() < 3){
+    printf("%s: perimeter needs at least 3 vertices\n", fileName);
+    ok = false;
+  }
+  return ok;
+}
+
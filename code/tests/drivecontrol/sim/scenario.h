@@ -0,0 +1,84 @@
+/*
+  Ardumower (www.ardumower.de)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <vector>
+#include <string>
+#include "../common.h"
+
+
+/*
+  simulation scenario (text file, one keyword per line, '#' = comment), example:
+
+    # small lawn
+    perimeter 30 35        # perimeter polygon vertex (cm), one line per vertex
+    perimeter 50 15
+    perimeter 400 40
+    island 100 100 150 100 150 150   # island polygon (cm), one line per island
+    station 35 150         # charging station (cm)
+    noise 0.01 0.2 0.5 10  # steering, distance, measurement, motor noise
+    drift 0.001            # odometry/IMU heading drift (rad/s)
+    gps 50 5               # GPS position noise (cm, 0 = no GPS), update rate (Hz)
+    coils 2                # perimeter coils: 1 (center), 2 (left/right, proportional wire tracking)
+    speed 30               # motor speed (rpm)
+    cutter 25              # cutter width (cm)
+    mowtime 600            # mowing time (s), then track perimeter to station
+    charge 1800            # charging time (s), then mow again (0 = stop when docked)
+    pattern planner        # mowing pattern: random, lanes, bidir, planner
+    steps 100000           # simulation steps (10ms)
+    seed 1                 # random seed (0 = time)
+*/
+
+class SimScenario
+{
+  public:
+    std::string name;
+    std::vector<point_t> perimeter; // cm
+    std::vector< std::vector<point_t> > islands;
+    int chgStationX, chgStationY;   // cm
+    float steering_noise;
+    float distance_noise;
+    float measurement_noise;
+    float motor_noise;
+    float odometryDrift; // rad/s
+    float gpsNoise;    // cm (0: no GPS)
+    float gpsRate;     // Hz
+    int coils;         // perimeter coils
+    float motorSpeed;  // rpm
+    float cutterWidth; // cm
+    float mowTime;     // seconds
+    float chargeTime;  // seconds
+    int pattern;       // PATTERN_...
+    long steps;
+    unsigned int seed;
+    // initializes default scenario (small lawn)
+    SimScenario();
+    // loads scenario file (returns false on error)
+    bool load(const char *fileName);
+    // scenario name of file (file name without path and extension)
+    static std::string nameFromFile(const char *fileName);
+    // pattern by name (-1 if unknown)
+    static int patternFromName(const char *patternName);
+    static const char *patternName(int pattern);
+};
+
+
+#endif
@@ -2,31 +2,183 @@
 #include <ctime>
 #include "simrobot.h"
 #include "world.h"
+#include "simarduino.h"
+#include "../../../ardumower/profiler.h"
 
 
 Simulator Sim;
 
+// simulation stages (profiler)
+enum { PROF_SIM_STEP, PROF_SIM_MOVE, PROF_SIM_SENSE, PROF_SIM_LOCALIZE, PROF_SIM_FUSION, PROF_SIM_CONTROL };
+
+Profiler profiler;
+
 // simulation initialization
 Simulator::Simulator(){
   stepCounter = 0;
   plotIdx = 0;
+  verbose = true;
   imgBfieldRobot = cv::Mat(140, 500, CV_8UC3, cv::Scalar(0,0,0));
   timeStep = 0.01; // one simulation step (seconds)
   simTime = 0;
+  profiler.addStage(PROF_SIM_STEP,    "step");
+  profiler.addStage(PROF_SIM_MOVE,    "move");
+  profiler.addStage(PROF_SIM_SENSE,   "sense");
+  profiler.addStage(PROF_SIM_LOCALIZE, "localize");
+  profiler.addStage(PROF_SIM_FUSION,  "fusion");
+  profiler.addStage(PROF_SIM_CONTROL, "control");
+  profiler.begin();
+}
+
+
+void Simulator::setup(SimScenario &scenario){
+  stepCounter = 0;
+  simTime = 0;
   // start random generator
-  time_t t;
-  time(&t);
-  srand((unsigned int)t);
+  unsigned int seed = scenario.seed;
+  if (seed == 0){
+    time_t t;
+    time(&t);
+    seed = (unsigned int)t;
+  }
+  srand(seed);
+  World.setPerimeter(scenario.perimeter, scenario.chgStationX, scenario.chgStationY);
+  for (unsigned int i=0; i < scenario.islands.size(); i++) World.addIsland(scenario.islands[i]);
   // place robot onto world
   Robot.orientation = 0;
   Robot.x = World.chgStationX+5; //+ 10;
   Robot.y = World.chgStationY-5; // + 10;
-  //robot.x = 100;
-  //robot.y = 100;
-  float steering_noise    = 0.01;
-  float distance_noise    = 0.2;
-  float measurement_noise = 0.5;
-  Robot.set_noise(steering_noise, distance_noise, measurement_noise);
+  Robot.set_noise(scenario.steering_noise, scenario.distance_noise, scenario.measurement_noise);
+  Robot.odometryDrift = scenario.odometryDrift;
+  Robot.coils = scenario.coils;
+  Robot.motor_noise = scenario.motor_noise;
+  Robot.motorSpeed = scenario.motorSpeed;
+  Robot.cutterWidth = scenario.cutterWidth;
+  Robot.mowTime = scenario.mowTime;
+  Robot.chargeTime = scenario.chargeTime;
+  Robot.pattern = scenario.pattern;
+  Robot.totalDistance = Robot.lastTotalDistance = 0;
+  Robot.odometryX = Robot.x;
+  Robot.odometryY = Robot.y;
+  Robot.odometryOrientation = Robot.orientation;
+  Robot.num_collision = 0;
+  Robot.dockTime = -1;
+  Robot.docks = 0;
+  Robot.lanePlanner.stop();
+  Robot.startMowing();
+  // particle filter: wire map of the scenario (the robot records it while tracking), known field scale
+  localizer.begin(seed);
+  for (unsigned int i=0; i < scenario.perimeter.size(); i++) localizer.addWirePoint(scenario.perimeter[i].x, scenario.perimeter[i].y);
+  localizer.closeLoop(false);
+  for (unsigned int k=0; k < scenario.islands.size(); k++){
+    for (unsigned int i=0; i < scenario.islands[k].size(); i++) localizer.addWirePoint(scenario.islands[k][i].x, scenario.islands[k][i].y);
+    localizer.closeLoop(true);
+  }
+  while (!localizer.prepare());
+  localizer.setScale(1);
+  localizer.reset(Robot.odometryX, Robot.odometryY, 10);
+  locErrorSum = odoErrorSum = 0;
+  locErrorCount = 0;
+  // pose fusion: fixes are geodetic positions of the true robot position (world origin at
+  // SIM_GPS_LAT/LON), the filter runs in the frame of its first fix (like the robot)
+  fusion = PoseFusion();
+  gpsWorld.setOrigin(SIM_GPS_LAT, SIM_GPS_LON);
+  gpsLocal = EnuProjection();
+  gpsNoise = scenario.gpsNoise;
+  gpsSteps = max(1, (int)(1.0 / (scenario.gpsRate * timeStep * LOCALIZE_STEPS) + 0.5)) * LOCALIZE_STEPS;
+  gpsOriginX = gpsOriginY = 0;
+  lastGpsX = Robot.x;
+  lastGpsY = Robot.y;
+  lastOdoOrientation = Robot.odometryOrientation;
+  Robot.odometryStep = 0;
+  fusionAlignTime = -1;
+  fusionErrorSum = fusionHeadingErrorSum = gpsErrorSum = 0;
+  fusionErrorCount = gpsErrorCount = 0;
+  profiler.reset();
+}
+
+
+float Simulator::getLocUpdateTime(){
+  return profiler.getAvgUs(PROF_SIM_LOCALIZE);
+}
+
+float Simulator::getFusionUpdateTime(){
+  return profiler.getAvgUs(PROF_SIM_FUSION);
+}
+
+
+void Simulator::runFusion(){
+  float dt = LOCALIZE_STEPS * timeStep;
+  // IMU yaw rate incl. drift (firmware heading is clockwise, simulator orientation counter-clockwise)
+  float yawRate = -scalePI(Robot.odometryOrientation - lastOdoOrientation) / dt;
+  lastOdoOrientation = Robot.odometryOrientation;
+  fusion.predict(Robot.odometryStep, yawRate, dt);
+  Robot.odometryStep = 0;
+  if ((stepCounter % gpsSteps) == 0){
+    // GPS fix (1e-7 deg) of the noisy true position, projected by the firmware frame
+    float fixX = Robot.x + gauss(0, gpsNoise);
+    float fixY = Robot.y + gauss(0, gpsNoise);
+    long lat, lon;
+    gpsWorld.toGeodetic(fixX / 100, fixY / 100, lat, lon);
+    if (!gpsLocal.isValid()){
+      gpsLocal.setOrigin(lat, lon);
+      gpsWorld.toLocal(lat, lon, gpsOriginX, gpsOriginY);
+      gpsOriginX *= 100;
+      gpsOriginY *= 100;
+    }
+    float east, north;
+    gpsLocal.toLocal(lat, lon, east, north);
+    if (!fusion.isInitialized()) fusion.reset(east * 100, north * 100, 0, M_PI, gpsNoise);
+      else fusion.updatePosition(east * 100, north * 100, gpsNoise);
+    gpsErrorSum += distance(east * 100 + gpsOriginX, north * 100 + gpsOriginY, Robot.x, Robot.y);
+    gpsErrorCount++;
+    // GPS velocity (course clockwise from north)
+    float gpsDt = gpsSteps * timeStep;
+    float vx = (Robot.x - lastGpsX) / gpsDt + gauss(0, SIM_GPS_SPEED_NOISE);
+    float vy = (Robot.y - lastGpsY) / gpsDt + gauss(0, SIM_GPS_SPEED_NOISE);
+    lastGpsX = Robot.x;
+    lastGpsY = Robot.y;
+    fusion.updateVelocity(sqrt(vx * vx + vy * vy), atan2(vx, vy), SIM_GPS_SPEED_NOISE);
+  }
+  const pose_t &pose = fusion.getPose();
+  if (!pose.valid) return;
+  if (fusionAlignTime < 0) fusionAlignTime = simTime;
+  fusionErrorSum += distance(pose.x + gpsOriginX, pose.y + gpsOriginY, Robot.x, Robot.y);
+  fusionHeadingErrorSum += fabs(distancePI(pose.heading, scalePI(M_PI/2 - Robot.orientation)));
+  fusionErrorCount++;
+}
+
+
+void Simulator::run(SimScenario &scenario, FILE *coverageLog){
+  int logSteps = COVERAGE_LOG_INTERVAL / timeStep;
+  if (coverageLog != NULL) fprintf(coverageLog, "time_s,coverage_pct\n");
+  for (long i=0; i < scenario.steps; i++){
+    step();
+    if ((coverageLog != NULL) && ((stepCounter % logSteps) == 0))
+      fprintf(coverageLog, "%.1f,%.3f\n", simTime, World.getCoverage());
+    if (Robot.state == STATE_OFF) break;
+  }
+}
+
+
+bool Simulator::writeResult(const char *fileName, SimScenario &scenario, float wallTime){
+  FILE *f = fopen(fileName, "r");
+  bool header = (f == NULL);
+  if (f != NULL) fclose(f);
+  f = fopen(fileName, "a");
+  if (f == NULL){
+    printf("cannot write %s\n", fileName);
+    return false;
+  }
+  if (header) fprintf(f, "scenario,pattern,steps,sim_time_s,coverage_pct,distance_m,collisions,time_to_dock_s,docks,"
+                       "loc_error_cm,odo_error_cm,loc_update_us,gps_error_cm,fusion_error_cm,fusion_heading_error_deg,"
+                       "fusion_update_us,wall_time_s\n");
+  fprintf(f, "%s,%s,%d,%.2f,%.2f,%.2f,%d,%.2f,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%.3f\n", scenario.name.c_str(),
+          SimScenario::patternName(scenario.pattern), stepCounter, simTime, World.getCoverage(), Robot.totalDistance,
+          Robot.num_collision, Robot.dockTime, Robot.docks, getLocError(), getOdoError(), getLocUpdateTime(),
+          getGpsError(), getFusionError(), getFusionHeadingError() / M_PI * 180, getFusionUpdateTime(), wallTime);
+  fclose(f);
+  return true;
 }
 
 
@@ -34,27 +186,53 @@ Simulator::Simulator(){
 void Simulator::step(){
   //printf("stateTime=%1.4f\n", stateTime);
 
+  uint32_t stepStart = profiler.ticks();
+  uint32_t t = stepStart;
   // simulate robot movement
+  float lastX = Robot.x;
+  float lastY = Robot.y;
   Robot.move(0, 0);
-  //filter.move(*this, robot.orientation, robot.speed*10 * timeStep);
-  World.setLawnMowed(Robot.x, Robot.y);
+  World.setLawnMowed(lastX, lastY, Robot.x, Robot.y, Robot.cutterWidth);
+  t = profiler.mark(PROF_SIM_MOVE, t);
 
   Robot.sense();
-  //filter.sense(*this, robot.bfieldStrength);
+  t = profiler.mark(PROF_SIM_SENSE, t);
+
+  // particle filter (firmware: odometry task)
+  if ((stepCounter % LOCALIZE_STEPS) == 0){
+    localizer.predict(Robot.odometryX, Robot.odometryY, scalePI(M_PI/2 - Robot.odometryOrientation));
+    localizer.sense(Robot.bfieldStrength);
+    t = profiler.mark(PROF_SIM_LOCALIZE, t);
+    locErrorSum += distance(localizer.getX(), localizer.getY(), Robot.x, Robot.y);
+    odoErrorSum += distance(Robot.odometryX, Robot.odometryY, Robot.x, Robot.y);
+    locErrorCount++;
+  }
+
+  // GPS/odometry pose fusion (firmware: odometry task and GPS fixes)
+  if ((gpsNoise > 0) && ((stepCounter % LOCALIZE_STEPS) == 0)){
+    runFusion();
+    t = profiler.mark(PROF_SIM_FUSION, t);
+  }
 
   // run robot controller
   Robot.control(timeStep);
+  profiler.mark(PROF_SIM_CONTROL, t);
+  profiler.mark(PROF_SIM_STEP, stepStart);
 
   // simulation time
   simTime += timeStep;
 
-  if ((stepCounter % 100) == 0){
+  if ((verbose) && ((stepCounter % 100) == 0)){
     printf("time=%5.1fs  orient=%3.1f  distChg=%3.1fm  totalDist=%3.1fm\n",
            simTime,
            Robot.orientation/M_PI*180.0,
            Robot.distanceToChgStation/10,
            Robot.totalDistance);
   }
+  if ((verbose) && ((stepCounter % 1000) == 0)){
+    profiler.printReport(Console);
+    profiler.reset();
+  }
   stepCounter++;
 }
 
@@ -63,9 +241,10 @@ void Simulator::step(){
 void Simulator::draw(){
   World.draw();
 
-  float x,y,theta;
-  //filter.get_position(x,y,theta);
-  //filter.drawCenter(world.imgWorld, x,y,theta);
+  // particle filter estimate (circle: spread)
+  float scale = World.drawScale;
+  circle( World.imgWorld, cv::Point(localizer.getX()/scale, localizer.getY()/scale), max(2.0f, localizer.getSpread()/scale),
+          cv::Scalar( 255, 255, 255), 1, 8 );
 
   Robot.draw(World.imgWorld);
 
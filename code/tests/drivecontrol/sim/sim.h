@@ -20,7 +20,23 @@
 #define SIM_H
 
 #include <vector>
+#include <stdio.h>
 #include <opencv2/core/core.hpp>
+#include "scenario.h"
+#include "../../../ardumower/localize.h"
+#include "../../../ardumower/fusion.h"
+
+
+// coverage log interval (seconds)
+#define COVERAGE_LOG_INTERVAL 10
+
+// localization update interval (steps, firmware: odometry task 100ms)
+#define LOCALIZE_STEPS 10
+
+// simulated GPS: geodetic position of the world origin (1e-7 deg), speed noise (cm/s)
+#define SIM_GPS_LAT 520000000
+#define SIM_GPS_LON 85000000
+#define SIM_GPS_SPEED_NOISE 5
 
 
 
@@ -33,10 +49,52 @@ class Simulator
     float simTime; // seconds
     float timeStep; // seconds
     int stepCounter;
+    bool verbose; // print status and profiler report
+    Localizer localizer;  // particle filter (firmware module) on odometry and perimeter magnitude
+    double locErrorSum;   // cm, localization error (estimate/odometry vs. true position)
+    double odoErrorSum;
+    long locErrorCount;
+    PoseFusion fusion;    // GPS/odometry Kalman filter (firmware module), runs if the scenario has GPS
+    EnuProjection gpsWorld;   // world origin (simulated fixes)
+    EnuProjection gpsLocal;   // firmware frame (origin: first fix)
+    float gpsNoise;       // cm
+    int gpsSteps;         // steps per GPS fix
+    float gpsOriginX;     // cm, firmware frame origin in the world
+    float gpsOriginY;
+    float lastGpsX;       // cm, true position at the last fix (GPS velocity)
+    float lastGpsY;
+    float lastOdoOrientation;
+    float fusionAlignTime;    // s, heading aligned (-1: not yet)
+    double fusionErrorSum;    // cm, fused pose vs. true position (after alignment)
+    double fusionHeadingErrorSum;  // rad
+    double gpsErrorSum;       // cm, GPS fix vs. true position
+    long fusionErrorCount;
+    long gpsErrorCount;
     Simulator();
+    // places robot into world of scenario
+    void setup(SimScenario &scenario);
     void step();
     void draw();
+    // headless: runs scenario steps (until robot is docked) as fast as possible,
+    // optionally logs coverage over time (CSV)
+    void run(SimScenario &scenario, FILE *coverageLog = NULL);
+    // mean localization error (cm) of the particle filter and of the odometry
+    float getLocError(){ return (locErrorCount > 0) ? locErrorSum / locErrorCount : 0; }
+    float getOdoError(){ return (locErrorCount > 0) ? odoErrorSum / locErrorCount : 0; }
+    // particle filter update time (us, average)
+    float getLocUpdateTime();
+    // mean pose fusion error (cm, rad) and GPS error (cm)
+    float getFusionError(){ return (fusionErrorCount > 0) ? fusionErrorSum / fusionErrorCount : 0; }
+    float getFusionHeadingError(){ return (fusionErrorCount > 0) ? fusionHeadingErrorSum / fusionErrorCount : 0; }
+    float getGpsError(){ return (gpsErrorCount > 0) ? gpsErrorSum / gpsErrorCount : 0; }
+    // pose fusion update time (us, average)
+    float getFusionUpdateTime();
+    // appends result line (pattern, coverage, distance, collisions, time-to-dock, localization) to results file
+    bool writeResult(const char *fileName, SimScenario &scenario, float wallTime);
     void plotXY(cv::Mat &image, int x, int y, int r, int g, int b, bool clearplot);
+  private:
+    // odometry/IMU yaw rate prediction, simulated GPS fix and velocity
+    void runFusion();
 };
 
 
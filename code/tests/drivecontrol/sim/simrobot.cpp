@@ -11,13 +11,40 @@ SimRobot::SimRobot(){
   //memset(robotMap, 0, sizeof robotMap);
   distanceToChgStation = 0;
   totalDistance = 0;
+  lastTotalDistance = 0;
 
   x = y = orientation = 0;
   odometryTicksPerRevolution = 1060;
   odometryTicksPerCm = 13.49;
   odometryWheelBaseCm = 36;    // wheel-to-wheel distance (cm)
+  cutterWidth = 25;
   leftMotorSpeed = 30;
   rightMotorSpeed = 5;
+  motorSpeed = 30;
+  mowTime = 600;
+  num_collision = 0;
+  num_steps = 0;
+  bfieldStrength = 0;
+  coils = 1;
+  bfieldLeft = bfieldRight = 0;
+  perimeterInside = true;
+  outsideTime = 0;
+  state = STATE_LANE_FORW;
+  stateStartTime = 0;
+  trackStartTime = 0;
+  dockTime = -1;
+  wireFound = false;
+  pattern = PATTERN_RANDOM;
+  chargeTime = 0;
+  mowStartTime = 0;
+  docks = 0;
+  odometryX = odometryY = 0;
+  odometryOrientation = 0;
+  odometryDrift = 0;
+  odometryStep = 0;
+  driveHeading = rollHeading = 0;
+  rollLeft = false;
+  bidirDir = 1;
 
   steering_noise    = 0.0;
   distance_noise    = 0.0;
@@ -27,6 +54,10 @@ SimRobot::SimRobot(){
 
 //sets a robot coordinate
 void SimRobot::set(float new_x, float new_y, float new_orientation){
+  // odometry follows the move (keeps its error)
+  odometryX += new_x - x;
+  odometryY += new_y - y;
+  odometryOrientation = scalePI( odometryOrientation + new_orientation - orientation );
   x = new_x;
   y = new_y;
   orientation = new_orientation;
@@ -58,8 +89,10 @@ void SimRobot::move(float course, float distance,
   float leftSpeedNoise  = leftMotorSpeed;
   float rightSpeedNoise = rightMotorSpeed;
 
-  rightSpeedNoise = gauss(rightMotorSpeed, motor_noise);
-  leftSpeedNoise = gauss(leftMotorSpeed, motor_noise);
+  if (state != STATE_OFF){
+    rightSpeedNoise = gauss(rightMotorSpeed, motor_noise);
+    leftSpeedNoise = gauss(leftMotorSpeed, motor_noise);
+  }
 
   float left_cm = leftSpeedNoise * cmPerRound/60.0 * Sim.timeStep;
   float right_cm = rightSpeedNoise * cmPerRound/60.0 * Sim.timeStep;
@@ -69,6 +102,12 @@ void SimRobot::move(float course, float distance,
   orientation = scalePI( orientation + wheel_theta );
   x = x + (avg_cm * cos(orientation)) ;
   y = y + (avg_cm * sin(orientation)) ;
+  // firmware odometry/IMU pose: measured distance, noisy and drifting heading
+  odometryOrientation = scalePI( odometryOrientation + wheel_theta + odometryDrift * Sim.timeStep );
+  float noisyOrientation = odometryOrientation + gauss(0, steering_noise);
+  odometryX += avg_cm * cos(noisyOrientation);
+  odometryY += avg_cm * sin(noisyOrientation);
+  odometryStep += avg_cm;
 
   totalDistance += fabs(avg_cm/100.0);
 
@@ -77,9 +116,21 @@ void SimRobot::move(float course, float distance,
 
 // measures magnetic field
 void SimRobot::sense(){
-  //bfieldStrength = sim.world.getBfield(x, y, 1);
-  //bfieldStrength += gauss(0.0, measurement_noise);
-  //printf("b=%3.4f\n", b);
+  bfieldStrength = World.getBfield(x, y, 1);
+  bfieldStrength += gauss(0.0, measurement_noise);
+  if (coils == 2){
+    // coils ahead of the center, left: side the robot turns to with the left wheel faster
+    float cx = x + COIL_AHEAD * cos(orientation);
+    float cy = y + COIL_AHEAD * sin(orientation);
+    float sx = -sin(orientation) * COIL_SPACING/2;
+    float sy = cos(orientation) * COIL_SPACING/2;
+    bfieldLeft = World.getBfield(cx + sx, cy + sy, 1) + gauss(0.0, measurement_noise);
+    bfieldRight = World.getBfield(cx - sx, cy - sy, 1) + gauss(0.0, measurement_noise);
+  }
+  // signal polarity (inside/outside) is robust against noise
+  bool inside = World.isInside(x, y);
+  if ((perimeterInside) && (!inside)) outsideTime = Sim.simTime;
+  perimeterInside = inside;
 }
 
 //  computes the probability of a measurement
@@ -94,27 +145,194 @@ float SimRobot::measurement_prob(float measurement){
 }
 
 
-// run robot controller
+void SimRobot::setState(int newState){
+  state = newState;
+  stateStartTime = Sim.simTime;
+}
+
+
+void SimRobot::startMowing(){
+  mowStartTime = Sim.simTime;
+  bidirDir = 1;
+  driveHeading = odometryOrientation;
+  if (pattern == PATTERN_PLANNER){
+    // new job (lanes along the current heading) or back to the last lane after charging
+    if (!lanePlanner.isActive()) lanePlanner.begin(odometryX, odometryY, toHeading(odometryOrientation), cutterWidth * 0.9);
+      else lanePlanner.resume();
+  }
+  setState(STATE_LANE_FORW);
+}
+
+
+// heading control (firmware: imuDirPID on imuDriveHeading)
+void SimRobot::driveToHeading(float speed){
+  float err = distancePI(odometryOrientation, driveHeading);
+  float corr = max(-1.0f, min(1.0f, 2.0f * err));
+  leftMotorSpeed = speed * (1 + corr);
+  rightMotorSpeed = speed * (1 - corr);
+}
+
+// roll in place (firmware: imuRollPID on imuRollHeading), true if heading reached
+bool SimRobot::rollToHeading(){
+  float err = distancePI(odometryOrientation, rollHeading);
+  if (fabs(err) < M_PI/36) return true;
+  leftMotorSpeed = (err > 0) ? motorSpeed : -motorSpeed;
+  rightMotorSpeed = -leftMotorSpeed;
+  return false;
+}
+
+
+// mowing states of the pattern
+void SimRobot::controlMowing(float stateTime, float timeStep){
+  switch (state){
+    case STATE_LANE_FORW:
+      // mowing: forward until perimeter is reached
+      if (pattern == PATTERN_BIDIR){
+        // firmware: speed ratio 0.3 for 4s, then 0.92 - perimeter: drive the other way, toggle side
+        float ratio = (stateTime > 4.0) ? 0.92 : 0.3;
+        leftMotorSpeed = bidirDir * motorSpeed;
+        rightMotorSpeed = bidirDir * motorSpeed * ratio;
+        if (rollLeft) std::swap(leftMotorSpeed, rightMotorSpeed);
+        if ((!perimeterInside) && (stateTime > 1.0)){
+          num_collision++;
+          bidirDir = -bidirDir;
+          rollLeft = !rollLeft;
+          setState(STATE_LANE_FORW);
+        }
+        break;
+      }
+      if (pattern == PATTERN_PLANNER){
+        lanePlanner.setPose(odometryX, odometryY, toHeading(odometryOrientation), perimeterInside);
+        if (lanePlanner.isDone()){
+          trackStartTime = Sim.simTime;
+          wireFound = false;
+          setState(STATE_TRACK);
+          break;
+        }
+        driveHeading = toOrientation(lanePlanner.getHeading());
+        if (lanePlanner.getRollRequest()){
+          rollHeading = driveHeading;
+          setState(STATE_LANE_ROLL);
+          break;
+        }
+      }
+      if (pattern == PATTERN_RANDOM) leftMotorSpeed = rightMotorSpeed = motorSpeed;
+        else driveToHeading(motorSpeed);
+      // heading controlled patterns: perimeter triggers when crossed (firmware: perimeterTriggerTime), outside
+      // at start (e.g. after a roll at the perimeter) the robot may drive back into the lawn
+      if ( (!perimeterInside) && ((pattern == PATTERN_RANDOM) || (outsideTime >= stateStartTime)
+                                  || (Sim.simTime - stateStartTime > 2.0)) ){
+        num_collision++;
+        if (pattern == PATTERN_PLANNER) lanePlanner.laneEnd(true);
+        setState(STATE_LANE_REV);
+      }
+      break;
+    case STATE_LANE_REV:
+      leftMotorSpeed = rightMotorSpeed = -motorSpeed;
+      if (stateTime > 1.0) {
+        if (pattern == PATTERN_LANES){
+          // firmware: toggle heading 180 degree, roll a bit more/less (alternating)
+          driveHeading = scalePI(driveHeading + M_PI);
+          rollHeading = scalePI(driveHeading + ((rollLeft) ? -M_PI/20 : M_PI/20));
+          rollLeft = !rollLeft;
+        } else if (pattern == PATTERN_PLANNER){
+          if (lanePlanner.isDone()) {
+            trackStartTime = Sim.simTime;
+            wireFound = false;
+            setState(STATE_TRACK);
+            break;
+          }
+          driveHeading = rollHeading = toOrientation(lanePlanner.getHeading());
+        }
+        setState(STATE_LANE_ROLL);
+      }
+      break;
+    case STATE_LANE_ROLL:
+      if (pattern == PATTERN_RANDOM){
+        // rotate by random angle
+        leftMotorSpeed = motorSpeed;
+        rightMotorSpeed = -motorSpeed;
+        if ((stateTime > 0.5) && (random() < timeStep)) setState(STATE_LANE_FORW);
+      } else if (rollToHeading()) setState(STATE_LANE_FORW);
+      break;
+  }
+}
+
+
+// run robot controller: mowing (pattern), then perimeter tracking to charging station
 void SimRobot::control(float timeStep){
 
   float deltaDistance = totalDistance - lastTotalDistance;
   distanceToChgStation = distance(x,y, World.chgStationX, World.chgStationY);
+  float stateTime = Sim.simTime - stateStartTime;
+
+  if ((Sim.simTime - mowStartTime >= mowTime) && (state != STATE_TRACK) && (state != STATE_OFF)
+      && (state != STATE_CHARGE)) {
+    trackStartTime = Sim.simTime;
+    wireFound = false;
+    setState(STATE_TRACK);
+  }
 
+  switch (state){
+    case STATE_LANE_FORW:
+    case STATE_LANE_REV:
+    case STATE_LANE_ROLL:
+      controlMowing(stateTime, timeStep);
+      break;
+    case STATE_TRACK:
+      // find perimeter, then follow it (bang-bang) until charging station is reached
+      if (!wireFound){
+        leftMotorSpeed = rightMotorSpeed = motorSpeed;
+        if (!perimeterInside) wireFound = true;
+      } else if ((coils == 2) && ((bfieldLeft > 0) != (bfieldRight > 0))){
+        // wire between the coils: left/right magnitude difference (firmware: motorControlPerimeter), positive:
+        // wire nearer to the left coil - proportional steering (both coils on one side: steer back below)
+        float sum = fabs(bfieldLeft) + fabs(bfieldRight);
+        float balance = (sum > 0) ? (fabs(bfieldLeft) - fabs(bfieldRight)) / sum : 0;
+        leftMotorSpeed = motorSpeed * min(1.0f, 1 + balance);
+        rightMotorSpeed = motorSpeed * min(1.0f, 1 - balance);
+      } else if (perimeterInside){
+        leftMotorSpeed = motorSpeed;
+        rightMotorSpeed = motorSpeed/2;
+      } else {
+        leftMotorSpeed = motorSpeed/2;
+        rightMotorSpeed = motorSpeed;
+      }
+      if (distanceToChgStation < 20){
+        if (dockTime < 0) dockTime = Sim.simTime - trackStartTime;
+        docks++;
+        // charge and mow again if there is something left to do
+        bool resume = (chargeTime > 0) && ((pattern != PATTERN_PLANNER) || (lanePlanner.isActive()));
+        setState((resume) ? STATE_CHARGE : STATE_OFF);
+      }
+      break;
+    case STATE_CHARGE:
+      leftMotorSpeed = rightMotorSpeed = 0;
+      if (stateTime > chargeTime){
+        // leave station (as placed at start, station exit is not simulated)
+        set(World.chgStationX+5, World.chgStationY-5, 0);
+        startMowing();
+      }
+      break;
+    case STATE_OFF:
+      leftMotorSpeed = rightMotorSpeed = 0;
+      break;
+  }
+  lastTotalDistance = totalDistance;
 }
 
 
 void SimRobot::draw(cv::Mat &img, bool drawAsFilter){
-  float r = odometryWheelBaseCm/2;
+  // world image may be scaled down (large worlds)
+  float scale = World.drawScale;
+  float r = max(2.0f, odometryWheelBaseCm/2/scale);
+  cv::Point pos(x/scale, y/scale);
+  cv::Point dir(x/scale + r * cos(orientation), y/scale + r * sin(orientation));
   if (drawAsFilter) {
-    circle( img, cv::Point( x, y), r, cv::Scalar( 255, 255, 255), 2, 8 );
-    line( img, cv::Point(x, y), cv::Point(x + r * cos(orientation), y + r * sin(orientation)), cv::Scalar(255,255,255), 2, 8);
+    circle( img, pos, r, cv::Scalar( 255, 255, 255), 2, 8 );
+    line( img, pos, dir, cv::Scalar(255,255,255), 2, 8);
   } else {
-    circle( img, cv::Point( x, y), r, cv::Scalar( 0, 0, 0 ), 2, 8 );
-    line( img, cv::Point(x, y), cv::Point(x + r * cos(orientation), y + r * sin(orientation)), cv::Scalar(0,0,0), 2, 8);
+    circle( img, pos, r, cv::Scalar( 0, 0, 0 ), 2, 8 );
+    line( img, pos, dir, cv::Scalar(0,0,0), 2, 8);
   }
 }
-
-
-
-
-
@@ -20,7 +20,11 @@
 #define SIMROBOT_H
 
 #include <opencv2/core/core.hpp>
-//#include "common.h"
+#include "../common.h"
+#include "../../../ardumower/lanes.h"
+
+#define COIL_SPACING 30    // cm, dual coil: distance between left and right coil
+#define COIL_AHEAD 20      // cm, dual coil: coils ahead of the center
 
 
 
@@ -32,6 +36,15 @@ enum {
   STATE_LANE_REV,
   STATE_LANE_ROLL,
   STATE_GOAL,
+  STATE_CHARGE,
+};
+
+// mowing patterns (firmware: MOW_RANDOM, MOW_LANES, MOW_BIDIR, MOW_LANES with lane planner)
+enum {
+  PATTERN_RANDOM,   // random bounce
+  PATTERN_LANES,    // heading toggled by 180 degree (+/- 9 degree roll)
+  PATTERN_BIDIR,    // curves forward/reverse
+  PATTERN_PLANNER,  // lane planner (lanes.cpp) on the odometry pose
 };
 
 
@@ -42,6 +55,7 @@ class SimRobot
     int odometryTicksPerRevolution;
     float odometryTicksPerCm;
     float odometryWheelBaseCm;
+    float cutterWidth; // cm
     float distanceToChgStation;
     float leftMotorSpeed; // meter/sec
     float rightMotorSpeed;
@@ -56,6 +70,33 @@ class SimRobot
     float measurement_noise;
     int num_collision;
     int num_steps;
+    float bfieldStrength;  // perimeter sensor: magnetic field strength
+    int coils;             // perimeter coils: 1 (center), 2 (left/right, ahead of the center)
+    float bfieldLeft;      // dual coil: field strength at left/right coil
+    float bfieldRight;
+    bool perimeterInside;  // perimeter sensor: inside loop?
+    float outsideTime;     // seconds (outside since)
+    int state;
+    float stateStartTime;  // seconds
+    float motorSpeed;      // rpm
+    float mowTime;         // seconds (then track perimeter to charging station)
+    float trackStartTime;  // seconds
+    float dockTime;        // seconds from tracking start to docking (-1: not docked)
+    bool wireFound;
+    int pattern;
+    float chargeTime;      // seconds in station, then resume mowing (0: stop when docked)
+    float mowStartTime;    // seconds
+    int docks;
+    float odometryX;       // cm (firmware odometry: true distance, noisy heading)
+    float odometryY;
+    float odometryOrientation;  // rad (simulator orientation + drift)
+    float odometryDrift;   // rad/s, heading drift (IMU yaw)
+    float odometryStep;    // cm, odometry distance since the last pose fusion update
+    float driveHeading;    // rad (simulator orientation), heading controlled patterns
+    float rollHeading;
+    bool rollLeft;
+    int bidirDir;          // bidir: +1 forward, -1 reverse
+    LanePlanner lanePlanner;
     // initializes robot
     SimRobot();
     // sets a robot coordinate
@@ -75,6 +116,16 @@ class SimRobot
     // run robot controller
     void control(float timeStep);
     void sense();
+    void setState(int newState);
+    // starts mowing with the pattern
+    void startMowing();
+  private:
+    // firmware heading (clockwise from y axis) <-> simulator orientation
+    float toHeading(float o){ return scalePI(M_PI/2 - o); }
+    float toOrientation(float h){ return scalePI(M_PI/2 - h); }
+    void driveToHeading(float speed);
+    bool rollToHeading();
+    void controlMowing(float stateTime, float timeStep);
 };
 
 extern SimRobot Robot;
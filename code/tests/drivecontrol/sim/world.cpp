@@ -4,103 +4,194 @@ SimWorld World;
 
 SimWorld::SimWorld(){
   drawMowedLawn = true;
-  memset(lawnMowStatus, 0, sizeof lawnMowStatus);
-  //printf("%d\n", sizeof bfield);
-  memset(bfield, 0, sizeof bfield);
-  imgBfield = cv::Mat(WORLD_SIZE_Y, WORLD_SIZE_X, CV_8UC3, cv::Scalar(0,0,0));
-  imgWorld = cv::Mat(WORLD_SIZE_Y, WORLD_SIZE_X, CV_8UC3, cv::Scalar(0,0,0));
-
-  // perimeter lines coordinates (cm)
-  std::vector<point_t> list;
-  list.push_back( (point_t) {30, 35 } );
-  list.push_back( (point_t) {50, 15 } );
-  list.push_back( (point_t) {400, 40 } );
-  list.push_back( (point_t) {410, 50 } );
-  list.push_back( (point_t) {420, 90 } );
-  list.push_back( (point_t) {350, 160 } );
-  list.push_back( (point_t) {320, 190 } );
-  list.push_back( (point_t) {210, 250 } );
-  list.push_back( (point_t) {40, 300 } );
-  list.push_back( (point_t) {20, 290 } );
-  list.push_back( (point_t) {30, 230 } );
-
-  chgStationX = 35;
-  chgStationY = 150;
-
-  // compute magnetic field (compute distance to perimeter lines)
-  int x1 = list[list.size()-1].x;
-  int y1 = list[list.size()-1].y;
-  // for each perimeter line
+  cacheBfield = true;
+  drawScale = 1;
+  worldSizeX = worldSizeY = 0;
+  tilesX = tilesY = 0;
+  lawnArea = 0;
+  mowedArea = 0;
+  chgStationX = chgStationY = 0;
+}
+
+
+SimWorld::~SimWorld(){
+  clearTiles();
+}
+
+
+void SimWorld::setPerimeter(std::vector<point_t> &list, int stationX, int stationY){
+  chgStationX = stationX;
+  chgStationY = stationY;
+  // world size from perimeter extent
+  worldSizeX = stationX;
+  worldSizeY = stationY;
   for (int i=0; i < list.size(); i++){
-    int x2 = list[i].x;
-    int y2 = list[i].y;
-    int dx = (x2-x1);
-    int dy = (y2-y1);
-    int len=(sqrt( dx*dx + dy*dy )); // line length
-    float phi = atan2(dy,dx); // line angle
-    // compute magnetic field for points (x,y) around perimeter line
-    for (int y=-200; y < 200; y++){
-      for (int x=-100; x < len*2+100-1; x++){
-        int px= x1 + cos(phi)*x/2 - sin(phi)*y;
-        int py= y1 + sin(phi)*x/2 + cos(phi)*y;
-        int xend = max(0, min(len, x/2)); // restrict to line ends
-        int cx = x1 + cos(phi)*xend;  // cx on line
-        int cy = y1 + sin(phi)*xend;  // cy on line
-        if ((py >= 0) && (py < WORLD_SIZE_Y)
-           && (px >=0) && (px < WORLD_SIZE_X)) {
-          float r = max(0.000001, sqrt( (cx-px)*(cx-px) + (cy-py)*(cy-py) ) ) / 10; // distance to line (meter)
-          float b=100.0/(2.0*M_PI*r); // field strength
-          int c = pnpoly(list, px, py);
-          //if ((y<=0) || (bfield[py][px] < 0)){
-          if (c == 0){
-            b=b*-1.0;
-            bfield[py][px] =  min(bfield[py][px], b);
-          } else bfield[py][px] = max(bfield[py][px], b);
-        }
-      }
-    }
-    x1=x2;
-    y1=y2;
+    worldSizeX = max(worldSizeX, (int)list[i].x);
+    worldSizeY = max(worldSizeY, (int)list[i].y);
   }
+  worldSizeX += WORLD_MARGIN;
+  worldSizeY += WORLD_MARGIN;
+  drawScale = max(1, max( (worldSizeX + WORLD_IMAGE_MAX_X-1) / WORLD_IMAGE_MAX_X,
+                          (worldSizeY + WORLD_IMAGE_MAX_Y-1) / WORLD_IMAGE_MAX_Y ));
+  lawnMowStatus.init(worldSizeX, worldSizeY);
+  lawnArea = 0;
+  mowedArea = 0;
+  segments.clear();
+  addLoop(list, false);
+}
 
-  // draw magnetic field onto image
-  for (int y=0; y < WORLD_SIZE_Y; y++){
-    for (int x=0; x < WORLD_SIZE_X; x++) {
-      float b=30 + 30*sqrt( abs(getBfield(x,y)) );
-      //b:=10 + bfield[y][x];
-      int v = min(255, max(0, (int)b));
-      cv::Vec3b intensity;
-      if (bfield[y][x] > 0){
-        intensity.val[0]=255-v;
-        intensity.val[1]=255-v;
-        intensity.val[2]=255;
-      } else {
-        intensity.val[0]=255;
-        intensity.val[1]=255-v;
-        intensity.val[2]=255-v;
-      }
-      imgBfield.at<cv::Vec3b>(y, x) = intensity;
+
+void SimWorld::addIsland(std::vector<point_t> &list){
+  addLoop(list, true);
+}
+
+
+// adds wire loop: current direction is chosen so that the field is positive inside the lawn
+// (perimeter: inside loop, island: outside loop)
+void SimWorld::addLoop(std::vector<point_t> &list, bool island){
+  int n = list.size();
+  if (n < 3) return;
+  float area = 0;
+  for (int i=0, j=n-1; i < n; j = i++) area += list[j].x * list[i].y - list[i].x * list[j].y;
+  bool reverse = ((area < 0) != island);
+  if (island) lawnArea -= fabs(area)/2;
+    else lawnArea += fabs(area)/2;
+  for (int i=0, j=n-1; i < n; j = i++){
+    segment_t seg;
+    if (reverse) seg = (segment_t){ list[i].x, list[i].y, list[j].x, list[j].y };
+      else seg = (segment_t){ list[j].x, list[j].y, list[i].x, list[i].y };
+    segments.push_back(seg);
+  }
+  buildIndex();
+  clearTiles();
+  imgBfield = cv::Mat();
+}
+
+
+// point-in-polygon index: for each horizontal bucket, all segments crossing it
+void SimWorld::buildIndex(){
+  edgeBuckets.clear();
+  edgeBuckets.resize(worldSizeY / EDGE_BUCKET_SIZE + 1);
+  for (unsigned int i=0; i < segments.size(); i++){
+    int b1 = max(0, (int)(min(segments[i].y1, segments[i].y2) / EDGE_BUCKET_SIZE));
+    int b2 = min((int)edgeBuckets.size()-1, (int)(max(segments[i].y1, segments[i].y2) / EDGE_BUCKET_SIZE));
+    for (int b=b1; b <= b2; b++) edgeBuckets[b].push_back(i);
+  }
+}
+
+
+void SimWorld::clearTiles(){
+  for (unsigned int i=0; i < bfieldTiles.size(); i++) delete[] bfieldTiles[i];
+  tilesX = (worldSizeX + BFIELD_TILE_SIZE-1) / BFIELD_TILE_SIZE;
+  tilesY = (worldSizeY + BFIELD_TILE_SIZE-1) / BFIELD_TILE_SIZE;
+  bfieldTiles.assign(tilesX * tilesY, (float*)NULL);
+}
+
+
+float* SimWorld::computeTile(int tx, int ty){
+  float *tile = new float[BFIELD_TILE_SIZE * BFIELD_TILE_SIZE];
+  for (int y=0; y < BFIELD_TILE_SIZE; y++){
+    for (int x=0; x < BFIELD_TILE_SIZE; x++){
+      tile[y*BFIELD_TILE_SIZE + x] = computeBfield(tx*BFIELD_TILE_SIZE + x, ty*BFIELD_TILE_SIZE + y);
     }
   }
+  bfieldTiles[ty*tilesX + tx] = tile;
+  return tile;
+}
+
+
+int SimWorld::getTileCount(){
+  int count = 0;
+  for (unsigned int i=0; i < bfieldTiles.size(); i++) if (bfieldTiles[i] != NULL) count++;
+  return count;
+}
+
+
+// magnetic field of the wire segments (Biot-Savart, field perpendicular to ground plane)
+// finite straight wire: B = k/d * (sin(a2) - sin(a1)), d = distance to wire line,
+// a1, a2 = angles from perpendicular to segment ends; infinite wire: B = 2k/d
+// k is chosen so that B = 100/(2*PI*r) (r in decimeter) for an infinite wire
+float SimWorld::computeBfield(float x, float y){
+  const float k = 100.0/(4.0*M_PI);
+  float b = 0;
+  for (unsigned int i=0; i < segments.size(); i++){
+    const segment_t &s = segments[i];
+    float dx = s.x2 - s.x1;
+    float dy = s.y2 - s.y1;
+    float len = sqrt(dx*dx + dy*dy);
+    if (len < 0.001) continue;
+    float tx = dx / len;
+    float ty = dy / len;
+    float ax = s.x1 - x;
+    float ay = s.y1 - y;
+    float bx = s.x2 - x;
+    float by = s.y2 - y;
+    // signed distance (positive left of segment), limited to 1 cm
+    float d = (tx*(-ay) - ty*(-ax)) / 10.0;
+    if (fabs(d) < 0.1) d = (d < 0) ? -0.1 : 0.1;
+    float ra = max(0.001f, sqrtf(ax*ax + ay*ay));
+    float rb = max(0.001f, sqrtf(bx*bx + by*by));
+    float sin1 = (tx*ax + ty*ay) / ra;
+    float sin2 = (tx*bx + ty*by) / rb;
+    b += k / d * (sin2 - sin1);
+  }
+  return b;
 }
 
+
 // x,y: cm
 float SimWorld::getBfield(int x, int y, int resolution){
-  float res = 0;
-  if ((x >= 0) && (x < WORLD_SIZE_X) && (y >= 0) && (y < WORLD_SIZE_Y)){
-    int xd = ((int)((x+resolution/2)/resolution))*resolution;
-    int yd = ((int)((y+resolution/2)/resolution))*resolution;
-    res = bfield[yd][xd];
-  }
+  int xd = ((int)((x+resolution/2)/resolution))*resolution;
+  int yd = ((int)((y+resolution/2)/resolution))*resolution;
+  if ((!cacheBfield) || (xd < 0) || (xd >= worldSizeX) || (yd < 0) || (yd >= worldSizeY))
+    return computeBfield(xd, yd);
+  int tx = xd / BFIELD_TILE_SIZE;
+  int ty = yd / BFIELD_TILE_SIZE;
+  float *tile = bfieldTiles[ty*tilesX + tx];
+  if (tile == NULL) tile = computeTile(tx, ty);
   //float measurement_noise = 0.5;
   //res += gauss(0.0, measurement_noise);
-  return res;
+  return tile[(yd - ty*BFIELD_TILE_SIZE)*BFIELD_TILE_SIZE + (xd - tx*BFIELD_TILE_SIZE)];
+}
+
+bool SimWorld::isInside(float x, float y){
+  return (pnpoly(x, y) != 0);
+}
+
+// coverage is counted while mowing (setLawnMowed), no map scan needed
+float SimWorld::getCoverage(){
+  if (lawnArea <= 0) return 0;
+  return min(100.0, 100.0 * mowedArea / lawnArea);
 }
 
 void SimWorld::draw(){
+  int cols = worldSizeX / drawScale;
+  int rows = worldSizeY / drawScale;
+  if (imgBfield.empty()){
+    // draw magnetic field onto image (once)
+    imgBfield = cv::Mat(rows, cols, CV_8UC3, cv::Scalar(0,0,0));
+    for (int y=0; y < rows; y++){
+      for (int x=0; x < cols; x++) {
+        float bfield = computeBfield(x*drawScale, y*drawScale);
+        float b=30 + 30*sqrt( fabs(bfield) );
+        int v = min(255, max(0, (int)b));
+        cv::Vec3b intensity;
+        if (bfield > 0){
+          intensity.val[0]=255-v;
+          intensity.val[1]=255-v;
+          intensity.val[2]=255;
+        } else {
+          intensity.val[0]=255;
+          intensity.val[1]=255-v;
+          intensity.val[2]=255-v;
+        }
+        imgBfield.at<cv::Vec3b>(y, x) = intensity;
+      }
+    }
+  }
   char buf[64];
-  sprintf(buf, " (%dcm x %dcm)", WORLD_SIZE_X, WORLD_SIZE_Y);
-  imshow("world " + std::string(buf), imgWorld);
+  sprintf(buf, " (%dcm x %dcm)", worldSizeX, worldSizeY);
+  if (!imgWorld.empty()) imshow("world " + std::string(buf), imgWorld);
   imgBfield.copyTo(imgWorld);
   // draw lawn mowed status
   if (drawMowedLawn){
@@ -108,26 +199,43 @@ void SimWorld::draw(){
     intensity.val[0]=0;
     intensity.val[1]=255;
     intensity.val[2]=0;
-    for (int y=0; y < WORLD_SIZE_Y; y++){
-      for (int x=0; x < WORLD_SIZE_X; x++){
-        if (lawnMowStatus[y][x] > 0) imgWorld.at<cv::Vec3b>(y, x) = intensity;
+    for (int y=0; y < rows; y++){
+      for (int x=0; x < cols; x++){
+        if (lawnMowStatus.get(x*drawScale, y*drawScale) > 0) imgWorld.at<cv::Vec3b>(y, x) = intensity;
       }
     }
   }
   // draw charging station
-  circle( imgWorld, cv::Point( chgStationX, chgStationY), 10, cv::Scalar( 0, 255, 255 ), -1, 8 );
+  circle( imgWorld, cv::Point( chgStationX/drawScale, chgStationY/drawScale), max(2, 10/drawScale), cv::Scalar( 0, 255, 255 ), -1, 8 );
 }
 
-// approximate circle pattern
-// 010
-// 111
-// 010
-// x,y: cm
-void SimWorld::setLawnMowed(int x, int y){
-  if (  (x <= 5) || (x >= WORLD_SIZE_X-5 ) || (y <= 5) || (y >= WORLD_SIZE_Y-5 )  )return;
-  for (int i=-2; i <= 2; i++){
-    for (int j=-2; j <= 2; j++){
-      lawnMowStatus[y+i][x+j] = 1.0;
+// rasterizes the cutter swath between two robot positions: all cells (cm) within width/2 of the
+// path, except those already covered by the cutter at the start position (mowed in the previous step),
+// so each pass over a cell is counted once
+void SimWorld::setLawnMowed(float x1, float y1, float x2, float y2, float width){
+  float r = width/2;
+  float dx = x2-x1;
+  float dy = y2-y1;
+  float len2 = dx*dx + dy*dy;
+  if (len2 < 0.000001) return;
+  int minX = max(0, (int)floor(min(x1, x2) - r));
+  int maxX = min(worldSizeX-1, (int)ceil(max(x1, x2) + r));
+  int minY = max(0, (int)floor(min(y1, y2) - r));
+  int maxY = min(worldSizeY-1, (int)ceil(max(y1, y2) + r));
+  for (int y=minY; y <= maxY; y++){
+    float py = y + 0.5;
+    for (int x=minX; x <= maxX; x++){
+      float px = x + 0.5;
+      // already under cutter at start position?
+      float ax = px-x1;
+      float ay = py-y1;
+      if (ax*ax + ay*ay <= r*r) continue;
+      // distance to path
+      float t = max(0.0f, min(1.0f, (ax*dx + ay*dy) / len2));
+      float ex = ax - t*dx;
+      float ey = ay - t*dy;
+      if (ex*ex + ey*ey > r*r) continue;
+      if ((lawnMowStatus.add(x, y) == 0) && (isInside(px, py))) mowedArea++;
     }
   }
 }
@@ -141,15 +249,18 @@ void SimWorld::setLawnMowed(int x, int y){
 // By repeatedly inverting the value of c, the algorithm counts how many times the rightward line crosses the
 // polygon. If it crosses an odd number of times, then the point is inside; if an even number, the point is outside.
 
-int SimWorld::pnpoly(std::vector<point_t> &vertices, float testx, float testy)
+// (only the edges of the bucket the test point is in are checked, islands are just more edges)
+
+int SimWorld::pnpoly(float testx, float testy)
 {
-  int i, j, c = 0;
-  int nvert = vertices.size();
-  for (i = 0, j = nvert-1; i < nvert; j = i++) {
-    if ( ((vertices[i].y>testy) != (vertices[j].y>testy)) &&
-     (testx < (vertices[j].x-vertices[i].x) * (testy-vertices[i].y) / (vertices[j].y-vertices[i].y) + vertices[i].x) )
+  int c = 0;
+  if ((testy < 0) || (testy >= edgeBuckets.size() * EDGE_BUCKET_SIZE)) return 0;
+  std::vector<int> &bucket = edgeBuckets[(int)(testy / EDGE_BUCKET_SIZE)];
+  for (unsigned int k = 0; k < bucket.size(); k++) {
+    const segment_t &s = segments[bucket[k]];
+    if ( ((s.y2>testy) != (s.y1>testy)) &&
+     (testx < (s.x1-s.x2) * (testy-s.y2) / (s.y1-s.y2) + s.x2) )
        c = !c;
   }
   return c;
 }
-
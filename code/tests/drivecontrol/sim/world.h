@@ -19,6 +19,7 @@
 #define WORLD_H
 
 #include "../common.h"
+#include "coverage.h"
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv/cv.h>
@@ -31,31 +32,87 @@
 
 
 
-// world size (cm)
-#define WORLD_SIZE_X 500
-#define WORLD_SIZE_Y 350
+// world margin around perimeter (cm)
+#define WORLD_MARGIN 100
 
+// magnetic field tile cache: tile size (cm, at 1 cm resolution)
+#define BFIELD_TILE_SIZE 32
 
-// world (perimeter wire etc.)
+// point-in-polygon index: height of edge buckets (cm)
+#define EDGE_BUCKET_SIZE 20
+
+// max. world image size (pixels), larger worlds are drawn scaled down
+#define WORLD_IMAGE_MAX_X 1000
+#define WORLD_IMAGE_MAX_Y 700
+
+
+// perimeter wire segment (current flows from 1 to 2)
+struct segment_t {
+  float x1, y1;
+  float x2, y2;
+};
+
+typedef struct segment_t segment_t;
+
+
+/*
+  world (perimeter wire etc.), world size follows the perimeter (coordinates in cm, >= 0)
+
+  The magnetic field is computed analytically (Biot-Savart sum over the wire segments) when needed,
+  optionally cached in tiles filled on first access. Inside/outside tests use the edges of the
+  horizontal bucket (row) the point is in, so both are independent of the world size.
+  Islands are additional loops with the wire current in opposite direction.
+*/
 class SimWorld
 {
-    // magnetic field
-    float bfield[WORLD_SIZE_Y][WORLD_SIZE_X];
-    // lawn mow status
-    float lawnMowStatus[WORLD_SIZE_Y][WORLD_SIZE_X];
-    int pnpoly(std::vector<point_t> &vertices, float testx, float testy);
+    int worldSizeX, worldSizeY;
+    // magnetic field tile cache (NULL = tile not computed yet)
+    std::vector<float*> bfieldTiles;
+    int tilesX, tilesY;
+    // lawn mow status (pass count per cm^2), lawn area and mowed area inside perimeter (cm^2)
+    SimCoverage lawnMowStatus;
+    double lawnArea;
+    long mowedArea;
+    // wire segments (all loops) and point-in-polygon index (segments per bucket)
+    std::vector<segment_t> segments;
+    std::vector< std::vector<int> > edgeBuckets;
+    void addLoop(std::vector<point_t> &list, bool island);
+    void buildIndex();
+    void clearTiles();
+    float* computeTile(int tx, int ty);
+    int pnpoly(float testx, float testy);
   public:
     int chgStationX, chgStationY; // cm
     cv::Mat imgBfield;
     cv::Mat imgWorld;
     bool drawMowedLawn;
+    bool cacheBfield;  // use tile cache for getBfield
+    int drawScale;     // cm per image pixel
     SimWorld();
+    ~SimWorld();
+    // sets perimeter loop (cm) and charging station
+    void setPerimeter(std::vector<point_t> &list, int stationX, int stationY);
+    // adds island (loop inside perimeter)
+    void addIsland(std::vector<point_t> &list);
     // return world size (cm)
-    int sizeX(){ return WORLD_SIZE_X; };
-    int sizeY(){ return WORLD_SIZE_Y; };
+    int sizeX(){ return worldSizeX; };
+    int sizeY(){ return worldSizeY; };
     // return magnetic field strength at world position
     float getBfield(int x, int y, int resolution=1);
-    void setLawnMowed(int x, int y);
+    // computes magnetic field strength at world position (no cache)
+    float computeBfield(float x, float y);
+    // number of computed field tiles
+    int getTileCount();
+    // inside perimeter loop?
+    bool isInside(float x, float y);
+    // mows cutter swath (width in cm) between two robot positions
+    void setLawnMowed(float x1, float y1, float x2, float y2, float width);
+    // pass count of lawn cell
+    int getLawnMowed(int x, int y){ return lawnMowStatus.get(x, y); };
+    // mowed share of lawn inside perimeter (percent)
+    float getCoverage();
+    // coverage map memory (bytes)
+    long getCoverageMemory(){ return lawnMowStatus.getMemory(); };
     void draw();
 };
 
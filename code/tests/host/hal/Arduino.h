@@ -0,0 +1,204 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+Arduino API for the host build (Arduino Due flavour, see hal.h)
+
+The firmware is compiled unchanged against this header: it takes the Due code paths
+(no __AVR__), the peripherals it touches directly (ADC, flash, timers) are emulated in hal.cpp.
+ARDUINO is intentionally not defined (host code paths of the profiler use the host clock).
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "binary.h"
+#include "WString.h"
+#include "Stream.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+#include "avr/pgmspace.h"   // PROGMEM, PSTR, pgm_read_xxx (simulator)
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define radians(deg) ((deg)*DEG_TO_RAD)
+#define degrees(rad) ((rad)*RAD_TO_DEG)
+#define sq(x) ((x)*(x))
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b) (1UL << (b))
+
+#ifndef F_CPU
+  #define F_CPU 84000000L
+#endif
+
+// Due pin numbering
+#define PINS_COUNT 79
+#define SDA 20
+#define SCL 21
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+#define DAC0 66
+#define DAC1 67
+#define CANRX 68
+#define CANTX 69
+
+#define digitalPinToInterrupt(p) (p)
+#define NOT_AN_INTERRUPT -1
+
+// interrupt service routines are plain functions (called by the HAL, see hal_attachInterrupt)
+#define ISR(vector) void vector(void)
+
+#include "chip.h"
+
+
+// serial port: TX goes to a sink (stdout for Serial), RX is injected by the harness (hal_serialInject)
+// or arrives at the baud rate (hal_serialLine)
+#define SERIAL_RX_SIZE 1024
+#define SERIAL_TX_SIZE 128
+#define HAL_SERIAL_CORE_RX 128       // RX line: core buffer size of the Due (further bytes are lost)
+
+class HardwareSerial : public Stream
+{
+  public:
+    HardwareSerial(const char *aName, FILE *aSink, Usart *aUsart = NULL);
+    void begin(unsigned long baud);
+    void end();
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    int availableForWrite();
+    operator bool() { return true; }
+    // harness side
+    const char *name;
+    FILE *sink;
+    unsigned long baud;
+    unsigned long txCount;
+    unsigned long txBaud;          // TX line rate model (0: unlimited, see hal_serialThrottle)
+    unsigned long txBusyUntil;     // micros when the queued TX bytes are sent
+    unsigned long txBlockedMicros; // time writes waited for TX buffer room
+    boolean inject(const uint8_t *data, size_t size);
+    // RX line model (hal_serialLine)
+    Usart *usart;                  // USART of the port (PDC receive), NULL: none
+    const uint8_t *lineData;
+    size_t lineSize;
+    size_t linePos;
+    uint64_t lineStartMicros;
+    unsigned long rxOverruns;      // line bytes lost (no room in the RX buffer)
+    void receive(uint8_t c);
+  private:
+    uint8_t rx[SERIAL_RX_SIZE];
+    volatile unsigned int rxHead;
+    volatile unsigned int rxTail;
+    void txWait();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+#define SerialUSB Serial
+
+
+// time (virtual clock, see hal.h)
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// pins
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+int analogRead(uint32_t pin);
+void analogWrite(uint32_t pin, uint32_t value);
+void analogReadResolution(int res);
+void analogWriteResolution(int res);
+unsigned long pulseIn(uint32_t pin, uint32_t state, unsigned long timeout = 1000000L);
+
+// interrupts
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+void interrupts(void);
+void noInterrupts(void);
+
+// math
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+#include "itoa.h"
+#include "avr/dtostrf.h"
+
+
+#endif
+
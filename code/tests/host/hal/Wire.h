@@ -0,0 +1,68 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+I2C master (host build)
+
+Transfers are served by emulated devices (register maps with auto-increment register pointer),
+attached by the harness with hal_i2cAttach (see hal.h). Unknown addresses are not acknowledged.
+*/
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH 32
+
+class TwoWire : public Stream
+{
+  public:
+    TwoWire();
+    void begin();
+    void setClock(uint32_t clock);
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address){ beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(uint8_t sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+    uint8_t requestFrom(int address, int quantity){ return requestFrom((uint8_t)address, (uint8_t)quantity); }
+    virtual size_t write(uint8_t data);
+    virtual size_t write(const uint8_t *data, size_t quantity);
+    using Print::write;
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+  private:
+    uint8_t txAddress;
+    uint8_t txBuffer[BUFFER_LENGTH];
+    uint8_t txLength;
+    uint8_t rxBuffer[BUFFER_LENGTH];
+    uint8_t rxIndex;
+    uint8_t rxLength;
+};
+
+extern TwoWire Wire;
+
+#endif
+
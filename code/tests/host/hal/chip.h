@@ -0,0 +1,255 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+SAM3X8E peripherals used directly by the firmware (host build)
+
+Only the registers/functions the firmware touches are provided. Register writes are picked up
+by hal_service() (ADC channel enable/disable, PDC transfer control), flash lives in a RAM array,
+the TWI transfers are served by the emulated I2C devices (hal_i2cAttach), USART3 (Serial3) receives
+the RX line bytes (hal_serialLine) with PDC.
+Peripheral addresses are 32 bit (as on the Due) - the host binary must be linked non-PIE
+so that static buffers are below 4 GB (checked by hal_begin).
+*/
+
+#ifndef _CHIP_H_
+#define _CHIP_H_
+
+#include <stdint.h>
+
+// DueTimer.h only compiles for ARM - the host build provides its API (hal_due.cpp)
+#ifndef __arm__
+  #define __arm__ 1
+#endif
+
+
+typedef enum IRQn {
+  TC0_IRQn = 27, TC1_IRQn, TC2_IRQn, TC3_IRQn, TC4_IRQn, TC5_IRQn, TC6_IRQn, TC7_IRQn, TC8_IRQn,
+  ADC_IRQn = 37,
+} IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+
+extern uint32_t SystemCoreClock;
+
+
+// --- ADC ---
+struct Adc {
+  volatile uint32_t ADC_CR;
+  volatile uint32_t ADC_MR;
+  volatile uint32_t ADC_SEQR1;
+  volatile uint32_t ADC_SEQR2;
+  volatile uint32_t ADC_CHER;   // write: enable channels
+  volatile uint32_t ADC_CHDR;   // write: disable channels
+  volatile uint32_t ADC_CHSR;   // channel status
+  volatile uint32_t ADC_LCDR;   // last converted data (with tag)
+  volatile uint32_t ADC_IER;
+  volatile uint32_t ADC_IDR;
+  volatile uint32_t ADC_IMR;
+  volatile uint32_t ADC_ISR;
+  volatile uint32_t ADC_EMR;
+  volatile uint32_t ADC_CDR[16];
+  // PDC (DMA)
+  volatile uint32_t ADC_RPR;
+  volatile uint32_t ADC_RCR;
+  volatile uint32_t ADC_RNPR;
+  volatile uint32_t ADC_RNCR;
+  volatile uint32_t ADC_PTCR;
+  volatile uint32_t ADC_PTSR;
+};
+
+extern Adc hal_adc;
+#define ADC (&hal_adc)
+
+#define ADC_MR_FREERUN_ON (0x1u << 7)
+#define ADC_EMR_TAG (0x1u << 24)
+#define ADC_LCDR_LDATA_Msk 0xFFFu
+#define ADC_LCDR_CHNB_Pos 12
+#define ADC_PTCR_RXTEN (0x1u << 0)
+#define ADC_PTCR_RXTDIS (0x1u << 1)
+#define ADC_PTSR_RXTEN (0x1u << 0)
+#define ADC_IER_DRDY (0x1u << 24)
+#define ADC_IER_ENDRX (0x1u << 27)
+#define ADC_IDR_ENDRX (0x1u << 27)
+#define ADC_ISR_DRDY (0x1u << 24)
+#define ADC_ISR_ENDRX (0x1u << 27)
+#define ADC_STARTUP_FAST 12
+#define ADC_SETTLING_TIME_3 3
+
+typedef enum adc_channel_num_t {
+  ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4, ADC_CHANNEL_5,
+  ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8, ADC_CHANNEL_9, ADC_CHANNEL_10, ADC_CHANNEL_11,
+  ADC_CHANNEL_12, ADC_CHANNEL_13, ADC_CHANNEL_14, ADC_TEMPERATURE_SENSOR,
+} adc_channel_num_t;
+
+uint32_t adc_init(Adc *p_adc, uint32_t ul_mck, uint32_t ul_adc_clock, uint8_t uc_startup);
+void adc_configure_timing(Adc *p_adc, uint8_t uc_tracking, uint8_t uc_settling, uint8_t uc_transfer);
+void adc_start(Adc *p_adc);
+void adc_enable_channel(Adc *p_adc, adc_channel_num_t adc_ch);
+void adc_disable_channel(Adc *p_adc, adc_channel_num_t adc_ch);
+void adc_enable_interrupt(Adc *p_adc, uint32_t ul_source);
+void adc_disable_interrupt(Adc *p_adc, uint32_t ul_source);
+uint32_t adc_get_status(Adc *p_adc);
+uint32_t adc_get_latest_value(Adc *p_adc);
+
+// ADC interrupt handler (firmware, adcman.cpp)
+void ADC_Handler(void);
+
+
+// --- timer counter (only referenced by the firmware, see hal_due.cpp) ---
+struct TcChannel {
+  volatile uint32_t TC_CCR;
+  volatile uint32_t TC_CMR;
+  volatile uint32_t TC_RA;
+  volatile uint32_t TC_RB;
+  volatile uint32_t TC_RC;
+  volatile uint32_t TC_SR;
+  volatile uint32_t TC_IER;
+  volatile uint32_t TC_IDR;
+  volatile uint32_t TC_IMR;
+};
+
+struct Tc {
+  TcChannel TC_CHANNEL[3];
+};
+
+extern Tc hal_tc[3];
+#define TC0 (&hal_tc[0])
+#define TC1 (&hal_tc[1])
+#define TC2 (&hal_tc[2])
+
+
+// --- two-wire interface (I2C master with PDC, libsam API, see hal.cpp) ---
+struct Twi {
+  volatile uint32_t TWI_CR;
+  volatile uint32_t TWI_MMR;
+  volatile uint32_t TWI_IADR;
+  volatile uint32_t TWI_CWGR;
+  volatile uint32_t TWI_SR;
+  volatile uint32_t TWI_IER;
+  volatile uint32_t TWI_IDR;
+  volatile uint32_t TWI_IMR;
+  volatile uint32_t TWI_RHR;
+  volatile uint32_t TWI_THR;
+  // PDC (DMA)
+  volatile uint32_t TWI_RPR;
+  volatile uint32_t TWI_RCR;
+  volatile uint32_t TWI_TPR;
+  volatile uint32_t TWI_TCR;
+  volatile uint32_t TWI_PTCR;
+  volatile uint32_t TWI_PTSR;
+};
+
+extern Twi hal_twi1;
+#define TWI1 (&hal_twi1)
+
+#define TWI_CR_START (0x1u << 0)
+#define TWI_CR_STOP (0x1u << 1)
+#define TWI_CR_MSEN (0x1u << 2)
+#define TWI_CR_SWRST (0x1u << 7)
+#define TWI_MMR_IADRSZ_Pos 8
+#define TWI_MMR_MREAD (0x1u << 12)
+#define TWI_MMR_DADR_Pos 16
+#define TWI_SR_TXCOMP (0x1u << 0)
+#define TWI_SR_RXRDY (0x1u << 1)
+#define TWI_SR_TXRDY (0x1u << 2)
+#define TWI_SR_NACK (0x1u << 8)
+#define TWI_SR_ENDRX (0x1u << 12)
+#define TWI_SR_ENDTX (0x1u << 13)
+#define TWI_PTCR_RXTEN (0x1u << 0)
+#define TWI_PTCR_RXTDIS (0x1u << 1)
+#define TWI_PTCR_TXTEN (0x1u << 8)
+#define TWI_PTCR_TXTDIS (0x1u << 9)
+#define TWI_PTSR_RXTEN (0x1u << 0)
+#define TWI_PTSR_TXTEN (0x1u << 8)
+
+void TWI_ConfigureMaster(Twi *pTwi, uint32_t twck, uint32_t mck);
+void TWI_Stop(Twi *pTwi);
+void TWI_SendSTOPCondition(Twi *pTwi);
+void TWI_StartRead(Twi *pTwi, uint8_t address, uint32_t iaddress, uint8_t isize);
+uint8_t TWI_ReadByte(Twi *pTwi);
+void TWI_StartWrite(Twi *pTwi, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t byte);
+void TWI_WriteByte(Twi *pTwi, uint8_t byte);
+uint32_t TWI_GetStatus(Twi *pTwi);
+
+
+// --- USART (receive with PDC, see hal_serialLine; TX goes through the HardwareSerial sink) ---
+struct Usart {
+  volatile uint32_t US_CR;
+  volatile uint32_t US_MR;
+  volatile uint32_t US_IER;
+  volatile uint32_t US_IDR;
+  volatile uint32_t US_IMR;
+  volatile uint32_t US_CSR;
+  volatile uint32_t US_RHR;
+  volatile uint32_t US_THR;
+  volatile uint32_t US_BRGR;
+  // PDC (DMA)
+  volatile uint32_t US_RPR;
+  volatile uint32_t US_RCR;
+  volatile uint32_t US_TPR;
+  volatile uint32_t US_TCR;
+  volatile uint32_t US_RNPR;
+  volatile uint32_t US_RNCR;
+  volatile uint32_t US_TNPR;
+  volatile uint32_t US_TNCR;
+  volatile uint32_t US_PTCR;
+  volatile uint32_t US_PTSR;
+};
+
+extern Usart hal_usart3;
+#define USART3 (&hal_usart3)
+
+#define US_CR_RSTSTA (0x1u << 8)
+#define US_IER_RXRDY (0x1u << 0)
+#define US_IDR_RXRDY (0x1u << 0)
+#define US_CSR_RXRDY (0x1u << 0)
+#define US_CSR_OVRE (0x1u << 5)
+#define US_PTCR_RXTEN (0x1u << 0)
+#define US_PTCR_RXTDIS (0x1u << 1)
+#define US_PTSR_RXTEN (0x1u << 0)
+
+
+// --- pin description (Due variant) ---
+struct PinDescription {
+  uint32_t ulADCChannelNumber;
+};
+
+extern const PinDescription g_APinDescription[];
+
+
+// --- embedded flash (second bank used for settings) ---
+#define IFLASH1_SIZE 0x40000
+#define IFLASH1_PAGE_SIZE 256
+#define IFLASH1_ADDR ((uint32_t)(uintptr_t)hal_flash)
+#define EFC_ACCESS_MODE_128 0
+#define EFC_ACCESS_MODE_64 (0x1u << 24)
+
+extern uint8_t hal_flash[IFLASH1_SIZE];
+
+
+#endif
+
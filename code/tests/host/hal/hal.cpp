@@ -0,0 +1,813 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+
+#include <chrono>
+#include "hal.h"
+#include "Wire.h"
+
+
+#define NO_ADC 0xFF
+#define HAL_I2C_DEVICES 8
+#define HAL_ADC_MAX_CONVERSIONS 4096   // per hal_service call (keeps busy loops responsive)
+
+
+// Due variant: ADC channel of each pin (A0..A11: AD7..AD0, AD10..AD13)
+const PinDescription g_APinDescription[PINS_COUNT] = {
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   //  0..9
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   // 10..19
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   // 20..29
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   // 30..39
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   // 40..49
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},                                                               // 50..53
+  {7}, {6}, {5}, {4}, {3}, {2}, {1}, {0}, {10}, {11}, {12}, {13},                                       // A0..A11
+  {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC}, {NO_ADC},   // 66..75
+  {NO_ADC}, {NO_ADC}, {NO_ADC},                                                                         // 76..78
+};
+
+uint32_t SystemCoreClock = 84000000;
+Adc hal_adc;
+Tc hal_tc[3];
+Twi hal_twi1;
+Usart hal_usart3;
+uint8_t hal_flash[IFLASH1_SIZE] __attribute__((aligned(256)));
+
+HardwareSerial Serial("Serial", stdout);
+HardwareSerial Serial1("Serial1", NULL);
+HardwareSerial Serial2("Serial2", NULL);
+HardwareSerial Serial3("Serial3", NULL, USART3);
+TwoWire Wire;
+
+// heap symbols of the AVR libc (freeRam, value has no meaning on the host)
+int __heap_start;
+int *__brkval = NULL;
+
+
+// --- clock ---
+static uint64_t startNanos = 0;
+static uint64_t offsetMicros = 0;
+
+static uint64_t hostNanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t nowMicros(){
+  if (startNanos == 0) startNanos = hostNanos();
+  return (hostNanos() - startNanos) / 1000 + offsetMicros;
+}
+
+unsigned long micros(void){
+  hal_service();
+  return nowMicros();
+}
+
+unsigned long millis(void){
+  hal_service();
+  return nowMicros() / 1000;
+}
+
+void delay(unsigned long ms){
+  hal_advanceMicros(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us){
+  hal_advanceMicros(us);
+}
+
+void hal_advanceMicros(unsigned long us){
+  offsetMicros += us;
+  hal_service();
+}
+
+
+// --- interrupts ---
+static boolean interruptsEnabled = true;
+static boolean adcIrqEnabled = false;
+static boolean inService = false;
+
+void interrupts(void){ interruptsEnabled = true; }
+void noInterrupts(void){ interruptsEnabled = false; }
+
+void NVIC_EnableIRQ(IRQn_Type irq){ if (irq == ADC_IRQn) adcIrqEnabled = true; }
+void NVIC_DisableIRQ(IRQn_Type irq){ if (irq == ADC_IRQn) adcIrqEnabled = false; }
+void NVIC_ClearPendingIRQ(IRQn_Type irq){}
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority){}
+
+
+// --- pins ---
+struct halpin_t {
+  uint8_t mode;
+  uint8_t latch;
+  int8_t external;        // driven by harness (-1: not driven)
+  uint32_t pwm;
+  void (*callback)(void);
+  uint32_t interruptMode;
+};
+
+static halpin_t pins[PINS_COUNT];
+static int analogValue[12];
+static hal_analog_source_t analogSource = NULL;
+static int readResolution = 10;
+
+static int pinLevel(uint32_t pin){
+  halpin_t &p = pins[pin];
+  if (p.external >= 0) return p.external;
+  if (p.mode == OUTPUT) return p.latch;
+  if ((pin == SDA) || (pin == SCL)) return HIGH;  // I2C bus pull-ups
+  return (p.mode == INPUT_PULLUP) ? HIGH : p.latch;
+}
+
+static void pinEdge(uint32_t pin, int before, int after){
+  halpin_t &p = pins[pin];
+  if ((p.callback == NULL) || (before == after) || (!interruptsEnabled)) return;
+  if ( (p.interruptMode == CHANGE)
+    || ((p.interruptMode == RISING) && (after == HIGH))
+    || ((p.interruptMode == FALLING) && (after == LOW)) ) p.callback();
+}
+
+static void i2cBusPin(uint32_t pin, int before);
+
+void pinMode(uint32_t pin, uint32_t mode){
+  if (pin >= PINS_COUNT) return;
+  int before = pinLevel(pin);
+  pins[pin].mode = mode;
+  i2cBusPin(pin, before);
+}
+
+void digitalWrite(uint32_t pin, uint32_t value){
+  if (pin >= PINS_COUNT) return;
+  int before = pinLevel(pin);
+  pins[pin].latch = (value != LOW);
+  pinEdge(pin, before, pinLevel(pin));
+  i2cBusPin(pin, before);
+}
+
+int digitalRead(uint32_t pin){
+  if (pin >= PINS_COUNT) return LOW;
+  return pinLevel(pin);
+}
+
+void analogWrite(uint32_t pin, uint32_t value){
+  hal_setPinPwm(pin, value);
+}
+
+void hal_setPinPwm(uint32_t pin, uint32_t value){
+  if (pin >= PINS_COUNT) return;
+  pins[pin].pwm = value;
+  pins[pin].latch = (value >= 128);
+}
+
+void analogReadResolution(int res){ readResolution = res; }
+void analogWriteResolution(int res){}
+
+unsigned long pulseIn(uint32_t pin, uint32_t state, unsigned long timeout){
+  // no pulse generator: wait for timeout
+  hal_advanceMicros(timeout);
+  return 0;
+}
+
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode){
+  if (pin >= PINS_COUNT) return;
+  pins[pin].callback = callback;
+  pins[pin].interruptMode = mode;
+}
+
+void detachInterrupt(uint32_t pin){
+  if (pin >= PINS_COUNT) return;
+  pins[pin].callback = NULL;
+}
+
+void hal_setPin(uint32_t pin, int value){
+  if (pin >= PINS_COUNT) return;
+  int before = pinLevel(pin);
+  pins[pin].external = (value != LOW);
+  pinEdge(pin, before, pinLevel(pin));
+}
+
+void hal_releasePin(uint32_t pin){
+  if (pin >= PINS_COUNT) return;
+  int before = pinLevel(pin);
+  pins[pin].external = -1;
+  pinEdge(pin, before, pinLevel(pin));
+}
+
+int hal_getPinOutput(uint32_t pin){
+  if (pin >= PINS_COUNT) return LOW;
+  return pins[pin].latch;
+}
+
+uint32_t hal_getPinPwm(uint32_t pin){
+  if (pin >= PINS_COUNT) return 0;
+  return pins[pin].pwm;
+}
+
+void hal_triggerInterrupt(uint32_t pin){
+  if ((pin >= PINS_COUNT) || (pins[pin].callback == NULL)) return;
+  pins[pin].callback();
+}
+
+
+// --- analog ---
+static int analogSample(uint32_t pin, uint64_t timeMicros){
+  int value = -1;
+  if (analogSource != NULL) value = analogSource(pin, timeMicros);
+  if (value < 0) value = analogValue[pin - A0];
+  return constrain(value, 0, 4095);
+}
+
+int analogRead(uint32_t pin){
+  if (pin < A0) pin += A0;
+  if ((pin < A0) || (pin > A11)) return 0;
+  int value = analogSample(pin, nowMicros());
+  if (readResolution < 12) return value >> (12 - readResolution);
+  return value << (readResolution - 12);
+}
+
+void hal_setAnalog(uint32_t pin, int value){
+  if (pin < A0) pin += A0;
+  if ((pin < A0) || (pin > A11)) return;
+  analogValue[pin - A0] = value;
+}
+
+void hal_setAnalogSource(hal_analog_source_t source){
+  analogSource = source;
+}
+
+
+// --- ADC (free running conversions, DRDY interrupt or PDC transfer with ENDRX interrupt) ---
+static uint32_t adcClock = 0;
+static boolean adcRunning = false;
+static uint64_t adcLastMicros = 0;
+static double adcPending = 0;            // conversions due (fraction)
+static uint8_t adcNextChannel = 0;
+static uint32_t adcChannelToPin[16];
+static unsigned long adcConversions = 0;
+
+uint32_t adc_init(Adc *p_adc, uint32_t ul_mck, uint32_t ul_adc_clock, uint8_t uc_startup){
+  memset((void*)p_adc, 0, sizeof(Adc));
+  adcClock = ul_adc_clock;
+  adcRunning = false;
+  return 0;
+}
+
+void adc_configure_timing(Adc *p_adc, uint8_t uc_tracking, uint8_t uc_settling, uint8_t uc_transfer){}
+
+void adc_start(Adc *p_adc){
+  if (!adcRunning) adcLastMicros = nowMicros();
+  adcRunning = true;
+}
+
+void adc_enable_channel(Adc *p_adc, adc_channel_num_t adc_ch){ p_adc->ADC_CHSR |= (1u << adc_ch); }
+void adc_disable_channel(Adc *p_adc, adc_channel_num_t adc_ch){ p_adc->ADC_CHSR &= ~(1u << adc_ch); }
+void adc_enable_interrupt(Adc *p_adc, uint32_t ul_source){ p_adc->ADC_IMR |= ul_source; }
+void adc_disable_interrupt(Adc *p_adc, uint32_t ul_source){ p_adc->ADC_IMR &= ~ul_source; }
+
+uint32_t adc_get_status(Adc *p_adc){
+  uint32_t status = p_adc->ADC_ISR & ~ADC_ISR_ENDRX;
+  if (p_adc->ADC_RCR == 0) status |= ADC_ISR_ENDRX;
+  return status;
+}
+
+uint32_t adc_get_latest_value(Adc *p_adc){
+  p_adc->ADC_ISR &= ~ADC_ISR_DRDY;
+  return p_adc->ADC_LCDR & ADC_LCDR_LDATA_Msk;
+}
+
+unsigned long hal_getAdcConversions(){
+  return adcConversions;
+}
+
+// apply register writes (channel enable/disable, PDC transfer control)
+static void adcRegisters(){
+  Adc *adc = ADC;
+  if (adc->ADC_CHDR) { adc->ADC_CHSR &= ~adc->ADC_CHDR; adc->ADC_CHDR = 0; }
+  if (adc->ADC_CHER) { adc->ADC_CHSR |= adc->ADC_CHER; adc->ADC_CHER = 0; }
+  if (adc->ADC_PTCR & ADC_PTCR_RXTDIS) adc->ADC_PTSR &= ~ADC_PTSR_RXTEN;
+    else if (adc->ADC_PTCR & ADC_PTCR_RXTEN) adc->ADC_PTSR |= ADC_PTSR_RXTEN;
+  adc->ADC_PTCR = 0;
+}
+
+static void adcConvert(uint64_t timeMicros){
+  Adc *adc = ADC;
+  // next enabled channel (channel sequence in ascending order)
+  uint8_t ch = adcNextChannel;
+  while ((adc->ADC_CHSR & (1u << ch)) == 0) ch = (ch + 1) & 0x0F;
+  adcNextChannel = (ch + 1) & 0x0F;
+  uint32_t value = analogSample(adcChannelToPin[ch], timeMicros);
+  adc->ADC_CDR[ch] = value;
+  adc->ADC_LCDR = value | ((adc->ADC_EMR & ADC_EMR_TAG) ? (ch << ADC_LCDR_CHNB_Pos) : 0);
+  adc->ADC_ISR |= ADC_ISR_DRDY;
+  adcConversions++;
+  boolean irq = adcIrqEnabled && interruptsEnabled;
+  if ((adc->ADC_PTSR & ADC_PTSR_RXTEN) && (adc->ADC_RCR > 0)) {
+    // PDC transfer (RPR holds a 32 bit address, see chip.h)
+    uint16_t *dest = (uint16_t*)(uintptr_t)adc->ADC_RPR;
+    *dest = adc->ADC_LCDR;
+    adc->ADC_RPR += 2;
+    adc->ADC_RCR--;
+    if ((adc->ADC_RCR == 0) && (adc->ADC_IMR & ADC_IER_ENDRX) && irq) ADC_Handler();
+  } else if ((adc->ADC_IMR & ADC_IER_DRDY) && irq) ADC_Handler();
+}
+
+static void adcService(){
+  Adc *adc = ADC;
+  adcRegisters();
+  uint64_t now = nowMicros();
+  if ((!adcRunning) || (adcClock == 0) || ((adc->ADC_MR & ADC_MR_FREERUN_ON) == 0) || ((adc->ADC_CHSR & 0xFFFF) == 0)) {
+    adcLastMicros = now;
+    adcPending = 0;
+    return;
+  }
+  // free running: one conversion per 21 ADC clocks
+  adcPending += ((double)(now - adcLastMicros)) * adcClock / 21.0 / 1000000.0;
+  adcLastMicros = now;
+  if (adcPending > HAL_ADC_MAX_CONVERSIONS) adcPending = HAL_ADC_MAX_CONVERSIONS;
+  double usPerConversion = 21.0 * 1000000.0 / adcClock;
+  while (adcPending >= 1.0) {
+    adcPending -= 1.0;
+    adcRegisters();
+    if ((adc->ADC_CHSR & 0xFFFF) == 0) break;
+    // conversions of this call spread over the elapsed time (sampled signals keep their waveform)
+    adcConvert(now - (uint64_t)(adcPending * usPerConversion));
+  }
+}
+
+
+// --- service ---
+static void twiService();
+static void serialService();
+
+void hal_service(){
+  if (inService) return;
+  inService = true;
+  adcService();
+  twiService();
+  serialService();
+  if (interruptsEnabled) hal_serviceTimers();
+  inService = false;
+}
+
+void hal_begin(){
+  // peripheral addresses are 32 bit (see chip.h)
+  if (((uint64_t)(uintptr_t)hal_flash > 0xFFFFFFFFULL) || ((uint64_t)(uintptr_t)&hal_adc > 0xFFFFFFFFULL)) {
+    fprintf(stderr, "hal: static data above 4 GB - link with -no-pie\n");
+    exit(1);
+  }
+  memset(hal_flash, 0xFF, sizeof hal_flash);
+  memset(pins, 0, sizeof pins);
+  for (int i=0; i < PINS_COUNT; i++) pins[i].external = -1;
+  for (int ch=0; ch < 16; ch++) adcChannelToPin[ch] = A0;
+  for (uint32_t pin=A0; pin <= A11; pin++) adcChannelToPin[g_APinDescription[pin].ulADCChannelNumber & 0x0F] = pin;
+  memset((void*)&hal_twi1, 0, sizeof hal_twi1);
+  memset((void*)&hal_usart3, 0, sizeof hal_usart3);
+  startNanos = hostNanos();
+  offsetMicros = 0;
+}
+
+
+// --- serial ---
+HardwareSerial::HardwareSerial(const char *aName, FILE *aSink, Usart *aUsart){
+  name = aName;
+  sink = aSink;
+  usart = aUsart;
+  lineData = NULL;
+  lineSize = linePos = 0;
+  lineStartMicros = 0;
+  rxOverruns = 0;
+  baud = 0;
+  txCount = 0;
+  txBaud = 0;
+  txBusyUntil = 0;
+  txBlockedMicros = 0;
+  rxHead = rxTail = 0;
+}
+
+void HardwareSerial::begin(unsigned long aBaud){ baud = aBaud; }
+void HardwareSerial::end(){ baud = 0; }
+
+int HardwareSerial::available(){
+  return (rxHead + SERIAL_RX_SIZE - rxTail) % SERIAL_RX_SIZE;
+}
+
+int HardwareSerial::read(){
+  if (rxHead == rxTail) return -1;
+  uint8_t c = rx[rxTail];
+  rxTail = (rxTail + 1) % SERIAL_RX_SIZE;
+  return c;
+}
+
+int HardwareSerial::peek(){
+  if (rxHead == rxTail) return -1;
+  return rx[rxTail];
+}
+
+void HardwareSerial::flush(){
+  if (sink) fflush(sink);
+}
+
+// throttled: waits for room in the TX buffer and queues one byte
+void HardwareSerial::txWait(){
+  if (txBaud == 0) return;
+  unsigned long byteTime = 10000000UL / txBaud;
+  while (availableForWrite() <= 0){
+    hal_advanceMicros(byteTime);
+    txBlockedMicros += byteTime;
+  }
+  unsigned long now = micros();
+  if ((long)(txBusyUntil - now) < 0) txBusyUntil = now;
+  txBusyUntil += byteTime;
+}
+
+size_t HardwareSerial::write(uint8_t c){
+  txWait();
+  txCount++;
+  if (sink) fputc(c, sink);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size){
+  for (size_t i=0; i < size; i++) txWait();
+  txCount += size;
+  if (sink) fwrite(buffer, 1, size, sink);
+  return size;
+}
+
+int HardwareSerial::availableForWrite(){
+  if (txBaud == 0) return SERIAL_TX_SIZE;
+  long busy = (long)(txBusyUntil - micros());
+  if (busy <= 0) return SERIAL_TX_SIZE;
+  long pending = (busy * (long)(txBaud / 10) + 999999L) / 1000000L;
+  return max(0L, SERIAL_TX_SIZE - pending);
+}
+
+boolean HardwareSerial::inject(const uint8_t *data, size_t size){
+  for (size_t i=0; i < size; i++){
+    unsigned int next = (rxHead + 1) % SERIAL_RX_SIZE;
+    if (next == rxTail) return false;
+    rx[rxHead] = data[i];
+    rxHead = next;
+  }
+  return true;
+}
+
+void hal_serialInject(HardwareSerial &port, const char *text){
+  port.inject((const uint8_t*)text, strlen(text));
+}
+
+void hal_serialSink(HardwareSerial &port, FILE *sink){
+  port.sink = sink;
+}
+
+void hal_serialThrottle(HardwareSerial &port, unsigned long baud){
+  port.txBaud = baud;
+  port.txBusyUntil = micros();
+  port.txBlockedMicros = 0;
+}
+
+// received byte: PDC buffer (if enabled) or core RX buffer
+void HardwareSerial::receive(uint8_t c){
+  Usart *p = usart;
+  if ((p != NULL) && (p->US_PTSR & US_PTSR_RXTEN)) {
+    if (p->US_RCR == 0) {
+      // PDC buffers full: receiver overrun
+      p->US_CSR |= US_CSR_OVRE;
+      rxOverruns++;
+      return;
+    }
+    // PDC transfer (RPR holds a 32 bit address, see chip.h)
+    *(uint8_t*)(uintptr_t)p->US_RPR = c;
+    p->US_RPR++;
+    p->US_RCR--;
+    if ((p->US_RCR == 0) && (p->US_RNCR != 0)) {
+      p->US_RPR = p->US_RNPR;
+      p->US_RCR = p->US_RNCR;
+      p->US_RNCR = 0;
+    }
+    return;
+  }
+  if (available() >= HAL_SERIAL_CORE_RX - 1) {
+    rxOverruns++;
+    return;
+  }
+  inject(&c, 1);
+}
+
+void hal_serialLine(HardwareSerial &port, const uint8_t *data, size_t size){
+  port.lineData = data;
+  port.lineSize = size;
+  port.linePos = 0;
+  port.lineStartMicros = nowMicros();
+}
+
+size_t hal_serialLinePending(HardwareSerial &port){
+  hal_service();
+  if (port.lineData == NULL) return 0;
+  return port.lineSize - port.linePos;
+}
+
+// apply register writes (interrupt enable/disable, status reset, PDC transfer control)
+static void usartRegisters(Usart *p){
+  if (p->US_IDR) { p->US_IMR &= ~p->US_IDR; p->US_IDR = 0; }
+  if (p->US_IER) { p->US_IMR |= p->US_IER; p->US_IER = 0; }
+  if (p->US_CR & US_CR_RSTSTA) p->US_CSR &= ~US_CSR_OVRE;
+  p->US_CR = 0;
+  if (p->US_PTCR & US_PTCR_RXTDIS) p->US_PTSR &= ~US_PTSR_RXTEN;
+    else if (p->US_PTCR & US_PTCR_RXTEN) p->US_PTSR |= US_PTSR_RXTEN;
+  p->US_PTCR = 0;
+}
+
+static void serialLine(HardwareSerial &port){
+  if (port.usart != NULL) usartRegisters(port.usart);
+  if ((port.lineData == NULL) || (port.baud == 0)) return;
+  // 10 bits per byte
+  uint64_t received = (nowMicros() - port.lineStartMicros) * (port.baud / 10) / 1000000;
+  while ((port.linePos < received) && (port.linePos < port.lineSize)) port.receive(port.lineData[port.linePos++]);
+  if (port.linePos >= port.lineSize) port.lineData = NULL;
+}
+
+static void serialService(){
+  serialLine(Serial1);
+  serialLine(Serial2);
+  serialLine(Serial3);
+}
+
+
+// --- I2C ---
+static hal_i2c_device_t *i2cDevices[HAL_I2C_DEVICES];
+
+void hal_i2cAttach(hal_i2c_device_t *device){
+  for (int i=0; i < HAL_I2C_DEVICES; i++){
+    if ((i2cDevices[i] == NULL) || (i2cDevices[i]->address == device->address)) {
+      i2cDevices[i] = device;
+      return;
+    }
+  }
+}
+
+static hal_i2c_device_t *i2cDevice(uint8_t address){
+  for (int i=0; i < HAL_I2C_DEVICES; i++){
+    if ((i2cDevices[i] != NULL) && (i2cDevices[i]->address == address)) return i2cDevices[i];
+  }
+  return NULL;
+}
+
+// --- TWI (I2C master with PDC), faults injected by the harness ---
+static struct {
+  boolean active;
+  hal_i2c_device_t *dev;    // NULL: address not acknowledged
+  boolean read;
+  boolean stop;             // STOP requested
+  boolean last;             // last byte transferred, STOP follows
+  uint64_t nextMicros;      // next byte on the bus
+} twi;
+static unsigned long twiClock = 100000;
+static unsigned long i2cDelay = 0;
+static int i2cNakCount = 0;
+static int i2cHoldClocks = 0;       // > 0: SDA held low by slave
+static unsigned long i2cTransfers = 0;
+
+void hal_i2cSetDelay(unsigned long us){ i2cDelay = us; }
+void hal_i2cInjectNak(int count){ i2cNakCount = count; }
+unsigned long hal_i2cTransfers(){ return i2cTransfers; }
+
+void hal_i2cHoldSDA(int clocks){
+  i2cHoldClocks = clocks;
+  pins[SDA].external = (clocks > 0) ? LOW : -1;
+}
+
+// SCL driven by the firmware (bus recovery): each rising edge clocks the stuck slave
+static void i2cBusPin(uint32_t pin, int before){
+  if ((pin != SCL) || (before != LOW) || (pinLevel(SCL) != HIGH) || (i2cHoldClocks == 0)) return;
+  if (--i2cHoldClocks == 0) pins[SDA].external = -1;
+}
+
+static uint64_t twiByteMicros(){
+  return 9000000ULL / twiClock;
+}
+
+static void twiRegisters(){
+  Twi *p = TWI1;
+  if (p->TWI_PTCR & TWI_PTCR_RXTDIS) p->TWI_PTSR &= ~TWI_PTSR_RXTEN;
+    else if (p->TWI_PTCR & TWI_PTCR_RXTEN) p->TWI_PTSR |= TWI_PTSR_RXTEN;
+  if (p->TWI_PTCR & TWI_PTCR_TXTDIS) p->TWI_PTSR &= ~TWI_PTSR_TXTEN;
+    else if (p->TWI_PTCR & TWI_PTCR_TXTEN) p->TWI_PTSR |= TWI_PTSR_TXTEN;
+  p->TWI_PTCR = 0;
+}
+
+static void twiStart(Twi *p, uint8_t address, boolean read){
+  p->TWI_SR &= ~(TWI_SR_TXCOMP | TWI_SR_NACK | TWI_SR_RXRDY);
+  twi.active = true;
+  twi.read = read;
+  twi.stop = twi.last = false;
+  twi.dev = i2cDevice(address);
+  if (i2cNakCount > 0) {
+    i2cNakCount--;
+    twi.dev = NULL;
+  }
+  if (twi.dev != NULL) twi.dev->reg = p->TWI_IADR;
+  i2cTransfers++;
+  // device and register address (read: repeated start, device address), slave delay
+  twi.nextMicros = nowMicros() + (read ? 3 : 2) * twiByteMicros() + i2cDelay;
+}
+
+static void twiStop(){
+  if (!twi.active) return;
+  // read: the byte after the one waiting in RHR (clock stretched before its ACK) is the last one
+  twi.stop = true;
+}
+
+void TWI_ConfigureMaster(Twi *pTwi, uint32_t twck, uint32_t mck){
+  memset((void*)pTwi, 0, sizeof(Twi));
+  pTwi->TWI_SR = TWI_SR_TXCOMP | TWI_SR_TXRDY;
+  twiClock = twck;
+  twi.active = false;
+}
+
+void TWI_Stop(Twi *pTwi){
+  pTwi->TWI_CR = TWI_CR_STOP;
+  twiStop();
+}
+
+void TWI_SendSTOPCondition(Twi *pTwi){
+  pTwi->TWI_CR |= TWI_CR_STOP;
+  twiStop();
+}
+
+void TWI_StartRead(Twi *pTwi, uint8_t address, uint32_t iaddress, uint8_t isize){
+  pTwi->TWI_MMR = (isize << TWI_MMR_IADRSZ_Pos) | TWI_MMR_MREAD | (address << TWI_MMR_DADR_Pos);
+  pTwi->TWI_IADR = iaddress;
+  pTwi->TWI_CR = TWI_CR_START;
+  twiStart(pTwi, address, true);
+}
+
+uint8_t TWI_ReadByte(Twi *pTwi){
+  pTwi->TWI_SR &= ~TWI_SR_RXRDY;
+  return pTwi->TWI_RHR;
+}
+
+void TWI_StartWrite(Twi *pTwi, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t byte){
+  pTwi->TWI_MMR = (isize << TWI_MMR_IADRSZ_Pos) | (address << TWI_MMR_DADR_Pos);
+  pTwi->TWI_IADR = iaddress;
+  TWI_WriteByte(pTwi, byte);
+  twiStart(pTwi, address, false);
+}
+
+void TWI_WriteByte(Twi *pTwi, uint8_t byte){
+  pTwi->TWI_THR = byte;
+  pTwi->TWI_SR &= ~TWI_SR_TXRDY;
+}
+
+uint32_t TWI_GetStatus(Twi *pTwi){
+  hal_service();
+  uint32_t sr = pTwi->TWI_SR;
+  if (pTwi->TWI_RCR == 0) sr |= TWI_SR_ENDRX;
+  if (pTwi->TWI_TCR == 0) sr |= TWI_SR_ENDTX;
+  pTwi->TWI_SR &= ~TWI_SR_NACK;   // cleared on read
+  return sr;
+}
+
+// bytes on the bus (one per 9 clocks), PDC transfers (RPR/TPR hold 32 bit addresses, see chip.h)
+static void twiService(){
+  Twi *p = TWI1;
+  twiRegisters();
+  if (!twi.active) return;
+  uint64_t now = nowMicros();
+  if (i2cHoldClocks > 0) {
+    twi.nextMicros = now;   // bus stuck
+    return;
+  }
+  while ((twi.active) && (now >= twi.nextMicros)){
+    if ((twi.dev == NULL) || (twi.last)) {
+      p->TWI_SR |= TWI_SR_TXCOMP | ((twi.dev == NULL) ? TWI_SR_NACK : 0);
+      twi.active = false;
+      break;
+    }
+    if (twi.read) {
+      if (p->TWI_SR & TWI_SR_RXRDY) {
+        twi.nextMicros = now;   // RHR full: clock stretched
+        break;
+      }
+      p->TWI_RHR = twi.dev->regs[twi.dev->reg++];
+      if (twi.stop) twi.last = true;
+      if ((p->TWI_PTSR & TWI_PTSR_RXTEN) && (p->TWI_RCR > 0)) {
+        *(uint8_t*)(uintptr_t)p->TWI_RPR = p->TWI_RHR;
+        p->TWI_RPR++;
+        p->TWI_RCR--;
+      } else p->TWI_SR |= TWI_SR_RXRDY;
+    } else {
+      if (p->TWI_SR & TWI_SR_TXRDY) {
+        // THR empty: STOP or clock stretched
+        if (twi.stop) twi.last = true;
+          else twi.nextMicros = now;
+        if (twi.stop) continue;
+        break;
+      }
+      twi.dev->regs[twi.dev->reg++] = p->TWI_THR;
+      p->TWI_SR |= TWI_SR_TXRDY;
+      if ((p->TWI_PTSR & TWI_PTSR_TXTEN) && (p->TWI_TCR > 0)) {
+        p->TWI_THR = *(uint8_t*)(uintptr_t)p->TWI_TPR;
+        p->TWI_TPR++;
+        p->TWI_TCR--;
+        p->TWI_SR &= ~TWI_SR_TXRDY;
+      }
+    }
+    twi.nextMicros += twiByteMicros();
+  }
+}
+
+
+TwoWire::TwoWire(){
+  txAddress = txLength = rxIndex = rxLength = 0;
+}
+
+void TwoWire::begin(){
+  TWI_ConfigureMaster(TWI1, 100000, SystemCoreClock);
+}
+
+void TwoWire::setClock(uint32_t clock){
+  twiClock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address){
+  txAddress = address;
+  txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop){
+  hal_i2c_device_t *dev = i2cDevice(txAddress);
+  if (i2cHoldClocks > 0) return 4;  // bus stuck
+  if (dev == NULL) return 2;  // address not acknowledged
+  // first byte: register pointer, then data (auto-increment)
+  if (txLength > 0) dev->reg = txBuffer[0];
+  for (int i=1; i < txLength; i++) dev->regs[dev->reg++] = txBuffer[i];
+  txLength = 0;
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop){
+  rxIndex = rxLength = 0;
+  hal_i2c_device_t *dev = i2cDevice(address);
+  if ((dev == NULL) || (i2cHoldClocks > 0)) return 0;
+  if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+  for (int i=0; i < quantity; i++) rxBuffer[i] = dev->regs[dev->reg++];
+  rxLength = quantity;
+  return quantity;
+}
+
+size_t TwoWire::write(uint8_t data){
+  if (txLength >= BUFFER_LENGTH) return 0;
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity){
+  for (size_t i=0; i < quantity; i++) if (!write(data[i])) return i;
+  return quantity;
+}
+
+int TwoWire::available(){ return rxLength - rxIndex; }
+int TwoWire::read(){ return (rxIndex < rxLength) ? rxBuffer[rxIndex++] : -1; }
+int TwoWire::peek(){ return (rxIndex < rxLength) ? rxBuffer[rxIndex] : -1; }
+void TwoWire::flush(){}
+
+
+// --- math ---
+long random(long howbig){
+  if (howbig == 0) return 0;
+  return rand() % howbig;
+}
+
+long random(long howsmall, long howbig){
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed){
+  if (seed != 0) srand(seed);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max){
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
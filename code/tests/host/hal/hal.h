@@ -0,0 +1,120 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+host build hardware abstraction (harness side)
+
+- clock:      micros()/millis() follow the host steady clock plus a virtual offset,
+              delay()/delayMicroseconds() advance the offset (no sleeping)
+- interrupts: pending peripheral events (ADC conversions/DMA, timers) are served by hal_service(),
+              which is called whenever the firmware reads the clock (so busy-wait loops progress)
+- pins:       digital pins keep their mode/latch, inputs can be driven by the harness (hal_setPin),
+              pin interrupts are raised on input edges (or explicitly via hal_triggerInterrupt)
+- analog:     12 bit samples from hal_setAnalog values or an analog source callback
+              (used by analogRead and the ADC emulation)
+- serial:     TX goes to a sink (Serial: stdout, others: none), RX is injected with hal_serialInject,
+              TX line rate modelled with hal_serialThrottle, RX line rate with hal_serialLine
+- I2C:        register-map devices attached with hal_i2cAttach (Wire and TWI/PDC transfers),
+              faults: slave delay (clock stretching), NACKs, SDA held low until clocked
+- flash:      RAM array (erased: 0xFF), optionally loaded/saved from/to a file
+
+How to use it (example):
+  hal_begin();
+  hal_setAnalog(pinBatteryVoltage, 3000);
+  robot.setup();
+  while (...) robot.loop();
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "Arduino.h"
+
+
+// analog sample source (12 bit, pin = A0..A11), returns -1 to use the hal_setAnalog value
+typedef int (*hal_analog_source_t)(uint32_t pin, unsigned long timeMicros);
+
+struct hal_i2c_device_t {
+  uint8_t address;
+  uint8_t regs[256];
+  uint8_t reg;            // register pointer (auto-increment)
+};
+
+typedef struct hal_i2c_device_t hal_i2c_device_t;
+
+
+// initialize HAL (and check that static buffers are addressable with 32 bit)
+void hal_begin();
+// serve pending peripheral events (called by the clock functions)
+void hal_service();
+
+// virtual clock
+void hal_advanceMicros(unsigned long us);
+
+// pins
+void hal_setPin(uint32_t pin, int value);
+void hal_releasePin(uint32_t pin);
+int hal_getPinOutput(uint32_t pin);
+uint32_t hal_getPinPwm(uint32_t pin);
+void hal_triggerInterrupt(uint32_t pin);
+
+// analog
+void hal_setAnalog(uint32_t pin, int value);
+void hal_setAnalogSource(hal_analog_source_t source);
+unsigned long hal_getAdcConversions();
+
+// serial
+void hal_serialInject(HardwareSerial &port, const char *text);
+void hal_serialSink(HardwareSerial &port, FILE *sink);
+// TX sent at 'baud' (0: unlimited): availableForWrite is the free room of the TX buffer, writes to a
+// full buffer wait (virtual clock advances) like the core's blocking write
+void hal_serialThrottle(HardwareSerial &port, unsigned long baud);
+// RX line: 'data' (kept by the caller) arrives at the port's baud rate from now on - into the core RX
+// buffer (HAL_SERIAL_CORE_RX bytes as on the Due) or, if the port's USART receives with PDC, into the
+// PDC buffer; bytes without room are lost (counted in rxOverruns)
+void hal_serialLine(HardwareSerial &port, const uint8_t *data, size_t size);
+// line bytes not received yet
+size_t hal_serialLinePending(HardwareSerial &port);
+
+// I2C
+void hal_i2cAttach(hal_i2c_device_t *device);
+// TWI transfers: slave delay (us) after the address, NACK the next 'count' transfers
+void hal_i2cSetDelay(unsigned long us);
+void hal_i2cInjectNak(int count);
+// slave holds SDA low (bus stuck) until SCL is clocked 'clocks' times
+void hal_i2cHoldSDA(int clocks);
+unsigned long hal_i2cTransfers();
+
+// flash
+boolean hal_flashLoad(const char *fileName);
+boolean hal_flashSave(const char *fileName);
+// write (erase) count of flash page
+unsigned long hal_flashPageWrites(uint32_t page);
+
+// host backends of the Due driver units (hal_due.cpp)
+void hal_serviceTimers();
+void hal_setPinPwm(uint32_t pin, uint32_t value);
+
+
+#endif
+
@@ -0,0 +1,162 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+host backends of the Due driver units DueTimer.cpp and pinman.cpp (timer counter and PWM registers):
+timer callbacks are called by hal_service() on the virtual clock, PWM values are recorded per pin
+*/
+
+#include "hal.h"
+#include "../../../ardumower/DueTimer.h"
+#include "../../../ardumower/pinman.h"
+
+
+#define HAL_TIMER_MAX_CALLS 64   // per hal_service call (high frequencies are slowed down)
+
+
+// --- DueTimer ---
+const DueTimer::Timer DueTimer::Timers[NUM_TIMERS] = {
+  {TC0,0,TC0_IRQn}, {TC0,1,TC1_IRQn}, {TC0,2,TC2_IRQn},
+  {TC1,0,TC3_IRQn}, {TC1,1,TC4_IRQn}, {TC1,2,TC5_IRQn},
+  {TC2,0,TC6_IRQn}, {TC2,1,TC7_IRQn}, {TC2,2,TC8_IRQn},
+};
+
+void (*DueTimer::callbacks[NUM_TIMERS])() = {};
+double DueTimer::_frequency[NUM_TIMERS] = {-1,-1,-1,-1,-1,-1,-1,-1,-1};
+
+static boolean timerRunning[NUM_TIMERS];
+static boolean timerAttached[NUM_TIMERS];
+static unsigned long timerNextMicros[NUM_TIMERS];
+static unsigned long timerPeriod[NUM_TIMERS];
+
+DueTimer Timer(0);
+DueTimer Timer1(1);
+DueTimer Timer0(0);
+DueTimer Timer2(2);
+DueTimer Timer3(3);
+DueTimer Timer4(4);
+DueTimer Timer5(5);
+DueTimer Timer6(6);
+DueTimer Timer7(7);
+DueTimer Timer8(8);
+
+
+DueTimer::DueTimer(unsigned short _timer) : timer(_timer){
+}
+
+DueTimer DueTimer::getAvailable(void){
+  for (int i=0; i < NUM_TIMERS; i++){
+    if (!callbacks[i]) return DueTimer(i);
+  }
+  return DueTimer(0);
+}
+
+DueTimer& DueTimer::attachInterrupt(void (*isr)()){
+  callbacks[timer] = isr;
+  timerAttached[timer] = (isr != NULL);
+  return *this;
+}
+
+DueTimer& DueTimer::detachInterrupt(void){
+  stop();
+  callbacks[timer] = NULL;
+  timerAttached[timer] = false;
+  return *this;
+}
+
+DueTimer& DueTimer::start(long microseconds){
+  if (microseconds > 0) setPeriod(microseconds);
+  if (_frequency[timer] <= 0) setFrequency(1);
+  timerRunning[timer] = true;
+  timerPeriod[timer] = getPeriod();
+  timerNextMicros[timer] = micros() + timerPeriod[timer];
+  return *this;
+}
+
+DueTimer& DueTimer::stop(void){
+  timerRunning[timer] = false;
+  return *this;
+}
+
+DueTimer& DueTimer::setFrequency(double frequency){
+  if (frequency <= 0) frequency = 1;
+  _frequency[timer] = frequency;
+  return *this;
+}
+
+DueTimer& DueTimer::setPeriod(unsigned long microseconds){
+  setFrequency(1000000.0 / microseconds);
+  return *this;
+}
+
+double DueTimer::getFrequency(void) const {
+  return _frequency[timer];
+}
+
+long DueTimer::getPeriod(void) const {
+  return max(1L, (long)(1000000.0 / getFrequency()));
+}
+
+// timer interrupt handlers
+void TC0_Handler(void){ DueTimer::callbacks[0](); }
+void TC1_Handler(void){ DueTimer::callbacks[1](); }
+void TC2_Handler(void){ DueTimer::callbacks[2](); }
+void TC3_Handler(void){ DueTimer::callbacks[3](); }
+void TC4_Handler(void){ DueTimer::callbacks[4](); }
+void TC5_Handler(void){ DueTimer::callbacks[5](); }
+void TC6_Handler(void){ DueTimer::callbacks[6](); }
+void TC7_Handler(void){ DueTimer::callbacks[7](); }
+void TC8_Handler(void){ DueTimer::callbacks[8](); }
+
+static void (*const timerHandlers[NUM_TIMERS])(void) = {
+  TC0_Handler, TC1_Handler, TC2_Handler, TC3_Handler, TC4_Handler, TC5_Handler, TC6_Handler, TC7_Handler, TC8_Handler,
+};
+
+void hal_serviceTimers(){
+  unsigned long now = micros();
+  for (int i=0; i < NUM_TIMERS; i++){
+    if ((!timerRunning[i]) || (!timerAttached[i])) continue;
+    int calls = 0;
+    while (((long)(now - timerNextMicros[i]) >= 0) && (calls < HAL_TIMER_MAX_CALLS)){
+      timerNextMicros[i] += timerPeriod[i];
+      timerHandlers[i]();
+      calls++;
+    }
+    if (calls == HAL_TIMER_MAX_CALLS) timerNextMicros[i] = now + timerPeriod[i];
+  }
+}
+
+
+// --- PinManager ---
+PinManager PinMan;
+
+void PinManager::begin(){
+}
+
+void PinManager::analogWrite(uint32_t ulPin, uint32_t ulValue){
+  hal_setPinPwm(ulPin, ulValue);
+}
+
+void PinManager::setDebounce(int pin, int usecs){
+}
+
@@ -0,0 +1,93 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+host backend of flash_efc.cpp (embedded flash controller): the second flash bank is a RAM array
+(hal_flash, erased: 0xFF) that can be loaded from/saved to a file to keep settings between runs,
+writes are counted per page (wear)
+*/
+
+#include "hal.h"
+#include "../../../ardumower/flash_efc.h"
+
+
+static unsigned long pageWrites[IFLASH1_SIZE / IFLASH1_PAGE_SIZE];
+
+
+static boolean flashRange(uint32_t ul_address, uint32_t ul_size){
+  return (ul_address >= IFLASH1_ADDR) && (ul_address + ul_size <= IFLASH1_ADDR + IFLASH1_SIZE);
+}
+
+uint32_t flash_init(uint32_t ul_mode, uint32_t ul_fws){
+  return FLASH_RC_OK;
+}
+
+uint32_t flash_set_wait_state(uint32_t ul_address, uint32_t ul_fws){
+  return FLASH_RC_OK;
+}
+
+uint32_t flash_unlock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end){
+  if (!flashRange(ul_start, ul_end - ul_start + 1)) return FLASH_RC_INVALID;
+  return FLASH_RC_OK;
+}
+
+uint32_t flash_lock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end){
+  if (!flashRange(ul_start, ul_end - ul_start + 1)) return FLASH_RC_INVALID;
+  return FLASH_RC_OK;
+}
+
+// erase flag set: page contents replaced, otherwise bits can only be cleared (NOR flash)
+uint32_t flash_write(uint32_t ul_address, const void *p_buffer, uint32_t ul_size, uint32_t ul_erase_flag){
+  if (!flashRange(ul_address, ul_size)) return FLASH_RC_INVALID;
+  uint8_t *dest = (uint8_t*)(uintptr_t)ul_address;
+  const uint8_t *src = (const uint8_t*)p_buffer;
+  uint32_t offset = ul_address - IFLASH1_ADDR;
+  for (uint32_t page = offset / IFLASH1_PAGE_SIZE; page <= (offset + ul_size - 1) / IFLASH1_PAGE_SIZE; page++) pageWrites[page]++;
+  for (uint32_t i=0; i < ul_size; i++){
+    if (ul_erase_flag) dest[i] = src[i];
+      else dest[i] &= src[i];
+  }
+  return FLASH_RC_OK;
+}
+
+unsigned long hal_flashPageWrites(uint32_t page){
+  if (page >= IFLASH1_SIZE / IFLASH1_PAGE_SIZE) return 0;
+  return pageWrites[page];
+}
+
+boolean hal_flashLoad(const char *fileName){
+  FILE *f = fopen(fileName, "rb");
+  if (f == NULL) return false;
+  size_t size = fread(hal_flash, 1, sizeof hal_flash, f);
+  fclose(f);
+  return (size == sizeof hal_flash);
+}
+
+boolean hal_flashSave(const char *fileName){
+  FILE *f = fopen(fileName, "wb");
+  if (f == NULL) return false;
+  size_t size = fwrite(hal_flash, 1, sizeof hal_flash, f);
+  fclose(f);
+  return (size == sizeof hal_flash);
+}
+
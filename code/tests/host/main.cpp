@@ -0,0 +1,1852 @@
+/*
+  Ardumower (www.ardumower.de)
+  Copyright (c) 2013-2015 by Alexander Grau
+  Copyright (c) 2013-2015 by Sven Gennat
+
+  Private-use only! (you need to ask for a commercial-use)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  Private-use only! (you need to ask for a commercial-use)
+
+*/
+/*
+host-native build of the Ardumower firmware (Arduino Due code paths, see hal/hal.h)
+
+The firmware units (code/ardumower) are compiled unchanged with the Arduino HAL shim in hal/,
+the Due driver units DueTimer.cpp, pinman.cpp and flash_efc.cpp are replaced by host backends
+(hal/hal_due.cpp, hal/hal_flash.cpp). Print/Stream/String are shared with the drive control simulator.
+
+Build: Code::Blocks project host.cbp (targets: Debug, Release, Sanitize) or the command line in README.md
+
+usage:
+  ardumower_host bench              benchmark (perimeter filter, IMU, PID, robot loop)
+  ardumower_host run N [flash.bin]  robot.setup() and N loops (settings flash loaded/saved from/to file)
+  ardumower_host flashlog N         flash log: N events with blob saves and reboots, checks contents and wear
+  ardumower_host settings           settings image: old layout migration, save/load round trip
+  ardumower_host pfod cmd...        sends pfodApp commands (e.g. "{s1}") via Bluetooth, prints the replies
+  ardumower_host ahrs [log.csv]     IMU filters (quaternion AHRS, previous filter): accuracy and speed on a synthetic
+                                    drive (known attitude, AHRS error limits on lanes and turns) or replay of a
+                                    recorded IMU log (telemetry_decode.py CSV, no limits: reference is the logged attitude)
+  ardumower_host i2c                I2C transaction manager: burst reads with slow slaves, NACK retries, bus recovery
+  ardumower_host median             running median: results against a sorted copy, speed against re-sorting
+  ardumower_host obstmap [map.pgm [log.csv]]
+                                    obstacle map: accuracy on a synthetic yard (emulated sonar/bumper) or replay of a
+                                    recorded drive (telemetry_decode.py CSV), flash round trip, map image (PGM)
+  ardumower_host sender             perimeter sender current control (../../sender/currentctl.cpp) against a loop
+                                    model: standard, long/wet (resistance step), short (driver fault) and open loop
+  ardumower_host console            console output: Streamprint formatter against snprintf (results, speed), loop time
+                                    of the info line with and without the TX buffer on a slow serial port
+  ardumower_host gps [log.ubx [baud]]
+                                    GPS reception (Serial3, default 115200 baud): synthetic 10 Hz UBX+NMEA stream
+                                    (message counts, checksum errors, position against the truth, NMEA fallback) or
+                                    replay of a captured receiver log (u-center .ubx or NMEA), at least 100x real time,
+                                    compared with the core RX buffer and byte-wise feed, ENU projection of the fixes
+                                    against great circle distance/bearing
+  ardumower_host encoder            encoder odometry: edge ring (overflow, micros wrap), wheel speed of the edge
+                                    timestamps against the 100 ms tick difference on synthetic encoder traces (20 and
+                                    1060 ticks/rev), pose per edge on a slalom
+  ardumower_host telemetry          binary telemetry round trip: frames decoded with the documented format (CRC-16,
+                                    schema, values, sequence gaps of dropped frames), schema changes, damaged frame
+*/
+
+#include <chrono>
+#include "hal/hal.h"
+#include "../../ardumower/mower.h"
+#include "../../ardumower/adcman.h"
+#include "../../ardumower/flashlog.h"
+#include "../../ardumower/flashmem.h"
+#include "../../ardumower/i2cman.h"
+#include "../../ardumower/RunningMedian.h"
+#include "../../ardumower/obstaclemap.h"
+#include "../../sender/currentctl.h"
+
+extern const char* stateNames[];
+
+
+// perimeter senders (one code value per 104 us): coil voltage follows the current changes
+// SIGCODE_1: perimeter loop, SIGCODE_2: neighbour zone loop (weaker)
+static const int8_t senderCodes[2][24] = {
+  { 1, 1,-1,-1, 1,-1, 1,-1,-1,1, -1, 1, 1,-1,-1, 1,-1,-1, 1,-1,-1, 1, 1,-1 },
+  { 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1, 1,-1,-1, 1, 1,-1,-1, 1,-1, 1,-1 },
+};
+static boolean senderOn = false;
+
+static int senderSignal(int code, int amplitude, unsigned long timeMicros){
+  const int8_t *senderCode = senderCodes[code];
+  int n = sizeof senderCodes[0];
+  unsigned long i = (unsigned long)(((uint64_t)timeMicros * 9615) / 1000000);
+  return amplitude * (senderCode[i % n] - senderCode[(i + n - 1) % n]) / 2;
+}
+
+// perimeter coils: idle signal (mid scale plus noise), sender on: left coil inside, right coil outside
+// (weaker), zone loop outside for both coils, other channels: hal_setAnalog values
+static int analogSource(uint32_t pin, unsigned long timeMicros){
+  if ((pin == pinPerimeterLeft) || (pin == pinPerimeterRight)) {
+    int value = 2048 + random(-64, 64);
+    if (senderOn) {
+      value += senderSignal(0, (pin == pinPerimeterLeft) ? -800 : 400, timeMicros);
+      value += senderSignal(1, 300, timeMicros);
+    }
+    return value;
+  }
+  return -1;
+}
+
+static void setupHardware(){
+  hal_begin();
+  hal_setAnalog(pinBatteryVoltage, 3040);     // approx. 25V
+  hal_setAnalogSource(analogSource);
+}
+
+static void runLoops(long loops){
+  for (long i=0; i < loops; i++) robot.loop();
+}
+
+// calls per second of a function
+template <class T> static long callsPerSecond(T func){
+  long calls = 0;
+  unsigned long endTime = millis() + 1000;
+  while (millis() < endTime){
+    func();
+    calls++;
+  }
+  return calls;
+}
+
+static int bench(){
+  setupHardware();
+  senderOn = true;
+  robot.setup();
+  robot.perimeterUse = true;                   // perimeter filter in the loop (keeps captures running)
+  unsigned long endTime = millis() + 500;      // fill ADC captures (some perimeter task runs)
+  while (millis() < endTime) robot.loop();
+
+  Console.println(F("---perimeter---"));
+  robot.perimeter.speedTest();
+  Console.print(F("magnitude left="));
+  Console.print(robot.perimeter.getMagnitude(0));
+  Console.print(F(" right="));
+  Console.println(robot.perimeter.getMagnitude(1));
+  robot.perimeter.codeMask = (1 << PERIMETER_CODES) - 1;   // all codes (filter bank)
+  endTime = millis() + 1000;
+  while (millis() < endTime) {
+    robot.loop();
+    robot.perimeter.getMagnitude(0);           // robot may be in error state (no perimeter task)
+  }
+  Console.print(F("code magnitudes left="));
+  for (byte code=1; code <= PERIMETER_CODES; code++){
+    Console.print(robot.perimeter.getCodeMagnitude(0, code));
+    Console.print(F("/q"));
+    Console.print(robot.perimeter.getCodeQuality(0, code));
+    Console.print(F(" "));
+  }
+  Console.print(F("tracking="));
+  Console.println(robot.perimeter.getMagnitude(0));
+  robot.perimeter.codeMask = 0;
+
+  Console.print(F("imu.update="));
+  Console.println(callsPerSecond([]{ robot.imu.update(); }));
+
+  PID pid(1.0, 0.1, 0.01);
+  pid.y_min = -255;
+  pid.y_max = 255;
+  pid.max_output = 255;
+  Console.print(F("pid.compute="));
+  Console.println(callsPerSecond([&pid]{ pid.x += 0.1; pid.compute(); }));
+
+  robot.profiler.reset();
+  Console.print(F("robot.loop="));
+  Console.println(callsPerSecond([]{ robot.loop(); }));
+  robot.profiler.printReport(Console);
+  return 0;
+}
+
+static int run(long loops, const char *flashFile){
+  setupHardware();
+  if ((flashFile != NULL) && (!hal_flashLoad(flashFile))) {
+    Console.print(F("no flash file "));
+    Console.println(flashFile);
+  }
+  robot.setup();
+  runLoops(loops);
+  robot.profiler.printReport(Console);
+  Console.print(F("ADC conversions="));
+  Console.println(hal_getAdcConversions());
+  if ((flashFile != NULL) && (!hal_flashSave(flashFile))) {
+    Console.print(F("cannot save flash file "));
+    Console.println(flashFile);
+    return 1;
+  }
+  return 0;
+}
+
+// appends events and stats blobs, 'reboots' (FlashLog.begin) in between and checks that
+// the latest events and blob survive, then reports the page write counts (wear levelling)
+static int flashlog(long events){
+  setupHardware();
+  FlashLog.begin();
+  long stats = 0;
+  int errors = 0;
+  for (long i=1; i <= events; i++){
+    hal_advanceMicros(1000000);
+    byte last = i & 0xFF;
+    FlashLog.add((i % 3 == 0) ? FLOG_ERROR : FLOG_STATE, i & 0x1F, &last, 1);
+    FlashLog.run();
+    if (i % 100 == 0){
+      stats = i;
+      FlashLog.saveBlob(FLOG_BLOB_STATS, &stats, sizeof stats);
+    }
+    if (i % 1000 == 0){
+      // reboot: unflushed events are lost, flush first
+      FlashLog.flush();
+      FlashLog.begin();
+      flashlogrecord_t rec;
+      long blob = 0;
+      if ((!FlashLog.loadBlob(FLOG_BLOB_STATS, &blob, sizeof blob)) || (blob != stats)) {
+        Console.print(F("blob lost at event "));
+        Console.println(i);
+        errors++;
+      }
+      int count = FlashLog.getRecordCount();
+      if ((count == 0) || (!FlashLog.getRecord(count-1, rec))) errors++;
+        else if ((rec.type < FLOG_BLOB_STATS) && (rec.data[0] != last)) {
+          Console.print(F("last event lost at event "));
+          Console.println(i);
+          errors++;
+        }
+    }
+  }
+  FlashLog.print(Console, 10, stateNames, STATE_BUMPER_FORWARD + 1);   // state codes up to 31: unknown ones as numbers
+  unsigned long minWrites = 0xFFFFFFFF;
+  unsigned long maxWrites = 0;
+  unsigned long total = 0;
+  for (uint32_t page = IFLASH1_SIZE / IFLASH1_PAGE_SIZE - FLASHLOG_PAGES; page < IFLASH1_SIZE / IFLASH1_PAGE_SIZE; page++){
+    unsigned long writes = hal_flashPageWrites(page);
+    minWrites = min(minWrites, writes);
+    maxWrites = max(maxWrites, writes);
+    total += writes;
+  }
+  Console.print(F("events="));
+  Console.print(events);
+  Console.print(F(" page writes="));
+  Console.print(total);
+  Console.print(F(" per page min="));
+  Console.print(minWrites);
+  Console.print(F(" max="));
+  Console.print(maxWrites);
+  Console.print(F(" errors="));
+  Console.println(errors);
+  return (errors == 0) ? 0 : 1;
+}
+
+// modified settings (differ from the defaults)
+static void modifySettings(int n){
+  robot.motorAccel = 1000 + n;
+  robot.motorSenseLeftScale = 0.5 + n;
+  robot.perimeterPID.Kp = 7.5 + n;
+  robot.perimeter.timedOutIfBelowSmag = 200 + n;
+  robot.odometryTicksPerRevolution = 1060 + n;
+  robot.timer[1].startTime.hour = 10 + n;
+  robot.esp8266ConfigString = String("ssid") + n;
+  robot.motorMowForceOff = true;
+}
+
+static int checkSettings(int n){
+  int errors = 0;
+  if (robot.motorAccel != 1000 + n) errors++;
+  if (robot.motorSenseLeftScale != 0.5 + n) errors++;
+  if (robot.perimeterPID.Kp != 7.5 + n) errors++;
+  if (robot.perimeter.timedOutIfBelowSmag != 200 + n) errors++;
+  if (robot.odometryTicksPerRevolution != 1060 + n) errors++;
+  if (robot.timer[1].startTime.hour != 10 + n) errors++;
+  if (robot.esp8266ConfigString != String("ssid") + n) errors++;
+  if (!robot.motorMowForceOff) errors++;
+  Console.print(F("settings check "));
+  Console.print(n);
+  Console.print(F(": errors="));
+  Console.println(errors);
+  return errors;
+}
+
+// old layout (MAGIC 52, settings in list order) => converted to the settings image on boot,
+// then save/load round trip of the image
+static int settings(){
+  setupHardware();
+  modifySettings(1);
+  int addr = 0;
+  eewrite(addr, (short)52);
+  setting_t info;
+  for (int idx=0; idx < SETTING_COUNT; idx++){
+    getSettingInfo(idx, info);
+    byte *value = (byte*)robot.settingValue(info.id);
+    if (info.kind == SET_STRING) eereadwriteString(false, addr, *(String*)value);
+      else for (int i=0; i < info.size; i++) Flash.write(addr++, value[i]);
+  }
+  modifySettings(0);
+  robot.setup();
+  int errors = checkSettings(1);
+  modifySettings(2);
+  robot.saveUserSettings();
+  modifySettings(0);
+  robot.setup();
+  errors += checkSettings(2);
+  return (errors == 0) ? 0 : 1;
+}
+
+// pfodApp commands (Bluetooth RX), replies (Bluetooth TX) go to stdout
+static int pfod(int count, char *cmds[]){
+  setupHardware();
+  robot.setup();
+  runLoops(10);
+  fflush(stdout);
+  Bluetooth.sink = stdout;
+  for (int i=0; i < count; i++){
+    printf("\n> %s\n", cmds[i]);
+    hal_serialInject(Bluetooth, cmds[i]);
+    unsigned long txCount = Bluetooth.txCount;
+    runLoops(10);
+    printf("\n(%lu bytes)\n", Bluetooth.txCount - txCount);
+  }
+  return 0;
+}
+
+// IMU sample (firmware units: rad/s, g, calibrated compass) and reference attitude
+struct imusample_t {
+  float time;
+  point_float_t gyro;
+  point_float_t acc;
+  point_float_t com;
+  ypr_t ref;
+};
+
+static float gauss(float sigma){
+  float u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  float u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sigma * sqrt(-2 * log(u1)) * cos(2 * PI * u2);
+}
+
+// attitude of the synthetic drive: lanes (15s) and 180 degree turns (5s) on a slope,
+// yaw counter-clockwise (unwrapped)
+static void syntheticAttitude(float t, float &yaw, float &pitch, float &roll){
+  int lane = t / 20;
+  float turn = constrain(t - lane * 20 - 15, 0, 5) / 5;
+  yaw = (lane + turn) * PI;
+  pitch = 0.15 * sin(2 * PI * t / 30);
+  roll  = 0.10 * sin(2 * PI * t / 17);
+}
+
+static boolean syntheticTurning(float t){
+  return (t - (int)(t / 20) * 20 >= 15);
+}
+
+// earth frame vector (x north, z up) in sensor frame
+static point_float_t toSensor(float x, float y, float z, float yaw, float pitch, float roll){
+  float x1 =  x * cos(yaw) + y * sin(yaw);
+  float y1 = -x * sin(yaw) + y * cos(yaw);
+  float x2 =  x1 * cos(pitch) - z * sin(pitch);
+  float z2 =  x1 * sin(pitch) + z * cos(pitch);
+  point_float_t v;
+  v.x = x2;
+  v.y =  y1 * cos(roll) + z2 * sin(roll);
+  v.z = -y1 * sin(roll) + z2 * cos(roll);
+  return v;
+}
+
+// sensor data of the synthetic drive: gyro bias and noise, vibration, compass noise (inclination 65 degree)
+static void syntheticSample(float t, imusample_t &s){
+  float yaw, pitch, roll, y0, p0, r0, y1, p1, r1;
+  float h = 0.001;
+  syntheticAttitude(t, yaw, pitch, roll);
+  syntheticAttitude(t - h, y0, p0, r0);
+  syntheticAttitude(t + h, y1, p1, r1);
+  float dyaw = (y1 - y0) / (2 * h);
+  float dpitch = (p1 - p0) / (2 * h);
+  float droll = (r1 - r0) / (2 * h);
+  s.time = t;
+  s.gyro.x = droll - dyaw * sin(pitch)                                + 0.005 + gauss(0.01);
+  s.gyro.y = dpitch * cos(roll) + dyaw * sin(roll) * cos(pitch)      - 0.004 + gauss(0.01);
+  s.gyro.z = -dpitch * sin(roll) + dyaw * cos(roll) * cos(pitch)     + 0.006 + gauss(0.01);
+  s.acc = toSensor(0, 0, 1, yaw, pitch, roll);
+  s.acc.x += gauss(0.05);
+  s.acc.y += gauss(0.05);
+  s.acc.z += gauss(0.05);
+  s.com = toSensor(cos(65 * DEG_TO_RAD), 0, -sin(65 * DEG_TO_RAD), yaw, pitch, roll);
+  s.com.x += gauss(0.01);
+  s.com.y += gauss(0.01);
+  s.com.z += gauss(0.01);
+  s.ref.yaw = robot.imu.scalePI(-yaw);
+  s.ref.pitch = pitch;
+  s.ref.roll = roll;
+}
+
+// next sample of a telemetry_decode.py CSV (columns time_s, yaw, pitch, roll, gyroX..comZ)
+static boolean logSample(FILE *f, int col[13], imusample_t &s){
+  char line[512];
+  if (fgets(line, sizeof line, f) == NULL) return false;
+  float v[64];
+  int n = 0;
+  for (char *p = strtok(line, ","); (p != NULL) && (n < 64); p = strtok(NULL, ",")) v[n++] = atof(p);
+  for (int i=0; i < 13; i++) if (col[i] >= n) return false;
+  s.time = v[col[0]];
+  s.ref.yaw = v[col[1]] * DEG_TO_RAD;
+  s.ref.pitch = v[col[2]] * DEG_TO_RAD;
+  s.ref.roll = v[col[3]] * DEG_TO_RAD;
+  s.gyro.x = v[col[4]] * DEG_TO_RAD;
+  s.gyro.y = v[col[5]] * DEG_TO_RAD;
+  s.gyro.z = v[col[6]] * DEG_TO_RAD;
+  s.acc.x = v[col[7]];
+  s.acc.y = v[col[8]];
+  s.acc.z = v[col[9]];
+  s.com.x = v[col[10]];
+  s.com.y = v[col[11]];
+  s.com.z = v[col[12]];
+  return true;
+}
+
+// column numbers of a telemetry_decode.py CSV (header line), false if a column is missing
+static boolean logColumns(FILE *f, const char **names, int count, int *col, const char *groups){
+  char line[512];
+  if (fgets(line, sizeof line, f) == NULL) return false;
+  for (int i=0; i < count; i++) col[i] = -1;
+  int n = 0;
+  for (char *p = strtok(line, ",\r\n"); p != NULL; p = strtok(NULL, ",\r\n"), n++)
+    for (int i=0; i < count; i++) if (strcmp(p, names[i]) == 0) col[i] = n;
+  for (int i=0; i < count; i++) {
+    if (col[i] != -1) continue;
+    printf("missing column %s (log the %s telemetry group)\n", names[i], groups);
+    return false;
+  }
+  return true;
+}
+
+static boolean logColumns(FILE *f, int col[13]){
+  const char *names[13] = {"time_s", "yaw", "pitch", "roll", "gyroX", "gyroY", "gyroZ",
+                           "accX", "accY", "accZ", "comX", "comY", "comZ"};
+  return logColumns(f, names, 13, col, "IMU");
+}
+
+// angle errors (degree) of a filter against the reference
+struct yprerror_t {
+  float sum[3];
+  float max[3];
+  long count;
+};
+
+static void addError(yprerror_t &e, const ypr_t &ref, const ypr_t &est){
+  float d[3] = { robot.imu.distancePI(ref.yaw, est.yaw), est.pitch - ref.pitch, est.roll - ref.roll };
+  for (int i=0; i < 3; i++){
+    d[i] = fabs(d[i]) * RAD_TO_DEG;
+    e.sum[i] += d[i] * d[i];
+    e.max[i] = max(e.max[i], d[i]);
+  }
+  e.count++;
+}
+
+static void printError(const char *name, const yprerror_t &e){
+  long n = max(1L, e.count);
+  printf("%-28s rms/max (deg)  yaw %6.2f %6.2f  pitch %6.2f %6.2f  roll %6.2f %6.2f\n", name,
+    sqrt(e.sum[0]/n), e.max[0], sqrt(e.sum[1]/n), e.max[1], sqrt(e.sum[2]/n), e.max[2]);
+}
+
+// AHRS limits on the synthetic drive (degree): steady state (lanes), dynamic (turns)
+#define AHRS_LANE_RMS 1.5
+#define AHRS_LANE_MAX 6
+#define AHRS_TURN_RMS 1.5
+#define AHRS_TURN_MAX 3
+
+static int checkError(const yprerror_t &e, float rmsLimit, float maxLimit){
+  long n = max(1L, e.count);
+  int errors = 0;
+  for (int i=0; i < 3; i++) if ((sqrt(e.sum[i]/n) > rmsLimit) || (e.max[i] > maxLimit)) errors++;
+  return errors;
+}
+
+// both IMU filters on the same sensor data: synthetic drive (reference = true attitude) or
+// recorded log (reference = attitude logged by the firmware), then calls per second of each filter
+static int ahrs(const char *logFile){
+  IMU cur, old;
+  yprerror_t errCur, errOld, errDiff, errLane, errTurn;
+  memset(&errCur, 0, sizeof errCur);
+  memset(&errLane, 0, sizeof errLane);
+  memset(&errTurn, 0, sizeof errTurn);
+  memset(&errOld, 0, sizeof errOld);
+  memset(&errDiff, 0, sizeof errDiff);
+  imusample_t s;
+  FILE *f = NULL;
+  int col[13];
+  if (logFile != NULL){
+    f = fopen(logFile, "r");
+    if ((f == NULL) || (!logColumns(f, col))) {
+      printf("cannot read log %s\n", logFile);
+      return 1;
+    }
+  }
+  srand(1);
+  float lastTime = -1;
+  for (long i=0; ; i++){
+    if (f != NULL) {
+      if (!logSample(f, col, s)) break;
+    } else {
+      if (i >= 120L * 1000 / IMU_AHRS_PERIOD) break;
+      syntheticSample(i * IMU_AHRS_PERIOD / 1000.0, s);
+    }
+    float dt = (lastTime < 0) ? IMU_AHRS_PERIOD / 1000.0 : s.time - lastTime;
+    lastTime = s.time;
+    if ((dt <= 0) || (dt > 0.5)) continue;
+    if (i == 0) old.ypr = s.ref;   // previous filter has no initialization
+    cur.gyro = old.gyro = s.gyro;
+    cur.acc = old.acc = s.acc;
+    cur.com = old.com = s.com;
+    cur.fuse(dt);
+    old.fuseComplementary(dt * 1000 + 0.5);
+    if (s.time < 5) continue;      // settling
+    addError(errCur, s.ref, cur.ypr);
+    if (f == NULL) addError(syntheticTurning(s.time) ? errTurn : errLane, s.ref, cur.ypr);
+    addError(errOld, s.ref, old.ypr);
+    addError(errDiff, old.ypr, cur.ypr);
+  }
+  if (f != NULL) fclose(f);
+  printf("%s: %ld samples\n", (logFile != NULL) ? logFile : "synthetic drive 120s", errCur.count);
+  printError("quaternion AHRS", errCur);
+  printError("previous filter", errOld);
+  printError("AHRS vs previous", errDiff);
+  int errors = 0;
+  if (f == NULL) {
+    printError("quaternion AHRS (lanes)", errLane);
+    printError("quaternion AHRS (turns)", errTurn);
+    errors += checkError(errLane, AHRS_LANE_RMS, AHRS_LANE_MAX);
+    errors += checkError(errTurn, AHRS_TURN_RMS, AHRS_TURN_MAX);
+  }
+
+  float maxErr = 0;
+  for (int i=0; i < 3600; i++){
+    float a = i * PI / 1800;
+    float x = cos(a) * (1 + (i % 7)), y = sin(a) * (1 + (i % 7));
+    maxErr = max(maxErr, (float)fabs(robot.imu.distancePI(atan2(y, x), fastAtan2(y, x))));
+  }
+  printf("fastAtan2 max error=%.5f deg\n", maxErr * RAD_TO_DEG);
+  Console.print(F("fuse (AHRS)="));
+  Console.println(callsPerSecond([&cur]{ cur.fuse(0.01); }));
+  Console.print(F("fuseComplementary="));
+  Console.println(callsPerSecond([&old]{ old.fuseComplementary(10); }));
+  volatile float sink = 0;
+  Console.print(F("fastAtan2="));
+  Console.println(callsPerSecond([&sink]{ sink += fastAtan2(sink + 0.3, 0.7); }));
+  Console.print(F("atan2="));
+  Console.println(callsPerSecond([&sink]{ sink += atan2(sink + 0.3, 0.7); }));
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// I2C transaction manager (TWI/PDC emulation): results, non-blocking run() with slow slaves,
+// retries on NACK, timeout with bus recovery (slave holding SDA)
+static hal_i2c_device_t i2cAcc, i2cGyro, i2cCom;
+static byte i2cBuf[I2C_QUEUE_SIZE][6];
+static byte i2cLastResult;
+static int i2cCallbacks;
+
+static void i2cDone(i2ctrans_t &t){
+  i2cLastResult = t.result;
+  i2cCallbacks++;
+}
+
+// run manager until 'callbacks' callbacks are done (or timeout), returns number of run() calls
+static long i2cRun(int callbacks, unsigned long timeout){
+  long calls = 0;
+  unsigned long endTime = millis() + timeout;
+  while ((i2cCallbacks < callbacks) && (millis() < endTime)){
+    I2CMan.run();
+    calls++;
+  }
+  return calls;
+}
+
+static int i2cCheck(const char *name, boolean ok){
+  printf("%-40s %s\n", name, ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+static int i2c(){
+  setupHardware();
+  Wire.begin();
+  I2CMan.begin();
+  i2cAcc.address = 0x53;
+  i2cGyro.address = 0x69;
+  for (int i=0; i < 6; i++){
+    i2cAcc.regs[0x32 + i] = 0x10 + i;
+    i2cGyro.regs[0xA8 + i] = 0x20 + i;
+  }
+  hal_i2cAttach(&i2cAcc);
+  hal_i2cAttach(&i2cGyro);
+  int errors = 0;
+
+  // burst reads (slave delay 2 ms): run() does not wait for the bus
+  hal_i2cSetDelay(2000);
+  i2cCallbacks = 0;
+  unsigned long start = micros();
+  I2CMan.read(0x53, 0x32, i2cBuf[0], 6, i2cDone);
+  I2CMan.read(0x69, 0xA8, i2cBuf[1], 6, i2cDone);
+  long calls = i2cRun(2, 100);
+  unsigned long duration = micros() - start;
+  printf("2 burst reads: %lu us, %ld run() calls\n", duration, calls);
+  errors += i2cCheck("burst read data", (i2cCallbacks == 2) && (i2cLastResult == I2C_OK)
+    && (memcmp(i2cBuf[0], &i2cAcc.regs[0x32], 6) == 0) && (memcmp(i2cBuf[1], &i2cGyro.regs[0xA8], 6) == 0));
+  errors += i2cCheck("run() non-blocking", (duration >= 4000) && (calls > 100));
+  hal_i2cSetDelay(0);
+
+  // single byte read, write
+  i2cCallbacks = 0;
+  I2CMan.read(0x69, 0xA9, i2cBuf[2], 1, i2cDone);
+  i2cRun(1, 100);
+  errors += i2cCheck("single byte read", (i2cLastResult == I2C_OK) && (i2cBuf[2][0] == 0x21));
+  i2cCallbacks = 0;
+  I2CMan.read(0x69, 0xA8, i2cBuf[2], 2, i2cDone);   // no PDC: STOP before the first byte is read
+  i2cRun(1, 100);
+  errors += i2cCheck("two byte read", (i2cLastResult == I2C_OK) && (memcmp(i2cBuf[2], &i2cGyro.regs[0xA8], 2) == 0));
+  byte data[3] = {0xAA, 0xBB, 0xCC};
+  i2cCallbacks = 0;
+  I2CMan.write(0x53, 0x2D, data, 3, i2cDone);
+  i2cRun(1, 100);
+  errors += i2cCheck("write", (i2cLastResult == I2C_OK) && (memcmp(&i2cAcc.regs[0x2D], data, 3) == 0));
+
+  // NACK: retried, unknown device fails
+  unsigned long retries = I2CMan.retryCount;
+  hal_i2cInjectNak(1);
+  i2cCallbacks = 0;
+  I2CMan.read(0x53, 0x32, i2cBuf[0], 6, i2cDone, NULL, 1);
+  i2cRun(1, 100);
+  errors += i2cCheck("NACK, retry succeeds", (i2cLastResult == I2C_OK) && (I2CMan.retryCount == retries + 1));
+  hal_i2cInjectNak(2);
+  i2cCallbacks = 0;
+  I2CMan.read(0x53, 0x32, i2cBuf[0], 6, i2cDone, NULL, 1);
+  i2cRun(1, 100);
+  errors += i2cCheck("NACK, retries exhausted", i2cLastResult == I2C_NACK);
+  i2cCallbacks = 0;
+  I2CMan.read(0x10, 0x00, i2cBuf[0], 6, i2cDone, NULL, 0);
+  i2cRun(1, 100);
+  errors += i2cCheck("unknown device", i2cLastResult == I2C_NACK);
+
+  // slave holds SDA: timeout, bus recovery (SCL pulses), retry
+  hal_i2cHoldSDA(5);
+  i2cCallbacks = 0;
+  I2CMan.read(0x69, 0xA8, i2cBuf[0], 6, i2cDone, NULL, 1);
+  i2cRun(1, 100);
+  errors += i2cCheck("bus stuck, recovered", (i2cLastResult == I2C_OK) && (I2CMan.recoveries == 1)
+    && (memcmp(i2cBuf[0], &i2cGyro.regs[0xA8], 6) == 0));
+
+  // bus stuck permanently: transactions fail, recovery is retried later
+  hal_i2cHoldSDA(1000);
+  i2cCallbacks = 0;
+  I2CMan.read(0x69, 0xA8, i2cBuf[0], 6, i2cDone, NULL, 0);
+  I2CMan.read(0x53, 0x32, i2cBuf[1], 6, i2cDone, NULL, 0);
+  i2cRun(2, 100);
+  errors += i2cCheck("bus stuck, bus error", (i2cCallbacks == 2) && (i2cLastResult == I2C_BUS_ERROR)
+    && (!I2CMan.read(0x53, 0x32, i2cBuf[0], 6, i2cDone)));
+  hal_i2cHoldSDA(0);
+  delay(I2C_RECOVER_INTERVAL);
+  I2CMan.run();
+  i2cCallbacks = 0;
+  I2CMan.read(0x53, 0x32, i2cBuf[0], 6, i2cDone);
+  i2cRun(1, 100);
+  errors += i2cCheck("bus released", (i2cLastResult == I2C_OK) && (I2CMan.recoveries == 2));
+
+  // IMU: each update fuses the previous burst reads and queues the next
+  i2cCom.address = 0x1E;
+  hal_i2cAttach(&i2cCom);
+  i2cAcc.regs[0x37] = 0x01;    // acc z = 256 (1g)
+  IMU &imu = robot.imu;
+  imu.hardwareInitialized = true;
+  imu.errorCounter = 0;
+  for (int i=0; i < 10; i++){
+    imu.update();
+    i2cRun(1000000, IMU_AHRS_PERIOD);   // bus running for one update period
+  }
+  errors += i2cCheck("IMU burst reads", (imu.getErrorCounter() == 0) && (imu.acc.z > 0) && (imu.gyroCounter >= 9));
+
+  // queue full, flush
+  int queued = 0;
+  for (int i=0; i < I2C_QUEUE_SIZE + 1; i++)
+    if (I2CMan.read(0x53, 0x32, i2cBuf[i % I2C_QUEUE_SIZE], 6, NULL)) queued++;
+  errors += i2cCheck("queue full", queued == I2C_QUEUE_SIZE);
+  errors += i2cCheck("flush", I2CMan.flush() && I2CMan.isIdle());
+
+  printf("transfers=%lu completed=%lu nacks=%lu timeouts=%lu retries=%lu busErrors=%lu recoveries=%lu maxQueued=%d\n",
+    hal_i2cTransfers(), I2CMan.completed, I2CMan.nacks, I2CMan.timeouts, I2CMan.retryCount,
+    I2CMan.busErrors, I2CMan.recoveries, I2CMan.maxQueued);
+  printf("%d errors\n", errors);
+  return errors;
+}
+
+// running median: results against a sorted copy (window of the last N values), add+getMedian speed
+// against the previous implementation (index array bubble-sorted again after each add)
+template <typename T, int N> class SortedMedian {
+  public:
+    SortedMedian(){
+      cnt = idx = 0;
+      for (int i=0; i < N; i++) p[i] = i;
+    }
+    void add(T value){
+      ar[idx++] = value;
+      if (idx >= N) idx = 0;
+      if (cnt < N) cnt++;
+      sorted = false;
+    }
+    T getSortedElement(int n){
+      if (!sorted) sort();
+      return ar[p[n]];
+    }
+    T getMedian(){
+      if (cnt & 1) return getSortedElement(cnt/2);
+      T lo = getSortedElement(cnt/2 - 1);
+      return lo + (getSortedElement(cnt/2) - lo) / 2;
+    }
+    int cnt;
+  private:
+    T ar[N];
+    uint8_t p[N];
+    int idx;
+    boolean sorted;
+    void sort(){
+      for (int i=0; i < cnt-1; i++){
+        boolean flag = true;
+        for (int j=1; j < cnt-i; j++){
+          if (ar[p[j-1]] > ar[p[j]]) {
+            uint8_t t = p[j-1];
+            p[j-1] = p[j];
+            p[j] = t;
+            flag = false;
+          }
+        }
+        if (flag) break;
+      }
+      sorted = true;
+    }
+};
+
+template <typename T, int N> static int medianTest(const char *name, T range){
+  static RunningMedian<T, N> med;
+  static SortedMedian<T, N> ref;
+  int errors = 0;
+  for (long i=0; i < 20000; i++){
+    // noise, steps and constant runs (duplicates)
+    T value = ((i / 500) & 1) ? (T)(range / 2) : (T)random(0, range);
+    med.add(value);
+    ref.add(value);
+    if ((med.getMedian() != ref.getMedian()) || (med.getHighest() != ref.getSortedElement(ref.cnt-1))
+      || (med.getLowest() != ref.getSortedElement(0))) errors++;
+    if ((i % 97 == 0) && (med.getSortedElement(i % ref.cnt) != ref.getSortedElement(i % ref.cnt))) errors++;
+  }
+  long calls = callsPerSecond([range]{ med.add(random(0, range)); med.getMedian(); });
+  long callsRef = callsPerSecond([range]{ ref.add(random(0, range)); ref.getMedian(); });
+  printf("%-22s N=%3d  add+getMedian/s: %9ld (re-sort %9ld)  errors=%d\n", name, N, calls, callsRef, errors);
+  return errors;
+}
+
+static int median(){
+  setupHardware();
+  int errors = 0;
+  errors += medianTest<int16_t, 19>("int16_t", 1000);
+  errors += medianTest<unsigned int, 96>("unsigned int", 1024);
+  errors += medianTest<int, 255>("int", 30000);
+  errors += medianTest<float, 32>("float", 100);
+  // ADCManager::readMedian (select instead of insertion sort)
+  static int16_t samples[200], copy[200];
+  long sortErrors = 0;
+  for (int n=1; n < 200; n++){
+    for (int i=0; i < n; i++) samples[i] = copy[i] = random(0, 1024);
+    for (int i=1; i < n; i++)
+      for (int j=i; (j > 0) && (copy[j-1] < copy[j]); j--) { int16_t t = copy[j]; copy[j] = copy[j-1]; copy[j-1] = t; }
+    if (selectElement(samples, n, n - 1 - n/2) != copy[n/2]) sortErrors++;
+  }
+  printf("selectElement (readMedian) errors=%ld\n", sortErrors);
+  return errors + sortErrors;
+}
+
+// synthetic yard (cm): perimeter rectangle with trees (circles) and a shed (box)
+struct yardobstacle_t {
+  float x, y, r;      // circle (r > 0) or box center/half size (r < 0: -half width, half height = h)
+  float h;
+};
+
+static const yardobstacle_t yardObstacles[] = {
+  {-300, 500, 30, 0}, {400, 300, 40, 0}, {200, 800, 25, 0}, {-500, 150, 20, 0}, {-550, 850, -80, 50},
+};
+#define YARD_OBSTACLES (sizeof yardObstacles / sizeof yardObstacles[0])
+#define YARD_X0 -800
+#define YARD_X1 800
+#define YARD_Y0 -100
+#define YARD_Y1 1100
+
+// distance (cm) of a point to an obstacle (< 0: inside)
+static float obstacleDistance(const yardobstacle_t &o, float x, float y){
+  if (o.r > 0) return sqrt(sq(x - o.x) + sq(y - o.y)) - o.r;
+  float dx = fabs(x - o.x) + o.r;
+  float dy = fabs(y - o.y) - o.h;
+  if ((dx < 0) && (dy < 0)) return max(dx, dy);
+  return sqrt(sq(max(dx, 0.0f)) + sq(max(dy, 0.0f)));
+}
+
+static boolean yardBlocked(float x, float y){
+  for (unsigned int i=0; i < YARD_OBSTACLES; i++) if (obstacleDistance(yardObstacles[i], x, y) < 0) return true;
+  return false;
+}
+
+// sonar echo (cm, 0: none) of a ray (heading clockwise from y), noise and dropouts
+static unsigned int yardSonar(float x, float y, float heading){
+  for (int d=0; d < 300; d++){
+    if (yardBlocked(x + d * sin(heading), y + d * cos(heading))) {
+      if (random(100) < 5) return 0;
+      return max(0, (int)(d + gauss(2) + 0.5));
+    }
+  }
+  return 0;
+}
+
+// obstacle map: random bounce drive in the synthetic yard (emulated sonar, bumper, noisy pose) or
+// replay of a recorded drive (telemetry_decode.py CSV with odometry, IMU and sensor groups),
+// then map accuracy, warnings before bumper hits, flash save/load round trip and an optional image (PGM)
+static int obstmap(const char *pgmFile, const char *logFile){
+  setupHardware();
+  ObstacleMap &map = robot.obstacleMap;
+  map.begin();
+  map.clear();
+  srand(1);
+  randomSeed(1);
+  int errors = 0;
+  long bumps = 0, warned = 0;
+  if (logFile != NULL){
+    const char *names[9] = {"time_s", "odoX", "odoY", "yaw", "sonL", "sonC", "sonR", "bumL", "bumR"};
+    int col[9];
+    FILE *f = fopen(logFile, "r");
+    if ((f == NULL) || (!logColumns(f, names, 9, col, "Odometry, IMU and Sensors"))) {
+      printf("cannot read log %s\n", logFile);
+      return 1;
+    }
+    char line[512];
+    float nextSonar = 0;
+    boolean bumper = false;
+    long samples = 0;
+    while (fgets(line, sizeof line, f) != NULL){
+      float v[64];
+      int n = 0;
+      for (char *p = strtok(line, ","); (p != NULL) && (n < 64); p = strtok(NULL, ",")) v[n++] = atof(p);
+      boolean ok = true;
+      for (int i=0; i < 9; i++) if (col[i] >= n) ok = false;
+      if (!ok) continue;
+      samples++;
+      map.setPose(v[col[1]], v[col[2]], v[col[3]] * DEG_TO_RAD);
+      if (v[col[0]] >= nextSonar){
+        nextSonar = v[col[0]] + 0.5;
+        map.addSonar(-OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, v[col[4]]);
+        map.addSonar(0, v[col[5]]);
+        map.addSonar(OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, v[col[6]]);
+      }
+      boolean bumL = (v[col[7]] != 0);
+      boolean bumR = (v[col[8]] != 0);
+      if ((bumL || bumR) && (!bumper)) {
+        bumps++;
+        int dist;
+        if (map.obstacleAhead(robot.obstacleMapSlowBelow, dist)) warned++;
+        map.addBumper(bumL, bumR);
+      }
+      bumper = bumL || bumR;
+    }
+    fclose(f);
+    printf("%s: %ld samples, bumper hits=%ld (warned before: %ld)\n", logFile, samples, bumps, warned);
+  } else {
+    // 60 minutes at 30 cm/s, 10 Hz
+    float x = 0, y = 0, heading = 0;
+    float turn = 0;             // rad left to turn
+    float reverse = 0;          // cm left to reverse
+    long bumpsLate = 0, warnedLate = 0;
+    unsigned long warnTime = 0;
+    const long steps = 36000;
+    for (long i=0; i < steps; i++){
+      unsigned long t = i * 100;
+      if (reverse > 0) {
+        x -= 3 * sin(heading);
+        y -= 3 * cos(heading);
+        reverse -= 3;
+      } else if (turn != 0) {
+        float da = constrain(turn, -0.15, 0.15);
+        heading += da;
+        turn -= da;
+        if (fabs(turn) < 0.001) turn = 0;
+      } else {
+        float nx = x + 3 * sin(heading);
+        float ny = y + 3 * cos(heading);
+        float fx = nx + OBSTMAP_SONAR_OFFSET * sin(heading);
+        float fy = ny + OBSTMAP_SONAR_OFFSET * cos(heading);
+        boolean bumL = yardBlocked(fx - OBSTMAP_BUMPER_SIDE * cos(heading), fy + OBSTMAP_BUMPER_SIDE * sin(heading));
+        boolean bumR = yardBlocked(fx + OBSTMAP_BUMPER_SIDE * cos(heading), fy - OBSTMAP_BUMPER_SIDE * sin(heading));
+        if (bumL || bumR || yardBlocked(fx, fy)) {
+          // bumper
+          bumps++;
+          boolean w = (t - warnTime < 2000);
+          if (w) warned++;
+          if (i >= steps / 2) { bumpsLate++; if (w) warnedLate++; }
+          map.addBumper(bumL || !bumR, bumR || !bumL);
+          reverse = 20;
+          turn = (random(2) ? 1 : -1) * (PI / 2 + random(0, 1000) * PI / 2000);
+        } else if ((fx < YARD_X0) || (fx > YARD_X1) || (fy < YARD_Y0) || (fy > YARD_Y1)) {
+          // perimeter (not mapped)
+          turn = (random(2) ? 1 : -1) * (PI / 2 + random(0, 1000) * PI / 2000);
+        } else {
+          x = nx;
+          y = ny;
+        }
+      }
+      // odometry/IMU pose (noisy)
+      map.setPose(x + gauss(2), y + gauss(2), heading + gauss(0.02));
+      if ((i % 5 == 0) && (reverse <= 0) && (turn == 0)){
+        float sx = x + OBSTMAP_SONAR_OFFSET * sin(heading);
+        float sy = y + OBSTMAP_SONAR_OFFSET * cos(heading);
+        map.addSonar(-OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, yardSonar(sx, sy, heading - OBSTMAP_SONAR_ANGLE * DEG_TO_RAD));
+        map.addSonar(0, yardSonar(sx, sy, heading));
+        map.addSonar(OBSTMAP_SONAR_ANGLE * DEG_TO_RAD, yardSonar(sx, sy, heading + OBSTMAP_SONAR_ANGLE * DEG_TO_RAD));
+      }
+      int dist;
+      if ((i % 2 == 0) && (turn == 0) && (reverse <= 0) && (map.obstacleAhead(robot.obstacleMapSlowBelow, dist))) warnTime = t;
+    }
+    // accuracy: occupied cells against the yard, detected obstacles
+    long occupied = 0, falsePos = 0, freeCells = 0;
+    boolean detected[YARD_OBSTACLES];
+    memset(detected, 0, sizeof detected);
+    for (int cy = YARD_Y0 / OBSTMAP_CELL_SIZE; cy < YARD_Y1 / OBSTMAP_CELL_SIZE; cy++){
+      for (int cx = YARD_X0 / OBSTMAP_CELL_SIZE; cx < YARD_X1 / OBSTMAP_CELL_SIZE; cx++){
+        float px = (cx + 0.5) * OBSTMAP_CELL_SIZE;
+        float py = (cy + 0.5) * OBSTMAP_CELL_SIZE;
+        int8_t value = map.getValue(px, py);
+        if (value < 0) freeCells++;
+        if (value < OBSTMAP_OCCUPIED) continue;
+        occupied++;
+        boolean near = false;
+        for (unsigned int k=0; k < YARD_OBSTACLES; k++){
+          if (obstacleDistance(yardObstacles[k], px, py) < OBSTMAP_CELL_SIZE * 1.5) {
+            near = true;
+            detected[k] = true;
+          }
+        }
+        if (!near) falsePos++;
+      }
+    }
+    int found = 0;
+    for (unsigned int k=0; k < YARD_OBSTACLES; k++) if (detected[k]) found++;
+    printf("synthetic drive 60min: bumper hits=%ld (warned before: %ld), second half: %ld (warned: %ld)\n",
+      bumps, warned, bumpsLate, warnedLate);
+    printf("cells: occupied=%ld (false=%ld) free=%ld  obstacles found=%d/%d\n",
+      occupied, falsePos, freeCells, found, (int)YARD_OBSTACLES);
+    if (found != YARD_OBSTACLES) errors++;
+    if (falsePos * 10 > occupied) errors++;
+    if (warnedLate * 2 < bumpsLate) errors++;
+  }
+  map.print(Console);
+  // flash round trip
+  int8_t before[64][96];
+  for (int cy=0; cy < 64; cy++)
+    for (int cx=0; cx < 96; cx++) before[cy][cx] = map.getValue((cx - 48) * OBSTMAP_CELL_SIZE, (cy - 8) * OBSTMAP_CELL_SIZE);
+  int tiles = map.getTileCount();
+  if (!map.save()) errors++;
+  map.clear();
+  map.begin();
+  int diff = 0;
+  for (int cy=0; cy < 64; cy++)
+    for (int cx=0; cx < 96; cx++) if (map.getValue((cx - 48) * OBSTMAP_CELL_SIZE, (cy - 8) * OBSTMAP_CELL_SIZE) != before[cy][cx]) diff++;
+  if ((diff != 0) || (map.getTileCount() != tiles)) errors++;
+  printf("flash save/load: tiles=%d differences=%d\n", map.getTileCount(), diff);
+  hal_flash[IFLASH1_SIZE - FLASHLOG_PAGES * FLASHLOG_PAGE_SIZE - OBSTMAP_FLASH_SIZE + OBSTMAP_TILE_SIZE + 10]++;   // corrupt first tile
+  map.begin();
+  if ((tiles > 0) && (map.getTileCount() != 0)) errors++;
+  printf("corrupted map discarded: %s\n", (map.getTileCount() == 0) ? "yes" : "no");
+  // full tile pool: far away tiles are reused
+  map.clear();
+  long tileCm = OBSTMAP_TILE_CELLS * OBSTMAP_CELL_SIZE;
+  for (int i=0; i < OBSTMAP_TILES + 12; i++){
+    map.setPose(i * tileCm, 0, 0);
+    map.addBumper(true, true);
+    map.addBumper(true, true);
+  }
+  boolean recent = map.isOccupied((OBSTMAP_TILES + 11) * tileCm, OBSTMAP_SONAR_OFFSET + OBSTMAP_CELL_SIZE/2);
+  boolean oldest = map.isOccupied(0, OBSTMAP_SONAR_OFFSET + OBSTMAP_CELL_SIZE/2);
+  if ((map.getTileCount() != OBSTMAP_TILES) || (!recent) || (oldest)) errors++;
+  printf("tile pool: tiles=%d evictions=%lu recent kept=%s oldest reused=%s\n", map.getTileCount(),
+    map.getEvictions(), recent ? "yes" : "no", oldest ? "no" : "yes");
+  Console.print(F("obstacleAhead="));
+  Console.println(callsPerSecond([&map]{ int dist; map.obstacleAhead(100, dist); }));
+  Console.print(F("addSonar="));
+  Console.println(callsPerSecond([&map]{ map.addSonar(0, 0); }));
+  if (pgmFile != NULL){
+    // one pixel per cell: unknown gray, free white, occupied black
+    int w = (YARD_X1 - YARD_X0) / OBSTMAP_CELL_SIZE + 20;
+    int h = (YARD_Y1 - YARD_Y0) / OBSTMAP_CELL_SIZE + 20;
+    FILE *f = fopen(pgmFile, "wb");
+    if (f == NULL) {
+      printf("cannot write %s\n", pgmFile);
+      return 1;
+    }
+    fprintf(f, "P5\n%d %d\n255\n", w, h);
+    for (int row=0; row < h; row++){
+      for (int c=0; c < w; c++){
+        float px = YARD_X0 + (c - 10 + 0.5) * OBSTMAP_CELL_SIZE;
+        float py = YARD_Y1 - (row - 10 + 0.5) * OBSTMAP_CELL_SIZE;
+        fputc(constrain(128 - 2 * map.getValue(px, py), 0, 255), f);
+      }
+    }
+    fclose(f);
+    printf("map image: %s (%dx%d)\n", pgmFile, w, h);
+  }
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// perimeter sender current control against a loop model: loop current = duty * voltage / loop resistance
+// (wire inductance: time constant < 1 ms, neglected), driver fault (MC33926 over-current) above
+// SENDER_FAULT_CURRENT switches the output off until the next control update, current sensor 525 mV/A on a
+// 10 bit ADC (1.1V ref) with noise, averaged over the last 16 readings (sender.ino: periCurrentMeasurements)
+#define SENDER_FAULT_CURRENT 4.0
+#define SENDER_TARGET 0.5
+
+struct senderloop_t {
+  const char *name;
+  float voltage;
+  float resistance;
+  float resistanceWet;   // second half of the run (rain)
+};
+
+static const senderloop_t senderLoops[] = {
+  { "standard loop (200m, 12 ohm)",      24, 12,    12 },
+  { "long loop, rain (500m, 30->45 ohm)", 24, 30,    45 },
+  { "short loop (20m, 3 ohm)",           24, 3,     3 },
+  { "wire short circuit (12->1 ohm)",    24, 12,    1 },
+  { "open loop (broken wire)",           24, 10000, 10000 },
+};
+
+// runs a loop for 'seconds', fixed duty (control false) or closed loop
+static void senderRun(const senderloop_t &loop, boolean control, int seconds, CurrentControl &ctl,
+    float &settleTime, float &steadyError, unsigned long &faults){
+  RunningMedian<unsigned int,16> measurements;
+  ctl.begin(SENDER_TARGET);
+  float duty = control ? ctl.getDuty() : 1.0;
+  boolean fault = false;
+  boolean driverOff = false;
+  settleTime = -1;
+  steadyError = 0;
+  faults = 0;
+  int periods = seconds * 1000 / CURRENTCTL_PERIOD;
+  for (int p=0; p < periods; p++){
+    float t = p * CURRENTCTL_PERIOD / 1000.0;
+    float resistance = (t < seconds / 2) ? loop.resistance : loop.resistanceWet;
+    // sender loop(): current readings between control updates (about every 2 ms)
+    for (int k=0; k < CURRENTCTL_PERIOD / 2; k++){
+      float current = driverOff ? 0 : duty * loop.voltage / resistance;
+      if (current > SENDER_FAULT_CURRENT) {
+        fault = true;
+        driverOff = true;
+        current = 0;
+      }
+      int adc = (int)(current * 0.525 / 1.1 * 1023 + gauss(2) + 0.5);
+      measurements.add(constrain(adc, 0, 1023));
+    }
+    float v = 0;
+    measurements.getAverage(v);
+    float current = v / 1023.0 * 1.1 / 0.525;
+    if (fault) faults++;
+    if (control) duty = ctl.update(current, fault);
+    fault = false;
+    driverOff = false;
+    // settled: within 5% of the target, steady error: second quarter of each half (after settling)
+    if ((control) && (settleTime < 0) && (abs(current - SENDER_TARGET) <= 0.05 * SENDER_TARGET)) settleTime = t;
+    float phase = fmod(t, seconds / 2.0f);
+    if ((phase >= seconds / 8.0f) && (phase < seconds / 4.0f)){
+      steadyError = max(steadyError, abs(current - SENDER_TARGET));
+    }
+  }
+}
+
+static int sender(){
+  int errors = 0;
+  int seconds = 120;
+  printf("loop current target=%.2fA, driver fault above %.1fA, %ds per loop (resistance step at half time)\n",
+    SENDER_TARGET, SENDER_FAULT_CURRENT, seconds);
+  for (unsigned int i=0; i < sizeof senderLoops / sizeof senderLoops[0]; i++){
+    const senderloop_t &loop = senderLoops[i];
+    CurrentControl ctl;
+    float settleTime, steadyError;
+    unsigned long faults;
+    senderRun(loop, false, seconds, ctl, settleTime, steadyError, faults);
+    printf("%s\n  fixed duty 100%%:  current=%.2fA faults=%lu\n", loop.name,
+      min(loop.voltage / loop.resistance, (float)SENDER_FAULT_CURRENT), faults);
+    senderRun(loop, true, seconds, ctl, settleTime, steadyError, faults);
+    printf("  current control:  settled=%.1fs steady error=%.3fA duty=%.2f faults=%lu open=%d\n  ",
+      settleTime, steadyError, ctl.getDuty(), faults, ctl.isOpen());
+    ctl.print(Console);
+    boolean open = (loop.voltage / loop.resistance < CURRENTCTL_OPEN_CURRENT);
+    if (open) {
+      if ((!ctl.isOpen()) || (faults != 0)) errors++;
+    } else {
+      if ((settleTime < 0) || (settleTime > 5) || (steadyError > 0.05 * SENDER_TARGET) || (ctl.isOpen())) errors++;
+    }
+  }
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// Print into a char array (formatter output)
+class BufferPrint : public Print
+{
+  public:
+    char text[200];
+    int len;
+    BufferPrint(){ clear(); }
+    void clear(){ len = 0; text[0] = 0; }
+    virtual size_t write(uint8_t c){
+      if (len < (int)sizeof text - 1) { text[len++] = c; text[len] = 0; }
+      return 1;
+    }
+};
+
+// Print without output (formatter speed)
+class NullPrint : public Print
+{
+  public:
+    virtual size_t write(uint8_t c){ return 1; }
+    virtual size_t write(const uint8_t *buffer, size_t size){ return size; }
+};
+
+// Streamprint against snprintf (same format and arguments)
+#define CHECKFMT(format, ...) { \
+    out.clear(); \
+    Streamprint(out, format, ##__VA_ARGS__); \
+    snprintf(ref, sizeof ref, format, ##__VA_ARGS__); \
+    if (strcmp(out.text, ref) != 0) { printf("  '%s': '%s' expected '%s'\n", format, out.text, ref); errors++; } \
+  }
+
+static int consoleFormat(){
+  int errors = 0;
+  char ref[200];
+  BufferPrint out;
+  CHECKFMT("t%6lu L%3d m%1d %4s ", 1234UL, 57, 1, "FORW");
+  CHECKFMT("%d %i %5d %-5d| %05d %05d", -17, 42, -3, 12, 42, -42);
+  CHECKFMT("%lu %lu %ld %ld", 0UL, 4294967295UL, -2147483647L, 2147483647L);
+  CHECKFMT("%x %4x %04x", 255, 10, 0xab);
+  CHECKFMT("bat %4.1f chg %4.1f %4.1f ", 25.36, 0.04, -1.26);
+  CHECKFMT("%.3f %.0f %8.2f %-8.2f| %f", -0.0015, 2.5001, 3.14159, -2.5, 1.0/3);
+  CHECKFMT("%s|%-6s|%6s|%c%c", "", "ab", "cd", 'x', 'y');
+  CHECKFMT("100%% done\r\n");
+  printf("format: Streamprint vs snprintf errors=%d\n", errors);
+  NullPrint sink;
+  char buf[100];
+  int i = 0;
+  long calls = callsPerSecond([&]{ Streamprint(sink, "t%6lu L%3d bat %4.1f %s\r\n", (unsigned long)i++, 57, 25.36, "FORW"); });
+  long callsRef = callsPerSecond([&]{
+    int len = snprintf(buf, sizeof buf, "t%6lu L%3d bat %4.1f %s\r\n", (unsigned long)i++, 57, 25.36, "FORW");
+    sink.write((const uint8_t*)buf, len);
+  });
+  printf("format: Streamprint %ld lines/s (snprintf %ld lines/s)\n", calls, callsRef);
+  return errors;
+}
+
+// info line once per second on a slow console (e.g. Bluetooth back-pressure): loop time spent in printInfo
+static void consoleInfo(Stream &s, unsigned long baud, unsigned long &blockMax, unsigned long &blockSum){
+  hal_serialThrottle(ConsolePort, baud);
+  blockMax = blockSum = 0;
+  for (int i=0; i < 20; i++){
+    unsigned long t = micros();
+    robot.printInfo(s);
+    unsigned long blocked = micros() - t;
+    blockMax = max(blockMax, blocked);
+    blockSum += blocked;
+    for (int j=0; j < 100; j++){
+      hal_advanceMicros(10000);                      // robot loop
+      ConsoleTx.run();
+    }
+  }
+  ConsoleTx.flush();
+  hal_serialThrottle(ConsolePort, 0);
+}
+
+static int console(){
+  setupHardware();
+  robot.setup();
+  int errors = consoleFormat();
+  hal_serialSink(ConsolePort, NULL);
+  const unsigned long bauds[] = { 115200, 19200, 300 };
+  for (unsigned int i=0; i < sizeof bauds / sizeof bauds[0]; i++){
+    unsigned long blockMax, blockSum, blockMaxTx, blockSumTx;
+    consoleInfo(ConsolePort, bauds[i], blockMax, blockSum);
+    unsigned long dropped = ConsoleTx.getDroppedLines();
+    unsigned long waits = ConsoleTx.getWaits();
+    consoleInfo(ConsoleTx, bauds[i], blockMaxTx, blockSumTx);
+    dropped = ConsoleTx.getDroppedLines() - dropped;
+    waits = ConsoleTx.getWaits() - waits;
+    printf("info line at %6lu baud: direct max=%7luus avg=%7luus  buffered max=%4luus avg=%4luus dropped=%lu waits=%lu\n",
+      bauds[i], blockMax, blockSum/20, blockMaxTx, blockSumTx/20, dropped, waits);
+    if ((waits != 0) || (blockMaxTx > 2000)) errors++;
+    if ((bauds[i] >= 19200) && (dropped != 0)) errors++;
+    if ((bauds[i] < 19200) && (dropped == 0)) errors++;
+  }
+  hal_serialSink(ConsolePort, stdout);
+  ConsoleTx.printReport(Console);
+  ConsoleTx.flush();
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// synthetic u-blox receiver output, 10 Hz: NMEA GGA, RMC, GSA, 3x GSV, VTG, GLL and UBX NAV-PVT,
+// NAV-RELPOSNED (robot on a 20 m circle), every 50th GSV and every 100th NAV-PVT with a transfer error
+#define GPS_EPOCHS      1200
+#define GPS_LAT0        515000000L    // 1e-7 degrees
+#define GPS_LON0        74000000L
+#define GPS_STREAM_SIZE (4L << 20)
+
+struct gpstruth_t {
+  long lat, lon;              // 1e-7 degrees
+  long relNorth, relEast;     // 0.1 mm
+};
+
+static uint8_t gpsStream[GPS_STREAM_SIZE];
+static long gpsStreamSize;
+static gpstruth_t gpsTruth;
+
+static void gpsPut(const void *data, int len){
+  if (gpsStreamSize + len > GPS_STREAM_SIZE) return;
+  memcpy(gpsStream + gpsStreamSize, data, len);
+  gpsStreamSize += len;
+}
+
+static void gpsNmea(const char *body, boolean corrupt){
+  byte parity = 0;
+  for (const char *p = body; *p; p++) parity ^= *p;
+  char line[120];
+  int len = snprintf(line, sizeof line, "$%s*%02X\r\n", body, parity);
+  if (corrupt) line[len / 2] ^= 0x01;
+  gpsPut(line, len);
+}
+
+// ddmm.mmmmm
+static void gpsNmeaDegrees(char *out, int size, long value, int degDigits){
+  long deg = labs(value) / 10000000L;
+  long minE5 = lround((labs(value) % 10000000L) * 60.0 / 100.0);
+  int len = snprintf(out, size, "%0*ld%02ld.%05ld", degDigits, deg, minE5 / 100000, minE5 % 100000);
+  if ((len < 0) || (len >= size)) out[0] = 0;    // does not fit: empty field (fix rejected)
+}
+
+static void gpsUbx(byte msgClass, byte msgId, byte *payload, int len, boolean corrupt){
+  byte frame[120] = { 0xB5, 0x62, msgClass, msgId, (byte)len, (byte)(len >> 8) };
+  memcpy(frame + 6, payload, len);
+  byte a = 0, b = 0;
+  for (int i=2; i < len + 6; i++) { a += frame[i]; b += a; }
+  frame[len + 6] = a;
+  frame[len + 7] = b;
+  if (corrupt) frame[6 + len / 2] ^= 0x10;
+  gpsPut(frame, len + 8);
+}
+
+static void gpsSet(byte *p, int ofs, long value, int bytes){
+  for (int i=0; i < bytes; i++) p[ofs + i] = (value >> (8 * i)) & 0xFF;
+}
+
+static void gpsGenerate(boolean ubx){
+  gpsStreamSize = 0;
+  for (int n=0; n < GPS_EPOCHS; n++){
+    // circle (20 m radius, 0.5 m/s), heading = course over ground
+    float t = n * 0.1;
+    float angle = t * 0.5 / 20.0;
+    double north = 20.0 * sin(angle), east = 20.0 - 20.0 * cos(angle);
+    float heading = fmod(angle * 180 / PI + 360.0, 360.0);
+    gpsTruth.lat = GPS_LAT0 + lround(north / 111320.0 * 1e7);
+    gpsTruth.lon = GPS_LON0 + lround(east / (111320.0 * cos(GPS_LAT0 / 1e7 * PI / 180)) * 1e7);
+    gpsTruth.relNorth = lround(north * 10000);
+    gpsTruth.relEast = lround(east * 10000);
+    int sec = n / 10, cs = (n % 10) * 10;
+    char lat[20], lon[20], body[100];
+    gpsNmeaDegrees(lat, sizeof lat, gpsTruth.lat, 2);
+    gpsNmeaDegrees(lon, sizeof lon, gpsTruth.lon, 3);
+    snprintf(body, sizeof body, "GNRMC,1200%02d.%02d,A,%s,N,%s,E,%.3f,%.2f,171026,,,R", sec % 60, cs, lat, lon, 0.5 / 0.514444, heading);
+    gpsNmea(body, false);
+    snprintf(body, sizeof body, "GNVTG,%.2f,T,,M,%.3f,N,%.3f,K,R", heading, 0.5 / 0.514444, 1.8);
+    gpsNmea(body, false);
+    snprintf(body, sizeof body, "GNGGA,1200%02d.%02d,%s,N,%s,E,4,14,0.62,100.0,M,47.0,M,1.0,0000", sec % 60, cs, lat, lon);
+    gpsNmea(body, false);
+    gpsNmea("GNGSA,A,3,02,05,07,09,13,15,18,20,,,,,1.20,0.62,1.03", false);
+    gpsNmea("GPGSV,3,1,11,02,45,120,44,05,60,210,46,07,30,045,40,09,20,300,38", (n % 50) == 25);
+    gpsNmea("GPGSV,3,2,11,13,75,010,48,15,15,180,35,18,50,250,45,20,10,090,30", false);
+    gpsNmea("GPGSV,3,3,11,25,05,330,22,29,40,135,42,30,35,270,41", false);
+    snprintf(body, sizeof body, "GNGLL,%s,N,%s,E,1200%02d.%02d,A,R", lat, lon, sec % 60, cs);
+    gpsNmea(body, false);
+    if (!ubx) continue;
+    byte pvt[92] = { 0 };
+    gpsSet(pvt, 0, 302400000L + n * 100, 4);         // iTOW
+    gpsSet(pvt, 4, 2026, 2);
+    pvt[6] = 10; pvt[7] = 17; pvt[8] = 12; pvt[9] = sec / 60; pvt[10] = sec % 60;
+    pvt[11] = 0x07;                                    // valid date, time, fully resolved
+    gpsSet(pvt, 16, cs * 10000000L, 4);                // nano
+    pvt[20] = 3;                                       // 3D fix
+    pvt[21] = 0x01 | (2 << 6);                         // gnssFixOK, RTK fixed
+    pvt[23] = 14;
+    gpsSet(pvt, 24, gpsTruth.lon, 4);
+    gpsSet(pvt, 28, gpsTruth.lat, 4);
+    gpsSet(pvt, 32, 147000, 4);
+    gpsSet(pvt, 36, 100000, 4);                        // hMSL mm
+    gpsSet(pvt, 40, 14, 4);                            // hAcc mm
+    gpsSet(pvt, 60, 500, 4);                           // gSpeed mm/s
+    gpsSet(pvt, 64, lround(heading * 100000), 4);
+    gpsSet(pvt, 76, 120, 2);                           // pDOP
+    gpsUbx(0x01, 0x07, pvt, sizeof pvt, (n % 100) == 50);
+    byte rel[64] = { 1 };
+    gpsSet(rel, 8, gpsTruth.relNorth / 100, 4);
+    gpsSet(rel, 12, gpsTruth.relEast / 100, 4);
+    rel[32] = gpsTruth.relNorth % 100;
+    rel[33] = gpsTruth.relEast % 100;
+    gpsSet(rel, 60, 0x01 | 0x02 | 0x04 | (2 << 3), 4);
+    gpsUbx(0x01, 0x3C, rel, sizeof rel, false);
+  }
+}
+
+static boolean gpsLoad(const char *fileName){
+  FILE *f = fopen(fileName, "rb");
+  if (f == NULL) return false;
+  gpsStreamSize = fread(gpsStream, 1, GPS_STREAM_SIZE, f);
+  fclose(f);
+  return true;
+}
+
+static double wallSeconds(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count() / 1e6;
+}
+
+// stream over Serial3 at 'baud', loop of 10..60 ms (every 100th 150 ms), returns replay speed (line time / wall time)
+static float gpsReplay(GPS &gps, unsigned long baud, boolean ring){
+  gps.init(baud);
+  if (!ring) USART3->US_PTCR = US_PTCR_RXTDIS;       // core RX buffer, byte-wise feed (previous firmware)
+  gps.resetStats();
+  Serial3.rxOverruns = 0;
+  hal_serialLine(Serial3, gpsStream, gpsStreamSize);
+  double start = wallSeconds();
+  for (long loops=0; hal_serialLinePending(Serial3) > 0; loops++){
+    hal_advanceMicros(((loops % 100) == 99) ? 150000 : random(10000, 60000));
+    if (ring) gps.feed();
+      else while (Serial3.available()) gps.encode(Serial3.read());
+  }
+  hal_advanceMicros(10000);
+  if (ring) gps.feed();
+    else while (Serial3.available()) gps.encode(Serial3.read());
+  double lineTime = gpsStreamSize * 10.0 / baud;
+  return lineTime / (wallSeconds() - start);
+}
+
+static int gpsCheckCount(GPS &gps, const char *name, byte type, unsigned long expected, unsigned long failed){
+  if ((gps.getMessages(type) == expected) && (gps.getFailed(type) == failed)) return 0;
+  printf("  %s: %lu failed=%lu, expected %lu failed=%lu\n", name, gps.getMessages(type), gps.getFailed(type), expected, failed);
+  return 1;
+}
+
+static int gpsCheck(GPS &gps, boolean ubx){
+  int errors = 0;
+  unsigned long e = GPS_EPOCHS;
+  errors += gpsCheckCount(gps, "GGA", GPS_MSG_GGA, e, 0);
+  errors += gpsCheckCount(gps, "RMC", GPS_MSG_RMC, e, 0);
+  errors += gpsCheckCount(gps, "GSA", GPS_MSG_GSA, e, 0);
+  errors += gpsCheckCount(gps, "GSV", GPS_MSG_GSV, 3 * e - e / 50, e / 50);
+  errors += gpsCheckCount(gps, "VTG", GPS_MSG_VTG, e, 0);
+  errors += gpsCheckCount(gps, "GLL", GPS_MSG_GLL, e, 0);
+  errors += gpsCheckCount(gps, "NAV-PVT", GPS_MSG_NAV_PVT, ubx ? e - e / 100 : 0, ubx ? e / 100 : 0);
+  errors += gpsCheckCount(gps, "NAV-RELPOSNED", GPS_MSG_NAV_RELPOSNED, ubx ? e : 0, 0);
+  if (gps.getOverflows() != 0) errors++;
+  long lat, lon;
+  gps.get_position_e7(&lat, &lon);
+  long tolerance = ubx ? 0 : 2;       // NMEA: minutes with 5 decimals
+  if ((labs(lat - gpsTruth.lat) > tolerance) || (labs(lon - gpsTruth.lon) > tolerance)) errors++;
+  if (ubx){
+    float north, east, down;
+    if ((!gps.get_relpos(&north, &east, &down)) || (gps.carrierSolution() != 2)
+      || (fabs(north - gpsTruth.relNorth / 10000.0) > 1e-4) || (fabs(east - gpsTruth.relEast / 10000.0) > 1e-4)) errors++;
+    if ((!gps.ubxActive()) || (gps.hAcc() != 14)) errors++;
+  }
+  printf("  position error lat=%ld lon=%ld (1e-7 deg) speed=%.2f km/h course=%.1f sats=%d\n",
+    lat - gpsTruth.lat, lon - gpsTruth.lon, gps.f_speed_kmph(), gps.f_course(), gps.satellites());
+  return errors;
+}
+
+// ENU projection (robot frame of the GPS fixes) vs. great circle distance and bearing, round trip
+static int gpsEnuCheck(){
+  int errors = 0;
+  EnuProjection enu;
+  enu.setOrigin(GPS_LAT0, GPS_LON0);
+  float maxDev = 0;
+  long maxRoundTrip = 0;
+  for (int i=0; i < 100; i++){
+    long lat = GPS_LAT0 + random(-90000, 90000);      // +-1 km
+    long lon = GPS_LON0 + random(-140000, 140000);
+    float east, north;
+    enu.toLocal(lat, lon, east, north);
+    float la0 = GPS_LAT0 / 1e7, lo0 = GPS_LON0 / 1e7, la = lat / 1e7, lo = lon / 1e7;
+    float dist = GPS::distance_between(la0, lo0, la, lo);
+    float course = GPS::course_to(la0, lo0, la, lo) * DEG_TO_RAD;
+    // sphere vs. ellipsoid: ~0.5%
+    float dev = sqrt(sq(east - dist * sin(course)) + sq(north - dist * cos(course))) / max(dist, 1.0f);
+    maxDev = max(maxDev, dev);
+    long lat2, lon2;
+    enu.toGeodetic(east, north, lat2, lon2);
+    maxRoundTrip = max(maxRoundTrip, max(labs(lat2 - lat), labs(lon2 - lon)));
+  }
+  if ((maxDev > 0.006) || (maxRoundTrip > 1)) errors++;
+  printf("ENU projection: deviation from great circle max=%.2f%%, round trip max=%ld (1e-7 deg)\n", maxDev * 100, maxRoundTrip);
+  return errors;
+}
+
+static int gpsTest(const char *logFile, unsigned long baud){
+  setupHardware();
+  static GPS gpsRing, gpsNmeaOnly, gpsCore;
+  int errors = 0;
+  if (logFile != NULL){
+    // captured receiver output (u-center .ubx or NMEA log)
+    if (!gpsLoad(logFile)) {
+      printf("cannot open %s\n", logFile);
+      return 1;
+    }
+    float speed = gpsReplay(gpsRing, baud, true);
+    printf("%s: %ld bytes at %lu baud, replay %.0fx real time\n", logFile, gpsStreamSize, baud, speed);
+    gpsRing.printStats(Console);
+    float speedCore = gpsReplay(gpsCore, baud, false);
+    printf("core RX buffer (byte-wise feed): replay %.0fx real time, lost bytes=%lu\n", speedCore, Serial3.rxOverruns);
+    gpsCore.printStats(Console);
+    Console.flush();
+    return (speed < 100) ? 1 : 0;
+  }
+  gpsGenerate(true);
+  printf("synthetic UBX+NMEA stream: %d epochs (10 Hz), %ld bytes at %lu baud\n", GPS_EPOCHS, gpsStreamSize, baud);
+  float speed = gpsReplay(gpsRing, baud, true);
+  printf("RX ring (PDC), block parser: replay %.0fx real time\n", speed);
+  gpsRing.printStats(Console);
+  Console.flush();
+  errors += gpsCheck(gpsRing, true);
+  if (speed < 100) errors++;
+  float speedCore = gpsReplay(gpsCore, baud, false);
+  printf("core RX buffer (%d bytes), byte-wise feed: replay %.0fx real time, lost bytes=%lu\n",
+    HAL_SERIAL_CORE_RX, speedCore, Serial3.rxOverruns);
+  gpsCore.printStats(Console);
+  Console.flush();
+  gpsGenerate(false);
+  printf("synthetic NMEA stream (fallback): %ld bytes\n", gpsStreamSize);
+  speed = gpsReplay(gpsNmeaOnly, baud, true);
+  gpsNmeaOnly.printStats(Console);
+  Console.flush();
+  errors += gpsCheck(gpsNmeaOnly, false);
+  // parser speed (no reception)
+  gpsGenerate(true);
+  long bytes = 0;
+  double start = wallSeconds();
+  while (wallSeconds() - start < 1.0){
+    gpsNmeaOnly.parse(gpsStream, gpsStreamSize);
+    bytes += gpsStreamSize;
+  }
+  printf("parser: %.1f MB/s\n", bytes / (wallSeconds() - start) / 1e6);
+  errors += gpsEnuCheck();
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// ---- encoder odometry ---------------------------------------------------------------------
+
+#define ENC_STEP_US 20                  // wheel model step
+#define ENC_LOOP_US 10000               // robot loop (EncoderOdometry::run)
+#define ENC_TASK_US 100000              // odometry task
+#define ENC_JITTER_US 15                // interrupt latency
+#define ENC_START_TIME 0xFFB3B4C0UL     // micros wrap after 5 s
+
+// ring: order, wraparound, overflow (dropped edges), micros wrap
+static int encoderRingCheck(){
+  int errors = 0;
+  EdgeRing ring;
+  uint32_t time;
+  int8_t dir;
+  for (int round=0; round < 3; round++){
+    for (int i=0; i < 20; i++) ring.push((uint32_t)(0xFFFFFFF0UL + round * 100 + i), (i % 3) ? 1 : -1);
+    if (ring.getPending() != 20) errors++;
+    for (int i=0; i < 20; i++){
+      if ((!ring.pop(time, dir)) || (time != (uint32_t)(0xFFFFFFF0UL + round * 100 + i)) || (dir != ((i % 3) ? 1 : -1))) errors++;
+    }
+    if (ring.pop(time, dir)) errors++;
+  }
+  for (int i=0; i < ENCODER_RING_SIZE + 10; i++) ring.push(i, (i < ENCODER_RING_SIZE + 5) ? 1 : -1);
+  if (ring.getPending() != ENCODER_RING_SIZE - 1) errors++;
+  if (ring.takeDropped() != 11 - 5 - 5) errors++;   // 11 dropped: 6 forward, 5 backward
+  if ((ring.getDropped() != 11) || (ring.takeDropped() != 0)) errors++;
+  // constant speed across the micros wrap
+  WheelSpeed speed;
+  for (int i=0; i < 50; i++) speed.edge((uint32_t)(0xFFFF0000UL + i * 2500), 1);     // 400 ticks/s
+  float value = speed.update((uint32_t)(0xFFFF0000UL + 49 * 2500 + 1000));
+  for (int i=50; i < 100; i++) speed.edge((uint32_t)(0xFFFF0000UL + i * 2500), 1);  // wraps at i=26..27
+  float value2 = speed.update((uint32_t)(0xFFFF0000UL + 99 * 2500 + 1000));
+  if ((fabs(value - 400) > 0.01) || (fabs(value2 - 400) > 0.01)) errors++;
+  // stopped
+  if (speed.update((uint32_t)(0xFFFF0000UL + 99 * 2500 + ENCODER_STOP_TIME + 1)) != 0) errors++;
+  // straight line: both wheels, edges merged in time order
+  EncoderOdometry enc;
+  enc.begin(10, 30);
+  for (int i=0; i < 100; i++){
+    enc.left.push(i * 1000, 1);
+    enc.right.push(i * 1000 + 500, 1);
+    if ((i % 20) == 19) enc.run();
+  }
+  if ((fabs(enc.getY() - 10) > 1e-3) || (fabs(enc.getX()) > 0.05) || (fabs(enc.getTheta()) > 1e-6)
+    || (enc.getEdges() != 200) || (fabs(enc.takeDistance() - 10) > 1e-3)) errors++;
+  printf("edge ring (%d entries): order, wraparound, dropped edges, micros wrap, straight line errors=%d\n",
+    ENCODER_RING_SIZE, errors);
+  return errors;
+}
+
+// wheel speed (rpm) of the synthetic trace: stop, slow, reverse, fast with load changes
+static float encoderProfile(float t){
+  if (t < 1) return 0;
+  if (t < 3) return 3 * (t - 1) / 2;                    // ramp to 3 rpm
+  if (t < 7) return 3 + 0.5 * sin(t * 3);               // slow
+  if (t < 10) return 3 + 27 * (t - 7) / 3;              // ramp to 30 rpm
+  if (t < 14) return 30 + 3 * sin(t * 5);               // fast, load changes
+  if (t < 17) return 30 - 30 * (t - 14) / 3;            // ramp down
+  if (t < 18) return 0;
+  if (t < 21) return -5;                                // reverse
+  return 0;
+}
+
+struct encwheel_t {
+  double pos;           // ticks (true)
+  long ticks;           // counted edges
+};
+
+// moves the wheel by rate (ticks/s) for one model step, pushes the edges
+static void encoderWheelStep(encwheel_t &w, double rate, uint32_t time, EdgeRing &ring){
+  w.pos += rate * ENC_STEP_US / 1e6;
+  while (floor(w.pos) > w.ticks){
+    w.ticks++;
+    ring.push(time + (uint32_t)fabs(gauss(ENC_JITTER_US)), 1);
+  }
+  while (floor(w.pos) < w.ticks){
+    w.ticks--;
+    ring.push(time + (uint32_t)fabs(gauss(ENC_JITTER_US)), -1);
+  }
+}
+
+struct rpmerror_t {
+  double sumOld;
+  double sumNew;
+  int count;
+};
+
+// RPM of the 100 ms tick difference vs. edge timestamp estimator against the true wheel speed
+static int encoderSpeedTrace(int ticksPerRevolution){
+  EncoderOdometry enc;
+  enc.begin(ticksPerRevolution / 69.1, 36);
+  encwheel_t wheel = { 0.5, 0 };
+  encwheel_t other = { 0.5, 0 };
+  rpmerror_t low = { 0, 0, 0 };
+  rpmerror_t high = { 0, 0, 0 };
+  long lastTicks = 0;
+  uint32_t time = ENC_START_TIME;
+  for (long us=0; us < 22000000; us += ENC_STEP_US, time += ENC_STEP_US){
+    float rpm = encoderProfile(us / 1e6);
+    encoderWheelStep(wheel, rpm * ticksPerRevolution / 60.0, time, enc.left);
+    encoderWheelStep(other, 0, time, enc.right);
+    if ((us % ENC_LOOP_US) == 0) enc.run();
+    if ((us % ENC_TASK_US) == 0){
+      enc.run();
+      enc.update(time);
+      float rpmNew = enc.getSpeedLeft() * 60.0 / ticksPerRevolution;
+      float rpmOld = (wheel.ticks - lastTicks) / ((float)ticksPerRevolution) / (ENC_TASK_US / 1000) * 60000.0;
+      lastTicks = wheel.ticks;
+      rpmerror_t &e = (fabs(rpm) < 6) ? low : high;
+      e.sumOld += sq(rpmOld - rpm);
+      e.sumNew += sq(rpmNew - rpm);
+      e.count++;
+    }
+  }
+  float lowOld = sqrt(low.sumOld / low.count), lowNew = sqrt(low.sumNew / low.count);
+  float highOld = sqrt(high.sumOld / high.count), highNew = sqrt(high.sumNew / high.count);
+  printf("%4d ticks/rev  rpm error (rms)  < 6 rpm: %6.2f (100 ms ticks %6.2f)  >= 6 rpm: %6.2f (%6.2f)\n",
+    ticksPerRevolution, lowNew, lowOld, highNew, highOld);
+  int errors = 0;
+  if ((lowNew > lowOld) || (highNew > highOld)) errors++;
+  if ((ticksPerRevolution <= 20) && (lowNew > lowOld / 2)) errors++;
+  return errors;
+}
+
+// pose on a slalom (varying arcs): edge integration vs. 100 ms tick difference against the true pose
+static int encoderPoseTrace(int ticksPerRevolution){
+  float ticksPerCm = ticksPerRevolution / 69.1;      // 22 cm wheel
+  float wheelBase = 36;
+  EncoderOdometry enc;
+  enc.begin(ticksPerCm, wheelBase);
+  encwheel_t left = { 0.5, 0 };
+  encwheel_t right = { 0.5, 0 };
+  double x = 0, y = 0, heading = 0;                    // truth
+  double oldX = 0, oldY = 0, oldTheta = 0;             // previous calcOdometry
+  long lastLeft = 0, lastRight = 0;
+  float maxNew = 0, maxOld = 0;
+  uint32_t time = ENC_START_TIME;
+  double dt = ENC_STEP_US / 1e6;
+  for (long us=0; us < 60000000; us += ENC_STEP_US, time += ENC_STEP_US){
+    double t = us / 1e6;
+    double v = 30;                                     // cm/s
+    double rate = 0.6 * sin(t * 0.5) + 0.3 * sin(t * 1.7);   // rad/s
+    double vLeft = v + rate * wheelBase / 2;
+    double vRight = v - rate * wheelBase / 2;
+    heading += (vLeft - vRight) / wheelBase * dt / 2;
+    x += (vLeft + vRight) / 2 * sin(heading) * dt;
+    y += (vLeft + vRight) / 2 * cos(heading) * dt;
+    heading += (vLeft - vRight) / wheelBase * dt / 2;
+    encoderWheelStep(left, vLeft * ticksPerCm, time, enc.left);
+    encoderWheelStep(right, vRight * ticksPerCm, time, enc.right);
+    if ((us % ENC_LOOP_US) == 0) enc.run();
+    if ((us % ENC_TASK_US) == 0){
+      enc.run();
+      enc.update(time);
+      enc.setHeading(enc.getTheta());
+      double leftCm = (left.ticks - lastLeft) / ticksPerCm;
+      double rightCm = (right.ticks - lastRight) / ticksPerCm;
+      lastLeft = left.ticks;
+      lastRight = right.ticks;
+      oldTheta += (leftCm - rightCm) / wheelBase;
+      oldX += (leftCm + rightCm) / 2 * sin(oldTheta);
+      oldY += (leftCm + rightCm) / 2 * cos(oldTheta);
+      maxNew = max(maxNew, (float)sqrt(sq(enc.getX() - x) + sq(enc.getY() - y)));
+      maxOld = max(maxOld, (float)sqrt(sq(oldX - x) + sq(oldY - y)));
+    }
+  }
+  printf("%4d ticks/rev  slalom 18 m: position error max %6.2f cm (100 ms ticks %6.2f cm), edges=%lu\n",
+    ticksPerRevolution, maxNew, maxOld, enc.getEdges());
+  return (maxNew > maxOld) ? 1 : 0;
+}
+
+static int encoder(){
+  int errors = 0;
+  errors += encoderRingCheck();
+  printf("synthetic encoder trace: stop, 3 rpm, 30 rpm with load changes, reverse, %d us interrupt latency\n",
+    ENC_JITTER_US);
+  errors += encoderSpeedTrace(20);
+  errors += encoderSpeedTrace(1060);
+  errors += encoderPoseTrace(20);
+  errors += encoderPoseTrace(1060);
+  // loop cost per edge
+  EncoderOdometry enc;
+  enc.begin(15.3, 36);
+  long edges = 0;
+  double start = wallSeconds();
+  while (wallSeconds() - start < 0.5){
+    for (int i=0; i < 100; i++){
+      enc.left.push(edges * 100 + i, 1);
+      enc.right.push(edges * 100 + i, -1);
+    }
+    enc.run();
+    edges += 200;
+  }
+  printf("EncoderOdometry::run: %.0f ns per edge\n", (wallSeconds() - start) / edges * 1e9);
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+// telemetry test values: from channel and time, TELE_INT32 channels outside the int16 range
+static long teleValue(byte ch, unsigned long ms){
+  long value = (long)((ms / 50) % 500) + ch * 100 - 2000;
+  return (pgm_read_byte(&teleChannels[ch].type) == TELE_INT32) ? value * 1000 : value;
+}
+
+struct TeleSource {
+  long raw(byte ch){ return teleValue(ch, millis()); }
+};
+
+// CRC-16/CCITT-FALSE as documented in telemetry.h (bitwise, independent of crc.h)
+static uint16_t teleCrc(const byte *data, int size){
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i < size; i++){
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit=0; bit < 8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+// stream decoder (frames, schema, values), counts everything that does not match the encoder
+struct TeleDecoder {
+  boolean schema;
+  byte schemaId, groupMask, count, known;
+  unsigned int period;
+  byte channel[TELE_CHANNEL_COUNT];
+  int lastSeq;
+  unsigned long frames, dataFrames, skipped, lost, crcErrors, schemaChanges, errors;
+
+  TeleDecoder(){
+    schema = false;
+    schemaId = groupMask = count = known = 0;
+    period = 0;
+    lastSeq = -1;
+    frames = dataFrames = skipped = lost = crcErrors = schemaChanges = errors = 0;
+  }
+
+  void schemaFrame(const byte *p, byte len){
+    if (len != 5) { errors++; return; }
+    if ((!schema) || (p[0] != schemaId)) schemaChanges++;
+    schema = true;
+    schemaId = p[0];
+    groupMask = p[1];
+    period = p[2] | (p[3] << 8);
+    count = p[4];
+    known = 0;
+  }
+
+  void channelFrame(const byte *p, byte len){
+    if ((!schema) || (p[0] != schemaId)) return;
+    byte ch = p[2];
+    if ((len < 5) || (p[1] != known) || (known >= count) || (ch >= TELE_CHANNEL_COUNT)) { errors++; return; }
+    telechannel_t c;
+    memcpy_P(&c, &teleChannels[ch], sizeof c);
+    if ((p[3] != c.type) || (p[4] != c.decimals) || ((c.group != 0) && (!(groupMask & c.group)))
+      || (len - 5 != (int)strnlen(c.name, TELE_NAME_SIZE)) || (memcmp(&p[5], c.name, len - 5) != 0)) errors++;
+    channel[known++] = ch;
+  }
+
+  void dataFrame(const byte *p, byte len){
+    if ((!schema) || (known < count)) { skipped++; return; }   // schema not complete yet
+    if (p[0] != schemaId) { errors++; return; }
+    unsigned long ms = p[1] | (p[2] << 8) | ((unsigned long)p[3] << 16) | ((unsigned long)p[4] << 24);
+    int pos = 5;
+    for (byte i=0; i < count; i++){
+      byte ch = channel[i];
+      long value;
+      if (pgm_read_byte(&teleChannels[ch].type) == TELE_INT32) {
+        if (pos + 4 > len) { errors++; return; }
+        value = (int32_t)(p[pos] | (p[pos+1] << 8) | ((uint32_t)p[pos+2] << 16) | ((uint32_t)p[pos+3] << 24));
+        pos += 4;
+      } else {
+        if (pos + 2 > len) { errors++; return; }
+        value = (int16_t)(p[pos] | (p[pos+1] << 8));
+        pos += 2;
+      }
+      if (value != teleValue(ch, ms)) errors++;
+    }
+    if (pos != len) errors++;
+    dataFrames++;
+  }
+
+  void decode(const byte *data, int size){
+    int i = 0;
+    while (i + 8 <= size){
+      if ((data[i] != TELE_SYNC1) || (data[i+1] != TELE_SYNC2)) { i++; continue; }
+      byte len = data[i+5];
+      if (i + 8 + len > size) break;
+      uint16_t crc = data[i+6+len] | (data[i+7+len] << 8);
+      if (teleCrc(&data[i+2], 4 + len) != crc) {
+        crcErrors++;
+        i++;
+        continue;
+      }
+      if (data[i+2] != TELE_VERSION) errors++;
+      byte seq = data[i+4];
+      if (lastSeq >= 0) lost += (byte)(seq - lastSeq - 1);
+      lastSeq = seq;
+      frames++;
+      const byte *p = &data[i+6];
+      switch (data[i+3]){
+        case TELE_FRAME_SCHEMA:  schemaFrame(p, len); break;
+        case TELE_FRAME_CHANNEL: channelFrame(p, len); break;
+        case TELE_FRAME_DATA:    dataFrame(p, len); break;
+        default: errors++;
+      }
+      i += 8 + len;
+    }
+  }
+};
+
+static int teleSend(Telemetry &tele, int frames, unsigned int period){
+  TeleSource source;
+  for (int i=0; i < frames; i++){
+    tele.send(&source, &TeleSource::raw);
+    hal_advanceMicros(period * 1000UL);
+  }
+  return frames;
+}
+
+// telemetry round trip: encoder output (Serial2) decoded with the documented frame format
+static int telemetry(){
+  int errors = 0;
+  FILE *sink = tmpfile();
+  hal_serialSink(Serial2, sink);
+  Telemetry tele;
+  int sent = 0;                                    // data frames
+  tele.begin(&Serial2);
+  byte mask = TELE_GROUP_IMU | TELE_GROUP_MOTOR | TELE_GROUP_BATTERY;
+  tele.setup(mask, 50);
+  sent += teleSend(tele, 200, 50);
+  tele.setup(mask, 50);                            // unchanged: schema sent again, same schema id
+  sent += teleSend(tele, 100, 50);
+  tele.setup(mask | TELE_GROUP_SENSORS, 20);       // new schema
+  sent += teleSend(tele, 500, 20);
+  tele.setup(0xFF, 20);                            // all groups: data frames too large for the TX buffer (dropped)
+  int allSize = tele.getDataFrameSize();
+  sent += teleSend(tele, 10, 20);
+  tele.setup(mask, 50);                            // drops show up as sequence gaps of the next frames
+  sent += teleSend(tele, 100, 50);
+  hal_serialSink(Serial2, NULL);
+  long size = ftell(sink);
+  byte *data = (byte*)malloc(size);
+  rewind(sink);
+  if (fread(data, 1, size, sink) != (size_t)size) errors++;
+  fclose(sink);
+
+  TeleDecoder dec;
+  dec.decode(data, size);
+  printf("frames=%lu (sent %lu) data=%lu skipped=%lu lost=%lu (dropped %lu) schemas=%lu crc errors=%lu value errors=%lu\n",
+    dec.frames, tele.getFrameCount(), dec.dataFrames, dec.skipped, dec.lost, tele.getDropCount(),
+    dec.schemaChanges, dec.crcErrors, dec.errors);
+  printf("data frame size: %d bytes (all groups %d)\n", tele.getDataFrameSize(), allSize);
+  if ((dec.frames != tele.getFrameCount()) || (dec.lost != tele.getDropCount()) || (dec.crcErrors != 0)
+    || (dec.schemaChanges != 4) || (dec.dataFrames + dec.skipped + tele.getDropCount() != (unsigned long)sent)
+    || (dec.errors != 0)) errors++;
+
+  // damaged frame: detected by the CRC, the decoder resynchronizes
+  int pos = size / 2;
+  while ((pos < size) && ((data[pos] != TELE_SYNC1) || (data[pos+1] != TELE_SYNC2) || (data[pos+3] != TELE_FRAME_DATA))) pos++;
+  data[pos + 10] ^= 0x10;
+  TeleDecoder damaged;
+  damaged.decode(data, size);
+  printf("damaged frame: frames=%lu data=%lu lost=%lu crc errors=%lu value errors=%lu\n",
+    damaged.frames, damaged.dataFrames, damaged.lost, damaged.crcErrors, damaged.errors);
+  if ((damaged.frames != dec.frames - 1) || (damaged.dataFrames != dec.dataFrames - 1) || (damaged.crcErrors != 1)
+    || (damaged.errors != 0)) errors++;
+  free(data);
+  printf("errors=%d\n", errors);
+  return errors;
+}
+
+int main(int argc, char *argv[]){
+  if ((argc >= 2) && (strcmp(argv[1], "bench") == 0)) return bench();
+  if ((argc >= 3) && (strcmp(argv[1], "run") == 0)) return run(atol(argv[2]), (argc >= 4) ? argv[3] : NULL);
+  if ((argc >= 3) && (strcmp(argv[1], "flashlog") == 0)) return flashlog(atol(argv[2]));
+  if ((argc >= 2) && (strcmp(argv[1], "settings") == 0)) return settings();
+  if ((argc >= 3) && (strcmp(argv[1], "pfod") == 0)) return pfod(argc-2, &argv[2]);
+  if ((argc >= 2) && (strcmp(argv[1], "ahrs") == 0)) return ahrs((argc >= 3) ? argv[2] : NULL);
+  if ((argc >= 2) && (strcmp(argv[1], "i2c") == 0)) return i2c();
+  if ((argc >= 2) && (strcmp(argv[1], "median") == 0)) return median();
+  if ((argc >= 2) && (strcmp(argv[1], "obstmap") == 0)) return obstmap((argc >= 3) ? argv[2] : NULL, (argc >= 4) ? argv[3] : NULL);
+  if ((argc >= 2) && (strcmp(argv[1], "sender") == 0)) return sender();
+  if ((argc >= 2) && (strcmp(argv[1], "console") == 0)) return console();
+  if ((argc >= 2) && (strcmp(argv[1], "gps") == 0)) return gpsTest((argc >= 3) ? argv[2] : NULL, (argc >= 4) ? atol(argv[3]) : 115200);
+  if ((argc >= 2) && (strcmp(argv[1], "encoder") == 0)) return encoder();
+  if ((argc >= 2) && (strcmp(argv[1], "telemetry") == 0)) return telemetry();
+  printf("usage: %s bench | run N [flash.bin] | flashlog N | settings | pfod cmd... | ahrs [log.csv] | i2c | median\n"
+         "       | obstmap [map.pgm [log.csv]] | sender | console | gps [log.ubx [baud]] | encoder | telemetry\n", argv[0]);
+  return 1;
+}
+
@@ -0,0 +1,198 @@
+#!/usr/bin/env python
+#
+# Ardumower binary telemetry decoder
+#
+# Decodes the binary telemetry stream (pfodApp: Plot -> Binary telemetry -> Start stream,
+# see code/ardumower/telemetry.h) from a serial port or a captured file and writes
+# one CSV file per schema (channel selection), columns: time_s, <channels>
+#
+# usage:
+#   telemetry_decode.py --port COM5 --baud 19200 --out log     (requires pyserial)
+#   telemetry_decode.py --file capture.bin --out log
+#   telemetry_decode.py --file capture.bin --out log --parquet (requires pandas + pyarrow)
+#
+# frame: 0xA5 0x5A | version | type | seq | len | payload | crc16 (lo, hi)
+
+import argparse
+import struct
+import sys
+
+SYNC1 = 0xA5
+SYNC2 = 0x5A
+VERSION = 1
+FRAME_SCHEMA = 1
+FRAME_CHANNEL = 2
+FRAME_DATA = 3
+INT16 = 1
+INT32 = 2
+
+
+def crc16(data, crc=0xFFFF):
+  for b in data:
+    crc ^= b << 8
+    for _ in range(8):
+      if crc & 0x8000:
+        crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+      else:
+        crc = (crc << 1) & 0xFFFF
+  return crc
+
+
+class Schema:
+  def __init__(self, schema_id, group_mask, period, count):
+    self.schema_id = schema_id
+    self.group_mask = group_mask
+    self.period = period
+    self.count = count
+    self.channels = [None] * count   # (name, type, decimals)
+
+  def complete(self):
+    return all(c is not None for c in self.channels)
+
+  def names(self):
+    return [c[0] for c in self.channels]
+
+
+class Decoder:
+  def __init__(self, out, parquet=False):
+    self.out = out
+    self.parquet = parquet
+    self.buf = bytearray()
+    self.schema = None
+    self.tables = {}      # schema key -> (names, list of rows)
+    self.frames = 0
+    self.crc_errors = 0
+    self.lost = 0
+    self.short_frames = 0
+    self.last_seq = None
+    self.millis_base = 0
+    self.last_millis = None
+
+  def feed(self, data):
+    self.buf.extend(data)
+    while True:
+      # search sync
+      i = self.buf.find(bytes([SYNC1, SYNC2]))
+      if i < 0:
+        del self.buf[:-1]
+        return
+      del self.buf[:i]
+      if len(self.buf) < 6:
+        return
+      length = self.buf[5]
+      if len(self.buf) < 8 + length:
+        return
+      frame = bytes(self.buf[:8 + length])
+      crc = frame[6 + length] | (frame[7 + length] << 8)
+      if crc16(frame[2:6 + length]) != crc or frame[2] != VERSION:
+        self.crc_errors += 1
+        del self.buf[:1]    # resync
+        continue
+      del self.buf[:8 + length]
+      self.handle(frame[3], frame[4], frame[6:6 + length])
+
+  def handle(self, ftype, seq, payload):
+    self.frames += 1
+    if self.last_seq is not None:
+      self.lost += (seq - self.last_seq - 1) & 0xFF
+    self.last_seq = seq
+    if ftype == FRAME_SCHEMA:
+      if len(payload) < 5:
+        self.short_frames += 1
+        return
+      schema_id, group_mask, period, count = struct.unpack('<BBHB', payload[:5])
+      if self.schema is None or self.schema.schema_id != schema_id or self.schema.count != count:
+        self.schema = Schema(schema_id, group_mask, period, count)
+    elif ftype == FRAME_CHANNEL:
+      if len(payload) < 5:
+        self.short_frames += 1
+        return
+      schema_id, idx, ch, vtype, decimals = struct.unpack('<BBBBB', payload[:5])
+      name = payload[5:].decode('ascii', 'replace')
+      if self.schema is not None and self.schema.schema_id == schema_id and idx < self.schema.count:
+        self.schema.channels[idx] = (name, vtype, decimals)
+    elif ftype == FRAME_DATA:
+      if self.schema is None or not self.schema.complete():
+        return
+      if len(payload) < 5 or payload[0] != self.schema.schema_id:
+        return
+      millis = struct.unpack('<I', payload[1:5])[0]
+      pos = 5
+      row = [self.unwrap(millis) / 1000.0]
+      for name, vtype, decimals in self.schema.channels:
+        size = 2 if vtype == INT16 else 4
+        if pos + size > len(payload):
+          # frame shorter than its schema: skip it
+          self.short_frames += 1
+          return
+        if vtype == INT16:
+          raw = struct.unpack('<h', payload[pos:pos + 2])[0]
+          pos += 2
+        else:
+          raw = struct.unpack('<i', payload[pos:pos + 4])[0]
+          pos += 4
+        row.append(raw / (10.0 ** decimals) if decimals else raw)
+      key = (self.schema.schema_id, tuple(self.schema.names()))
+      if key not in self.tables:
+        self.tables[key] = (['time_s'] + self.schema.names(), [])
+      self.tables[key][1].append(row)
+
+  def unwrap(self, millis):
+    # millis() overflow (49 days)
+    if self.last_millis is not None and millis < self.last_millis and self.last_millis - millis > 0x80000000:
+      self.millis_base += 0x100000000
+    self.last_millis = millis
+    return self.millis_base + millis
+
+  def write(self):
+    files = []
+    for n, (key, (names, rows)) in enumerate(self.tables.items()):
+      name = '%s_%d' % (self.out, n)
+      if self.parquet:
+        import pandas
+        df = pandas.DataFrame(rows, columns=names)
+        df.to_parquet(name + '.parquet')
+        files.append(name + '.parquet')
+      else:
+        with open(name + '.csv', 'w') as f:
+          f.write(','.join(names) + '\n')
+          for row in rows:
+            f.write(','.join(str(v) for v in row) + '\n')
+        files.append(name + '.csv')
+    return files
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Ardumower binary telemetry decoder')
+  parser.add_argument('--port', help='serial port (e.g. COM5 or /dev/rfcomm0)')
+  parser.add_argument('--baud', type=int, default=19200)
+  parser.add_argument('--file', help='captured binary stream')
+  parser.add_argument('--out', default='telemetry', help='output file prefix')
+  parser.add_argument('--parquet', action='store_true', help='write parquet instead of CSV')
+  args = parser.parse_args()
+
+  dec = Decoder(args.out, args.parquet)
+  if args.file:
+    with open(args.file, 'rb') as f:
+      dec.feed(f.read())
+  elif args.port:
+    import serial
+    ser = serial.Serial(args.port, args.baud, timeout=0.5)
+    print('logging... press CTRL+C to stop')
+    try:
+      while True:
+        dec.feed(ser.read(256))
+    except KeyboardInterrupt:
+      pass
+  else:
+    parser.print_help()
+    return 1
+
+  for name in dec.write():
+    print('written %s' % name)
+  print('frames=%d crc_errors=%d lost=%d short=%d' % (dec.frames, dec.crc_errors, dec.lost, dec.short_frames))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())